@@ -80,6 +80,18 @@ typedef struct ZZJSON {
     struct ZZJSON *next;
 } ZZJSON;
 
+/* Streaming writer, emits JSON as it goes instead of building a tree */
+
+#define ZZJSON_WRITER_DEPTH     16
+
+typedef struct ZZJSON_WRITER {
+    ZZJSON_CONFIG *config;                      // needs the pr fields
+    unsigned int depth;                         // containers currently open
+    unsigned int count[ZZJSON_WRITER_DEPTH+1];  // values written in each
+    char close[ZZJSON_WRITER_DEPTH+1];          // '}' or ']'
+    int error;
+} ZZJSON_WRITER;
+
 /* Functions: */
 
 ZZJSON *zzjson_parse(ZZJSON_CONFIG *config);
@@ -113,4 +125,20 @@ ZZJSON *zzjson_object_prepend(ZZJSON_CONFIG *config, ZZJSON *object,
                                         char *label, ZZJSON *val);
 ZZJSON *zzjson_object_append (ZZJSON_CONFIG *config, ZZJSON *object,
                                         char *label, ZZJSON *val);
+
+/* label is NULL for array elements and top level values */
+void zzjson_writer_init(ZZJSON_WRITER *writer, ZZJSON_CONFIG *config);
+int zzjson_write_object(ZZJSON_WRITER *writer, const char *label);
+int zzjson_write_array(ZZJSON_WRITER *writer, const char *label);
+int zzjson_write_end(ZZJSON_WRITER *writer);      // closes the innermost
+int zzjson_write_end_all(ZZJSON_WRITER *writer);  // closes all
+int zzjson_write_string(ZZJSON_WRITER *writer, const char *label,
+                                               const char *s);
+int zzjson_write_number_i(ZZJSON_WRITER *writer, const char *label,
+                                                 long long i);
+int zzjson_write_number_d(ZZJSON_WRITER *writer, const char *label,
+                                                 double d);
+int zzjson_write_true(ZZJSON_WRITER *writer, const char *label);
+int zzjson_write_false(ZZJSON_WRITER *writer, const char *label);
+int zzjson_write_null(ZZJSON_WRITER *writer, const char *label);
 #endif
@@ -0,0 +1,164 @@
+/* JSON Streaming Writer
+ * ZZJSON - Copyright (C) 2008 by Ivo van Poorten
+ * License: GNU Lesser General Public License version 2.1
+ *
+ * Emits much the same layout as zzjson_print(), but straight through
+ * config->print as the values come, so that large documents need no
+ * tree and no memory beyond the nesting state.
+ */
+
+#include "zzjson.h"
+#include <string.h>
+
+#ifdef CONFIG_NO_ERROR_MESSAGES
+#define ERROR(x...)
+#else
+#define ERROR(x...)     writer->config->error(writer->config->ehandle, ##x)
+#endif
+
+#define PRINT(fmt...)   if (writer->config->print(writer->config->ohandle, \
+                                ##fmt) < 0) return fail(writer);
+#define INC 4
+
+static int fail(ZZJSON_WRITER *writer) {
+    if (!writer->error) ERROR("write: unable to print");
+    writer->error = -1;
+    return -1;
+}
+
+/* Copy runs of plain characters in one go, escape the rest */
+static int write_string(ZZJSON_WRITER *writer, const char *s) {
+    const char *run;
+    int c;
+
+    if (!s) return 0;
+    while (*s) {
+        for (run = s; *s && *s != '"' && *s != '\\' &&
+                                    (unsigned char)*s >= 0x20; s++) ;
+        if (s > run) PRINT("%.*s", (int)(s - run), run);
+        if (!*s) break;
+
+        c = (unsigned char)*s++;
+        switch (c) {
+            case '"':
+            case '\\':                      break;
+            case '\b':  c = 'b';            break;
+            case '\f':  c = 'f';            break;
+            case '\n':  c = 'n';            break;
+            case '\r':  c = 'r';            break;
+            case '\t':  c = 't';            break;
+            default:
+                PRINT("\\u%04x", c);
+                continue;
+        }
+        PRINT("\\%c", c);
+    }
+    return 0;
+}
+
+/* Separate from the previous value, indent, and print the label if any */
+static int write_prefix(ZZJSON_WRITER *writer, const char *label) {
+    unsigned int depth = writer->depth;
+
+    if (writer->error) return -1;
+
+    if (depth) {
+        PRINT("%s\n%*s", writer->count[depth] ? "," : "", depth * INC, "");
+    }
+    writer->count[depth]++;
+
+    if (label) {
+        PRINT("\"");
+        if (write_string(writer, label) < 0) return -1;
+        PRINT("\" : ");
+    }
+    return 0;
+}
+
+static int write_open(ZZJSON_WRITER *writer, const char *label,
+                                             char open, char close) {
+    if (writer->depth == ZZJSON_WRITER_DEPTH) {
+        ERROR("write: too deeply nested");
+        writer->error = -1;
+        return -1;
+    }
+    if (write_prefix(writer, label) < 0) return -1;
+    PRINT("%c", open);
+
+    writer->depth++;
+    writer->count[writer->depth] = 0;
+    writer->close[writer->depth] = close;
+    return 0;
+}
+
+void zzjson_writer_init(ZZJSON_WRITER *writer, ZZJSON_CONFIG *config) {
+    memset(writer, 0, sizeof(ZZJSON_WRITER));
+    writer->config = config;
+}
+
+int zzjson_write_object(ZZJSON_WRITER *writer, const char *label) {
+    return write_open(writer, label, '{', '}');
+}
+
+int zzjson_write_array(ZZJSON_WRITER *writer, const char *label) {
+    return write_open(writer, label, '[', ']');
+}
+
+int zzjson_write_end(ZZJSON_WRITER *writer) {
+    if (writer->error) return -1;
+    if (!writer->depth) {
+        ERROR("write: nothing to close");
+        writer->error = -1;
+        return -1;
+    }
+    writer->depth--;
+    PRINT("\n%*s%c", writer->depth * INC, "", writer->close[writer->depth+1]);
+    return 0;
+}
+
+int zzjson_write_end_all(ZZJSON_WRITER *writer) {
+    while (writer->depth)
+        if (zzjson_write_end(writer) < 0) return -1;
+    return writer->error;
+}
+
+int zzjson_write_string(ZZJSON_WRITER *writer, const char *label,
+                                               const char *s) {
+    if (write_prefix(writer, label) < 0) return -1;
+    PRINT("\"");
+    if (write_string(writer, s) < 0) return -1;
+    PRINT("\"");
+    return 0;
+}
+
+int zzjson_write_number_i(ZZJSON_WRITER *writer, const char *label,
+                                                 long long i) {
+    if (write_prefix(writer, label) < 0) return -1;
+    PRINT("%lld", i);
+    return 0;
+}
+
+int zzjson_write_number_d(ZZJSON_WRITER *writer, const char *label,
+                                                 double d) {
+    if (write_prefix(writer, label) < 0) return -1;
+    PRINT("%16.16e", d);
+    return 0;
+}
+
+int zzjson_write_true(ZZJSON_WRITER *writer, const char *label) {
+    if (write_prefix(writer, label) < 0) return -1;
+    PRINT("true");
+    return 0;
+}
+
+int zzjson_write_false(ZZJSON_WRITER *writer, const char *label) {
+    if (write_prefix(writer, label) < 0) return -1;
+    PRINT("false");
+    return 0;
+}
+
+int zzjson_write_null(ZZJSON_WRITER *writer, const char *label) {
+    if (write_prefix(writer, label) < 0) return -1;
+    PRINT("null");
+    return 0;
+}
@@ -285,4 +285,5 @@ struct cli_mode_descr acpi_mode = {
     .default_modules = NULL,
     .show_modules = &acpi_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_ACPI,
 };
@@ -260,4 +260,5 @@ struct cli_mode_descr cpu_mode = {
     .default_modules = NULL,
     .show_modules = &cpu_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_CPU,
 };
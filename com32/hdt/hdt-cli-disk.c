@@ -247,4 +247,5 @@ struct cli_mode_descr disk_mode = {
     .default_modules = NULL,
     .show_modules = &disk_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_DISKS,
 };
@@ -687,4 +687,5 @@ struct cli_mode_descr dmi_mode = {
     .default_modules = NULL,
     .show_modules = &dmi_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_DMI | HDT_DETECT_MEMORY,
 };
@@ -259,6 +259,15 @@ static void do_dump(int argc __unused, char **argv __unused,
     dump(hardware);
 }
 
+/**
+ * do_snapshot - save the probe results, to be loaded on the next start
+ **/
+static void do_snapshot(int argc __unused, char **argv __unused,
+			struct s_hardware *hardware)
+{
+    save_snapshot(hardware);
+}
+
 /* Default hdt mode */
 struct cli_callback_descr list_hdt_default_modules[] = {
     {
@@ -289,6 +298,10 @@ struct cli_callback_descr list_hdt_default_modules[] = {
      .name = CLI_DUMP,
      .exec = do_dump,
      },
+    {
+     .name = CLI_SNAPSHOT,
+     .exec = do_snapshot,
+     },
     {
      .name = NULL,
      .exec = NULL},
@@ -387,4 +400,6 @@ struct cli_mode_descr hdt_mode = {
     .default_modules = &hdt_default_modules,
     .show_modules = &hdt_show_modules,
     .set_modules = &hdt_set_modules,
+    .detect = HDT_DETECT_CPU | HDT_DETECT_DMI | HDT_DETECT_MEMORY |
+	      HDT_DETECT_PCI | HDT_DETECT_PXE,
 };
@@ -145,4 +145,5 @@ struct cli_mode_descr kernel_mode = {
     .default_modules = NULL,
     .show_modules = &kernel_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_PCI,
 };
@@ -131,4 +131,5 @@ struct cli_mode_descr memory_mode = {
     .default_modules = NULL,
     .show_modules = &memory_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_DMI | HDT_DETECT_MEMORY,
 };
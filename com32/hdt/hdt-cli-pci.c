@@ -288,4 +288,5 @@ struct cli_mode_descr pci_mode = {
     .default_modules = NULL,
     .show_modules = &pci_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_PCI | HDT_DETECT_PXE,
 };
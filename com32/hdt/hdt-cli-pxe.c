@@ -94,4 +94,5 @@ struct cli_mode_descr pxe_mode = {
     .default_modules = NULL,
     .show_modules = &pxe_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_PXE,
 };
@@ -137,4 +137,5 @@ struct cli_mode_descr vesa_mode = {
     .default_modules = &vesa_commands,
     .show_modules = &vesa_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_VESA,
 };
@@ -77,4 +77,5 @@ struct cli_mode_descr vpd_mode = {
     .default_modules = NULL,
     .show_modules = &vpd_show_modules,
     .set_modules = NULL,
+    .detect = HDT_DETECT_VPD,
 };
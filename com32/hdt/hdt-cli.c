@@ -159,6 +159,7 @@ void set_mode(cli_mode_t mode, struct s_hardware *hardware)
 	snprintf(hdt_cli.prompt, sizeof(hdt_cli.prompt), "%s> ", CLI_CPU);
 	break;
     case DMI_MODE:
+	detect_hardware(hardware, HDT_DETECT_DMI);
 	if (!hardware->is_dmi_valid) {
 	    printf("No valid DMI table found, exiting.\n");
 	    break;
@@ -171,6 +172,7 @@ void set_mode(cli_mode_t mode, struct s_hardware *hardware)
 	snprintf(hdt_cli.prompt, sizeof(hdt_cli.prompt), "%s> ", CLI_DISK);
 	break;
     case VPD_MODE:
+	detect_hardware(hardware, HDT_DETECT_VPD);
 	if (!hardware->is_vpd_valid) {
 	    printf("No valid VPD table found, exiting.\n");
 	    break;
@@ -612,6 +614,34 @@ out:
     return;
 }
 
+/**
+ * detect_for_command - probe what a show command is about to display
+ * @command:	first token in the line
+ * @module:	second token in the line, if any
+ *
+ * The hardware is only probed when first needed: "show <module>" needs
+ * what the mode of that name needs, anything else shown needs what the
+ * current mode needs.
+ **/
+static void detect_for_command(struct s_hardware *hardware, char *command,
+			       char *module)
+{
+    struct cli_mode_descr *mode = current_mode;
+    cli_mode_t module_mode;
+
+    if (strncmp(command, CLI_SHOW, sizeof(CLI_SHOW) - 1))
+	return;
+
+    if (module != NULL) {
+	module_mode = mode_s_to_mode_t(module);
+	if (module_mode != INVALID_MODE)
+	    find_cli_mode_descr(module_mode, &mode);
+    }
+
+    if (mode != NULL)
+	detect_hardware(hardware, mode->detect);
+}
+
 /**
  * exec_command - main logic to map the command line to callbacks
  **/
@@ -631,6 +661,9 @@ static void exec_command(char *line, struct s_hardware *hardware)
      */
     expand_aliases(line, &command, &module, &argc, argv);
 
+    if (command != NULL)
+	detect_for_command(hardware, command, module);
+
     if (module == NULL) {
 	dprintf("CLI DEBUG: single command detected\n");
 	/*
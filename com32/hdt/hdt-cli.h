@@ -66,6 +66,7 @@
 #define CLI_ENABLE "enable"
 #define CLI_DISABLE "disable"
 #define CLI_DUMP "dump"
+#define CLI_SNAPSHOT "snapshot"
 
 typedef enum {
     INVALID_MODE,
@@ -107,6 +108,8 @@ struct cli_mode_descr {
     struct cli_module_descr *show_modules;
     /* Handle set <module> <args> */
     struct cli_module_descr *set_modules;
+    /* Subsystems to probe before showing anything (HDT_DETECT_*) */
+    unsigned int detect;
 };
 
 /* Describe a subset of commands in a module (default, show, set, ...) */
@@ -115,6 +115,9 @@ void detect_parameters(const int argc, const char *argv[],
 	} else if (!strncmp(argv[i], "tftp_ip=", 8)) {
 	    strlcpy(hardware->tftp_ip, argv[i] + 8,
 		    sizeof(hardware->tftp_ip));
+	} else if (!strncmp(argv[i], "snapshot=", 9)) {
+	    strlcpy(hardware->snapshot_path, argv[i] + 9,
+		    sizeof(hardware->snapshot_path));
 	} else if (!strncmp(argv[i], "postexec=", 9)) {
 	    /* The postexec= parameter is separated in several argv[]
 	     * as it can contains spaces.
@@ -232,6 +235,7 @@ void init_hardware(struct s_hardware *hardware)
     memset(hardware->vesa_background, 0, sizeof hardware->vesa_background);
     memset(hardware->tftp_ip, 0, sizeof hardware->tftp_ip);
     memset(hardware->postexec, 0, sizeof hardware->postexec);
+    memset(hardware->snapshot_path, 0, sizeof hardware->snapshot_path);
     strcat(hardware->dump_path, "hdt");
     strcat(hardware->dump_filename, "%{m}+%{p}+%{v}");
     strcat(hardware->pciids_path, "pci.ids");
@@ -419,6 +423,9 @@ int detect_pxe(struct s_hardware *hardware)
     if (hardware->sv->filesystem != SYSLINUX_FS_PXELINUX) {
 	return -1;
     }
+
+    /* We look for the NIC among the PCI devices */
+    detect_pci(hardware);
 // printf("PXE: PXElinux detected\n");
     if (!pxe_get_cached_info(PXENV_PACKET_TYPE_DHCP_ACK, &dhcpdata, &dhcplen)) {
 	pxe_bootp_t *dhcp = &hardware->pxe.dhcpdata;
@@ -583,6 +590,11 @@ void cpu_detect(struct s_hardware *hardware)
 {
     if (hardware->cpu_detection == true)
 	return;
+
+    /* The DMI and ACPI tables complete what the cpu tells us */
+    detect_dmi(hardware);
+    detect_acpi(hardware);
+
     detect_cpu(&hardware->cpu);
     /* Old processors doesn't manage the identify commands 
      * Let's use the dmi value in that case */
@@ -726,50 +738,76 @@ void init_console(struct s_hardware *hardware)
 	console_ansi_raw();
 }
 
-void detect_hardware(struct s_hardware *hardware)
+/*
+ * Probe the subsystems in "what" which haven't been probed yet; each
+ * one is only probed once, on the first call which asks for it.
+ */
+void detect_hardware(struct s_hardware *hardware, unsigned int what)
 {
-    if (!quiet)
-        more_printf("ACPI: Detecting\n");
-    detect_acpi(hardware);
+    if (what & HDT_DETECT_CPU)
+	what |= HDT_DETECT_DMI | HDT_DETECT_ACPI;
+    if (what & HDT_DETECT_PXE)
+	what |= HDT_DETECT_PCI;
+
+    if ((what & HDT_DETECT_ACPI) && !hardware->acpi_detection) {
+	if (!quiet)
+	    more_printf("ACPI: Detecting\n");
+	detect_acpi(hardware);
+    }
 
-    if (!quiet)
-        more_printf("MEMORY: Detecting\n");
-    detect_memory(hardware);
+    if ((what & HDT_DETECT_MEMORY) && !hardware->memory_detection) {
+	if (!quiet)
+	    more_printf("MEMORY: Detecting\n");
+	detect_memory(hardware);
+    }
 
-    if (!quiet)
-        more_printf("DMI: Detecting Table\n");
-    if (detect_dmi(hardware) == -ENODMITABLE) {
-        printf("DMI: ERROR ! Table not found ! \n");
-        printf("DMI: Many hardware components will not be detected ! \n");
-    } else {
-        if (!quiet)
-            more_printf("DMI: Table found ! (version %u.%u)\n",
-                        hardware->dmi.dmitable.major_version,
-                        hardware->dmi.dmitable.minor_version);
+    if ((what & HDT_DETECT_DMI) && !hardware->dmi_detection) {
+	if (!quiet)
+	    more_printf("DMI: Detecting Table\n");
+	if (detect_dmi(hardware) == -ENODMITABLE) {
+	    printf("DMI: ERROR ! Table not found ! \n");
+	    printf("DMI: Many hardware components will not be detected ! \n");
+	} else {
+	    if (!quiet)
+		more_printf("DMI: Table found ! (version %u.%u)\n",
+			    hardware->dmi.dmitable.major_version,
+			    hardware->dmi.dmitable.minor_version);
+	}
     }
 
-    if (!quiet)
-        more_printf("CPU: Detecting\n");
-    cpu_detect(hardware);
+    if ((what & HDT_DETECT_CPU) && !hardware->cpu_detection) {
+	if (!quiet)
+	    more_printf("CPU: Detecting\n");
+	cpu_detect(hardware);
+    }
 
-    if (!quiet)
-        more_printf("DISKS: Detecting\n");
-    detect_disks(hardware);
+    if ((what & HDT_DETECT_DISKS) && !hardware->disk_detection) {
+	if (!quiet)
+	    more_printf("DISKS: Detecting\n");
+	detect_disks(hardware);
+    }
 
-    if (!quiet)
-        more_printf("VPD: Detecting\n");
-    detect_vpd(hardware);
+    if ((what & HDT_DETECT_VPD) && !hardware->vpd_detection) {
+	if (!quiet)
+	    more_printf("VPD: Detecting\n");
+	detect_vpd(hardware);
+    }
 
-    detect_pci(hardware);
-    if (!quiet)
-        more_printf("PCI: %d Devices Found\n", hardware->nb_pci_devices);
- 
-   if (!quiet)
-        more_printf("PXE: Detecting\n");
-    detect_pxe(hardware);
+    if ((what & HDT_DETECT_PCI) && !hardware->pci_detection) {
+	detect_pci(hardware);
+	if (!quiet)
+	    more_printf("PCI: %d Devices Found\n", hardware->nb_pci_devices);
+    }
 
-    if (!quiet)
-        more_printf("VESA: Detecting\n");
-    detect_vesa(hardware);
-}
+    if ((what & HDT_DETECT_PXE) && !hardware->pxe_detection) {
+	if (!quiet)
+	    more_printf("PXE: Detecting\n");
+	detect_pxe(hardware);
+    }
 
+    if ((what & HDT_DETECT_VESA) && !hardware->vesa_detection) {
+	if (!quiet)
+	    more_printf("VESA: Detecting\n");
+	detect_vesa(hardware);
+    }
+}
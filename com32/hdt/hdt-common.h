@@ -82,6 +82,18 @@
 #define MAX_CLI_LINES 20
 #define MAX_VESA_CLI_LINES 24
 
+/* Subsystems to probe, for detect_hardware() */
+#define HDT_DETECT_ACPI		0x001
+#define HDT_DETECT_MEMORY	0x002
+#define HDT_DETECT_DMI		0x004
+#define HDT_DETECT_CPU		0x008	/* Needs DMI and ACPI */
+#define HDT_DETECT_DISKS	0x010
+#define HDT_DETECT_VPD		0x020
+#define HDT_DETECT_PCI		0x040
+#define HDT_DETECT_PXE		0x080	/* Needs PCI */
+#define HDT_DETECT_VESA		0x100
+#define HDT_DETECT_ALL		0x1ff
+
 struct upload_backend *upload;
 
 /* Defines if the cli is quiet*/
@@ -220,6 +232,7 @@ struct s_hardware {
     char auto_label[AUTO_COMMAND_SIZE];
     char vesa_background[255];
     char postexec[255];
+    char snapshot_path[255]; /* Probe snapshot to load or save */
 };
 
 void reset_more_printf(void);
@@ -243,6 +256,8 @@ void detect_parameters(const int argc, const char *argv[],
 int detect_vesa(struct s_hardware *hardware);
 void detect_memory(struct s_hardware *hardware);
 void init_console(struct s_hardware *hardware);
-void detect_hardware(struct s_hardware *hardware);
+void detect_hardware(struct s_hardware *hardware, unsigned int what);
 void dump(struct s_hardware *hardware);
+int load_snapshot(struct s_hardware *hardware);
+int save_snapshot(struct s_hardware *hardware);
 #endif
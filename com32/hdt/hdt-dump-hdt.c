@@ -30,7 +30,7 @@
 #include "hdt-dump.h"
 #include <syslinux/config.h>
 
-void dump_hdt(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item) {
+void dump_hdt(struct s_hardware *hardware, ZZJSON_WRITER *writer) {
 
 	(void) hardware;
 	CREATE_NEW_OBJECT;
@@ -29,8 +29,7 @@
 #include "hdt-common.h"
 #include "hdt-dump.h"
 
-void dump_kernel(struct s_hardware *hardware, ZZJSON_CONFIG * config,
-		 ZZJSON ** item)
+void dump_kernel(struct s_hardware *hardware, ZZJSON_WRITER *writer)
 {
     struct pci_device *pci_device = NULL;
     CREATE_ARRAY
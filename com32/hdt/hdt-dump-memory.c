@@ -30,7 +30,7 @@
 #include "hdt-common.h"
 #include "hdt-dump.h"
 
-void dump_88(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item) {
+void dump_88(struct s_hardware *hardware, ZZJSON_WRITER *writer) {
 
 	(void) hardware;
 	int mem_size = 0;
@@ -47,7 +47,7 @@ void dump_88(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item)
 	FLUSH_OBJECT;
 }
 
-void dump_e801(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item) {
+void dump_e801(struct s_hardware *hardware, ZZJSON_WRITER *writer) {
 
 	(void) hardware;
 	int mem_low, mem_high = 0;
@@ -68,7 +68,7 @@ void dump_e801(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item
 	FLUSH_OBJECT;
 
 }
-void dump_e820(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item) {
+void dump_e820(struct s_hardware *hardware, ZZJSON_WRITER *writer) {
     
 	(void) hardware;
 	struct e820entry map[E820MAX];
@@ -120,14 +120,14 @@ void dump_e820(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item
 	}
 }
 
-void dump_memory(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item) {
+void dump_memory(struct s_hardware *hardware, ZZJSON_WRITER *writer) {
 
 	CREATE_NEW_OBJECT;
 		add_s("Memory configuration","true");
 	FLUSH_OBJECT;
 
-	dump_88(hardware,config,item);
-	dump_e801(hardware,config,item);
-	dump_e820(hardware,config,item);
+	dump_88(hardware,writer);
+	dump_e801(hardware,writer);
+	dump_e820(hardware,writer);
 	to_cpio("memory");
 }
@@ -30,7 +30,7 @@
 #include "hdt-dump.h"
 #include <syslinux/config.h>
 
-void dump_vesa(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item) {
+void dump_vesa(struct s_hardware *hardware, ZZJSON_WRITER *writer) {
 
 	CREATE_NEW_OBJECT;
 	add_hb(is_vesa_valid);
@@ -143,18 +143,13 @@ void to_cpio(char *filename)
     }
 }
 
-void flush(ZZJSON_CONFIG * config, ZZJSON ** item)
-{
-    zzjson_print(config, *item);
-    zzjson_free(config, *item);
-    *item = NULL;
-}
-
 /**
  * dump - dump info
  **/
 void dump(struct s_hardware *hardware)
 {
+    detect_hardware(hardware, HDT_DETECT_ALL);
+
     if (hardware->is_pxe_valid == false) {
 	printf("PXE stack was not detected, Dump feature is not available\n");
 	return;
@@ -162,7 +157,7 @@ void dump(struct s_hardware *hardware)
 
     const union syslinux_derivative_info *sdi = syslinux_derivative_info();
     int err = 0;
-    ZZJSON *json = NULL;
+    ZZJSON_WRITER writer;
     ZZJSON_CONFIG config = { ZZJSON_VERY_STRICT, NULL,
 	(int (*)(void *))fgetc,
 	NULL,
@@ -173,6 +168,7 @@ void dump(struct s_hardware *hardware)
     };
 
     memset(&p_buf, 0, sizeof(p_buf));
+    zzjson_writer_init(&writer, &config);
 
     /* By now, we only support TFTP reporting */
     upload = &upload_tftp;
@@ -202,18 +198,18 @@ void dump(struct s_hardware *hardware)
     /* We initiate the cpio to send */
     cpio_init(upload, (const char **)arg);
 
-    dump_cpu(hardware, &config, &json);
-    dump_pxe(hardware, &config, &json);
-    dump_syslinux(hardware, &config, &json);
-    dump_vpd(hardware, &config, &json);
-    dump_vesa(hardware, &config, &json);
-    dump_disks(hardware, &config, &json);
-    dump_dmi(hardware, &config, &json);
-    dump_memory(hardware, &config, &json);
-    dump_pci(hardware, &config, &json);
-    dump_acpi(hardware, &config, &json);
-    dump_kernel(hardware, &config, &json);
-    dump_hdt(hardware, &config, &json);
+    dump_cpu(hardware, &writer);
+    dump_pxe(hardware, &writer);
+    dump_syslinux(hardware, &writer);
+    dump_vpd(hardware, &writer);
+    dump_vesa(hardware, &writer);
+    dump_disks(hardware, &writer);
+    dump_dmi(hardware, &writer);
+    dump_memory(hardware, &writer);
+    dump_pci(hardware, &writer);
+    dump_acpi(hardware, &writer);
+    dump_kernel(hardware, &writer);
+    dump_hdt(hardware, &writer);
 
     /* We close & flush the file to send */
     cpio_close(upload);
@@ -34,52 +34,55 @@
 #include <zzjson/zzjson.h>
 #include "hdt-common.h"
 
+/*
+ * The JSON is written out as these macros go, through the writer: an
+ * object or array is complete once the next one starts, or at
+ * FLUSH_OBJECT.
+ */
+
 // Macros to manipulate Arrays
-#define APPEND_ARRAY ZZJSON *temp_array; temp_array = zzjson_array_append(config, *item, zzjson_create_object(config,
-#define APPEND_OBJECT_ARRAY(value) ZZJSON *temp_ar; temp_ar = zzjson_array_append(config, *item, value); *item=temp_ar; 
-#define CREATE_ARRAY *item = zzjson_create_array(config, zzjson_create_object(config, 
-#define add_ai(name,value) name,zzjson_create_number_i(config,value),
+#define CREATE_ARRAY zzjson_write_end_all(writer); zzjson_write_array(writer, NULL); zzjson_write_object(writer, NULL);
+#define APPEND_ARRAY zzjson_write_object(writer, NULL);
+#define add_ai(name,value) add_i(name,value);
 #define add_ahi(value) add_ai(#value,hardware->value)
-#define add_as(name,value) name,zzjson_create_string(config,value),
+#define add_as(name,value) add_s(name,value);
 #define add_ahs(value) add_as(#value,hardware->value)
-#define END_OF_ARRAY NULL),NULL)
-#define END_OF_APPEND NULL)); *item=temp_array;
+#define END_OF_ARRAY zzjson_write_end(writer)
+#define END_OF_APPEND zzjson_write_end(writer);
 
 // Macros to manipulate objects
-#define CREATE_NEW_OBJECT   *item = zzjson_create_object(config, NULL);
-#define FLUSH_OBJECT flush(config, item); 
+#define CREATE_NEW_OBJECT zzjson_write_end_all(writer); zzjson_write_object(writer, NULL);
+#define FLUSH_OBJECT zzjson_write_end_all(writer);
 
 // Macros to manipulate integers as objects
-#define add_i(name,value) *item = zzjson_object_append(config, *item, name, zzjson_create_number_i(config, value))
+#define add_i(name,value) zzjson_write_number_i(writer, name, value)
 #define add_hi(value) add_i(#value,hardware->value)
 
 // Macros to manipulate strings as objects
-#define add_s(name,value) *item = zzjson_object_append(config, *item, name, zzjson_create_string(config, value))
+#define add_s(name,value) zzjson_write_string(writer, name, value)
 #define add_hs(value) add_s(#value,(char *)hardware->value)
 
 // Macros to manipulate bool as objects
-#define add_bool_true(name) *item = zzjson_object_append(config, *item, (char *)name, zzjson_create_true(config))
-#define add_bool_false(name) *item = zzjson_object_append(config, *item, (char*)name, zzjson_create_false(config))
+#define add_bool_true(name) zzjson_write_true(writer, name)
+#define add_bool_false(name) zzjson_write_false(writer, name)
 #define add_b(name,value) if (value==true) {add_bool_true(name);} else {add_bool_false(name);}
 #define add_hb(value) add_b(#value,hardware->value)
 
 extern struct print_buf p_buf;
 
-void print_and_flush(ZZJSON_CONFIG *config, ZZJSON **item);
 int dumpprintf(FILE *p, const char *format, ...);
-void flush (ZZJSON_CONFIG *config, ZZJSON ** item);
 void to_cpio(char *filename);
 
-void dump_cpu(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_pxe(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_syslinux(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_vpd(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_vesa(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_disks(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_dmi(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_memory(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_pci(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_acpi(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_kernel(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
-void dump_hdt(struct s_hardware *hardware, ZZJSON_CONFIG *config, ZZJSON **item);
+void dump_cpu(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_pxe(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_syslinux(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_vpd(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_vesa(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_disks(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_dmi(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_memory(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_pci(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_acpi(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_kernel(struct s_hardware *hardware, ZZJSON_WRITER *writer);
+void dump_hdt(struct s_hardware *hardware, ZZJSON_WRITER *writer);
 void dump(struct s_hardware *hardware);
@@ -37,6 +37,9 @@ int start_menu_mode(struct s_hardware *hardware, char *version_string)
 
     memset(&hdt_menu, 0, sizeof(hdt_menu));
 
+    /* The menus are built once, with everything in them */
+    detect_hardware(hardware, HDT_DETECT_ALL);
+
     /* Setup the menu system */
     setup_menu(version_string);
 
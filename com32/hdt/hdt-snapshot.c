@@ -0,0 +1,193 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Erwan Velu - All Rights Reserved
+ *
+ *   Permission is hereby granted, free of charge, to any person
+ *   obtaining a copy of this software and associated documentation
+ *   files (the "Software"), to deal in the Software without
+ *   restriction, including without limitation the rights to use,
+ *   copy, modify, merge, publish, distribute, sublicense, and/or
+ *   sell copies of the Software, and to permit persons to whom
+ *   the Software is furnished to do so, subject to the following
+ *   conditions:
+ *
+ *   The above copyright notice and this permission notice shall
+ *   be included in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *   OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * -----------------------------------------------------------------------
+ */
+
+/*
+ * hdt-snapshot.c
+ *
+ * Save the results of the slowest probes, the INT 13h scan of the disks
+ * and the list of VESA modes, so that the next run on the same machine
+ * can load them instead of probing again.  The snapshot is uploaded by
+ * TFTP like a dump ("snapshot" command), and loaded at startup from the
+ * file given by snapshot=.  It is only used if the DMI identity and the
+ * memory size of the machine match the ones it was saved with.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getkey.h>
+#include <syslinux/config.h>
+#include <syslinux/zio.h>
+#include "hdt-common.h"
+
+#define SNAPSHOT_MAGIC		0x53544448	/* "HDTS" */
+#define SNAPSHOT_VERSION	1
+
+/* Identifies the machine, and the layout of what follows */
+struct snapshot_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t driveinfo_size;
+    uint32_t vesa_size;
+    uint32_t memory_size;
+    char manufacturer[SYSTEM_MANUFACTURER_SIZE];
+    char product_name[SYSTEM_PRODUCT_NAME_SIZE];
+    char serial[SYSTEM_SERIAL_SIZE];
+    char uuid[SYSTEM_UUID_SIZE];
+};
+
+/*
+ * Followed by:
+ *   int disks_count, struct driveinfo disk_info[256], uint32_t mbr_ids[256]
+ *   bool is_vesa_valid, struct s_vesa vesa
+ */
+
+static void fill_header(struct s_hardware *hardware,
+			struct snapshot_header *hdr)
+{
+    memset(hdr, 0, sizeof *hdr);
+    hdr->magic = SNAPSHOT_MAGIC;
+    hdr->version = SNAPSHOT_VERSION;
+    hdr->header_size = sizeof *hdr;
+    hdr->driveinfo_size = sizeof(struct driveinfo);
+    hdr->vesa_size = sizeof(struct s_vesa);
+    hdr->memory_size = hardware->detected_memory_size;
+    strlcpy(hdr->manufacturer, hardware->dmi.system.manufacturer,
+	    sizeof hdr->manufacturer);
+    strlcpy(hdr->product_name, hardware->dmi.system.product_name,
+	    sizeof hdr->product_name);
+    strlcpy(hdr->serial, hardware->dmi.system.serial, sizeof hdr->serial);
+    strlcpy(hdr->uuid, hardware->dmi.system.uuid, sizeof hdr->uuid);
+}
+
+/*
+ * Load the snapshot, if it was made on this machine; the subsystems it
+ * holds are then considered detected.
+ */
+int load_snapshot(struct s_hardware *hardware)
+{
+    struct snapshot_header want, hdr;
+    int disks_count;
+    bool is_vesa_valid;
+    FILE *f;
+
+    /* The DMI table tells us which machine this is */
+    detect_hardware(hardware, HDT_DETECT_DMI | HDT_DETECT_MEMORY);
+    if (!hardware->is_dmi_valid)
+	return -1;
+    fill_header(hardware, &want);
+
+    f = zfopen(hardware->snapshot_path, "r");
+    if (!f)
+	return -1;
+
+    if (fread(&hdr, sizeof hdr, 1, f) != 1 ||
+	memcmp(&hdr, &want, sizeof hdr))
+	goto bad;
+
+    if (fread(&disks_count, sizeof disks_count, 1, f) != 1 ||
+	fread(hardware->disk_info, sizeof hardware->disk_info, 1, f) != 1 ||
+	fread(hardware->mbr_ids, sizeof hardware->mbr_ids, 1, f) != 1 ||
+	fread(&is_vesa_valid, sizeof is_vesa_valid, 1, f) != 1 ||
+	fread(&hardware->vesa, sizeof hardware->vesa, 1, f) != 1) {
+	memset(hardware->disk_info, 0, sizeof hardware->disk_info);
+	memset(hardware->mbr_ids, 0, sizeof hardware->mbr_ids);
+	memset(&hardware->vesa, 0, sizeof hardware->vesa);
+	goto bad;
+    }
+    fclose(f);
+
+    hardware->disks_count = disks_count;
+    hardware->disk_detection = true;
+    hardware->is_vesa_valid = is_vesa_valid;
+    hardware->vesa_detection = true;
+
+    if (!quiet)
+	more_printf("SNAPSHOT: Loaded %s\n", hardware->snapshot_path);
+    return 0;
+
+bad:
+    fclose(f);
+    if (!quiet)
+	more_printf("SNAPSHOT: %s doesn't match this machine, ignored\n",
+		    hardware->snapshot_path);
+    return -1;
+}
+
+/* Probe what goes into a snapshot, and upload it by TFTP */
+int save_snapshot(struct s_hardware *hardware)
+{
+    struct snapshot_header hdr;
+    const char *arg[3];
+    int err;
+
+    if (strlen(hardware->snapshot_path) == 0) {
+	printf("No snapshot file, please use the snapshot= parameter\n");
+	return -1;
+    }
+
+    if (hardware->sv->filesystem != SYSLINUX_FS_PXELINUX) {
+	printf("Snapshots are uploaded by TFTP, which needs PXELINUX\n");
+	return -1;
+    }
+
+    detect_hardware(hardware, HDT_DETECT_DMI | HDT_DETECT_MEMORY |
+		    HDT_DETECT_DISKS | HDT_DETECT_VESA);
+    if (!hardware->is_dmi_valid) {
+	printf("No DMI table, a snapshot couldn't be matched to this machine\n");
+	return -1;
+    }
+    fill_header(hardware, &hdr);
+
+    arg[0] = hardware->snapshot_path;
+    arg[1] = strlen(hardware->tftp_ip) ? hardware->tftp_ip : NULL;
+    arg[2] = NULL;
+
+    upload = &upload_tftp;
+    if (init_data(upload, arg))
+	return -1;
+
+    write_data(upload, &hdr, sizeof hdr);
+    write_data(upload, &hardware->disks_count, sizeof hardware->disks_count);
+    write_data(upload, hardware->disk_info, sizeof hardware->disk_info);
+    write_data(upload, hardware->mbr_ids, sizeof hardware->mbr_ids);
+    write_data(upload, &hardware->is_vesa_valid,
+	       sizeof hardware->is_vesa_valid);
+    write_data(upload, &hardware->vesa, sizeof hardware->vesa);
+
+    if ((err = flush_data(upload)) != TFTP_OK) {
+	more_printf("Snapshot failed !\n");
+	more_printf("TFTP ERROR on  : %s\n", hardware->snapshot_path);
+	more_printf("TFTP ERROR msg : %s \n", tftp_string_error_message[-err]);
+	return -1;
+    }
+
+    more_printf("Snapshot sent to %s\n", hardware->snapshot_path);
+    return 0;
+}
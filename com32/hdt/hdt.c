@@ -65,8 +65,12 @@ int main(const int argc, const char *argv[])
     /* Opening the Syslinux console */
     init_console(&hardware);
 
-    /* Detect hardware */
-    detect_hardware(&hardware);
+    /*
+     * The hardware is probed when it is first needed; a snapshot saved
+     * by an earlier run can spare us the slowest probes.
+     */
+    if (strlen(hardware.snapshot_path) > 0)
+	load_snapshot(&hardware);
 
     /* Clear the screen and reset position of the cursor */
     clear_screen();
@@ -0,0 +1,135 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   Permission is hereby granted, free of charge, to any person
+ *   obtaining a copy of this software and associated documentation
+ *   files (the "Software"), to deal in the Software without
+ *   restriction, including without limitation the rights to use,
+ *   copy, modify, merge, publish, distribute, sublicense, and/or
+ *   sell copies of the Software, and to permit persons to whom
+ *   the Software is furnished to do so, subject to the following
+ *   conditions:
+ *
+ *   The above copyright notice and this permission notice shall
+ *   be included in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *   OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * sys/pciidx.h
+ *
+ * Format of the binary index of pci.ids, modules.alias or
+ * modules.pcimap generated by utils/pciidx.  This is shared between
+ * the PCI library and the host-side generator.
+ *
+ * The file is a header and a directory, padded to a whole page,
+ * followed by the pages themselves.  Each page holds whole records,
+ * sorted by key across the file, and the directory gives the key of
+ * the first record of every page; a reader can thus tell which pages
+ * it needs without looking at the others.  A record is a struct
+ * pciidx_rec followed by its NUL-terminated name; a record length of
+ * zero ends the page.  All fields are little endian.
+ */
+
+#ifndef _SYS_PCIIDX_H
+#define _SYS_PCIIDX_H
+
+#include <stdint.h>
+
+#define PCIIDX_MAGIC		0x58494350	/* "PCIX" */
+#define PCIIDX_VERSION		1
+#define PCIIDX_PAGE_SIZE	2048
+#define PCIIDX_MAX_PAGES	4096
+
+/* Groups, in file order */
+enum pciidx_group {
+    PCIIDX_GROUP_CLASS,		/* Classes, from pci.ids */
+    PCIIDX_GROUP_IDS,		/* Vendors and devices, from pci.ids */
+    PCIIDX_GROUP_MODULE,	/* From modules.alias or modules.pcimap */
+};
+
+/*
+ * Record types; within a group, records sort by id and then by type.
+ * Module records sort by vendor and device only, and otherwise stay in
+ * the order of the input file, which is the order the modules of a
+ * device are listed in.
+ */
+enum pciidx_type {
+    PCIIDX_CLASS = 1,		/* id[0] = class */
+    PCIIDX_SUBCLASS,		/* id[0] = class, id[1] = subclass */
+    PCIIDX_VENDOR,		/* id[0] = vendor */
+    PCIIDX_DEVICE,		/* id[0] = vendor, id[1] = device */
+    PCIIDX_SUBSYS,		/* id[0..3] = vendor, device, subvendor,
+				   subdevice */
+    PCIIDX_MODULE,		/* As PCIIDX_SUBSYS; 0xffff matches any
+				   subvendor or subdevice */
+};
+
+struct pciidx_key {
+    uint8_t group;
+    uint8_t type;
+    uint16_t id[4];
+} __attribute__ ((packed));
+
+struct pciidx_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t page_size;
+    uint32_t npages;
+    uint32_t reserved;
+    struct pciidx_key first[];	/* First key of each page */
+} __attribute__ ((packed));
+
+struct pciidx_rec {
+    uint8_t len;		/* Including the name and its NUL */
+    struct pciidx_key key;
+    char name[];
+} __attribute__ ((packed));
+
+#define PCIIDX_MAX_NAME		(255 - sizeof(struct pciidx_rec) - 1)
+
+/* Offset of the first page */
+#define PCIIDX_DATA_OFFSET(npages)					\
+    ((sizeof(struct pciidx_header) +					\
+      (npages) * sizeof(struct pciidx_key) + PCIIDX_PAGE_SIZE - 1)	\
+     & ~(PCIIDX_PAGE_SIZE - 1))
+
+/*
+ * Forced inline: this header is also used by the host tool, which
+ * can't see klibc's __must_inline, and libcom32 builds with -Winline.
+ */
+static inline __attribute__ ((always_inline))
+int pciidx_keycmp(const struct pciidx_key *a, const struct pciidx_key *b)
+{
+    int i, n = a->group == PCIIDX_GROUP_MODULE ? 2 : 4;
+
+    if (a->group != b->group)
+	return a->group < b->group ? -1 : 1;
+    for (i = 0; i < n; i++)
+	if (a->id[i] != b->id[i])
+	    return a->id[i] < b->id[i] ? -1 : 1;
+    if (a->type != b->type)
+	return a->type < b->type ? -1 : 1;
+    return 0;
+}
+
+/* Reader, in the PCI library: call fn for every record in the ranges */
+struct pciidx_range {
+    struct pciidx_key lo, hi;
+};
+
+int pciidx_scan(const char *path, const struct pciidx_range *ranges,
+		int nranges, void (*fn) (const struct pciidx_rec *, void *),
+		void *data);
+
+#endif /* _SYS_PCIIDX_H */
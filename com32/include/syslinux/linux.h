@@ -69,5 +69,6 @@ int initramfs_load_file(struct initramfs *ihead, const char *src_filename,
 			const char *dst_filename, int do_mkdir, uint32_t mode);
 int initramfs_add_trailer(struct initramfs *ihead);
 int initramfs_load_archive(struct initramfs *ihead, const char *filename);
+int initramfs_zload_archive(struct initramfs *ihead, const char *filename);
 
 #endif /* _SYSLINUX_LINUX_H */
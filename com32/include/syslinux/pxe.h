@@ -36,9 +36,21 @@
 
 #include <syslinux/pxe_api.h>
 
+/* PXELINUX DNS cache statistics, as returned by INT 22h AX=0025h */
+struct pxe_dns_stats {
+    uint32_t hits;		/* Lookups answered from the cache */
+    uint32_t neg_hits;		/* ... of which cached "no such name" */
+    uint32_t misses;		/* Lookups that went to the network */
+    uint32_t queries;		/* Query packets sent */
+    uint32_t timeouts;		/* Lookups no server answered */
+    uint32_t entries;		/* Names currently in the cache */
+    uint32_t evictions;		/* Live entries replaced to make room */
+};
+
 /* SYSLINUX-defined PXE utility functions */
 int pxe_get_cached_info(int level, void **buf, size_t *len);
 int pxe_get_nic_type(t_PXENV_UNDI_GET_NIC_TYPE * gnt);
 uint32_t pxe_dns(const char *hostname);
+int pxe_get_dns_stats(struct pxe_dns_stats *stats);
 
 #endif /* _SYSLINUX_PXE_H */
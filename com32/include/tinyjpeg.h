@@ -48,6 +48,10 @@ struct jdec_private;
 struct tinyjpeg_colorspace;
 typedef const struct tinyjpeg_colorspace *tinyjpeg_colorspace_t;
 
+/* Called after each row of MCUs (8 or 16 lines) has been decoded */
+typedef void (*tinyjpeg_row_callback_t)(void *opaque, unsigned int y,
+					unsigned int nrows);
+
 extern const tinyjpeg_colorspace_t TINYJPEG_FMT_GREY, TINYJPEG_FMT_BGR24,
   TINYJPEG_FMT_RGB24, TINYJPEG_FMT_YUV420P, TINYJPEG_FMT_BGRA32,
   TINYJPEG_FMT_RGBA32;
@@ -64,6 +68,7 @@ int tinyjpeg_set_components(struct jdec_private *priv, unsigned char * const *co
 int tinyjpeg_get_bytes_per_row(struct jdec_private *priv, unsigned int *bytes, unsigned int ncomponents);
 int tinyjpeg_set_bytes_per_row(struct jdec_private *priv, const unsigned int *bytes, unsigned int ncomponents);
 int tinyjpeg_set_flags(struct jdec_private *priv, int flags);
+int tinyjpeg_set_row_callback(struct jdec_private *priv, tinyjpeg_row_callback_t callback, void *opaque);
 
 #ifdef __cplusplus
 }
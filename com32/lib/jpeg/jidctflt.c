@@ -72,6 +72,7 @@
  */
 
 #include <stdint.h>
+#include "tinyjpeg.h"
 #include "tinyjpeg-internal.h"
 
 #define FAST_FLOAT float
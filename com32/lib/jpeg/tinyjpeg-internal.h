@@ -89,6 +89,8 @@ struct jdec_private
   unsigned int bytes_per_row[COMPONENTS];
   unsigned int width, height;	/* Size of the image */
   unsigned int flags;
+  tinyjpeg_row_callback_t row_callback;
+  void *row_opaque;
 
   /* Private variables */
   const unsigned char *stream_begin, *stream_end;
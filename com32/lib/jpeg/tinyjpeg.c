@@ -965,6 +965,15 @@ int tinyjpeg_decode(struct jdec_private *priv,
 	    }
 	 }
       }
+
+     /* In strip mode, hand over the lines and reuse the buffer */
+     if (priv->row_callback)
+      {
+	priv->row_callback(priv->row_opaque, priv->height-y, sy);
+	pptr[0] = priv->components[0];
+	pptr[1] = priv->components[1];
+	pptr[2] = priv->components[2];
+      }
    }
 
   trace("Input file size: %d\n", priv->stream_length+2);
@@ -1036,3 +1045,18 @@ int tinyjpeg_set_flags(struct jdec_private *priv, int flags)
   priv->flags = flags;
   return oldflags;
 }
+
+/**
+ * Decode the image one row of MCUs at a time: after each row, the
+ * callback is given the lines just decoded, and the next row is
+ * decoded into the start of the components again.  The components
+ * then only need room for 16 lines.
+ */
+int tinyjpeg_set_row_callback(struct jdec_private *priv,
+			      tinyjpeg_row_callback_t callback,
+			      void *opaque)
+{
+  priv->row_callback = callback;
+  priv->row_opaque = opaque;
+  return 0;
+}
@@ -0,0 +1,166 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   Permission is hereby granted, free of charge, to any person
+ *   obtaining a copy of this software and associated documentation
+ *   files (the "Software"), to deal in the Software without
+ *   restriction, including without limitation the rights to use,
+ *   copy, modify, merge, publish, distribute, sublicense, and/or
+ *   sell copies of the Software, and to permit persons to whom
+ *   the Software is furnished to do so, subject to the following
+ *   conditions:
+ *
+ *   The above copyright notice and this permission notice shall
+ *   be included in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *   OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * pciidx.c
+ *
+ * Look records up in a binary pci.ids or modules.alias index, as made
+ * by utils/pciidx.  Files can't seek, so the pages are still read in
+ * order, but only those which can hold a record we want are parsed,
+ * and reading stops after the last of them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/pciidx.h>
+#include <syslinux/zio.h>
+#include <dprintf.h>
+
+/* Index of the last page whose first key is <= key (or < key), or -1 */
+static int find_page(const struct pciidx_key *first, int npages,
+		     const struct pciidx_key *key, int strict)
+{
+    int lo = 0, hi = npages, mid, cmp;
+
+    while (lo < hi) {
+	mid = (lo + hi) >> 1;
+	cmp = pciidx_keycmp(&first[mid], key);
+	if (cmp < 0 || (cmp == 0 && !strict))
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return lo - 1;
+}
+
+static int in_ranges(const struct pciidx_key *key,
+		     const struct pciidx_range *ranges, int nranges)
+{
+    int i;
+
+    for (i = 0; i < nranges; i++)
+	if (pciidx_keycmp(key, &ranges[i].lo) >= 0 &&
+	    pciidx_keycmp(key, &ranges[i].hi) <= 0)
+	    return 1;
+    return 0;
+}
+
+/*
+ * Returns 0 on success, or -1 if there is no usable index, in which
+ * case the caller should fall back to the text file.
+ */
+int pciidx_scan(const char *path, const struct pciidx_range *ranges,
+		int nranges, void (*fn) (const struct pciidx_rec *, void *),
+		void *data)
+{
+    struct pciidx_header hdr;
+    struct pciidx_key *first = NULL;
+    const struct pciidx_rec *rec;
+    uint8_t *need = NULL, *page = NULL;
+    size_t offset, skip, len, off;
+    int i, p, lo, hi, last = -1, parsed = 0;
+    int rv = -1;
+    FILE *f;
+
+    f = zfopen(path, "r");
+    if (!f)
+	return -1;
+
+    if (fread(&hdr, 1, sizeof hdr, f) != sizeof hdr ||
+	hdr.magic != PCIIDX_MAGIC || hdr.version != PCIIDX_VERSION ||
+	hdr.page_size != PCIIDX_PAGE_SIZE || hdr.npages > PCIIDX_MAX_PAGES)
+	goto out;
+
+    first = malloc(hdr.npages * sizeof *first);
+    need = calloc(hdr.npages, 1);
+    page = malloc(PCIIDX_PAGE_SIZE);
+    if (!first || !need || !page)
+	goto out;
+
+    if (fread(first, sizeof *first, hdr.npages, f) != hdr.npages)
+	goto out;
+    offset = sizeof hdr + hdr.npages * sizeof *first;
+
+    /*
+     * Records equal to the low end of a range may start in the page
+     * before the first one whose first key is equal to it.
+     */
+    for (i = 0; i < nranges; i++) {
+	hi = find_page(first, hdr.npages, &ranges[i].hi, 0);
+	if (hi < 0)
+	    continue;
+	lo = find_page(first, hdr.npages, &ranges[i].lo, 1);
+	if (lo < 0)
+	    lo = 0;
+	for (p = lo; p <= hi; p++)
+	    need[p] = 1;
+	if (hi > last)
+	    last = hi;
+    }
+
+    /* Skip the rest of the header page(s) */
+    skip = PCIIDX_DATA_OFFSET(hdr.npages) - offset;
+    while (skip) {
+	len = skip < PCIIDX_PAGE_SIZE ? skip : PCIIDX_PAGE_SIZE;
+	if (fread(page, 1, len, f) != len)
+	    goto out;
+	skip -= len;
+    }
+
+    for (p = 0; p <= last; p++) {
+	if (fread(page, 1, PCIIDX_PAGE_SIZE, f) != PCIIDX_PAGE_SIZE)
+	    goto out;
+	if (!need[p])
+	    continue;
+
+	parsed++;
+	off = 0;
+	while (off < PCIIDX_PAGE_SIZE && page[off]) {
+	    rec = (const struct pciidx_rec *)(page + off);
+	    len = rec->len;
+	    if (len <= sizeof *rec || off + len > PCIIDX_PAGE_SIZE ||
+		page[off + len - 1])
+		goto out;	/* Corrupt */
+	    if (in_ranges(&rec->key, ranges, nranges))
+		fn(rec, data);
+	    off += len;
+	}
+    }
+
+    dprintf("pciidx: %s: parsed %d of %d pages, read %d\n",
+	    path, parsed, hdr.npages, last + 1);
+    rv = 0;
+
+out:
+    free(page);
+    free(need);
+    free(first);
+    fclose(f);
+    return rv;
+}
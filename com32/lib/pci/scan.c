@@ -37,6 +37,7 @@
 #include <string.h>
 #include <console.h>
 #include <sys/pci.h>
+#include <sys/pciidx.h>
 #include <com32.h>
 #include <stdbool.h>
 #include <ctype.h>
@@ -61,6 +62,167 @@ static int hex_to_int(char *hexa)
     return strtoul(hexa, NULL, 16);
 }
 
+/* Add a kernel module to a pci device, unless we already knew it */
+static void add_kernel_module(struct pci_device *dev, const char *module_name)
+{
+    struct pci_dev_info *info = dev->dev_info;
+    int i;
+
+    for (i = 0; i < info->linux_kernel_module_count; i++) {
+	if (strstr(info->linux_kernel_module[i], module_name))
+	    return;
+    }
+
+    if (info->linux_kernel_module_count < MAX_KERNEL_MODULES_PER_PCI_DEVICE) {
+	strcpy(info->linux_kernel_module[info->linux_kernel_module_count],
+	       module_name);
+	info->linux_kernel_module_count++;
+    }
+}
+
+#define PCIIDX_RANGES_PER_DEV	3
+
+/*
+ * Look the pci devices up in the binary index of a text file, if there
+ * is one: "pci.ids.idx" for "pci.ids" and so on, see utils/pciidx.
+ * add_ranges() gives the records each device needs, and fn() is called
+ * for each of them.  Returns 0 if the index could be used.
+ */
+static int lookup_pciidx(struct pci_domain *domain, const char *path,
+			 int (*add_ranges) (const struct pci_device *,
+					    struct pciidx_range *),
+			 void (*fn) (const struct pciidx_rec *, void *))
+{
+    struct pci_device *dev;
+    struct pciidx_range *ranges;
+    char *idx_path;
+    int ndev = 0, nranges = 0, rv = -1;
+
+    for_each_pci_func(dev, domain)
+	ndev++;
+
+    idx_path = malloc(strlen(path) + 5);
+    ranges = malloc(ndev * PCIIDX_RANGES_PER_DEV * sizeof *ranges);
+    if (idx_path && ranges) {
+	strcpy(idx_path, path);
+	strcat(idx_path, ".idx");
+
+	for_each_pci_func(dev, domain)
+	    nranges += add_ranges(dev, ranges + nranges);
+
+	rv = pciidx_scan(idx_path, ranges, nranges, fn, domain);
+    }
+
+    free(ranges);
+    free(idx_path);
+    return rv;
+}
+
+static void pciidx_point(struct pciidx_range *r, int group, int type,
+			 uint16_t a, uint16_t b, uint16_t c, uint16_t d)
+{
+    r->lo = r->hi = (struct pciidx_key) {
+	group, type, { a, b, c, d }
+    };
+}
+
+/* Vendor, device and subsystem of each device */
+static int name_ranges(const struct pci_device *dev, struct pciidx_range *r)
+{
+    pciidx_point(&r[0], PCIIDX_GROUP_IDS, PCIIDX_VENDOR,
+		 dev->vendor, 0, 0, 0);
+    pciidx_point(&r[1], PCIIDX_GROUP_IDS, PCIIDX_DEVICE,
+		 dev->vendor, dev->product, 0, 0);
+    pciidx_point(&r[2], PCIIDX_GROUP_IDS, PCIIDX_SUBSYS,
+		 dev->vendor, dev->product, dev->sub_vendor, dev->sub_product);
+    return 3;
+}
+
+/* Records come in order, so a subsystem name overrides the device's */
+static void name_rec(const struct pciidx_rec *rec, void *data)
+{
+    struct pci_domain *domain = data;
+    struct pci_device *dev;
+
+    for_each_pci_func(dev, domain) {
+	if (dev->vendor != rec->key.id[0])
+	    continue;
+
+	switch (rec->key.type) {
+	case PCIIDX_VENDOR:
+	    strlcpy(dev->dev_info->vendor_name, rec->name,
+		    PCI_VENDOR_NAME_SIZE - 1);
+	    break;
+	case PCIIDX_SUBSYS:
+	    if (dev->sub_vendor != rec->key.id[2] ||
+		dev->sub_product != rec->key.id[3])
+		break;
+	    /* fall through */
+	case PCIIDX_DEVICE:
+	    if (dev->product == rec->key.id[1])
+		strlcpy(dev->dev_info->product_name, rec->name,
+			PCI_PRODUCT_NAME_SIZE - 1);
+	    break;
+	}
+    }
+}
+
+/* Class and subclass of each device */
+static int class_ranges(const struct pci_device *dev, struct pciidx_range *r)
+{
+    pciidx_point(&r[0], PCIIDX_GROUP_CLASS, PCIIDX_CLASS,
+		 dev->class[2], 0, 0, 0);
+    pciidx_point(&r[1], PCIIDX_GROUP_CLASS, PCIIDX_SUBCLASS,
+		 dev->class[2], dev->class[1], 0, 0);
+    return 2;
+}
+
+static void class_rec(const struct pciidx_rec *rec, void *data)
+{
+    struct pci_domain *domain = data;
+    struct pci_device *dev;
+
+    for_each_pci_func(dev, domain) {
+	if (dev->class[2] != rec->key.id[0])
+	    continue;
+
+	if (rec->key.type == PCIIDX_CLASS) {
+	    /* As in pci.ids, the class name starts with the class id */
+	    strlcpy(dev->dev_info->class_name, rec->name,
+		    PCI_CLASS_NAME_SIZE - 1);
+	    if (strlen(rec->name) > 4)
+		strlcpy(dev->dev_info->category_name, rec->name + 4,
+			PCI_CLASS_NAME_SIZE - 1);
+	} else if (dev->class[1] == rec->key.id[1]) {
+	    strlcpy(dev->dev_info->class_name, rec->name,
+		    PCI_CLASS_NAME_SIZE - 1);
+	}
+    }
+}
+
+/* All the modules for the vendor and device, whatever the subsystem */
+static int module_ranges(const struct pci_device *dev,
+			 struct pciidx_range *r)
+{
+    pciidx_point(&r[0], PCIIDX_GROUP_MODULE, PCIIDX_MODULE,
+		 dev->vendor, dev->product, 0, 0);
+    return 1;
+}
+
+static void module_rec(const struct pciidx_rec *rec, void *data)
+{
+    struct pci_domain *domain = data;
+    struct pci_device *dev;
+
+    for_each_pci_func(dev, domain) {
+	if (dev->vendor == rec->key.id[0] &&
+	    dev->product == rec->key.id[1] &&
+	    (rec->key.id[2] & dev->sub_vendor) == dev->sub_vendor &&
+	    (rec->key.id[3] & dev->sub_product) == dev->sub_product)
+	    add_kernel_module(dev, rec->name);
+    }
+}
+
 /* Try to match any pci device to the appropriate kernel module */
 /* it uses the modules.pcimap from the boot device */
 int get_module_name_from_pcimap(struct pci_domain *domain,
@@ -91,6 +253,10 @@ int get_module_name_from_pcimap(struct pci_domain *domain,
     }
   }
 
+  /* Use the binary index, if there is one */
+  if (!lookup_pciidx(domain, modules_pcimap_path, module_ranges, module_rec))
+    return 0;
+
   /* Opening the modules.pcimap (of a linux kernel) from the boot device */
   f=zfopen(modules_pcimap_path, "r");
   if (!f)
@@ -145,22 +311,7 @@ int get_module_name_from_pcimap(struct pci_domain *domain,
 	  == dev->sub_product &&
 	  (int_sub_vendor_id & dev->sub_vendor)
 	  == dev->sub_vendor) {
-	      bool found=false;
-
-	      /* Scan all known kernel modules for this pci device */
-	      for (int i=0; i<dev->dev_info->linux_kernel_module_count; i++) {
-
-       	      /* Try to detect if we already knew the same kernel module*/
-	       if (strstr(dev->dev_info->linux_kernel_module[i], module_name)) {
-		      found=true;
-		      break;
-	       }
-	      }
-	      /* If we don't have this kernel module, let's add it */
-	      if (!found) {
-		strcpy(dev->dev_info->linux_kernel_module[dev->dev_info->linux_kernel_module_count], module_name);
-		dev->dev_info->linux_kernel_module_count++;
-	      }
+	      add_kernel_module(dev, module_name);
       }
     }
   }
@@ -193,6 +344,10 @@ int get_class_name_from_pci_ids(struct pci_domain *domain, char *pciids_path)
 	strlcpy(dev->dev_info->class_name, "unknown", 7);
     }
 
+    /* Use the binary index, if there is one */
+    if (!lookup_pciidx(domain, pciids_path, class_ranges, class_rec))
+	return 0;
+
     /* Opening the pci.ids from the boot device */
     f = zfopen(pciids_path, "r");
     if (!f)
@@ -293,6 +448,10 @@ int get_name_from_pci_ids(struct pci_domain *domain, char *pciids_path)
 	strlcpy(dev->dev_info->product_name, "unknown", 7);
     }
 
+    /* Use the binary index, if there is one */
+    if (!lookup_pciidx(domain, pciids_path, name_ranges, name_rec))
+	return 0;
+
     /* Opening the pci.ids from the boot device */
     f = zfopen(pciids_path, "r");
     if (!f)
@@ -619,6 +778,10 @@ int get_module_name_from_alias(struct pci_domain *domain, char *modules_alias_pa
     }
   }
 
+  /* Use the binary index, if there is one */
+  if (!lookup_pciidx(domain, modules_alias_path, module_ranges, module_rec))
+    return 0;
+
   /* Opening the modules.pcimap (of a linux kernel) from the boot device */
   f=zfopen(modules_alias_path, "r");
   if (!f)
@@ -705,22 +868,7 @@ int get_module_name_from_alias(struct pci_domain *domain, char *modules_alias_pa
 	  == dev->sub_product &&
 	  (int_sub_vendor_id & dev->sub_vendor)
 	  == dev->sub_vendor) {
-	      bool found=false;
-	      
-	      /* Scan all known kernel modules for this pci device */
-	      for (int i=0; i<dev->dev_info->linux_kernel_module_count; i++) {
-
-       	      /* Try to detect if we already knew the same kernel module*/
-	       if (strstr(dev->dev_info->linux_kernel_module[i], module_name)) {
-		      found=true;
-		      break;
-	       }
-	      }
-	      /* If we don't have this kernel module, let's add it */
-	      if (!found) {
-		strcpy(dev->dev_info->linux_kernel_module[dev->dev_info->linux_kernel_module_count], module_name);
-		dev->dev_info->linux_kernel_module_count++;
-	      }
+	      add_kernel_module(dev, module_name);
       }
     }
   }
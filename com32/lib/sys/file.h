@@ -35,6 +35,7 @@
 #define _COM32_SYS_FILE_H
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <dev.h>
@@ -99,6 +100,11 @@ struct file_info {
 
 extern struct file_info __file_info[NFILES];
 
+/* Direct serial port output, see serial_uart.c */
+bool __serial_putc(char);
+void __serial_flush(void);
+void __serial_send(const void *, size_t);
+
 /* Line input discipline */
 ssize_t __line_input(struct file_info *fp, char *buf, size_t bufsize,
 		     ssize_t(*get_char) (struct file_info *, void *, size_t));
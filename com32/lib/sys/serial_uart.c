@@ -0,0 +1,136 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   Permission is hereby granted, free of charge, to any person
+ *   obtaining a copy of this software and associated documentation
+ *   files (the "Software"), to deal in the Software without
+ *   restriction, including without limitation the rights to use,
+ *   copy, modify, merge, publish, distribute, sublicense, and/or
+ *   sell copies of the Software, and to permit persons to whom
+ *   the Software is furnished to do so, subject to the following
+ *   conditions:
+ *
+ *   The above copyright notice and this permission notice shall
+ *   be included in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *   OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * serial_uart.c
+ *
+ * Output to the serial console straight from protected mode.  INT 21h
+ * AH=04h costs a trip to real mode and back for every byte; instead,
+ * drive the 16550 the same way the core does: wait for the transmitter
+ * to be empty and for the input flow control bits (if any) to be set,
+ * then fill the whole transmit FIFO at once.
+ *
+ * Output is gathered in a small queue, which the device write routines
+ * flush before they return, so nothing is ever held back.
+ */
+
+#include <string.h>
+#include <minmax.h>
+#include <sys/io.h>
+#include <sys/cpu.h>
+#include <syslinux/config.h>
+#include "file.h"
+
+/* 16550 registers */
+#define UART_THR	0	/* Transmit holding register */
+#define UART_IIR	2	/* Interrupt identification */
+#define UART_LSR	5	/* Line status */
+#define UART_MSR	6	/* Modem status */
+
+#define UART_IIR_FIFO	0xc0	/* FIFOs enabled (and usable) */
+#define UART_LSR_THRE	0x20	/* Transmitter (FIFO) empty */
+
+#define UART_FIFO_SIZE	16
+
+#define SERIAL_QUEUE_SIZE 256
+
+static struct {
+    uint16_t iobase;		/* 0 if not set up yet */
+    uint8_t flow;		/* MSR bits which must be set to send */
+    uint8_t burst;		/* Bytes to write per THRE */
+    uint16_t qlen;
+    uint8_t queue[SERIAL_QUEUE_SIZE];
+} uart;
+
+static bool uart_init(void)
+{
+    const struct syslinux_serial_console_info *si =
+	syslinux_serial_console_info();
+
+    if (!si->iobase)
+	return false;
+
+    uart.iobase = si->iobase;
+    uart.flow = si->flowctl & 0xf0;
+
+    /* The core has enabled the FIFOs if they work; see if it did */
+    if ((inb(uart.iobase + UART_IIR) & UART_IIR_FIFO) == UART_IIR_FIFO)
+	uart.burst = UART_FIFO_SIZE;
+    else
+	uart.burst = 1;
+
+    return true;
+}
+
+static void uart_send(const uint8_t *p, size_t count)
+{
+    const uint16_t iobase = uart.iobase;
+    const uint8_t flow = uart.flow;
+    size_t n;
+
+    while (count) {
+	while (!(inb(iobase + UART_LSR) & UART_LSR_THRE) ||
+	       (flow && (inb(iobase + UART_MSR) & flow) != flow))
+	    cpu_relax();
+
+	n = min(count, (size_t)uart.burst);
+	count -= n;
+	while (n--)
+	    outb(*p++, iobase + UART_THR);
+    }
+}
+
+/* Send out whatever is queued */
+void __serial_flush(void)
+{
+    if (uart.qlen) {
+	uart_send(uart.queue, uart.qlen);
+	uart.qlen = 0;
+    }
+}
+
+/* Queue one byte; returns false if there is no serial console */
+bool __serial_putc(char ch)
+{
+    if (!uart.iobase && !uart_init())
+	return false;
+
+    if (uart.qlen >= SERIAL_QUEUE_SIZE)
+	__serial_flush();
+    uart.queue[uart.qlen++] = ch;
+    return true;
+}
+
+/* Send a buffer, after anything already queued */
+void __serial_send(const void *buf, size_t count)
+{
+    if (!uart.iobase && !uart_init())
+	return;
+
+    __serial_flush();
+    uart_send(buf, count);
+}
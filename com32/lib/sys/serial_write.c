@@ -40,25 +40,10 @@
 
 ssize_t __serial_write(struct file_info *fp, const void *buf, size_t count)
 {
-    com32sys_t ireg;
-    const char *bufp = buf;
-    size_t n = 0;
-
     (void)fp;
 
-    if (!syslinux_serial_console_info()->iobase)
-	return count;		/* Nothing to do */
-
-    memset(&ireg, 0, sizeof ireg);
-    ireg.eax.b[1] = 0x04;
-
-    while (count--) {
-	ireg.edx.b[0] = *bufp++;
-	__intcall(0x21, &ireg, NULL);
-	n++;
-    }
-
-    return n;
+    __serial_send(buf, count);
+    return count;
 }
 
 const struct output_dev dev_serial_w = {
@@ -31,6 +31,7 @@
 #include <com32.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <minmax.h>
 #include <stdbool.h>
@@ -52,6 +53,22 @@ static void draw_background_line(int line, int start, int npixels)
     __vesacon_copy_to_screen(fbptr, bgptr, npixels);
 }
 
+/* A background of a single color can be scrolled along with the text */
+bool __vesacon_flat_background = true;
+
+static bool background_is_flat(void)
+{
+    const uint32_t *bgptr = __vesacon_background;
+    unsigned int count = __vesa_info.mi.h_res * __vesa_info.mi.v_res;
+    uint32_t color = *bgptr;
+
+    while (count--) {
+	if (*bgptr++ != color)
+	    return false;
+    }
+    return true;
+}
+
 /* This draws the border, then redraws the text area */
 static void draw_background(void)
 {
@@ -73,6 +90,7 @@ static void draw_background(void)
 	 i < __vesa_info.mi.v_res; i++)
 	draw_background_line(i, 0, __vesa_info.mi.h_res);
 
+    __vesacon_flat_background = background_is_flat();
     __vesacon_redraw_text();
 }
 
@@ -108,6 +126,85 @@ static void tile_image(int width, int height)
     }
 }
 
+/*
+ * The decoders hand the image over one row at a time.  An image the
+ * size of the screen, or small enough to be a tile (at most half the
+ * screen each way) is decoded straight into the background; anything
+ * else is scaled to the size of the screen on the way, so only a few
+ * rows of it are ever held in memory.  LSS16 images aren't tiled, but
+ * padded with black, as they always were.
+ */
+#define MAX_IMAGE_SIZE	4096	/* Either way; tinyjpeg's limit as well */
+
+struct bg_image {
+    int width, height;
+    int row;			/* Rows delivered so far */
+    bool tile;
+    struct vesacon_scaler *scaler;	/* NULL if decoding in place */
+    uint32_t *rowbuf;		/* Decode buffer, if scaling */
+};
+
+static void end_image(struct bg_image *img)
+{
+    if (img->scaler) {
+	__vesacon_scaler_free(img->scaler);
+	free(img->rowbuf);
+	img->scaler = NULL;
+	img->rowbuf = NULL;
+    } else if (img->row && img->tile) {
+	tile_image(img->width, img->height);
+    }
+}
+
+/* rows is how many rows the decoder wants to decode at a time */
+static int start_image(struct bg_image *img, int width, int height, int rows,
+		       bool tile)
+{
+    int xsize = __vesa_info.mi.h_res;
+    int ysize = __vesa_info.mi.v_res;
+
+    memset(img, 0, sizeof *img);
+    img->width = width;
+    img->height = height;
+    img->tile = tile;
+
+    if (width < 1 || height < 1 ||
+	width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE)
+	return -1;
+
+    if (tile ? ((width == xsize && height == ysize) ||
+		(2 * width <= xsize && 2 * height <= ysize)) :
+	(width <= xsize && height <= ysize))
+	return 0;
+
+    img->rowbuf = malloc(width * rows * sizeof(uint32_t));
+    img->scaler = __vesacon_scaler_init(width, height, __vesacon_background,
+					xsize, ysize);
+    if (!img->rowbuf || !img->scaler) {
+	img->row = 0;
+	end_image(img);
+	return -1;
+    }
+    return 0;
+}
+
+/* Where to decode the next row */
+static uint32_t *image_row(const struct bg_image *img)
+{
+    if (img->scaler)
+	return img->rowbuf;
+    else
+	return __vesacon_background + img->row * __vesa_info.mi.h_res;
+}
+
+/* The next row has been decoded, at *row */
+static void put_image_row(struct bg_image *img, const uint32_t *row)
+{
+    if (img->scaler)
+	__vesacon_scale_row(img->scaler, row);
+    img->row++;
+}
+
 static int read_png_file(FILE * fp)
 {
     png_structp png_ptr = NULL;
@@ -116,10 +213,15 @@ static int read_png_file(FILE * fp)
     png_color_16p image_background;
     static const png_color_16 my_background = { 0, 0, 0, 0, 0 };
 #endif
-    png_bytep row_pointers[__vesa_info.mi.v_res], rp;
-    int i;
+    struct bg_image img;
+    png_bytep * volatile row_pointers = NULL;
+    uint32_t * volatile image = NULL;
+    uint32_t *rp;
+    int i, passes, stride;
     int rv = -1;
 
+    memset(&img, 0, sizeof img);
+
     png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     info_ptr = png_create_info_struct(png_ptr);
 
@@ -129,7 +231,7 @@ static int read_png_file(FILE * fp)
     png_init_io(png_ptr, fp);
     png_set_sig_bytes(png_ptr, 8);
 
-    png_set_user_limits(png_ptr, __vesa_info.mi.h_res, __vesa_info.mi.v_res);
+    png_set_user_limits(png_ptr, MAX_IMAGE_SIZE, MAX_IMAGE_SIZE);
 
     png_read_info(png_ptr, info_ptr);
 
@@ -168,20 +270,47 @@ static int read_png_file(FILE * fp)
 			   PNG_BACKGROUND_GAMMA_SCREEN, 0, 1.0);
 #endif
 
+    passes = png_set_interlace_handling(png_ptr);
+
+    if (start_image(&img, info_ptr->width, info_ptr->height, 1, true))
+	goto err;
+
     /* Whew!  Now we should get the stuff we want... */
-    rp = (png_bytep)__vesacon_background;
-    for (i = 0; i < (int)info_ptr->height; i++) {
-	row_pointers[i] = rp;
-	rp += __vesa_info.mi.h_res << 2;
-    }
+    if (passes == 1) {
+	for (i = 0; i < img.height; i++) {
+	    rp = image_row(&img);
+	    png_read_row(png_ptr, (png_bytep)rp, NULL);
+	    put_image_row(&img, rp);
+	}
+    } else {
+	/* Interlaced images only come together at the end */
+	if (img.scaler) {
+	    image = malloc(img.width * img.height * sizeof(uint32_t));
+	    stride = img.width;
+	} else {
+	    image = __vesacon_background;
+	    stride = __vesa_info.mi.h_res;
+	}
+	row_pointers = malloc(img.height * sizeof(png_bytep));
+	if (!image || !row_pointers)
+	    goto err;
 
-    png_read_image(png_ptr, row_pointers);
+	for (i = 0; i < img.height; i++)
+	    row_pointers[i] = (png_bytep)(image + i * stride);
 
-    tile_image(info_ptr->width, info_ptr->height);
+	png_read_image(png_ptr, row_pointers);
+
+	for (i = 0; i < img.height; i++)
+	    put_image_row(&img, (uint32_t *)row_pointers[i]);
+    }
 
     rv = 0;
 
 err:
+    end_image(&img);
+    if (image && image != __vesacon_background)
+	free(image);
+    free(row_pointers);
     if (png_ptr)
 	png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
     return rv;
@@ -194,6 +323,20 @@ static int jpeg_sig_cmp(uint8_t * bytes, int len)
     return (bytes[0] == 0xff && bytes[1] == 0xd8) ? 0 : -1;
 }
 
+/* tinyjpeg has decoded another strip of rows into img->rowbuf */
+static void jpeg_strip_done(void *opaque, unsigned int y, unsigned int nrows)
+{
+    struct bg_image *img = opaque;
+    const uint32_t *row = img->rowbuf;
+
+    (void)y;
+
+    while (nrows--) {
+	put_image_row(img, row);
+	row += img->width;
+    }
+}
+
 static int read_jpeg_file(FILE * fp, uint8_t * header, int len)
 {
     struct jdec_private *jdec = NULL;
@@ -201,13 +344,16 @@ static int read_jpeg_file(FILE * fp, uint8_t * header, int len)
     size_t length_of_file;
     unsigned int width, height;
     int rv = -1;
+    struct bg_image img;
     unsigned char *components[1];
     unsigned int bytes_per_row[1];
 
+    memset(&img, 0, sizeof img);
+
     rv = floadfile(fp, &jpeg_file, &length_of_file, header, len);
-    fclose(fp);
     if (rv)
 	goto err;
+    rv = -1;
 
     jdec = tinyjpeg_init();
     if (!jdec)
@@ -216,21 +362,31 @@ static int read_jpeg_file(FILE * fp, uint8_t * header, int len)
     if (tinyjpeg_parse_header(jdec, jpeg_file, length_of_file) < 0)
 	goto err;
 
+    /* tinyjpeg decodes up to 16 rows at a time */
     tinyjpeg_get_size(jdec, &width, &height);
-    if (width > __vesa_info.mi.h_res || height > __vesa_info.mi.v_res)
+    if (start_image(&img, width, height, 16, true))
 	goto err;
 
-    components[0] = (void *)__vesacon_background;
+    if (img.scaler) {
+	components[0] = (void *)img.rowbuf;
+	bytes_per_row[0] = width << 2;
+	tinyjpeg_set_row_callback(jdec, jpeg_strip_done, &img);
+    } else {
+	components[0] = (void *)__vesacon_background;
+	bytes_per_row[0] = __vesa_info.mi.h_res << 2;
+	img.row = height;
+    }
     tinyjpeg_set_components(jdec, components, 1);
-    bytes_per_row[0] = __vesa_info.mi.h_res << 2;
     tinyjpeg_set_bytes_per_row(jdec, bytes_per_row, 1);
 
-    tinyjpeg_decode(jdec, TINYJPEG_FMT_BGRA32);
-    tile_image(width, height);
+    if (tinyjpeg_decode(jdec, TINYJPEG_FMT_BGRA32) < 0)
+	goto err;
 
     rv = 0;
 
 err:
+    end_image(&img);
+
     /* Don't use tinyjpeg_free() here, since we didn't allow tinyjpeg
        to allocate the frame buffer */
     if (jdec)
@@ -307,9 +463,7 @@ static inline int lss16_sig_cmp(const void *header, int len)
     if (len != 8)
 	return 1;
 
-    return !(h->magic == LSS16_MAGIC &&
-	     h->xsize <= __vesa_info.mi.h_res &&
-	     h->ysize <= __vesa_info.mi.v_res);
+    return !(h->magic == LSS16_MAGIC && h->xsize && h->ysize);
 }
 
 static int read_lss16_file(FILE * fp, const void *header, int header_len)
@@ -327,16 +481,21 @@ static int read_lss16_file(FILE * fp, const void *header, int header_len)
 	st_c2,
     } state;
     int i, x, y;
-    uint32_t *bgptr = __vesacon_background;
+    int rv = -1;
+    struct bg_image img;
+    uint32_t *bgptr;
 
     /* Assume the header, 8 bytes, has already been loaded. */
     if (header_len != 8)
 	return -1;
 
+    if (start_image(&img, h->xsize, h->ysize, 1, false))
+	return -1;
+
     for (i = 0; i < 16; i++) {
 	uint8_t rgb[3];
 	if (fread(rgb, 1, 3, fp) != 3)
-	    return -1;
+	    goto err;
 
 	colors[i] = (((rgb[0] & 63) * 255 / 63) << 16) +
 	    (((rgb[1] & 63) * 255 / 63) << 8) +
@@ -345,6 +504,7 @@ static int read_lss16_file(FILE * fp, const void *header, int header_len)
 
     /* By spec, the state machine is per row */
     for (y = 0; y < h->ysize; y++) {
+	bgptr = image_row(&img);
 	state = st_start;
 	has_nybble = false;
 	color = colors[prev = 0];	/* By specification */
@@ -354,7 +514,7 @@ static int read_lss16_file(FILE * fp, const void *header, int header_len)
 	while (x < h->xsize) {
 	    if (!has_nybble) {
 		if (fread(&byte, 1, 1, fp) != 1)
-		    return -1;
+		    goto err;
 		nybble = byte & 0xf;
 		has_nybble = true;
 	    } else {
@@ -400,16 +560,94 @@ do_run:
 	    }
 	}
 
-	/* Zero-fill rest of row */
-	i = __vesa_info.mi.h_res - x;
+	if (!img.scaler) {
+	    /* Zero-fill rest of row */
+	    i = __vesa_info.mi.h_res - x;
+	    asm volatile ("rep; stosl":"+D" (bgptr), "+c"(i):"a"(0):"memory");
+	}
+	put_image_row(&img, image_row(&img));
+    }
+
+    if (!img.scaler) {
+	/* Zero-fill rest of screen */
+	bgptr = image_row(&img);
+	i = (__vesa_info.mi.v_res - y) * __vesa_info.mi.h_res;
 	asm volatile ("rep; stosl":"+D" (bgptr), "+c"(i):"a"(0):"memory");
     }
 
-    /* Zero-fill rest of screen */
-    i = (__vesa_info.mi.v_res - y) * __vesa_info.mi.h_res;
-    asm volatile ("rep; stosl":"+D" (bgptr), "+c"(i):"a"(0):"memory");
+    rv = 0;
 
-    return 0;
+err:
+    end_image(&img);
+    return rv;
+}
+
+/*
+ * Backgrounds loaded from files are kept, converted and at the size of
+ * the screen, so going back to a menu doesn't decode its image again.
+ */
+#define BACKGROUND_CACHE_SIZE	4
+
+static struct background_cache {
+    char *filename;
+    int xsize, ysize;
+    uint32_t *image;
+    unsigned int lru;
+} bg_cache[BACKGROUND_CACHE_SIZE];
+static unsigned int bg_cache_clock;
+
+static size_t background_bytes(void)
+{
+    return __vesa_info.mi.h_res * __vesa_info.mi.v_res * sizeof(uint32_t);
+}
+
+static bool cache_load(const char *filename)
+{
+    struct background_cache *bc;
+
+    for (bc = bg_cache; bc < &bg_cache[BACKGROUND_CACHE_SIZE]; bc++) {
+	if (bc->image && bc->xsize == __vesa_info.mi.h_res &&
+	    bc->ysize == __vesa_info.mi.v_res &&
+	    !strcmp(bc->filename, filename)) {
+	    memcpy(__vesacon_background, bc->image, background_bytes());
+	    bc->lru = ++bg_cache_clock;
+	    return true;
+	}
+    }
+    return false;
+}
+
+static void cache_store(const char *filename)
+{
+    struct background_cache *bc, *victim = bg_cache;
+
+    for (bc = bg_cache; bc < &bg_cache[BACKGROUND_CACHE_SIZE]; bc++) {
+	if (!bc->image) {
+	    victim = bc;
+	    break;
+	}
+	if (bc->lru < victim->lru)
+	    victim = bc;
+    }
+
+    free(victim->filename);
+    free(victim->image);
+
+    victim->filename = strdup(filename);
+    victim->image = malloc(background_bytes());
+    if (!victim->filename || !victim->image) {
+	/* Not worth failing over */
+	free(victim->filename);
+	free(victim->image);
+	victim->filename = NULL;
+	victim->image = NULL;
+	return;
+    }
+
+    memcpy(victim->image, __vesacon_background, background_bytes());
+    victim->xsize = __vesa_info.mi.h_res;
+    victim->ysize = __vesa_info.mi.v_res;
+    victim->lru = ++bg_cache_clock;
 }
 
 int vesacon_load_background(const char *filename)
@@ -421,6 +659,11 @@ int vesacon_load_background(const char *filename)
     if (__vesacon_pixel_format == PXF_NONE)
 	return 0;		/* Not in graphics mode */
 
+    if (cache_load(filename)) {
+	draw_background();
+	return 0;
+    }
+
     fp = fopen(filename, "r");
 
     if (!fp)
@@ -437,6 +680,9 @@ int vesacon_load_background(const char *filename)
 	rv = read_lss16_file(fp, header, 8);
     }
 
+    if (!rv)
+	cache_store(filename);
+
     /* This actually displays the stuff */
     draw_background();
 
@@ -450,6 +696,7 @@ err:
 int __vesacon_init_background(void)
 {
     /* __vesacon_background was cleared by calloc() */
+    __vesacon_flat_background = true;
 
     /* The VESA BIOS has already cleared the screen */
     return 0;
@@ -0,0 +1,165 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   Permission is hereby granted, free of charge, to any person
+ *   obtaining a copy of this software and associated documentation
+ *   files (the "Software"), to deal in the Software without
+ *   restriction, including without limitation the rights to use,
+ *   copy, modify, merge, publish, distribute, sublicense, and/or
+ *   sell copies of the Software, and to permit persons to whom
+ *   the Software is furnished to do so, subject to the following
+ *   conditions:
+ *
+ *   The above copyright notice and this permission notice shall
+ *   be included in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *   OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * drawbench.c
+ *
+ * Host-side benchmark for the VESA text renderer: draws a full screen
+ * of text over a background image into a memory frame buffer, over
+ * and over, and reports the time per frame.  The checksum printed
+ * identifies the rendered image, so it can be compared between
+ * versions of drawtxt.c and screencpy.c.
+ *
+ * Build with "make sys/vesa/drawbench" in com32/lib.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "video.h"
+
+/* The state normally set up by initvesa.c and background.c */
+struct vesa_info __vesa_info;
+struct vesa_char *__vesacon_text_display;
+int __vesacon_font_height;
+int __vesacon_text_rows;
+int __vesacon_text_cols;
+uint8_t __vesacon_graphics_font[FONT_MAX_CHARS][FONT_MAX_HEIGHT];
+unsigned int __vesacon_bytes_per_pixel;
+uint32_t *__vesacon_background, *__vesacon_shadowfb;
+bool __vesacon_flat_background;
+
+/* A menu-like color table: translucent colors, all the shadow modes */
+static struct color_table bench_color_table[] = {
+    {"screen", "37;40", 0x80ffffff, 0x00000000, SHADOW_NORMAL},
+    {"border", "30;44", 0x40000000, 0x00000000, SHADOW_NORMAL},
+    {"title", "1;36;44", 0xc00090f0, 0x00000000, SHADOW_NORMAL},
+    {"sel", "7;37;40", 0xe0000000, 0x20ff8000, SHADOW_NONE},
+    {"unsel", "37;44", 0x90ffffff, 0x00000000, SHADOW_NORMAL},
+    {"hotkey", "1;37;44", 0xffffffff, 0x00000000, SHADOW_REVERSE},
+    {"help", "37;40", 0xc0ffffff, 0x00000000, SHADOW_ALL},
+    {"timeout", "1;37;40", 0xffffffff, 0xff000000, SHADOW_NONE},
+};
+
+struct color_table *console_color_table = bench_color_table;
+int console_color_table_size =
+    sizeof bench_color_table / sizeof bench_color_table[0];
+
+static uint32_t *framebuffer;
+
+/* No BIOS here; screencpy.c only calls it for banking and panning */
+void __intcall(uint8_t vec, const com32sys_t * ireg, com32sys_t * oreg)
+{
+    (void)vec;
+    (void)ireg;
+    if (oreg)
+	memset(oreg, 0, sizeof *oreg);
+}
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    int xres = 1024, yres = 768, frames = 50;
+    int x, y, i, nchars;
+    uint32_t sum;
+    double start, elapsed;
+
+    if (argc > 1)
+	frames = atoi(argv[1]);
+    if (argc > 3) {
+	xres = atoi(argv[2]);
+	yres = atoi(argv[3]);
+    }
+
+    __vesa_info.mi.h_res = xres;
+    __vesa_info.mi.v_res = yres;
+    __vesa_info.mi.logical_scan = xres * 4;
+    __vesa_info.mi.mode_attr = 0x0080;	/* Linear frame buffer */
+    __vesacon_bytes_per_pixel = 4;
+    __vesacon_format_pixels = __vesacon_format_pixels_list[PXF_BGRA32];
+    __vesacon_font_height = 16;
+    __vesacon_text_cols = TEXT_PIXEL_COLS / FONT_WIDTH;
+    __vesacon_text_rows = TEXT_PIXEL_ROWS / __vesacon_font_height;
+
+    /* One extra row, as the renderer reads one pixel below and beyond */
+    __vesacon_background = calloc(xres * (yres + 1) + 1, 4);
+    framebuffer = calloc(xres * yres, 4);
+    __vesacon_shadowfb = calloc(xres * yres, 4);
+    nchars = (__vesacon_text_cols + 2) * (__vesacon_text_rows + 2);
+    __vesacon_text_display = calloc(nchars, sizeof(struct vesa_char));
+    if (!__vesacon_background || !framebuffer || !__vesacon_shadowfb ||
+	!__vesacon_text_display) {
+	perror(argv[0]);
+	return 1;
+    }
+
+    /* A gradient background, a pseudo-random font, random text */
+    for (y = 0; y < yres; y++)
+	for (x = 0; x < xres; x++)
+	    __vesacon_background[y * xres + x] =
+		((x * 255 / xres) << 16) + ((y * 255 / yres) << 8) +
+		((x ^ y) & 0xff);
+
+    srand(1);
+    for (i = 0; i < FONT_MAX_CHARS; i++)
+	for (y = 0; y < __vesacon_font_height; y++)
+	    __vesacon_graphics_font[i][y] = i ? rand() : 0;
+
+    for (i = 0; i < nchars; i++) {
+	__vesacon_text_display[i].ch = rand();
+	__vesacon_text_display[i].attr =
+	    (i / 37) % console_color_table_size;
+    }
+
+    __vesa_info.mi.lfb_ptr = (uint8_t *)framebuffer;
+    __vesacon_init_copy_to_screen();
+    __vesacon_init_cursor(__vesacon_font_height);
+    __vesacon_set_cursor(10, 5, true);
+
+    start = now();
+    for (i = 0; i < frames; i++)
+	__vesacon_redraw_text();
+    elapsed = now() - start;
+
+    sum = 0;
+    for (i = 0; i < xres * yres; i++)
+	sum = (sum << 5) + (sum >> 27) + framebuffer[i];
+
+    printf("%dx%d, %dx%d text: %.2f ms/frame, checksum %08x\n",
+	   xres, yres, __vesacon_text_cols, __vesacon_text_rows,
+	   elapsed * 1000 / frames, sum);
+
+    return 0;
+}
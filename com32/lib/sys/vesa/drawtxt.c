@@ -56,35 +56,102 @@ uint8_t alpha_val(uint8_t fg, uint8_t bg, uint8_t alpha)
     return __vesacon_linear_to_srgb[tmp >> 12];
 }
 
-static uint32_t alpha_pixel(uint32_t fg, uint32_t bg)
+/*
+ * Blending a color onto the background through the gamma tables is
+ * by far the most expensive part of drawing text.  For a given ARGB
+ * color, however, each channel of the result depends only on the same
+ * channel of the background pixel, so we keep, for the few colors in
+ * use, tables of the blended value for every background value.
+ */
+#define BLEND_CACHE_SIZE 16
+
+struct blend_table {
+    uint32_t argb;		/* Color this table is for */
+    uint32_t lru;		/* Time of last use; 0 = unused */
+    uint8_t r[256], g[256], b[256];
+};
+
+static struct blend_table blend_cache[BLEND_CACHE_SIZE];
+static uint32_t blend_clock;
+
+static const struct blend_table *blend_table(uint32_t argb)
 {
-    uint8_t alpha = fg >> 24;
-    uint8_t fg_r = fg >> 16;
-    uint8_t fg_g = fg >> 8;
-    uint8_t fg_b = fg;
-    uint8_t bg_r = bg >> 16;
-    uint8_t bg_g = bg >> 8;
-    uint8_t bg_b = bg;
-
-    return
-	(alpha_val(fg_r, bg_r, alpha) << 16) |
-	(alpha_val(fg_g, bg_g, alpha) << 8) | (alpha_val(fg_b, bg_b, alpha));
+    struct blend_table *bt, *victim = blend_cache;
+    uint8_t alpha = argb >> 24;
+    uint8_t fg_r = argb >> 16;
+    uint8_t fg_g = argb >> 8;
+    uint8_t fg_b = argb;
+    int i;
+
+    for (bt = blend_cache; bt < &blend_cache[BLEND_CACHE_SIZE]; bt++) {
+	if (bt->lru && bt->argb == argb) {
+	    bt->lru = ++blend_clock;
+	    return bt;
+	}
+	if (bt->lru < victim->lru)
+	    victim = bt;
+    }
+
+    bt = victim;
+    for (i = 0; i < 256; i++) {
+	bt->r[i] = alpha_val(fg_r, i, alpha);
+	bt->g[i] = alpha_val(fg_g, i, alpha);
+	bt->b[i] = alpha_val(fg_b, i, alpha);
+    }
+    bt->argb = argb;
+    bt->lru = ++blend_clock;
+
+    return bt;
+}
+
+/* Same as alpha blending the table's color over bg */
+static inline __attribute__ ((always_inline))
+uint32_t blend_pixel(const struct blend_table *bt, uint32_t bg)
+{
+    return (bt->r[(uint8_t)(bg >> 16)] << 16) |
+	(bt->g[(uint8_t)(bg >> 8)] << 8) | bt->b[(uint8_t)bg];
+}
+
+/* One pixel row of a character, including the cursor if it is there */
+static inline uint8_t glyph_bits(const struct vesa_char *cptr, int pixrow)
+{
+    uint8_t bits = __vesacon_graphics_font[cptr->ch][pixrow];
+
+    if (__unlikely(cptr == cursor_pointer))
+	bits |= cursor_pattern[pixrow];
+
+    return bits;
+}
+
+/*
+ * The pixels of a character which are raised (drawn with the
+ * background offset) or cast a shadow, depending on the shadow mode.
+ */
+static inline uint8_t shadow_bits(uint8_t bits, const struct vesa_char *cptr)
+{
+    uint8_t sha = console_color_table[cptr->attr].shadow;
+
+    bits &= (sha & 0x02) ? 0xff : 0x00;
+    bits ^= (sha & 0x01) ? 0xff : 0x00;
+
+    return bits;
 }
 
 static void vesacon_update_characters(int row, int col, int nrows, int ncols)
 {
     const int height = __vesacon_font_height;
     const int width = FONT_WIDTH;
-    uint32_t *bgrowptr, *bgptr, bgval, fgval;
-    uint32_t fgcolor = 0, bgcolor = 0, color;
-    uint8_t chbits = 0, chxbits = 0, chsbits = 0;
-    int i, j, jx, pixrow, pixsrow;
+    const unsigned int h_res = __vesa_info.mi.h_res;
+    uint32_t *bgrowptr, *bgptr, bgval, color;
+    const struct blend_table *fgtbl = NULL, *bgtbl = NULL;
+    uint8_t chbits, chxbits, chsbits, upbits, lastupbits, bit;
+    int i, j, c, npix, pixrow, pixsrow;
+    int last_attr = -1;
     struct vesa_char *rowptr, *rowsptr, *cptr, *csptr;
     unsigned int bytes_per_pixel = __vesacon_bytes_per_pixel;
     unsigned long pixel_offset;
     uint32_t row_buffer[__vesa_info.mi.h_res], *rowbufptr;
     size_t fbrowptr;
-    uint8_t sha;
 
     pixel_offset = ((row * height + VIDEO_BORDER) * __vesa_info.mi.h_res) +
 	(col * width + VIDEO_BORDER);
@@ -106,13 +173,9 @@ static void vesacon_update_characters(int row, int col, int nrows, int ncols)
 	cptr = rowptr;
 	csptr = rowsptr;
 
-	chsbits = __vesacon_graphics_font[csptr->ch][pixsrow];
-	if (__unlikely(csptr == cursor_pointer))
-	    chsbits |= cursor_pattern[pixsrow];
-	sha = console_color_table[csptr->attr].shadow;
-	chsbits &= (sha & 0x02) ? 0xff : 0x00;
-	chsbits ^= (sha & 0x01) ? 0xff : 0x00;
-	chsbits <<= (width - 2);
+	/* The shadow is offset one pixel down and to the right, so the
+	   first pixel gets its shadow from the character to the upper left */
+	lastupbits = shadow_bits(glyph_bits(csptr, pixsrow), csptr);
 	csptr++;
 
 	/* Draw two pixels beyond the end of the line.  One for the shadow,
@@ -120,58 +183,43 @@ static void vesacon_update_characters(int row, int col, int nrows, int ncols)
 	   operation at the end.  Note that this code depends on the fact that
 	   all characters begin on dword boundaries in the frame buffer. */
 
-	for (jx = 1, j = width * ncols + 1; j >= 0; j--) {
-	    chbits <<= 1;
-	    chsbits <<= 1;
-	    chxbits <<= 1;
-
-	    switch (jx) {
-	    case 1:
-		chbits = __vesacon_graphics_font[cptr->ch][pixrow];
-		if (__unlikely(cptr == cursor_pointer))
-		    chbits |= cursor_pattern[pixrow];
-		sha = console_color_table[cptr->attr].shadow;
-		chxbits = chbits;
-		chxbits &= (sha & 0x02) ? 0xff : 0x00;
-		chxbits ^= (sha & 0x01) ? 0xff : 0x00;
-		fgcolor = console_color_table[cptr->attr].argb_fg;
-		bgcolor = console_color_table[cptr->attr].argb_bg;
-		cptr++;
-		jx--;
-		break;
-	    case 0:
-		chsbits = __vesacon_graphics_font[csptr->ch][pixsrow];
-		if (__unlikely(csptr == cursor_pointer))
-		    chsbits |= cursor_pattern[pixsrow];
-		sha = console_color_table[csptr->attr].shadow;
-		chsbits &= (sha & 0x02) ? 0xff : 0x00;
-		chsbits ^= (sha & 0x01) ? 0xff : 0x00;
-		csptr++;
-		jx = width - 1;
-		break;
-	    default:
-		jx--;
-		break;
+	for (c = ncols; c >= 0; c--) {
+	    chbits = glyph_bits(cptr, pixrow);
+	    chxbits = shadow_bits(chbits, cptr);
+
+	    upbits = shadow_bits(glyph_bits(csptr, pixsrow), csptr);
+	    chsbits = (lastupbits << 7) | (upbits >> 1);
+	    lastupbits = upbits;
+
+	    /* Pixels which are in the shadow and not raised */
+	    chsbits &= ~chxbits;
+
+	    if (cptr->attr != last_attr) {
+		last_attr = cptr->attr;
+		fgtbl = blend_table(console_color_table[last_attr].argb_fg);
+		bgtbl = blend_table(console_color_table[last_attr].argb_bg);
 	    }
 
-	    /* If this pixel is raised, use the offsetted value */
-	    bgval = (chxbits & 0x80)
-		? bgptr[__vesa_info.mi.h_res + 1] : *bgptr;
-	    bgptr++;
+	    cptr++;
+	    csptr++;
 
-	    /* If this pixel is set, use the fg color, else the bg color */
-	    fgval = (chbits & 0x80) ? fgcolor : bgcolor;
+	    npix = c ? width : 2;
+	    for (j = 0, bit = 0x80; j < npix; j++, bit >>= 1) {
+		/* If this pixel is raised, use the offsetted value */
+		bgval = (chxbits & bit) ? bgptr[h_res + 1] : *bgptr;
+		bgptr++;
 
-	    /* Produce the combined color pixel value */
-	    color = alpha_pixel(fgval, bgval);
+		/* If this pixel is set, use the fg color, else the bg color */
+		color = blend_pixel((chbits & bit) ? fgtbl : bgtbl, bgval);
 
-	    /* Apply the shadow (75% shadow) */
-	    if ((chsbits & ~chxbits) & 0x80) {
-		color >>= 2;
-		color &= 0x3f3f3f;
-	    }
+		/* Apply the shadow (75% shadow) */
+		if (chsbits & bit) {
+		    color >>= 2;
+		    color &= 0x3f3f3f;
+		}
 
-	    *rowbufptr++ = color;
+		*rowbufptr++ = color;
+	    }
 	}
 
 	/* Copy to frame buffer */
@@ -203,6 +251,8 @@ void __vesacon_doit(void)
 	upd_x0 = upd_y0 = -1U;
 	upd_x1 = upd_y1 = 0;
     }
+
+    __vesacon_flush_screen();
 }
 
 /* Mark a range for update; note argument sequence is the same as
@@ -264,7 +314,33 @@ void __vesacon_scroll_up(int nrows, attr_t attr)
 
     vesacon_fill(toptr, fill, dword_count);
 
-    vesacon_touch(0, 0, __vesacon_text_rows, __vesacon_text_cols);
+    if (!__vesacon_flat_background) {
+	vesacon_touch(0, 0, __vesacon_text_rows, __vesacon_text_cols);
+	return;
+    }
+
+    /*
+     * With a flat background, what is on the screen can simply be
+     * moved up along with the text.  Anything waiting to be drawn
+     * moves with it, and only the new rows at the bottom, and the
+     * cursor, need drawing.  The top row is redrawn right away, as it
+     * may have had shadows cast on it by the row which went away.
+     */
+    __vesacon_scroll_screen(nrows * __vesacon_font_height);
+    vesacon_update_characters(0, 0, 1, __vesacon_text_cols);
+
+    if (upd_y1 > upd_y0) {
+	upd_y0 = (upd_y0 > (unsigned int)nrows) ? upd_y0 - nrows : 0;
+	upd_y1 = (upd_y1 > (unsigned int)nrows) ? upd_y1 - nrows : 0;
+	if (upd_y1 <= upd_y0) {
+	    upd_x0 = upd_y0 = -1U;
+	    upd_x1 = upd_y1 = 0;
+	}
+    }
+    if (cursor_pointer && cursor_y >= nrows)
+	vesacon_touch(cursor_y - nrows, cursor_x, 1, 1);
+
+    vesacon_touch(__vesacon_text_rows - nrows, 0, nrows, __vesacon_text_cols);
 }
 
 /* Draw one character text at a specific area of the screen */
@@ -314,4 +390,5 @@ void __vesacon_init_cursor(int font_height)
 void __vesacon_redraw_text(void)
 {
     vesacon_update_characters(0, 0, __vesacon_text_rows, __vesacon_text_cols);
+    __vesacon_flush_screen();
 }
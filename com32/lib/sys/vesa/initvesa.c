@@ -268,6 +268,14 @@ static int vesacon_set_mode(int x, int y)
     unpack_font((uint8_t *) __vesacon_graphics_font, rom_font,
 		__vesacon_font_height);
 
+    /* Allocate before switching, so running out of memory leaves text mode */
+    __vesacon_background = calloc(mi->h_res*mi->v_res, 4);
+    __vesacon_shadowfb = calloc(mi->logical_scan*mi->v_res, 1);
+    if (!__vesacon_background || !__vesacon_shadowfb) {
+	err = 10;		/* Out of memory */
+	goto exit;
+    }
+
     /* Now set video mode */
     rm.eax.w[0] = 0x4F02;	/* Set SVGA video mode */
     if (mi->mode_attr & 0x0080)
@@ -279,9 +287,6 @@ static int vesacon_set_mode(int x, int y)
 	goto exit;
     }
 
-    __vesacon_background = calloc(mi->h_res*mi->v_res, 4);
-    __vesacon_shadowfb = calloc(mi->h_res*mi->v_res, 4);
-
     __vesacon_init_copy_to_screen();
 
     /* Tell syslinux we changed video mode */
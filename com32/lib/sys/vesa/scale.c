@@ -0,0 +1,318 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   Permission is hereby granted, free of charge, to any person
+ *   obtaining a copy of this software and associated documentation
+ *   files (the "Software"), to deal in the Software without
+ *   restriction, including without limitation the rights to use,
+ *   copy, modify, merge, publish, distribute, sublicense, and/or
+ *   sell copies of the Software, and to permit persons to whom
+ *   the Software is furnished to do so, subject to the following
+ *   conditions:
+ *
+ *   The above copyright notice and this permission notice shall
+ *   be included in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *   OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * scale.c
+ *
+ * Resample a 32-bit BGRA image to a different size.  The image is
+ * fed in one source row at a time, as it is decoded, and output rows
+ * are written as soon as all the source rows they depend on have been
+ * seen; only a few rows of state are kept, never the whole image.
+ *
+ * Each direction is handled separately: a box filter (area average)
+ * when shrinking, so that large reductions don't alias, and bilinear
+ * interpolation when enlarging.  Rows are first resampled across,
+ * then combined down.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <minmax.h>
+#include "video.h"
+
+struct vesacon_scaler {
+    int sw, sh;			/* Source size */
+    int dw, dh;			/* Destination size */
+    uint32_t *dst;		/* Destination, dw pixels per row */
+    int sy;			/* Source rows seen so far */
+    int dy;			/* Destination rows written so far */
+
+    /* Across: the bilinear source position of each destination pixel */
+    uint16_t *xidx;
+    uint8_t *xfrac;		/* Weight of xidx+1, in 1/256 */
+
+    /* Down, box filter: weighted sums for the current destination row */
+    uint32_t *acc;		/* 4 per pixel */
+    int yneed;			/* Weight still needed for that row */
+
+    /* Down, bilinear: the last two source rows, already scaled across */
+    uint32_t *hrow[2];
+
+    uint32_t yscale;		/* 2^24/sh, to normalize the box sums */
+};
+
+/*
+ * Bilinear interpolation of two BGRA pixels; f is the weight of b,
+ * in 1/256.  The red and blue bytes are done in one multiply, then
+ * alpha and green: each product, rounded, still fits in 16 bits.
+ */
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, unsigned int f)
+{
+    uint32_t rb, ag;
+
+    rb = ((a & 0x00ff00ff) * (256 - f) + (b & 0x00ff00ff) * f +
+	  0x00800080) >> 8;
+    ag = (((a >> 8) & 0x00ff00ff) * (256 - f) +
+	  ((b >> 8) & 0x00ff00ff) * f + 0x00800080);
+
+    return (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+}
+
+/*
+ * Position of destination pixel d of n in a source of m pixels
+ * (m <= n), as the index of the left pixel and the weight of the right.
+ * Sample centers are aligned, and the edges clamped.
+ */
+static void bilinear_pos(int d, int m, int n, int *idx, unsigned int *frac)
+{
+    /* (d + 1/2) * m/n - 1/2, in 16.16 fixed point */
+    uint32_t num = (2 * d + 1) * m;
+    uint32_t den = 2 * n;
+    int32_t pos = ((num / den) << 16) + ((num % den) << 16) / den - 0x8000;
+
+    pos = (pos + 0x80) & ~0xff;	/* Round to 1/256 */
+
+    if (pos < 0)
+	pos = 0;
+    else if (pos > (m - 1) << 16)
+	pos = (m - 1) << 16;
+
+    *idx = pos >> 16;
+    *frac = (pos >> 8) & 0xff;
+}
+
+/* Shrink a row across with a box filter */
+static void box_row(uint32_t *dst, const uint32_t *src, int sw, int dw)
+{
+    /*
+     * In units of 1/(sw*dw) of the row, each source pixel has weight
+     * dw and each destination pixel needs sw in total.
+     */
+    const uint32_t scale = (1 << 24) / sw;
+    uint32_t b = 0, g = 0, r = 0, a = 0;
+    int left = dw, need = sw, n = dw, w;
+    uint32_t px = *src;
+
+    for (;;) {
+	w = min(left, need);
+	b += (px & 0xff) * w;
+	g += ((px >> 8) & 0xff) * w;
+	r += ((px >> 16) & 0xff) * w;
+	a += (px >> 24) * w;
+
+	if (!(need -= w)) {
+	    *dst++ = ((b * scale + (1 << 23)) >> 24) |
+		(((g * scale + (1 << 23)) >> 24) << 8) |
+		(((r * scale + (1 << 23)) >> 24) << 16) |
+		(((a * scale + (1 << 23)) >> 24) << 24);
+	    if (!--n)
+		break;
+	    b = g = r = a = 0;
+	    need = sw;
+	}
+	if (!(left -= w)) {
+	    px = *++src;
+	    left = dw;
+	}
+    }
+}
+
+/* Resample a source row across, to dw pixels */
+static void scale_across(const struct vesacon_scaler *s, uint32_t *dst,
+			 const uint32_t *src)
+{
+    int x;
+
+    if (s->sw == s->dw) {
+	memcpy(dst, src, s->dw * sizeof(uint32_t));
+    } else if (s->sw > s->dw) {
+	box_row(dst, src, s->sw, s->dw);
+    } else {
+	for (x = 0; x < s->dw; x++) {
+	    const uint32_t *p = &src[s->xidx[x]];
+	    unsigned int f = s->xfrac[x];
+
+	    *dst++ = f ? lerp_pixel(p[0], p[1], f) : p[0];
+	}
+    }
+}
+
+/* Shrinking down: add a row into the box sums, with weight w */
+static void box_add(uint32_t *acc, const uint32_t *row, int n, uint32_t w)
+{
+    uint32_t px;
+
+    while (n--) {
+	px = *row++;
+	acc[0] += (px & 0xff) * w;
+	acc[1] += ((px >> 8) & 0xff) * w;
+	acc[2] += ((px >> 16) & 0xff) * w;
+	acc[3] += (px >> 24) * w;
+	acc += 4;
+    }
+}
+
+static void box_emit(uint32_t *dst, uint32_t *acc, int n, uint32_t scale)
+{
+    while (n--) {
+	*dst++ = ((acc[0] * scale + (1 << 23)) >> 24) |
+	    (((acc[1] * scale + (1 << 23)) >> 24) << 8) |
+	    (((acc[2] * scale + (1 << 23)) >> 24) << 16) |
+	    (((acc[3] * scale + (1 << 23)) >> 24) << 24);
+	acc[0] = acc[1] = acc[2] = acc[3] = 0;
+	acc += 4;
+    }
+}
+
+/*
+ * Feed the next source row (sw pixels); this writes out all the
+ * destination rows which are complete after it.
+ */
+void __vesacon_scale_row(struct vesacon_scaler *s, const uint32_t *src)
+{
+    const uint32_t *row, *r0, *r1;
+    uint32_t *dp;
+    int left, w, y0, y1, x;
+    unsigned int f;
+
+    if (s->sy >= s->sh)
+	return;
+
+    if (s->sh > s->dh) {
+	/* Box filter down: this row has weight dh, each output needs sh */
+	if (s->sw == s->dw) {
+	    row = src;
+	} else {
+	    scale_across(s, s->hrow[0], src);
+	    row = s->hrow[0];
+	}
+
+	left = s->dh;
+	while (left) {
+	    w = min(left, s->yneed);
+	    box_add(s->acc, row, s->dw, w);
+	    left -= w;
+	    if (!(s->yneed -= w)) {
+		box_emit(s->dst + s->dy++ * s->dw, s->acc, s->dw, s->yscale);
+		s->yneed = s->sh;
+	    }
+	}
+    } else {
+	/* Bilinear down: keep this row and the one before it */
+	scale_across(s, s->hrow[s->sy & 1], src);
+
+	while (s->dy < s->dh) {
+	    bilinear_pos(s->dy, s->sh, s->dh, &y0, &f);
+	    y1 = f ? y0 + 1 : y0;
+	    if (y1 > s->sy)
+		break;		/* Need more source rows */
+
+	    dp = s->dst + s->dy++ * s->dw;
+	    r0 = s->hrow[y0 & 1];
+	    r1 = s->hrow[y1 & 1];
+	    if (!f) {
+		memcpy(dp, r0, s->dw * sizeof(uint32_t));
+	    } else {
+		for (x = 0; x < s->dw; x++)
+		    dp[x] = lerp_pixel(r0[x], r1[x], f);
+	    }
+	}
+    }
+
+    s->sy++;
+}
+
+void __vesacon_scaler_free(struct vesacon_scaler *s)
+{
+    if (!s)
+	return;
+
+    free(s->xidx);
+    free(s->xfrac);
+    free(s->acc);
+    free(s->hrow[0]);
+    free(s->hrow[1]);
+    free(s);
+}
+
+/*
+ * Set up to scale an image of sw x sh pixels to dw x dh, written to
+ * dst.  Returns NULL if out of memory.
+ */
+struct vesacon_scaler *__vesacon_scaler_init(int sw, int sh, uint32_t *dst,
+					     int dw, int dh)
+{
+    struct vesacon_scaler *s;
+    size_t rowbytes = dw * sizeof(uint32_t);
+    unsigned int f;
+    int x, idx;
+
+    s = calloc(1, sizeof *s);
+    if (!s)
+	return NULL;
+
+    s->sw = sw;
+    s->sh = sh;
+    s->dw = dw;
+    s->dh = dh;
+    s->dst = dst;
+
+    if (sw < dw) {
+	s->xidx = malloc(dw * sizeof *s->xidx);
+	s->xfrac = malloc(dw * sizeof *s->xfrac);
+	if (!s->xidx || !s->xfrac)
+	    goto err;
+
+	for (x = 0; x < dw; x++) {
+	    bilinear_pos(x, sw, dw, &idx, &f);
+	    s->xidx[x] = idx;
+	    s->xfrac[x] = f;
+	}
+    }
+
+    s->hrow[0] = malloc(rowbytes);
+    if (!s->hrow[0])
+	goto err;
+
+    if (sh > dh) {
+	s->acc = calloc(dw, 4 * sizeof(uint32_t));
+	if (!s->acc)
+	    goto err;
+	s->yneed = sh;
+	s->yscale = (1 << 24) / sh;
+    } else {
+	s->hrow[1] = malloc(rowbytes);
+	if (!s->hrow[1])
+	    goto err;
+    }
+
+    return s;
+
+err:
+    __vesacon_scaler_free(s);
+    return NULL;
+}
@@ -26,6 +26,7 @@
  * ----------------------------------------------------------------------- */
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <minmax.h>
 #include <klibc/compiler.h>
 #include <string.h>
@@ -42,6 +43,38 @@ static struct win_info {
     int win_num;
 } wi;
 
+/*
+ * Everything is drawn into a shadow copy of the screen, in the final
+ * pixel format (__vesacon_shadowfb, logical_scan bytes per line), and
+ * only the areas which actually changed are written to the frame
+ * buffer, in one pass, by __vesacon_flush_screen().  Frame buffer
+ * writes are slow, especially across PCI Express, and bytes which did
+ * not change are never rewritten.
+ *
+ * Changed areas are tracked as a few rectangles, each covering bytes
+ * [x0, x1) of lines [y0, y1); a scroll typically changes both the top
+ * and the bottom of the screen, but nothing in between.
+ */
+#define DIRTY_RECTS 4
+
+struct dirty_rect {
+    size_t x0, x1, y0, y1;
+};
+static struct dirty_rect dirty[DIRTY_RECTS];
+static int ndirty;
+
+/*
+ * If the mode has room for more lines than are displayed, scrolling
+ * with a flat background is done by moving the display start (VBE
+ * function 4F07h); then only the lines scrolled in need writing.
+ */
+static struct pan_info {
+    bool ok;			/* Panning is usable */
+    bool pending;		/* Display start needs setting */
+    size_t fb_lines;		/* Lines of frame buffer memory */
+    size_t disp_y;		/* First displayed line */
+} pan;
+
 void __vesacon_init_copy_to_screen(void)
 {
     struct vesa_mode_info *const mi = &__vesa_info.mi;
@@ -69,6 +102,16 @@ void __vesacon_init_copy_to_screen(void)
 	wi.win_gshift = ilog2(mi->win_grain) + 10;
 	wi.win_pos = -1;	/* Undefined position */
     }
+
+    /* The shadow starts out cleared, just like the screen */
+    ndirty = 0;
+
+    pan.fb_lines = ((size_t)__vesa_info.gi.total_memory << 16) /
+	mi->logical_scan;
+    pan.ok = wi.win_num < 0 && __vesa_info.gi.version >= 0x0200 &&
+	pan.fb_lines > mi->v_res;
+    pan.pending = false;
+    pan.disp_y = 0;
 }
 
 static void set_window_pos(size_t win_pos)
@@ -87,18 +130,29 @@ static void set_window_pos(size_t win_pos)
     __intcall(0x10, &ireg, NULL);
 }
 
-void __vesacon_copy_to_screen(size_t dst, const uint32_t * src, size_t npixels)
+static int set_display_start(size_t line)
+{
+    static com32sys_t ireg;
+    com32sys_t oreg;
+
+    ireg.eax.w[0] = 0x4F07;
+    ireg.ebx.w[0] = 0x0000;	/* Set display start */
+    ireg.ecx.w[0] = 0;		/* First pixel in line */
+    ireg.edx.w[0] = line;
+
+    __intcall(0x10, &ireg, &oreg);
+
+    return oreg.eax.w[0] == 0x004F ? 0 : -1;
+}
+
+/* Write to the frame buffer proper */
+static void copy_to_fb(size_t dst, const char *s, size_t bytes)
 {
     size_t win_pos, win_off;
     size_t win_size = wi.win_size;
     size_t omask = win_size - 1;
     char *win_base = wi.win_base;
     size_t l;
-    size_t bytes = npixels * __vesacon_bytes_per_pixel;
-    char rowbuf[bytes + 4] __aligned(4);
-    const char *s;
-
-    s = (const char *)__vesacon_format_pixels(rowbuf, src, npixels);
 
     while (bytes) {
 	win_off = dst & omask;
@@ -115,3 +169,146 @@ void __vesacon_copy_to_screen(size_t dst, const uint32_t * src, size_t npixels)
 	dst += l;
     }
 }
+
+static void mark_dirty(size_t x0, size_t x1, size_t y0, size_t y1)
+{
+    struct dirty_rect *dr;
+    int i;
+
+    /* Merge with a rectangle touching the same lines, if any... */
+    for (i = 0; i < ndirty; i++) {
+	dr = &dirty[i];
+	if (y0 <= dr->y1 && y1 >= dr->y0)
+	    goto merge;
+    }
+
+    /* ... else start a new one, or, when out of them, grow the last */
+    if (ndirty < DIRTY_RECTS) {
+	dr = &dirty[ndirty++];
+	dr->x0 = x0;
+	dr->x1 = x1;
+	dr->y0 = y0;
+	dr->y1 = y1;
+	return;
+    }
+    dr = &dirty[DIRTY_RECTS - 1];
+
+merge:
+    dr->x0 = min(dr->x0, x0);
+    dr->x1 = max(dr->x1, x1);
+    dr->y0 = min(dr->y0, y0);
+    dr->y1 = max(dr->y1, y1);
+}
+
+void __vesacon_copy_to_screen(size_t dst, const uint32_t * src, size_t npixels)
+{
+    size_t bytes = npixels * __vesacon_bytes_per_pixel;
+    size_t scan = __vesa_info.mi.logical_scan;
+    char *sp = (char *)__vesacon_shadowfb + dst;
+    char rowbuf[bytes + 4] __aligned(4);
+    const char *s;
+
+    s = (const char *)__vesacon_format_pixels(rowbuf, src, npixels);
+
+    /* Callers never cross a line, so this is a single line segment */
+    if (!memcmp(sp, s, bytes))
+	return;			/* Nothing changed */
+
+    memcpy(sp, s, bytes);
+    mark_dirty(dst % scan, dst % scan + bytes, dst / scan, dst / scan + 1);
+}
+
+/* Write out whatever changed since the last call */
+void __vesacon_flush_screen(void)
+{
+    size_t scan = __vesa_info.mi.logical_scan;
+    size_t y, offs, bytes;
+    const struct dirty_rect *dr;
+    const char *sp;
+
+    for (dr = dirty; dr < &dirty[ndirty]; dr++) {
+	offs = dr->y0 * scan + dr->x0;
+	sp = (const char *)__vesacon_shadowfb + offs;
+	offs += pan.disp_y * scan;
+	bytes = dr->x1 - dr->x0;
+
+	if (bytes == scan) {
+	    /* Whole lines, do it all in one go */
+	    copy_to_fb(offs, sp, bytes * (dr->y1 - dr->y0));
+	} else {
+	    for (y = dr->y0; y < dr->y1; y++) {
+		copy_to_fb(offs, sp, bytes);
+		offs += scan;
+		sp += scan;
+	    }
+	}
+    }
+    ndirty = 0;
+
+    if (pan.pending) {
+	pan.pending = false;
+	if (set_display_start(pan.disp_y)) {
+	    /* Doesn't work after all, go back to the top and stay there */
+	    pan.ok = false;
+	    pan.disp_y = 0;
+	    set_display_start(0);
+	    mark_dirty(0, scan, 0, __vesa_info.mi.v_res);
+	    __vesacon_flush_screen();
+	}
+    }
+}
+
+/*
+ * Scroll the entire screen, borders included, up by the given number
+ * of lines.  This is only correct if the background is flat.  The
+ * caller has to draw the lines scrolled in at the bottom; we redraw
+ * the top border here.
+ */
+void __vesacon_scroll_screen(int lines)
+{
+    const size_t scan = __vesa_info.mi.logical_scan;
+    const size_t v_res = __vesa_info.mi.v_res;
+    const size_t h_res = __vesa_info.mi.h_res;
+    char *shadow = (char *)__vesacon_shadowfb;
+    size_t y;
+    int i, j;
+
+    memmove(shadow, shadow + lines * scan, (v_res - lines) * scan);
+
+    if (pan.ok && pan.disp_y + lines + v_res <= pan.fb_lines) {
+	/* The frame buffer contents move along with the display start */
+	pan.disp_y += lines;
+	pan.pending = true;
+
+	/* So do the pending changes; drop those scrolled off the top */
+	for (i = j = 0; i < ndirty; i++) {
+	    if (dirty[i].y1 <= (size_t)lines)
+		continue;
+	    dirty[j].x0 = dirty[i].x0;
+	    dirty[j].x1 = dirty[i].x1;
+	    dirty[j].y0 = (dirty[i].y0 > (size_t)lines)
+		? dirty[i].y0 - lines : 0;
+	    dirty[j].y1 = dirty[i].y1 - lines;
+	    j++;
+	}
+	ndirty = j;
+
+	/* Frame buffer memory not displayed before is stale */
+	mark_dirty(0, scan, v_res - lines, v_res);
+    } else {
+	if (pan.disp_y) {
+	    /* Out of room, start over from the top */
+	    pan.disp_y = 0;
+	    pan.pending = true;
+	}
+	ndirty = 0;
+	mark_dirty(0, scan, 0, v_res);
+    }
+
+    for (y = 0; y < VIDEO_BORDER; y++)
+	__vesacon_copy_to_screen(y * scan, &__vesacon_background[y * h_res],
+				 h_res);
+    for (y = v_res - lines; y < v_res; y++)
+	__vesacon_copy_to_screen(y * scan, &__vesacon_background[y * h_res],
+				 h_res);
+}
@@ -75,6 +75,7 @@ extern int __vesacon_text_cols;
 extern uint8_t __vesacon_graphics_font[FONT_MAX_CHARS][FONT_MAX_HEIGHT];
 extern uint32_t *__vesacon_background;
 extern uint32_t *__vesacon_shadowfb;
+extern bool __vesacon_flat_background;
 
 extern const uint16_t __vesacon_srgb_to_linear[256];
 extern const uint8_t __vesacon_linear_to_srgb[4080];
@@ -90,8 +91,15 @@ void __vesacon_redraw_text(void);
 void __vesacon_doit(void);
 void __vesacon_set_cursor(int, int, bool);
 void __vesacon_copy_to_screen(size_t, const uint32_t *, size_t);
+void __vesacon_flush_screen(void);
+void __vesacon_scroll_screen(int);
 void __vesacon_init_copy_to_screen(void);
 
+struct vesacon_scaler;
+struct vesacon_scaler *__vesacon_scaler_init(int, int, uint32_t *, int, int);
+void __vesacon_scale_row(struct vesacon_scaler *, const uint32_t *);
+void __vesacon_scaler_free(struct vesacon_scaler *);
+
 int __vesacon_i915resolution(int x, int y);
 
 #endif /* LIB_SYS_VESA_VIDEO_H */
@@ -40,14 +40,9 @@
 #include <syslinux/config.h>
 #include "file.h"
 
-static void emit(char ch)
+static inline void emit(char ch)
 {
-    static com32sys_t ireg;	/* Zeroed with the BSS */
-
-    ireg.eax.b[1] = 0x04;
-    ireg.edx.b[0] = ch;
-
-    __intcall(0x21, &ireg, NULL);
+    __serial_putc(ch);
 }
 
 ssize_t __xserial_write(struct file_info *fp, const void *buf, size_t count)
@@ -114,5 +109,6 @@ ssize_t __xserial_write(struct file_info *fp, const void *buf, size_t count)
 	n++;
     }
 
+    __serial_flush();
     return n;
 }
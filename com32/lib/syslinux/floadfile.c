@@ -37,6 +37,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <minmax.h>
 
 #include <syslinux/loadfile.h>
 
@@ -67,7 +68,15 @@ int floadfile(FILE * f, void **ptr, size_t * len, const void *prefix,
 	}
 
 	do {
-	    alen += INCREMENTAL_CHUNK;
+	    /*
+	     * Grow by a quarter of what we have, so that if realloc()
+	     * can't grow the block in place the copying stays linear in
+	     * the file size; the excess is trimmed below.  Keep alen a
+	     * multiple of LOADFILE_ZERO_PAD, so the padding always fits
+	     * even if that trim fails.
+	     */
+	    alen += max(alen >> 2, (size_t)INCREMENTAL_CHUNK);
+	    alen = (alen + LOADFILE_ZERO_PAD - 1) & ~(LOADFILE_ZERO_PAD - 1);
 	    dp = realloc(data, alen);
 	    if (!dp)
 		goto err;
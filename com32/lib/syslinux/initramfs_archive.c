@@ -28,7 +28,7 @@
 /*
  * initramfs_archive.c
  *
- * Utility function to load an initramfs archive.
+ * Utility functions to load an initramfs archive.
  */
 
 #include <stdlib.h>
@@ -45,3 +45,21 @@ int initramfs_load_archive(struct initramfs *ihead, const char *filename)
 
     return initramfs_add_data(ihead, data, len, len, 4);
 }
+
+/*
+ * Same, but decompress a gzip'd archive as it is read: zloadfile()
+ * inflates each block as it arrives, straight into the final buffer,
+ * so the compressed image is never held in memory.  Useful for images
+ * the kernel would otherwise have to decompress again, e.g. MEMDISK
+ * disk images.
+ */
+int initramfs_zload_archive(struct initramfs *ihead, const char *filename)
+{
+    void *data;
+    size_t len;
+
+    if (zloadfile(filename, &data, &len))
+	return -1;
+
+    return initramfs_add_data(ihead, data, len, len, 4);
+}
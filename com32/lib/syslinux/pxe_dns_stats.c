@@ -0,0 +1,62 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2012 H. Peter Anvin - All Rights Reserved
+ *
+ *   Permission is hereby granted, free of charge, to any person
+ *   obtaining a copy of this software and associated documentation
+ *   files (the "Software"), to deal in the Software without
+ *   restriction, including without limitation the rights to use,
+ *   copy, modify, merge, publish, distribute, sublicense, and/or
+ *   sell copies of the Software, and to permit persons to whom
+ *   the Software is furnished to do so, subject to the following
+ *   conditions:
+ *
+ *   The above copyright notice and this permission notice shall
+ *   be included in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *   OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * pxe_dns_stats.c
+ *
+ * Get the PXELINUX DNS cache statistics
+ */
+
+#include <string.h>
+#include <com32.h>
+
+#include <syslinux/pxe.h>
+
+/* Returns 0 on success, or -1 if not running under a PXELINUX which
+   supports this call */
+int pxe_get_dns_stats(struct pxe_dns_stats *stats)
+{
+    com32sys_t regs;
+    size_t len;
+
+    memset(&regs, 0, sizeof regs);
+    regs.eax.w[0] = 0x0025;
+
+    __intcall(0x22, &regs, &regs);
+
+    if (regs.eflags.l & EFLAGS_CF)
+	return -1;
+
+    /* Older or newer cores may have a differently sized structure */
+    memset(stats, 0, sizeof *stats);
+    len = regs.ecx.w[0];
+    if (len > sizeof *stats)
+	len = sizeof *stats;
+    memcpy(stats, MK_PTR(regs.es, regs.ebx.w[0]), len);
+
+    return 0;
+}
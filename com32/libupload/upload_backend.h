@@ -15,6 +15,7 @@ struct upload_backend {
     const char *name;
     const char *helpmsg;
     int minargs;
+    int zlevel;			/* Compression level */
 
     size_t dbytes;
     size_t zbytes;
@@ -23,10 +24,16 @@ struct upload_backend {
     uint32_t now;
 
     int (*write)(struct upload_backend *);
+    /*
+     * Optional: called whenever the output buffer fills up; returns how
+     * many bytes off the front of it were sent.  ->write gets the rest.
+     */
+    size_t (*stream)(struct upload_backend *);
 
     z_stream zstream;
     char *outbuf;
     size_t alloc;
+    size_t zsent;		/* Compressed bytes already streamed */
 };
 
 /* zout.c */
@@ -81,5 +81,6 @@ struct upload_backend upload_srec = {
     .name       = "srec",
     .helpmsg    = "[filename]",
     .minargs    = 0,
+    .zlevel     = Z_BEST_COMPRESSION,
     .write      = upload_srec_write,
 };
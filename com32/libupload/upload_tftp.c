@@ -1,9 +1,17 @@
 /*
  * TFTP data output backend
+ *
+ * The data goes out with a WRQ asking for a larger block size (RFC 2348)
+ * and a window of several blocks per acknowledgement (RFC 7440); servers
+ * which don't know about these options get plain 512-byte lockstep.
+ *
+ * The transfer starts as soon as the first buffer of compressed data is
+ * full, so the upload overlaps the compression and the buffer stays small.
  */
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <syslinux/pxe.h>
 #include <syslinux/config.h>
 #include <netinet/in.h>
@@ -16,6 +24,7 @@ enum tftp_opcode {
     TFTP_DATA	= 3,
     TFTP_ACK	= 4,
     TFTP_ERROR	= 5,
+    TFTP_OACK	= 6,
 };
 
 struct tftp_error {
@@ -30,9 +39,17 @@ struct tftp_state {
     uint32_t srv_gw;
     uint16_t my_port;
     uint16_t srv_port;
-    uint16_t seq;
+    uint16_t blksize;
+    uint16_t windowsize;
+    uint32_t block;		/* Blocks sent and acknowledged */
+    int opened;			/* The WRQ has been tried */
+    int status;			/* TFTP_OK or error; an ERROR 0 gives 0 */
+    t_PXENV_UDP_WRITE *uw;
+    t_PXENV_UDP_READ  *ur;
 };
 
+static struct tftp_state tftp_state;
+
 const char *tftp_string_error_message[]={
 "",
 "File not found",
@@ -48,157 +65,346 @@ const char *tftp_string_error_message[]={
 "No Error",
 };
 
-#define RCV_BUF	2048
+#define RCV_BUF		2048
+#define SND_BUF		2048
+
+#define TFTP_DEF_BLKSIZE	512
+#define TFTP_BLKSIZE		1408	/* Fits an Ethernet frame, even
+					   with some tunneling overhead */
+#define TFTP_WINDOWSIZE		16
+
+#define STR(x)			#x
+#define XSTR(x)			STR(x)
+
+/* Retransmission timeouts, in BIOS ticks as in the core */
+static const clock_t timeouts[] = {
+    2, 2, 3, 3, 4, 5, 6, 7, 9, 10, 12, 15, 18, 21, 26, 31,
+    37, 44, 53, 64, 77, 92, 110, 132, 159, 191, 229, 0
+};
+#define TICKS_TO_MS(x)	((x) * 55)
 
-static int send_ack_packet(struct tftp_state *tftp,
-			   const void *pkt, size_t len)
+static void send_packet(struct tftp_state *tftp, const void *pkt, size_t len)
 {
+    t_PXENV_UDP_WRITE *uw = tftp->uw;
     com32sys_t ireg, oreg;
-    t_PXENV_UDP_WRITE *uw;
-    t_PXENV_UDP_READ  *ur;
-    clock_t start;
-    static const clock_t timeouts[] = {
-	2, 2, 3, 3, 4, 5, 6, 7, 9, 10, 12, 15, 18, 21, 26, 31,
-	37, 44, 53, 64, 77, 92, 110, 132, 159, 191, 229, 0
-    };
-    const clock_t *timeout;
-    int err = -1;
-
-    uw = lmalloc(sizeof *uw + len);
-    ur = lmalloc(sizeof *ur + RCV_BUF);
 
     memset(&ireg, 0, sizeof ireg);
     ireg.eax.w[0] = 0x0009;
 
-    for (timeout = timeouts ; *timeout ; timeout++) {
-	memset(uw, 0, sizeof *uw);
+    memset(uw, 0, sizeof *uw);
+    if (pkt != uw+1)
 	memcpy(uw+1, pkt, len);
-	uw->ip = tftp->srv_ip;
-	uw->gw = tftp->srv_gw;
-	uw->src_port = tftp->my_port;
-	uw->dst_port = tftp->srv_port ? tftp->srv_port : htons(69);
-	uw->buffer_size = len;
-	uw->buffer = FAR_PTR(uw+1);
+    uw->ip = tftp->srv_ip;
+    uw->gw = tftp->srv_gw;
+    uw->src_port = tftp->my_port;
+    uw->dst_port = tftp->srv_port ? tftp->srv_port : htons(69);
+    uw->buffer_size = len;
+    uw->buffer = FAR_PTR(uw+1);
+
+    ireg.ebx.w[0] = PXENV_UDP_WRITE;
+    ireg.es = SEG(uw);
+    ireg.edi.w[0] = OFFS(uw);
+
+    __intcall(0x22, &ireg, &oreg);
+}
+
+/*
+ * Wait for a packet from the server; returns its length, or -1 on
+ * timeout.  The packet is at tftp->ur+1.
+ */
+static int recv_packet(struct tftp_state *tftp, clock_t start, clock_t timeout)
+{
+    t_PXENV_UDP_READ *ur = tftp->ur;
+    com32sys_t ireg, oreg;
+
+    memset(&ireg, 0, sizeof ireg);
+    ireg.eax.w[0] = 0x0009;
 
-	ireg.ebx.w[0] = PXENV_UDP_WRITE;
-	ireg.es = SEG(uw);
-	ireg.edi.w[0] = OFFS(uw);
+    do {
+	memset(ur, 0, sizeof *ur);
+	ur->src_ip = tftp->srv_ip;
+	ur->dest_ip = tftp->my_ip;
+	ur->s_port = tftp->srv_port;
+	ur->d_port = tftp->my_port;
+	ur->buffer_size = RCV_BUF;
+	ur->buffer = FAR_PTR(ur+1);
 
+	ireg.ebx.w[0] = PXENV_UDP_READ;
+	ireg.es = SEG(ur);
+	ireg.edi.w[0] = OFFS(ur);
 	__intcall(0x22, &ireg, &oreg);
 
+	if (!(oreg.eflags.l & EFLAGS_CF) &&
+	    ur->status == PXENV_STATUS_SUCCESS &&
+	    tftp->srv_ip == ur->src_ip &&
+	    (tftp->srv_port == 0 ||
+	     tftp->srv_port == ur->s_port) &&
+	    ur->buffer_size >= 4)
+	    return ur->buffer_size;
+    } while ((clock_t)(times(NULL) - start) < TICKS_TO_MS(timeout));
+
+    return -1;
+}
+
+static int error_packet(struct tftp_state *tftp)
+{
+    struct tftp_error *te = (struct tftp_error *)(tftp->ur+1);
+
+    if (te->errcode == TFTP_ERR_UNKNOWN_ERROR) {
+	tftp_string_error_message[TFTP_ERR_UNKNOWN_ERROR]=strdup(te->errmsg);
+    }
+    return -ntohs(te->errcode); // Return the associated error code
+}
+
+/*
+ * Parse an OACK; anything we didn't ask for, or larger than we asked
+ * for, makes the negotiation fail.
+ */
+static int parse_oack(struct tftp_state *tftp, int len)
+{
+    char *p = (char *)(tftp->ur+1) + 2;
+    char *end = p + len - 2;
+    const char *opt, *val;
+    unsigned long v;
+
+    end[-1] = '\0';		/* Don't run off the end */
+
+    while (p < end && *p) {
+	opt = p;
+	p += strlen(p) + 1;
+	if (p >= end)
+	    return -1;
+	val = p;
+	p += strlen(p) + 1;
+
+	v = strtoul(val, NULL, 10);
+	if (!strcasecmp(opt, "blksize") && v >= 8 && v <= TFTP_BLKSIZE)
+	    tftp->blksize = v;
+	else if (!strcasecmp(opt, "windowsize") && v >= 1 &&
+		 v <= TFTP_WINDOWSIZE)
+	    tftp->windowsize = v;
+	else
+	    return -1;
+    }
+
+    return 0;
+}
+
+static int send_wrq(struct tftp_state *tftp, const char *filename)
+{
+    static const char options[] =
+	"octet\0"
+	"blksize\0" XSTR(TFTP_BLKSIZE) "\0"
+	"windowsize\0" XSTR(TFTP_WINDOWSIZE);
+    char *buffer = (char *)(tftp->uw+1);
+    const clock_t *timeout;
+    uint16_t *xb = (uint16_t *)(tftp->ur+1);
+    uint16_t *eb = (uint16_t *)(tftp->uw+1);
+    clock_t start;
+    int nlen, len;
+
+    buffer[0] = 0;
+    buffer[1] = TFTP_WRQ;
+    nlen = strlcpy(buffer+2, filename, 512);
+    memcpy(buffer+3+nlen, options, sizeof options);
+    len = 2+nlen+1+sizeof options;
+
+    for (timeout = timeouts ; *timeout ; timeout++) {
+	send_packet(tftp, buffer, len);
 	start = times(NULL);
 
-	do {
-	    memset(ur, 0, sizeof *ur);
-	    ur->src_ip = tftp->srv_ip;
-	    ur->dest_ip = tftp->my_ip;
-	    ur->s_port = tftp->srv_port;
-	    ur->d_port = tftp->my_port;
-	    ur->buffer_size = RCV_BUF;
-	    ur->buffer = FAR_PTR(ur+1);
-
-	    ireg.ebx.w[0] = PXENV_UDP_READ;
-	    ireg.es = SEG(ur);
-	    ireg.edi.w[0] = OFFS(ur);
-	    __intcall(0x22, &ireg, &oreg);
-
-	    if (!(oreg.eflags.l & EFLAGS_CF) &&
-		ur->status == PXENV_STATUS_SUCCESS &&
-		tftp->srv_ip == ur->src_ip &&
-		(tftp->srv_port == 0 ||
-		 tftp->srv_port == ur->s_port)) {
-		uint16_t *xb = (uint16_t *)(ur+1);
-		if (ntohs(xb[0]) == TFTP_ACK &&
-		    ntohs(xb[1]) == tftp->seq) {
-		    tftp->srv_port = ur->s_port;
-		    err = TFTP_OK;		/* All good! */
-		    goto done;
-		} else if (ntohs(xb[0]) == TFTP_ERROR) {
-		    struct tftp_error *te = (struct tftp_error *)(ur+1);
-		    if (te->errcode == TFTP_ERR_UNKNOWN_ERROR) {
-		    	tftp_string_error_message[TFTP_ERR_UNKNOWN_ERROR]=strdup(te->errmsg);
-		    }
- 		    err=-ntohs(te->errcode); // Return the associated error code
-		    goto done;
+	while ((len = recv_packet(tftp, start, *timeout)) >= 0) {
+	    switch (ntohs(xb[0])) {
+	    case TFTP_ACK:
+		if (ntohs(xb[1]) != 0)
+		    continue;
+		/* No options; plain TFTP */
+		tftp->blksize    = TFTP_DEF_BLKSIZE;
+		tftp->windowsize = 1;
+		break;
+	    case TFTP_OACK:
+		tftp->blksize    = TFTP_DEF_BLKSIZE;
+		tftp->windowsize = 1;
+		if (parse_oack(tftp, len)) {
+		    tftp->srv_port = tftp->ur->s_port;
+		    eb[0] = htons(TFTP_ERROR);
+		    eb[1] = htons(TFTP_ERR_BAD_OPTS);
+		    memcpy(eb+2, "Bad options", 12);
+		    send_packet(tftp, eb, 4+12);
+		    return -TFTP_ERR_BAD_OPTS;
 		}
+		break;
+	    case TFTP_ERROR:
+		return error_packet(tftp);
+	    default:
+		continue;
 	    }
-	} while ((clock_t)(times(NULL) - start) < *timeout);
+	    tftp->srv_port = tftp->ur->s_port;
+	    return TFTP_OK;
+	}
     }
 
-done:
-    lfree(ur);
-    lfree(uw);
+    return -1;
+}
 
-    return err;
+static void send_block(struct tftp_state *tftp, uint32_t blk,
+		       const char *data, size_t len)
+{
+    char *buffer = (char *)(tftp->uw+1);
+    size_t offset = (size_t)(blk - 1) * tftp->blksize;
+    size_t chunk = len - offset;
+
+    if (chunk > tftp->blksize)
+	chunk = tftp->blksize;
+
+    buffer[0] = 0;
+    buffer[1] = TFTP_DATA;
+    *((uint16_t *)(buffer+2)) = htons((uint16_t)(tftp->block + blk));
+    memcpy(buffer+4, data + offset, chunk);
+
+    send_packet(tftp, buffer, chunk+4);
 }
 
-static int upload_tftp_write(struct upload_backend *be)
+/*
+ * Send nblocks blocks of data a window at a time.  The server
+ * acknowledges the last block of every window, or the last one it got
+ * in sequence if some were lost; we then carry on from there.  Block
+ * numbers roll over to zero past 65535.
+ */
+static int send_data(struct tftp_state *tftp, const char *data, size_t len,
+		     uint32_t nblocks)
+{
+    uint32_t acked = 0, sent, blk;
+    uint16_t *xb = (uint16_t *)(tftp->ur+1);
+    uint16_t delta;
+    const clock_t *timeout = timeouts;
+    clock_t start;
+
+    while (acked < nblocks) {
+	sent = acked + tftp->windowsize;
+	if (sent > nblocks)
+	    sent = nblocks;
+	for (blk = acked + 1; blk <= sent; blk++)
+	    send_block(tftp, blk, data, len);
+
+	start = times(NULL);
+	for (;;) {
+	    if (recv_packet(tftp, start, *timeout) < 0) {
+		if (!*++timeout)
+		    return -1;
+		break;		/* Send the window again */
+	    }
+
+	    if (ntohs(xb[0]) == TFTP_ERROR)
+		return error_packet(tftp);
+	    if (ntohs(xb[0]) != TFTP_ACK)
+		continue;
+
+	    delta = ntohs(xb[1]) - (uint16_t)(tftp->block + acked);
+	    if (delta && delta <= sent - acked) {
+		acked += delta;
+		timeout = timeouts;
+		break;
+	    }
+	}
+    }
+
+    tftp->block += nblocks;
+    return TFTP_OK;
+}
+
+static int tftp_open(struct upload_backend *be, struct tftp_state *tftp)
 {
     static uint16_t local_port = 0x4000;
-    struct tftp_state tftp;
-    char buffer[512+4+6];
-    int nlen;
-    int err=TFTP_OK;
     const union syslinux_derivative_info *sdi =
 	syslinux_derivative_info();
-    const char *data = be->outbuf;
-    size_t len = be->zbytes;
-    size_t chunk;
 
-    tftp.my_ip    = sdi->pxe.myip;
-    tftp.my_port  = htons(local_port++);
-    tftp.srv_gw   = ((tftp.srv_ip ^ tftp.my_ip) & sdi->pxe.ipinfo->netmask)
-	? sdi->pxe.ipinfo->gateway : 0;
-    tftp.srv_port = 0;
-    tftp.seq      = 0;
+    tftp->my_ip    = sdi->pxe.myip;
+    tftp->my_port  = htons(local_port++);
+    tftp->srv_port = 0;
+    tftp->block    = 0;
 
     if (be->argv[1]) {
-	tftp.srv_ip   = pxe_dns(be->argv[1]);
-	if (!tftp.srv_ip) {
+	tftp->srv_ip   = pxe_dns(be->argv[1]);
+	if (!tftp->srv_ip) {
 //	    printf("\nUnable to resolve hostname: %s\n", be->argv[1]);
 	    return -TFTP_ERR_UNABLE_TO_RESOLVE;
 	}
     } else {
-	tftp.srv_ip   = sdi->pxe.ipinfo->serverip;
-	if (!tftp.srv_ip) {
+	tftp->srv_ip   = sdi->pxe.ipinfo->serverip;
+	if (!tftp->srv_ip) {
 //	    printf("\nNo server IP address\n");
 	    return -TFTP_ERR_UNABLE_TO_CONNECT;
 	}
     }
 
+    tftp->srv_gw   = ((tftp->srv_ip ^ tftp->my_ip) & sdi->pxe.ipinfo->netmask)
+	? sdi->pxe.ipinfo->gateway : 0;
+
 /*    printf("server %u.%u.%u.%u... ",
-	   ((uint8_t *)&tftp.srv_ip)[0],
-	   ((uint8_t *)&tftp.srv_ip)[1],
-	   ((uint8_t *)&tftp.srv_ip)[2],
-	   ((uint8_t *)&tftp.srv_ip)[3]);*/
+	   ((uint8_t *)&tftp->srv_ip)[0],
+	   ((uint8_t *)&tftp->srv_ip)[1],
+	   ((uint8_t *)&tftp->srv_ip)[2],
+	   ((uint8_t *)&tftp->srv_ip)[3]);*/
 
-    buffer[0] = 0;
-    buffer[1] = TFTP_WRQ;
-    nlen = strlcpy(buffer+2, be->argv[0], 512);
-    memcpy(buffer+3+nlen, "octet", 6);
+    tftp->uw = lmalloc(sizeof *tftp->uw + SND_BUF);
+    tftp->ur = lmalloc(sizeof *tftp->ur + RCV_BUF);
+    if (!tftp->uw || !tftp->ur)
+	return -1;
 
-    if ((err=send_ack_packet(&tftp, buffer, 2+nlen+1+6))!=TFTP_OK)
-	return err;
+    return send_wrq(tftp, be->argv[0]);
+}
 
-    do {
-	chunk = len >= 512 ? 512 : len;
+/*
+ * Send all the full blocks we have so far; the last, short block has
+ * to wait for upload_tftp_write().  Once the transfer has failed the
+ * data has nowhere to go, so it is dropped, and the error reported at
+ * the end.
+ */
+static size_t upload_tftp_stream(struct upload_backend *be)
+{
+    struct tftp_state *tftp = &tftp_state;
+    size_t len = be->zbytes - be->zsent;
+    uint32_t nblocks;
 
-	buffer[1] = TFTP_DATA;
-	*((uint16_t *)(buffer+2)) = htons(++tftp.seq);
-	memcpy(buffer+4, data, chunk);
-	data += chunk;
-	len -= chunk;
+    if (!tftp->opened) {
+	tftp->opened = 1;
+	tftp->status = tftp_open(be, tftp);
+    }
+    if (tftp->status != TFTP_OK)
+	return len;
 
-	if ((err=send_ack_packet(&tftp, buffer, chunk+4))!=TFTP_OK)
-	    return err;
-    } while (chunk == 512);
+    nblocks = len / tftp->blksize;
+    tftp->status = send_data(tftp, be->outbuf, len, nblocks);
+    return (size_t)nblocks * tftp->blksize;
+}
 
-    return TFTP_OK;
+static int upload_tftp_write(struct upload_backend *be)
+{
+    struct tftp_state *tftp = &tftp_state;
+    size_t len = be->zbytes - be->zsent;
+    int err;
+
+    if (!tftp->opened) {
+	tftp->opened = 1;
+	tftp->status = tftp_open(be, tftp);
+    }
+    if (tftp->status == TFTP_OK)	/* The last block is short, maybe empty */
+	tftp->status = send_data(tftp, be->outbuf, len,
+				 len / tftp->blksize + 1);
+
+    err = tftp->status;
+    lfree(tftp->ur);
+    lfree(tftp->uw);
+    memset(tftp, 0, sizeof *tftp);
+    return err;
 }
 
 struct upload_backend upload_tftp = {
     .name       = "tftp",
     .helpmsg    = "filename [tftp_server]",
     .minargs    = 1,
+    .zlevel     = Z_BEST_SPEED,
     .write      = upload_tftp_write,
+    .stream     = upload_tftp_stream,
 };
@@ -171,5 +171,6 @@ struct upload_backend upload_ymodem = {
     .name       = "ymodem",
     .helpmsg    = "filename [port [speed]]",
     .minargs    = 1,
+    .zlevel     = Z_BEST_COMPRESSION,
     .write      = upload_ymodem_write,
 };
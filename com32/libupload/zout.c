@@ -12,6 +12,7 @@
 #include "ctime.h"
 
 #define ALLOC_CHUNK	65536
+#define STREAM_CHUNK	32768	/* Output buffer of a streaming back end */
 
 int init_data(struct upload_backend *be, const char *argv[])
 {
@@ -23,10 +24,10 @@ int init_data(struct upload_backend *be, const char *argv[])
     be->zstream.next_out  = NULL;
     be->outbuf = NULL;
     be->zstream.avail_out = be->alloc  = 0;
-    be->dbytes = be->zbytes = 0;
+    be->dbytes = be->zbytes = be->zsent = 0;
 
     /* Initialize a gzip data stream */
-    if (deflateInit2(&be->zstream, 9, Z_DEFLATED,
+    if (deflateInit2(&be->zstream, be->zlevel, Z_DEFLATED,
 		     16+15, 9, Z_DEFAULT_STRATEGY) < 0)
 	return -1;
 
@@ -37,20 +38,42 @@ static int do_deflate(struct upload_backend *be, int flush)
 {
     int rv;
     char *buf;
+    size_t grow, used, sent;
 
     while (1) {
 	rv = deflate(&be->zstream, flush);
-	be->zbytes = be->alloc - be->zstream.avail_out;
+	be->zbytes = be->zsent + be->alloc - be->zstream.avail_out;
 	if (be->zstream.avail_out)
 	    return rv;		   /* Not an issue of output space... */
 
-	buf = realloc(be->outbuf, be->alloc + ALLOC_CHUNK);
+	used = be->zbytes - be->zsent;
+
+	/* Let a streaming back end send what it can of a full buffer */
+	if (be->stream && be->alloc) {
+	    sent = be->stream(be);
+	    if (sent) {
+		memmove(be->outbuf, be->outbuf + sent, used - sent);
+		be->zsent += sent;
+		be->zstream.next_out = (void *)(be->outbuf + used - sent);
+		be->zstream.avail_out = be->alloc - (used - sent);
+		continue;
+	    }
+	}
+
+	/* Grow geometrically, or large dumps spend their time copying */
+	grow = be->alloc >> 1;
+	if (grow < ALLOC_CHUNK)
+	    grow = ALLOC_CHUNK;
+	if (be->stream && !be->alloc)
+	    grow = STREAM_CHUNK;
+
+	buf = realloc(be->outbuf, be->alloc + grow);
 	if (!buf)
 	    return Z_MEM_ERROR;
 	be->outbuf = buf;
-	be->alloc += ALLOC_CHUNK;
-	be->zstream.next_out = (void *)(buf + be->zbytes);
-	be->zstream.avail_out = be->alloc - be->zbytes;
+	be->alloc += grow;
+	be->zstream.next_out = (void *)(buf + used);
+	be->zstream.avail_out = be->alloc - used;
     }
 }
 
@@ -85,15 +108,17 @@ int flush_data(struct upload_backend *be)
 	if (rv < 0)
 	    return -1;
     }
+    deflateEnd(&be->zstream);
 
 //    printf("Uploading data, %u bytes... ", be->zbytes);
 
     if ((err=be->write(be)) != 0)
 	return err;
 
+    /* Leave dbytes and zbytes for the caller to report */
     free(be->outbuf);
     be->outbuf = NULL;
-    be->dbytes = be->zbytes = be->alloc = 0;
+    be->alloc = 0;
 
 //    printf("done.\n");
     return 0;
@@ -11,6 +11,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef SYSLINUX
+#include <sys/stat.h>
+#endif
 
 
 /* This file uses only the official API of Lua.
@@ -549,10 +552,92 @@ static int errfile (lua_State *L, const char *what, int fnameindex) {
 }
 
 
+#ifdef SYSLINUX
+/*
+** The compiled chunks of the files loaded so far, so that running a
+** script again (dofile, loadfile) undumps it instead of parsing it
+** again.  There are no modification times here, so a file whose size
+** changed is taken to have changed.
+*/
+
+#define CHUNKCACHE_MAX	(1 << 20)  /* at most this much bytecode is kept */
+
+typedef struct Chunk {
+  struct Chunk *next;
+  size_t fsize;  /* size of the file it was compiled from */
+  size_t size, alloc;
+  char *code;
+  char name[1];
+} Chunk;
+
+static Chunk *chunkcache = NULL;
+static size_t chunkcache_size = 0;
+
+
+static Chunk *findchunk (const char *filename, size_t fsize) {
+  Chunk **cp, *c;
+  for (cp = &chunkcache; (c = *cp) != NULL; cp = &c->next) {
+    if (strcmp(c->name, filename) != 0) continue;
+    if (c->fsize == fsize) return c;
+    *cp = c->next;  /* the file changed, drop the old code */
+    chunkcache_size -= c->size;
+    free(c->code);
+    free(c);
+    break;
+  }
+  return NULL;
+}
+
+
+static int writechunk (lua_State *L, const void *p, size_t sz, void *ud) {
+  Chunk *c = (Chunk *)ud;
+  (void)L;
+  if (chunkcache_size + c->size + sz > CHUNKCACHE_MAX) return 1;
+  if (c->size + sz > c->alloc) {
+    size_t alloc = c->alloc ? c->alloc * 2 : LUAL_BUFFERSIZE;
+    char *code;
+    while (alloc < c->size + sz) alloc *= 2;
+    code = (char *)realloc(c->code, alloc);
+    if (code == NULL) return 1;
+    c->code = code;
+    c->alloc = alloc;
+  }
+  memcpy(c->code + c->size, p, sz);
+  c->size += sz;
+  return 0;
+}
+
+
+/* keep the bytecode of the function on top of the stack */
+static void cachechunk (lua_State *L, const char *filename, size_t fsize) {
+  size_t len = strlen(filename);
+  Chunk *c = (Chunk *)malloc(sizeof(Chunk) + len);
+  if (c == NULL) return;
+  memcpy(c->name, filename, len + 1);
+  c->fsize = fsize;
+  c->size = c->alloc = 0;
+  c->code = NULL;
+  if (lua_dump(L, writechunk, c) != 0) {
+    free(c->code);
+    free(c);
+    return;
+  }
+  c->next = chunkcache;
+  chunkcache = c;
+  chunkcache_size += c->size;
+}
+#endif
+
+
 LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
   LoadF lf;
   int status, readstatus;
   int fnameindex = lua_gettop(L) + 1;  /* index of filename on the stack */
+#ifdef SYSLINUX
+  struct stat st;
+  Chunk *c;
+  st.st_mode = 0;
+#endif
   lf.extraline = 0;
   if (filename == NULL) {
     lua_pushliteral(L, "=stdin");
@@ -562,6 +647,15 @@ LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
     lua_pushfstring(L, "@%s", filename);
     lf.f = fopen(filename, "r");
     if (lf.f == NULL) return errfile(L, "open", fnameindex);
+#ifdef SYSLINUX
+    if (fstat(fileno(lf.f), &st) == 0 && S_ISREG(st.st_mode) &&
+        (c = findchunk(filename, st.st_size)) != NULL) {
+      fclose(lf.f);
+      status = luaL_loadbuffer(L, c->code, c->size, lua_tostring(L, -1));
+      lua_remove(L, fnameindex);
+      return status;
+    }
+#endif
   }
 #ifndef SYSLINUX
   int c;
@@ -588,6 +682,10 @@ LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
     return errfile(L, "read", fnameindex);
   }
   lua_remove(L, fnameindex);
+#ifdef SYSLINUX
+  if (status == 0 && S_ISREG(st.st_mode))
+    cachechunk(L, filename, st.st_size);
+#endif
   return status;
 }
 
@@ -626,6 +724,7 @@ LUALIB_API int (luaL_loadstring) (lua_State *L, const char *s) {
 /* }====================================================== */
 
 
+#ifndef SYSLINUX
 static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
   (void)ud;
   (void)osize;
@@ -636,6 +735,87 @@ static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
   else
     return realloc(ptr, nsize);
 }
+#else
+/*
+** Small blocks (strings, table nodes, closures...) come from pools of
+** fixed-size blocks, one per multiple of POOL_GRAIN bytes, carved out
+** of large arenas; freed blocks go back on the free list of their pool.
+** Lua always tells us the size of the block it frees, so the blocks
+** need no header.  Larger blocks go to malloc.  Lua does not allow a
+** shrinking realloc to fail, so if no smaller block can be had, the
+** old one is kept and later freed into the pool of its new size.
+*/
+
+#define POOL_GRAIN	8
+#define POOL_MAX	256
+#define POOL_ARENA	16384
+
+#define poolindex(s)	(((s) - 1) / POOL_GRAIN)
+
+typedef union PoolBlock {
+  union PoolBlock *next;
+  double align;
+} PoolBlock;
+
+static struct {
+  PoolBlock *free[POOL_MAX / POOL_GRAIN];
+  char *top, *end;  /* what is left of the current arena */
+} pool;
+
+
+static void pool_put (void *ptr, size_t size) {
+  PoolBlock *b = (PoolBlock *)ptr;
+  size_t i = poolindex(size);
+  b->next = pool.free[i];
+  pool.free[i] = b;
+}
+
+
+static void *pool_get (size_t size) {
+  size_t i = poolindex(size);
+  PoolBlock *b = pool.free[i];
+  size = (i + 1) * POOL_GRAIN;
+  if (b != NULL) {
+    pool.free[i] = b->next;
+    return b;
+  }
+  if ((size_t)(pool.end - pool.top) < size) {
+    char *arena = (char *)malloc(POOL_ARENA);
+    if (arena == NULL) return NULL;
+    if (pool.end - pool.top >= POOL_GRAIN)  /* don't waste the rest */
+      pool_put(pool.top, pool.end - pool.top);
+    pool.top = arena;
+    pool.end = arena + POOL_ARENA;
+  }
+  pool.top += size;
+  return pool.top - size;
+}
+
+
+static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+  void *nptr;
+  (void)ud;
+  if (ptr == NULL) osize = 0;
+  if (nsize == 0) {
+    if (osize > POOL_MAX) free(ptr);
+    else if (ptr != NULL) pool_put(ptr, osize);
+    return NULL;
+  }
+  if (osize > POOL_MAX && nsize > POOL_MAX)
+    return realloc(ptr, nsize);
+  if (osize != 0 && nsize <= POOL_MAX && poolindex(osize) == poolindex(nsize))
+    return ptr;  /* still fits */
+  nptr = (nsize > POOL_MAX) ? malloc(nsize) : pool_get(nsize);
+  if (nptr == NULL && nsize <= osize)
+    return ptr;  /* shrinking must not fail; keep the old block */
+  if (nptr != NULL && ptr != NULL) {
+    memcpy(nptr, ptr, (osize < nsize) ? osize : nsize);
+    if (osize > POOL_MAX) free(ptr);
+    else pool_put(ptr, osize);
+  }
+  return nptr;
+}
+#endif
 
 
 static int panic (lua_State *L) {
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/times.h>
 #include <syslinux/boot.h>
 
 #define lnetlib_c		/* Define the library */
@@ -301,6 +302,13 @@ static int sl_msleep(lua_State * L)
     return 0;
 }
 
+/* a clock in milliseconds, to time things with */
+static int sl_clock(lua_State * L)
+{
+    lua_pushnumber(L, times(NULL));
+    return 1;
+}
+
 static int sl_run_kernel_image(lua_State * L)
 {
     const char *filename = luaL_checkstring(L, 1);
@@ -452,6 +460,7 @@ static const luaL_reg syslinuxlib[] = {
     {"run_kernel_image", sl_run_kernel_image},
     {"sleep", sl_sleep},
     {"msleep", sl_msleep},
+    {"clock", sl_clock},
     {"loadfile", sl_loadfile},
     {"filesize", sl_filesize},
     {"filename", sl_filename},
@@ -0,0 +1,35 @@
+-- allocbench.lua
+-- time the allocator: strings, tables and closures made and dropped
+-- usage: lua.c32 allocbench.lua [rounds]
+
+local clock = syslinux.clock
+local rounds = tonumber(arg and arg[1]) or 20
+
+local function bench(name, f)
+  collectgarbage("collect")
+  local t = clock()
+  for i = 1, rounds do f(i) end
+  io.write(string.format("%-10s %6d ms  %6d KB in use\n", name, clock() - t,
+                         collectgarbage("count")))
+end
+
+bench("strings", function(r)
+  local t = {}
+  for i = 1, 2000 do t[i] = "item " .. i .. " of round " .. r end
+end)
+
+bench("tables", function()
+  local t = {}
+  for i = 1, 2000 do t[i] = { vendor = i, product = i * 2, name = "x" } end
+  for i = 2000, 1, -1 do table.remove(t) end
+end)
+
+bench("closures", function()
+  local fs = {}
+  for i = 1, 2000 do fs[i] = function() return i end end
+end)
+
+bench("concat", function()
+  local s = ""
+  for i = 1, 300 do s = s .. string.format("%04x:%04x ", i, i) end
+end)
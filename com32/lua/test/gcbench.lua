@@ -0,0 +1,33 @@
+-- gcbench.lua
+-- try collector settings (collectgarbage "setpause" / "setstepmul")
+-- on the same garbage-heavy work, to pick the ones for a script
+-- usage: lua.c32 gcbench.lua
+
+local clock = syslinux.clock
+
+local function work()
+  local keep = {}
+  for i = 1, 20000 do
+    local t = { i, tostring(i), { i } }
+    if i % 10 == 0 then keep[#keep + 1] = t end
+  end
+  return #keep
+end
+
+for _, pause in ipairs { 100, 200, 400 } do
+  for _, stepmul in ipairs { 100, 200, 400 } do
+    collectgarbage("collect")
+    collectgarbage("setpause", pause)
+    collectgarbage("setstepmul", stepmul)
+    local peak, t = 0, clock()
+    for i = 1, 5 do
+      work()
+      peak = math.max(peak, collectgarbage("count"))
+    end
+    io.write(string.format("pause %3d stepmul %3d  %6d ms  peak %6d KB\n",
+                           pause, stepmul, clock() - t, peak))
+  end
+end
+
+collectgarbage("setpause", 200)
+collectgarbage("setstepmul", 200)
@@ -0,0 +1,23 @@
+-- loadbench.lua
+-- compare parsing a script every time with loadfile, which keeps the
+-- compiled code of the files it loaded
+-- usage: lua.c32 loadbench.lua [script [times]]
+
+local clock = syslinux.clock
+local file = arg and arg[1] or "life.lua"
+local times = tonumber(arg and arg[2]) or 50
+
+local f = assert(io.open(file))
+local source = f:read("*a")
+f:close()
+
+local t = clock()
+for i = 1, times do assert(loadstring(source, "=" .. file)) end
+local parse = clock() - t
+
+t = clock()
+for i = 1, times do assert(loadfile(file)) end
+local cached = clock() - t
+
+io.write(string.format("%s, %d times: parsed %d ms, loadfile %d ms\n",
+                       file, times, parse, cached))
@@ -0,0 +1,27 @@
+-- pcibench.lua
+-- time what boot menu scripts usually do: read the PCI devices and
+-- look their names up, then read the DMI table
+-- usage: lua.c32 pcibench.lua [pci.ids [rounds]]
+
+local clock = syslinux.clock
+local ids = arg and arg[1] or "/pci.ids"
+local rounds = tonumber(arg and arg[2]) or 5
+
+local t = clock()
+local names = 0
+for r = 1, rounds do
+  local pciinfo = pci.getinfo()
+  local pciids = pci.getidlist(ids)
+  for _, device in pairs(pciinfo) do
+    local id = string.format("%04x%04x", device['vendor'], device['product'])
+    if pciids[id] then names = names + 1 end
+  end
+end
+io.write(string.format("pci: %d rounds, %d names found, %d ms, %d KB in use\n",
+                       rounds, names, clock() - t, collectgarbage("count")))
+
+if dmi.supported() then
+  t = clock()
+  for r = 1, rounds do dmi.gettable() end
+  io.write(string.format("dmi: %d rounds, %d ms\n", rounds, clock() - t))
+end
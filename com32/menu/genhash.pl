@@ -0,0 +1,89 @@
+#!/usr/bin/perl
+#
+# Generate perfect hash tables for the configuration file keywords.
+#
+# Each line of the input is a keyword, optionally followed by the name
+# of the keyword it is a synonym for.  Keywords of the form "menu.foo"
+# go in the table of MENU keywords, the others in the top level one.
+#
+# The hash function is the one used by core/genhash.pl, and must match
+# keyword_hash() in readconfig.c.  Each table gets the smallest size
+# for which no two keywords in it end up in the same slot.
+#
+
+eval { use bytes; };
+
+sub hash($) {
+    my($keywd) = @_;
+    my $h = 0;
+
+    foreach my $c (unpack('C*', $keywd)) {
+	$h = ((($h << 5)|($h >> 27)) ^ ($c | 0x20)) & 0xFFFFFFFF;
+    }
+    return $h;
+}
+
+sub symbol($) {
+    my($name) = @_;
+    $name =~ tr/a-z./A-Z_/;
+    return "KW_$name";
+}
+
+@symbols = ();
+%tables = ();
+
+while ( defined($line = <STDIN>) ) {
+    chomp $line;
+    next if ( $line =~ /^\s*(\#|$)/ );
+
+    ($keywd, $name) = split(/\s+/, $line);
+    $name = $keywd unless ( $name );
+
+    push(@symbols, symbol($name)) unless ( $seen{$name}++ );
+
+    if ( $keywd =~ /^(\w+)\.(\w+)$/ ) {
+	$table = "$1_keywords";
+	$keywd = $2;
+    } else {
+	$table = 'keywords';
+    }
+    push(@{$tables{$table}}, [$keywd, symbol($name), hash($keywd)]);
+}
+
+print "/* Generated by genhash.pl from keywords; do not edit */\n\n";
+print "enum keyword_id {\n";
+print "    KW_NONE,\n";
+foreach $sym ( @symbols ) {
+    print "    $sym,\n";
+}
+print "};\n\n";
+print "struct keyword {\n";
+print "    const char *name;\n";
+print "    enum keyword_id id;\n";
+print "};\n";
+
+foreach $table ( sort keys(%tables) ) {
+    @kw = @{$tables{$table}};
+
+    for ( $size = scalar(@kw) ; ; $size++ ) {
+	%slot = ();
+	$ok = 1;
+	foreach $k ( @kw ) {
+	    $s = $k->[2] % $size;
+	    if ( defined($slot{$s}) ) {
+		$ok = 0;
+		last;
+	    }
+	    $slot{$s} = $k;
+	}
+	last if ( $ok );
+	die "$0: no perfect hash for $table\n" if ( $size > 64*scalar(@kw) );
+    }
+
+    print "\nstatic const struct keyword ${table}[$size] = {\n";
+    foreach $s ( sort { $a <=> $b } keys(%slot) ) {
+	$k = $slot{$s};
+	printf "    [%d] = {\"%s\", %s},\n", $s, $k->[0], $k->[1];
+    }
+    print "};\n";
+}
@@ -63,6 +63,7 @@ struct menu_entry {
     const char *background;
     struct menu *submenu;
     struct menu_entry *next;	/* Linked list of all labels across menus */
+    struct menu_entry *hnext;	/* Next in the label hash chain */
     int entry;			/* Entry number inside menu */
     enum menu_action action;
     unsigned char hotkey;
@@ -144,6 +145,7 @@ struct fkey_help {
 
 struct menu {
     struct menu *next;		/* Linked list of all menus */
+    struct menu *hnext;		/* Next in the menu label hash chain */
     const char *label;		/* Goto label for this menu */
     struct menu *parent;
     struct menu_entry *parent_entry;	/* Entry for self in parent */
@@ -48,6 +48,17 @@ static bool menusave = false;	/* True if there is any "menu save" */
 static struct menu_entry *all_entries;
 static struct menu_entry **all_entries_end = &all_entries;
 
+/*
+ * Hash indices of the entries by label and the menus by label, so that
+ * configurations with thousands of labels don't take quadratic time
+ * to resolve.
+ */
+#define LABEL_HASH_SIZE	1024	/* Must be a power of 2 */
+#define MENU_HASH_SIZE	256	/* Must be a power of 2 */
+
+static struct menu_entry *label_hash[LABEL_HASH_SIZE];
+static struct menu *menu_hash[MENU_HASH_SIZE];
+
 static const struct messages messages[MSG_COUNT] = {
     [MSG_AUTOBOOT] = {"autoboot", "Automatic boot in # second{,s}..."},
     [MSG_TAB] = {"tabmsg", "Press [Tab] to edit options"},
@@ -77,14 +88,29 @@ const char *const kernel_types[] = {
     NULL
 };
 
+/* FNV-1a */
+static uint32_t hash_label(const char *str, size_t len)
+{
+    uint32_t h = 2166136261U;
+
+    while (len--) {
+	h ^= (unsigned char)*str++;
+	h *= 16777619;
+    }
+
+    return h;
+}
+
 /*
- * Search the list of all menus for a specific label
+ * Find the menu with a specific label; if there are several, the
+ * latest one, which is what a search of menu_list would find.
  */
 static struct menu *find_menu(const char *label)
 {
     struct menu *m;
 
-    for (m = menu_list; m; m = m->next) {
+    m = menu_hash[hash_label(label, strlen(label)) & (MENU_HASH_SIZE - 1)];
+    for (; m; m = m->hnext) {
 	if (!strcmp(label, m->label))
 	    return m;
     }
@@ -142,6 +168,43 @@ static char *looking_at(char *line, const char *kwd)
     return my_isspace(*p) ? p : NULL;	/* Must be EOL or whitespace */
 }
 
+/*
+ * Configuration keywords are looked up in perfect hash tables,
+ * generated from the file "keywords" by genhash.pl, rather than by
+ * trying each one in turn.
+ */
+#include "kwdhash.gen"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* Must match hash() in genhash.pl */
+static uint32_t keyword_hash(const char *p)
+{
+    uint32_t h = 0;
+
+    while (!my_isspace(*p)) {
+	h = ((h << 5) | (h >> 27)) ^ ((unsigned char)*p | 0x20);
+	p++;
+    }
+
+    return h;
+}
+
+/*
+ * Identify the keyword at the start of the line; if it is one,
+ * *ep is set to the first character past it.
+ */
+static enum keyword_id lookup_keyword(const struct keyword *table,
+				      size_t size, char *p, char **ep)
+{
+    const struct keyword *kw = &table[keyword_hash(p) % size];
+
+    if (!kw->name || !(*ep = looking_at(p, kw->name)))
+	return KW_NONE;
+
+    return kw->id;
+}
+
 /* Get a single word into a new refstr; advances the input pointer */
 static char *get_word(char *str, char **word)
 {
@@ -210,6 +273,13 @@ static struct menu *new_menu(struct menu *parent,
     m->next = menu_list;
     menu_list = m;
 
+    if (label) {
+	struct menu **mh =
+	    &menu_hash[hash_label(label, strlen(label)) & (MENU_HASH_SIZE - 1)];
+	m->hnext = *mh;
+	*mh = m;
+    }
+
     return m;
 }
 
@@ -273,6 +343,36 @@ static struct menu_entry *new_entry(struct menu *m)
     return me;
 }
 
+/*
+ * Find the entry with the label str[0..len-1]; if there are several,
+ * the first one defined.
+ */
+static struct menu_entry *lookup_label(const char *str, size_t len)
+{
+    struct menu_entry *me;
+
+    me = label_hash[hash_label(str, len) & (LABEL_HASH_SIZE - 1)];
+    for (; me; me = me->hnext) {
+	if (!strncmp(str, me->label, len) && !me->label[len])
+	    return me;
+    }
+
+    return NULL;
+}
+
+static void index_label(struct menu_entry *me)
+{
+    size_t len = strlen(me->label);
+    struct menu_entry **mh;
+
+    if (lookup_label(me->label, len))
+	return;			/* The first one wins */
+
+    mh = &label_hash[hash_label(me->label, len) & (LABEL_HASH_SIZE - 1)];
+    me->hnext = *mh;
+    *mh = me;
+}
+
 static void consider_for_hotkey(struct menu *m, struct menu_entry *me)
 {
     const char *p = strchr(me->displayname, '^');
@@ -339,6 +439,9 @@ static void record(struct menu *m, struct labeldata *ld, const char *append)
 	    me->passwd = NULL;
 	}
 
+	if (me->label)
+	    index_label(me);
+
 	if (ld->menulabel)
 	    consider_for_hotkey(m, me);
 
@@ -419,22 +522,13 @@ static struct menu *end_submenu(void)
 static struct menu_entry *find_label(const char *str)
 {
     const char *p;
-    struct menu_entry *me;
-    int pos;
 
     p = str;
     while (*p && !my_isspace(*p))
 	p++;
 
     /* p now points to the first byte beyond the kernel name */
-    pos = p - str;
-
-    for (me = all_entries; me; me = me->next) {
-	if (!strncmp(str, me->label, pos) && !me->label[pos])
-	    return me;
-    }
-
-    return NULL;
+    return lookup_label(str, p - str);
 }
 
 static const char *unlabel(const char *str)
@@ -443,22 +537,18 @@ static const char *unlabel(const char *str)
     const char *p;
     const char *q;
     struct menu_entry *me;
-    int pos;
 
     p = str;
     while (*p && !my_isspace(*p))
 	p++;
 
     /* p now points to the first byte beyond the kernel name */
-    pos = p - str;
-
-    for (me = all_entries; me; me = me->next) {
-	if (!strncmp(str, me->label, pos) && !me->label[pos]) {
-	    /* Found matching label */
-	    rsprintf(&q, "%s%s", me->cmdline, p);
-	    refstr_put(str);
-	    return q;
-	}
+    me = lookup_label(str, p - str);
+    if (me) {
+	/* Found matching label */
+	rsprintf(&q, "%s%s", me->cmdline, p);
+	refstr_put(str);
+	return q;
     }
 
     return str;
@@ -637,10 +727,13 @@ static void parse_config_file(FILE * f)
 
 	p = skipspace(line);
 
-	if (looking_at(p, "menu")) {
+	switch (lookup_keyword(keywords, ARRAY_SIZE(keywords), p, &ep)) {
+	case KW_MENU:
 	    p = skipspace(p + 4);
 
-	    if (looking_at(p, "label")) {
+	    switch (lookup_keyword(menu_keywords, ARRAY_SIZE(menu_keywords),
+				   p, &ep)) {
+	    case KW_MENU_LABEL:
 		if (ld.label) {
 		    refstr_put(ld.menulabel);
 		    ld.menulabel = refstrdup(skipspace(p + 5));
@@ -654,7 +747,9 @@ static void parse_config_file(FILE * f)
 			m->title = strip_caret(m->parent_entry->displayname);
 		    }
 		}
-	    } else if (looking_at(p, "title")) {
+		break;
+
+	    case KW_MENU_TITLE:
 		refstr_put(m->title);
 		m->title = refstrdup(skipspace(p + 5));
 		if (m->parent_entry) {
@@ -664,15 +759,21 @@ static void parse_config_file(FILE * f)
 			m->parent_entry->displayname = refstr_get(m->title);
 		    }
 		}
-	    } else if (looking_at(p, "default")) {
+		break;
+
+	    case KW_MENU_DEFAULT:
 		if (ld.label) {
 		    ld.menudefault = 1;
 		} else if (m->parent_entry) {
 		    m->parent->defentry = m->parent_entry->entry;
 		}
-	    } else if (looking_at(p, "hide")) {
+		break;
+
+	    case KW_MENU_HIDE:
 		ld.menuhide = 1;
-	    } else if (looking_at(p, "passwd")) {
+		break;
+
+	    case KW_MENU_PASSWD:
 		if (ld.label) {
 		    refstr_put(ld.passwd);
 		    ld.passwd = refstrdup(skipspace(p + 6));
@@ -680,184 +781,228 @@ static void parse_config_file(FILE * f)
 		    refstr_put(m->parent_entry->passwd);
 		    m->parent_entry->passwd = refstrdup(skipspace(p + 6));
 		}
-	    } else if (looking_at(p, "shiftkey")) {
+		break;
+
+	    case KW_MENU_SHIFTKEY:
 		shiftkey = 1;
-	    } else if (looking_at(p, "save")) {
+		break;
+
+	    case KW_MENU_SAVE:
 		menusave = true;
 		if (ld.label)
 		    ld.save = 1;
 		else
 		    m->save = true;
-	    } else if (looking_at(p, "nosave")) {
+		break;
+
+	    case KW_MENU_NOSAVE:
 		if (ld.label)
 		    ld.save = -1;
 		else
 		    m->save = false;
-	    } else if (looking_at(p, "immediate")) {
+		break;
+
+	    case KW_MENU_IMMEDIATE:
 		if (ld.label)
 		    ld.immediate = 1;
 		else
 		    m->immediate = true;
-	    } else if (looking_at(p, "noimmediate")) {
+		break;
+
+	    case KW_MENU_NOIMMEDIATE:
 		if (ld.label)
 		    ld.immediate = -1;
 		else
 		    m->immediate = false;
-	    } else if (looking_at(p, "onerror")) {
+		break;
+
+	    case KW_MENU_ONERROR:
 		refstr_put(m->onerror);
 		m->onerror = refstrdup(skipspace(p + 7));
-	    } else if (looking_at(p, "master")) {
+		break;
+
+	    case KW_MENU_MASTER:
 		p = skipspace(p + 6);
 		if (looking_at(p, "passwd")) {
 		    refstr_put(m->menu_master_passwd);
 		    m->menu_master_passwd = refstrdup(skipspace(p + 6));
 		}
-	    } else if ((ep = looking_at(p, "include"))) {
+		break;
+
+	    case KW_MENU_INCLUDE:
 		goto do_include;
-	    } else if ((ep = looking_at(p, "background"))) {
+
+	    case KW_MENU_BACKGROUND:
 		p = skipspace(ep);
 		refstr_put(m->menu_background);
 		m->menu_background = refdup_word(&p);
-	    } else if ((ep = looking_at(p, "hidden"))) {
+		break;
+
+	    case KW_MENU_HIDDEN:
 		hiddenmenu = 1;
-	    } else if (looking_at(p, "hiddenkey")) {
-		char *key_name, *k, *ek;
-		const char *command;
-		int key;
-		p = get_word(skipspace(p + 9), &key_name);
-		command = refstrdup(skipspace(p));
-		k = key_name;
-		for (;;) {
-		    ek = strchr(k+1, ',');
-		    if (ek)
-			*ek = '\0';
-		    key = key_name_to_code(k);
-		    if (key >= 0) {
-			refstr_put(hide_key[key]);
-			hide_key[key] = refstr_get(command);
+		break;
+
+	    case KW_MENU_HIDDENKEY:
+		{
+		    char *key_name, *k, *ek;
+		    const char *command;
+		    int key;
+		    p = get_word(skipspace(p + 9), &key_name);
+		    command = refstrdup(skipspace(p));
+		    k = key_name;
+		    for (;;) {
+			ek = strchr(k+1, ',');
+			if (ek)
+			    *ek = '\0';
+			key = key_name_to_code(k);
+			if (key >= 0) {
+			    refstr_put(hide_key[key]);
+			    hide_key[key] = refstr_get(command);
+			}
+			if (!ek)
+			    break;
+			k = ek+1;
 		    }
-		    if (!ek)
-			break;
-		    k = ek+1;
+		    refstr_put(key_name);
+		    refstr_put(command);
 		}
-		refstr_put(key_name);
-		refstr_put(command);
-	    } else if ((ep = looking_at(p, "clear"))) {
-		clearmenu = 1;
-	    } else if ((ep = is_message_name(p, &msgnr))) {
-		refstr_put(m->messages[msgnr]);
-		m->messages[msgnr] = refstrdup(skipspace(ep));
-	    } else if ((ep = looking_at(p, "color")) ||
-		       (ep = looking_at(p, "colour"))) {
-		int i;
-		struct color_table *cptr;
-		p = skipspace(ep);
-		cptr = m->color_table;
-		for (i = 0; i < menu_color_table_size; i++) {
-		    if ((ep = looking_at(p, cptr->name))) {
-			p = skipspace(ep);
-			if (*p) {
-			    if (looking_at(p, "*")) {
-				p++;
-			    } else {
-				refstr_put(cptr->ansi);
-				cptr->ansi = refdup_word(&p);
-			    }
+		break;
 
-			    p = skipspace(p);
+	    case KW_MENU_CLEAR:
+		clearmenu = 1;
+		break;
+
+	    case KW_MENU_COLOR:
+		{
+		    int i;
+		    struct color_table *cptr;
+		    p = skipspace(ep);
+		    cptr = m->color_table;
+		    for (i = 0; i < menu_color_table_size; i++) {
+			if ((ep = looking_at(p, cptr->name))) {
+			    p = skipspace(ep);
 			    if (*p) {
-				if (looking_at(p, "*"))
+				if (looking_at(p, "*")) {
 				    p++;
-				else
-				    cptr->argb_fg = parse_argb(&p);
+				} else {
+				    refstr_put(cptr->ansi);
+				    cptr->ansi = refdup_word(&p);
+				}
 
 				p = skipspace(p);
 				if (*p) {
 				    if (looking_at(p, "*"))
 					p++;
 				    else
-					cptr->argb_bg = parse_argb(&p);
+					cptr->argb_fg = parse_argb(&p);
 
-				    /* Parse a shadow mode */
 				    p = skipspace(p);
-				    ch = *p | 0x20;
-				    if (ch == 'n')	/* none */
-					cptr->shadow = SHADOW_NONE;
-				    else if (ch == 's')	/* std, standard */
-					cptr->shadow = SHADOW_NORMAL;
-				    else if (ch == 'a')	/* all */
-					cptr->shadow = SHADOW_ALL;
-				    else if (ch == 'r')	/* rev, reverse */
-					cptr->shadow = SHADOW_REVERSE;
+				    if (*p) {
+					if (looking_at(p, "*"))
+					    p++;
+					else
+					    cptr->argb_bg = parse_argb(&p);
+
+					/* Parse a shadow mode */
+					p = skipspace(p);
+					ch = *p | 0x20;
+					if (ch == 'n')	/* none */
+					    cptr->shadow = SHADOW_NONE;
+					else if (ch == 's')	/* std, standard */
+					    cptr->shadow = SHADOW_NORMAL;
+					else if (ch == 'a')	/* all */
+					    cptr->shadow = SHADOW_ALL;
+					else if (ch == 'r')	/* rev, reverse */
+					    cptr->shadow = SHADOW_REVERSE;
+				    }
 				}
 			    }
+			    break;
 			}
-			break;
+			cptr++;
 		    }
-		    cptr++;
 		}
-	    } else if ((ep = looking_at(p, "msgcolor")) ||
-		       (ep = looking_at(p, "msgcolour"))) {
-		unsigned int fg_mask = MSG_COLORS_DEF_FG;
-		unsigned int bg_mask = MSG_COLORS_DEF_BG;
-		enum color_table_shadow shadow = MSG_COLORS_DEF_SHADOW;
+		break;
 
-		p = skipspace(ep);
-		if (*p) {
-		    if (!looking_at(p, "*"))
-			fg_mask = parse_argb(&p);
+	    case KW_MENU_MSGCOLOR:
+		{
+		    unsigned int fg_mask = MSG_COLORS_DEF_FG;
+		    unsigned int bg_mask = MSG_COLORS_DEF_BG;
+		    enum color_table_shadow shadow = MSG_COLORS_DEF_SHADOW;
 
-		    p = skipspace(p);
+		    p = skipspace(ep);
 		    if (*p) {
 			if (!looking_at(p, "*"))
-			    bg_mask = parse_argb(&p);
+			    fg_mask = parse_argb(&p);
 
 			p = skipspace(p);
-			switch (*p | 0x20) {
-			case 'n':
-			    shadow = SHADOW_NONE;
-			    break;
-			case 's':
-			    shadow = SHADOW_NORMAL;
-			    break;
-			case 'a':
-			    shadow = SHADOW_ALL;
-			    break;
-			case 'r':
-			    shadow = SHADOW_REVERSE;
-			    break;
-			default:
-			    /* go with default */
-			    break;
+			if (*p) {
+			    if (!looking_at(p, "*"))
+				bg_mask = parse_argb(&p);
+
+			    p = skipspace(p);
+			    switch (*p | 0x20) {
+			    case 'n':
+				shadow = SHADOW_NONE;
+				break;
+			    case 's':
+				shadow = SHADOW_NORMAL;
+				break;
+			    case 'a':
+				shadow = SHADOW_ALL;
+				break;
+			    case 'r':
+				shadow = SHADOW_REVERSE;
+				break;
+			    default:
+				/* go with default */
+				break;
+			    }
 			}
 		    }
+		    set_msg_colors_global(m->color_table, fg_mask, bg_mask, shadow);
 		}
-		set_msg_colors_global(m->color_table, fg_mask, bg_mask, shadow);
-	    } else if (looking_at(p, "separator")) {
+		break;
+
+	    case KW_MENU_SEPARATOR:
 		record(m, &ld, append);
 		ld.label = refstr_get(empty_string);
 		ld.menuseparator = 1;
 		record(m, &ld, append);
-	    } else if (looking_at(p, "disable") || looking_at(p, "disabled")) {
+		break;
+
+	    case KW_MENU_DISABLE:
 		ld.menudisabled = 1;
-	    } else if (looking_at(p, "indent")) {
+		break;
+
+	    case KW_MENU_INDENT:
 		ld.menuindent = atoi(skipspace(p + 6));
-	    } else if (looking_at(p, "begin")) {
+		break;
+
+	    case KW_MENU_BEGIN:
 		record(m, &ld, append);
 		m = current_menu = begin_submenu(skipspace(p + 5));
-	    } else if (looking_at(p, "end")) {
+		break;
+
+	    case KW_MENU_END:
 		record(m, &ld, append);
 		m = current_menu = end_submenu();
-	    } else if (looking_at(p, "quit")) {
+		break;
+
+	    case KW_MENU_QUIT:
 		if (ld.label)
 		    ld.action = MA_QUIT;
-	    } else if (looking_at(p, "goto")) {
+		break;
+
+	    case KW_MENU_GOTO:
 		if (ld.label) {
 		    ld.action = MA_GOTO_UNRES;
 		    refstr_put(ld.kernel);
 		    ld.kernel = refstrdup(skipspace(p + 4));
 		}
-	    } else if (looking_at(p, "exit")) {
+		break;
+
+	    case KW_MENU_EXIT:
 		p = skipspace(p + 4);
 		if (ld.label && m->parent) {
 		    if (*p) {
@@ -870,9 +1015,13 @@ static void parse_config_file(FILE * f)
 			ld.submenu = m->parent;
 		    }
 		}
-	    } else if (looking_at(p, "start")) {
+		break;
+
+	    case KW_MENU_START:
 		start_menu = m;
-	    } else if (looking_at(p, "help")) {
+		break;
+
+	    case KW_MENU_HELP:
 		if (ld.label) {
 		    ld.action = MA_HELP;
 		    p = skipspace(p + 4);
@@ -890,69 +1039,70 @@ static void parse_config_file(FILE * f)
 			ld.append = refdup_word(&p); /* Background */
 		    }
 		}
-	    } else if ((ep = looking_at(p, "resolution"))) {
-		int x, y;
-		x = strtoul(ep, &ep, 0);
-		y = strtoul(skipspace(ep), NULL, 0);
-		set_resolution(x, y);
-	    } else {
-		/* Unknown, check for layout parameters */
-		enum parameter_number mp;
-		for (mp = 0; mp < NPARAMS; mp++) {
-		    if ((ep = looking_at(p, mparm[mp].name))) {
-			m->mparm[mp] = atoi(skipspace(ep));
-			break;
+		break;
+
+	    case KW_MENU_RESOLUTION:
+		{
+		    int x, y;
+		    x = strtoul(ep, &ep, 0);
+		    y = strtoul(skipspace(ep), NULL, 0);
+		    set_resolution(x, y);
+		}
+		break;
+
+	    default:
+		if ((ep = is_message_name(p, &msgnr))) {
+		    refstr_put(m->messages[msgnr]);
+		    m->messages[msgnr] = refstrdup(skipspace(ep));
+		} else {
+		    /* Unknown, check for layout parameters */
+		    enum parameter_number mp;
+		    for (mp = 0; mp < NPARAMS; mp++) {
+			if ((ep = looking_at(p, mparm[mp].name))) {
+			    m->mparm[mp] = atoi(skipspace(ep));
+			    break;
+			}
 		    }
 		}
+		break;
 	    }
-	} else if (looking_at(p, "text")) {
-	    enum text_cmd {
-		TEXT_UNKNOWN,
-		TEXT_HELP
-	    } cmd = TEXT_UNKNOWN;
-	    int len = ld.helptext ? strlen(ld.helptext) : 0;
-	    int xlen;
+	    break;
 
-	    p = skipspace(p + 4);
+	case KW_TEXT:
+	    {
+		enum text_cmd {
+		    TEXT_UNKNOWN,
+		    TEXT_HELP
+		} cmd = TEXT_UNKNOWN;
+		int len = ld.helptext ? strlen(ld.helptext) : 0;
+		int xlen;
 
-	    if (looking_at(p, "help"))
-		cmd = TEXT_HELP;
+		p = skipspace(p + 4);
 
-	    while (fgets(line, sizeof line, f)) {
-		p = skipspace(line);
-		if (looking_at(p, "endtext"))
-		    break;
+		if (looking_at(p, "help"))
+		    cmd = TEXT_HELP;
 
-		xlen = strlen(line);
+		while (fgets(line, sizeof line, f)) {
+		    p = skipspace(line);
+		    if (looking_at(p, "endtext"))
+			break;
 
-		switch (cmd) {
-		case TEXT_UNKNOWN:
-		    break;
-		case TEXT_HELP:
-		    ld.helptext = realloc(ld.helptext, len + xlen + 1);
-		    memcpy(ld.helptext + len, line, xlen + 1);
-		    len += xlen;
-		    break;
+		    xlen = strlen(line);
+
+		    switch (cmd) {
+		    case TEXT_UNKNOWN:
+			break;
+		    case TEXT_HELP:
+			ld.helptext = realloc(ld.helptext, len + xlen + 1);
+			memcpy(ld.helptext + len, line, xlen + 1);
+			len += xlen;
+			break;
+		    }
 		}
 	    }
-	} else if ((ep = is_fkey(p, &fkeyno))) {
-	    p = skipspace(ep);
-	    if (m->fkeyhelp[fkeyno].textname) {
-		refstr_put(m->fkeyhelp[fkeyno].textname);
-		m->fkeyhelp[fkeyno].textname = NULL;
-	    }
-	    if (m->fkeyhelp[fkeyno].background) {
-		refstr_put(m->fkeyhelp[fkeyno].background);
-		m->fkeyhelp[fkeyno].background = NULL;
-	    }
+	    break;
 
-	    refstr_put(m->fkeyhelp[fkeyno].textname);
-	    m->fkeyhelp[fkeyno].textname = refdup_word(&p);
-	    if (*p) {
-		p = skipspace(p);
-		m->fkeyhelp[fkeyno].background = refdup_word(&p);
-	    }
-	} else if ((ep = looking_at(p, "include"))) {
+	case KW_INCLUDE:
 do_include:
 	    {
 		const char *file;
@@ -970,24 +1120,34 @@ do_include:
 		}
 		refstr_put(file);
 	    }
-	} else if (looking_at(p, "append")) {
-	    const char *a = refstrdup(skipspace(p + 6));
-	    if (ld.label) {
-		refstr_put(ld.append);
-		ld.append = a;
-	    } else {
-		refstr_put(append);
-		append = a;
+	    break;
+
+	case KW_APPEND:
+	    {
+		const char *a = refstrdup(skipspace(p + 6));
+		if (ld.label) {
+		    refstr_put(ld.append);
+		    ld.append = a;
+		} else {
+		    refstr_put(append);
+		    append = a;
+		}
 	    }
-	} else if (looking_at(p, "initrd")) {
-	    const char *a = refstrdup(skipspace(p + 6));
-	    if (ld.label) {
-		refstr_put(ld.initrd);
-		ld.initrd = a;
-	    } else {
-		/* Ignore */
+	    break;
+
+	case KW_INITRD:
+	    {
+		const char *a = refstrdup(skipspace(p + 6));
+		if (ld.label) {
+		    refstr_put(ld.initrd);
+		    ld.initrd = a;
+		} else {
+		    /* Ignore */
+		}
 	    }
-	} else if (looking_at(p, "label")) {
+	    break;
+
+	case KW_LABEL:
 	    p = skipspace(p + 5);
 	    record(m, &ld, append);
 	    ld.label = refstrdup(p);
@@ -1001,30 +1161,66 @@ do_include:
 	    ld.ipappend = ipappend;
 	    ld.menudefault = ld.menuhide = ld.menuseparator =
 		ld.menudisabled = ld.menuindent = 0;
-	} else if ((ep = is_kernel_type(p, &type))) {
-	    if (ld.label) {
-		refstr_put(ld.kernel);
-		ld.kernel = refstrdup(skipspace(ep));
-		ld.type = type;
-	    }
-	} else if (looking_at(p, "timeout")) {
+	    break;
+
+	case KW_TIMEOUT:
 	    m->timeout = (atoi(skipspace(p + 7)) * CLK_TCK + 9) / 10;
-	} else if (looking_at(p, "totaltimeout")) {
+	    break;
+
+	case KW_TOTALTIMEOUT:
 	    totaltimeout = (atoll(skipspace(p + 13)) * CLK_TCK + 9) / 10;
-	} else if (looking_at(p, "ontimeout")) {
+	    break;
+
+	case KW_ONTIMEOUT:
 	    m->ontimeout = refstrdup(skipspace(p + 9));
-	} else if (looking_at(p, "allowoptions")) {
+	    break;
+
+	case KW_ALLOWOPTIONS:
 	    m->allowedit = !!atoi(skipspace(p + 12));
-	} else if (looking_at(p, "ipappend")) {
+	    break;
+
+	case KW_IPAPPEND:
 	    if (ld.label)
 		ld.ipappend = atoi(skipspace(p + 8));
 	    else
 		ipappend = atoi(skipspace(p + 8));
-	} else if (looking_at(p, "default")) {
+	    break;
+
+	case KW_DEFAULT:
 	    refstr_put(globaldefault);
 	    globaldefault = refstrdup(skipspace(p + 7));
-	} else if (looking_at(p, "ui")) {
+	    break;
+
+	case KW_UI:
 	    has_ui = 1;
+	    break;
+
+	default:
+	    if ((ep = is_fkey(p, &fkeyno))) {
+		p = skipspace(ep);
+		if (m->fkeyhelp[fkeyno].textname) {
+		    refstr_put(m->fkeyhelp[fkeyno].textname);
+		    m->fkeyhelp[fkeyno].textname = NULL;
+		}
+		if (m->fkeyhelp[fkeyno].background) {
+		    refstr_put(m->fkeyhelp[fkeyno].background);
+		    m->fkeyhelp[fkeyno].background = NULL;
+		}
+
+		refstr_put(m->fkeyhelp[fkeyno].textname);
+		m->fkeyhelp[fkeyno].textname = refdup_word(&p);
+		if (*p) {
+		    p = skipspace(p);
+		    m->fkeyhelp[fkeyno].background = refdup_word(&p);
+		}
+	    } else if ((ep = is_kernel_type(p, &type))) {
+		if (ld.label) {
+		    refstr_put(ld.kernel);
+		    ld.kernel = refstrdup(skipspace(ep));
+		    ld.type = type;
+		}
+	    }
+	    break;
 	}
     }
 }
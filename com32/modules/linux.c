@@ -35,7 +35,11 @@
  * If -dhcpinfo is specified, the DHCP info is written into the file
  * /dhcpinfo.dat in the initramfs.
  *
- * Usage: linux.c32 [-dhcpinfo] kernel arguments...
+ * If -unzip is specified, gzip'd initrds are decompressed while they
+ * are being loaded, so e.g. MEMDISK gets an uncompressed disk image
+ * and does not need to keep two copies while decompressing it.
+ *
+ * Usage: linux.c32 [-dhcpinfo] [-unzip] kernel arguments...
  */
 
 #include <stdbool.h>
@@ -118,9 +122,11 @@ int main(int argc, char *argv[])
     size_t kernel_len;
     bool opt_dhcpinfo = false;
     bool opt_quiet = false;
+    bool opt_unzip = false;
     void *dhcpdata;
     size_t dhcplen;
     char **argp, *arg, *p;
+    int rv;
 
     openconsole(&dev_null_r, &dev_stdcon_w);
 
@@ -130,6 +136,8 @@ int main(int argc, char *argv[])
     while ((arg = *argp) && arg[0] == '-') {
 	if (!strcmp("-dhcpinfo", arg)) {
 	    opt_dhcpinfo = true;
+	} else if (!strcmp("-unzip", arg)) {
+	    opt_unzip = true;
 	} else {
 	    fprintf(stderr, "%s: unknown option: %s\n", progname, arg);
 	    return 1;
@@ -185,7 +193,11 @@ int main(int argc, char *argv[])
 
 	    if (!opt_quiet)
 		printf("Loading %s... ", arg);
-	    if (initramfs_load_archive(initramfs, arg)) {
+	    if (opt_unzip)
+		rv = initramfs_zload_archive(initramfs, arg);
+	    else
+		rv = initramfs_load_archive(initramfs, arg);
+	    if (rv) {
 		if (opt_quiet)
 		    printf("Loading %s ", kernel_name);
 		printf("failed!\n");
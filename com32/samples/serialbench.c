@@ -0,0 +1,118 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * serialbench.c
+ *
+ * Measure serial console output speed: write the same text through
+ * INT 21h AH=04h, one byte at a time as COM32 used to, and through the
+ * serial console device, and print the bytes per second of each.
+ *
+ * Usage: serialbench.c32 [kilobytes]
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <console.h>
+#include <com32.h>
+#include <sys/times.h>
+#include <syslinux/config.h>
+
+static char text[1024];
+
+static void fill_text(void)
+{
+    static const char line[] =
+	"The quick brown fox jumps over the lazy dog 0123456789\r\n";
+    size_t i;
+
+    for (i = 0; i < sizeof text; i++)
+	text[i] = line[i % (sizeof line - 1)];
+}
+
+static unsigned long rate(unsigned long bytes, clock_t ticks)
+{
+    if (!ticks)
+	ticks = 1;
+    return (unsigned long)((unsigned long long)bytes * CLK_TCK / ticks);
+}
+
+static clock_t bench_intcall(int kbytes)
+{
+    static com32sys_t ireg;
+    clock_t start = times(NULL);
+    int i;
+    size_t j;
+
+    ireg.eax.b[1] = 0x04;
+    for (i = 0; i < kbytes; i++) {
+	for (j = 0; j < sizeof text; j++) {
+	    ireg.edx.b[0] = text[j];
+	    __intcall(0x21, &ireg, NULL);
+	}
+    }
+
+    return times(NULL) - start;
+}
+
+static clock_t bench_device(int kbytes)
+{
+    clock_t start = times(NULL);
+    int i;
+
+    for (i = 0; i < kbytes; i++)
+	fwrite(text, 1, sizeof text, stdout);
+    fflush(stdout);
+
+    return times(NULL) - start;
+}
+
+int main(int argc, char *argv[])
+{
+    const struct syslinux_serial_console_info *si;
+    int kbytes = 64;
+    unsigned long bytes;
+    clock_t t_int, t_dev;
+
+    if (argc > 1)
+	kbytes = atoi(argv[1]);
+
+    openconsole(&dev_null_r, &dev_stdcon_w);
+
+    si = syslinux_serial_console_info();
+    if (!si->iobase) {
+	printf("No serial console configured\n");
+	return 1;
+    }
+
+    fill_text();
+    bytes = (unsigned long)kbytes * sizeof text;
+
+    t_int = bench_intcall(kbytes);
+
+    openconsole(&dev_null_r, &dev_serial_w);
+    t_dev = bench_device(kbytes);
+
+    openconsole(&dev_null_r, &dev_stdcon_w);
+
+    printf("\nSerial port %#06x", si->iobase);
+    if (si->divisor)
+	printf(", %d baud (line rate %d bytes/s)",
+	       115200 / si->divisor, 11520 / si->divisor);
+    printf("\nINT 21h AH=04h: %lu bytes in %u ms, %lu bytes/s\n",
+	   bytes, t_int, rate(bytes, t_int));
+    printf("Serial device:  %lu bytes in %u ms, %lu bytes/s\n",
+	   bytes, t_dev, rate(bytes, t_dev));
+
+    return 0;
+}
@@ -19,6 +19,7 @@
 #include <dprintf.h>
 #include <console.h>
 #include <sys/cpu.h>
+#include <sys/times.h>
 #include <version.h>
 #include "sysdump.h"
 
@@ -31,8 +32,26 @@ __noreturn die(const char *msg)
     exit(1);
 }
 
+/* Bytes over milliseconds, in MB/s with one decimal */
+static void report(const char *what, uint64_t bytes, clock_t ms)
+{
+    unsigned int rate;
+
+    if (!ms)
+	ms = 1;
+    rate = bytes / ((uint64_t)ms * 100);
+
+    printf("%s %llu bytes in %u.%03u s, %u.%u MB/s\n", what,
+	   (unsigned long long)bytes, ms / 1000, ms % 1000,
+	   rate / 10, rate % 10);
+}
+
 static void dump_all(struct upload_backend *be, const char *argv[])
 {
+    clock_t start, dumped;
+    int err;
+
+    start = times(NULL);
     cpio_init(be, argv);
 
     cpio_writefile(be, "sysdump", version, sizeof version-1);
@@ -46,7 +65,15 @@ static void dump_all(struct upload_backend *be, const char *argv[])
     dump_vesa_tables(be);
 
     cpio_close(be);
-    flush_data(be);
+    dumped = times(NULL);
+    report("Dumped", be->dbytes, dumped - start);
+
+    err = flush_data(be);
+    if (err && err != TFTP_OK) {	/* tftp reports success as TFTP_OK */
+	printf("Upload failed (%d)\n", err);
+	return;
+    }
+    report("Uploaded", be->zbytes, times(NULL) - dumped);
 }
 
 static struct upload_backend *upload_backends[] =
@@ -63,7 +90,7 @@ __noreturn usage(void)
 
     printf("Usage:\n");
     for (bep = upload_backends ; (be = *bep) ; bep++)
-	printf("    %s %s %s\n", program, be->name, be->helpmsg);
+	printf("    %s [-z level] %s %s\n", program, be->name, be->helpmsg);
 
     exit(1);
 }
@@ -71,10 +98,19 @@ __noreturn usage(void)
 int main(int argc, char *argv[])
 {
     struct upload_backend **bep, *be;
+    int zlevel = -1;
 
     openconsole(&dev_null_r, &dev_stdcon_w);
     fputs(version, stdout);
 
+    if (argc > 2 && !strcmp(argv[1], "-z")) {
+	zlevel = atoi(argv[2]);
+	if (zlevel < 0 || zlevel > 9)
+	    usage();
+	argc -= 2;
+	argv += 2;
+    }
+
     if (argc < 2)
 	usage();
 
@@ -86,6 +122,9 @@ int main(int argc, char *argv[])
     if (!be || argc < be->minargs + 2)
 	usage();
 
+    if (zlevel >= 0)
+	be->zlevel = zlevel;
+
     /* Do this as early as possible */
     snapshot_lowmem();
 
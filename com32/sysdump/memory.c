@@ -1,15 +1,24 @@
 /*
  * Dump memory
+ *
+ * All-zero pages are left out: each run of pages with something in
+ * them becomes a file named after its address, and any gaps between
+ * the files read as zero.
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <minmax.h>
 #include <sys/cpu.h>
 #include "sysdump.h"
 
+#define DUMP_PAGE	4096U
+
 static char *lowmem;
 static size_t lowmem_len;
+static size_t zero_bytes;
 
 void *zero_addr;		/* Hack to keep gcc from complaining */
 
@@ -28,13 +37,46 @@ void snapshot_lowmem(void)
     }
 }
 
+static bool is_zero(const void *p, size_t len)
+{
+    const uint32_t *wp = p;
+    const uint8_t *bp;
+
+    for (; len >= sizeof *wp; len -= sizeof *wp)
+	if (*wp++)
+	    return false;
+    for (bp = (const uint8_t *)wp; len; len--)
+	if (*bp++)
+	    return false;
+    return true;
+}
+
 static void dump_memory_range(struct upload_backend *be, const void *where,
 			      const void *addr, size_t len)
 {
     char filename[32];
+    const char *p = where;
+    size_t off = 0, start, chunk;
+    bool zero;
+
+    while (off < len) {
+	/* Find a run of pages which are all zero, or all not */
+	start = off;
+	chunk = min(len - off, DUMP_PAGE);
+	zero = is_zero(p + off, chunk);
+	do {
+	    off += chunk;
+	    chunk = min(len - off, DUMP_PAGE);
+	} while (chunk && is_zero(p + off, chunk) == zero);
 
-    sprintf(filename, "memory/%08zx", (size_t)addr);
-    cpio_writefile(be, filename, where, len);
+	chunk = off - start;
+	if (zero) {
+	    zero_bytes += chunk;
+	} else {
+	    sprintf(filename, "memory/%08zx", (size_t)addr + start);
+	    cpio_writefile(be, filename, p + start, chunk);
+	}
+    }
 }
 
 void dump_memory(struct upload_backend *be)
@@ -46,5 +88,5 @@ void dump_memory(struct upload_backend *be)
     if (lowmem)
 	dump_memory_range(be, lowmem, zero_addr, lowmem_len);
 
-    printf("done.\n");
+    printf("done, %zu KB of zero pages skipped.\n", zero_bytes >> 10);
 }
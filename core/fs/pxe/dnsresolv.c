@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <core.h>
+#include <syslinux/pxe.h>
 #include "pxe.h"
 
 /* DNS CLASS values we care about */
@@ -9,6 +10,7 @@
 /* DNS TYPE values we care about */
 #define TYPE_A		1
 #define TYPE_CNAME	5
+#define TYPE_SOA	6
 
 /*
  * The DNS header structure
@@ -162,29 +164,180 @@ static char *dns_skiplabel(char *label)
     }
 }
 
+/*
+ * DNS response cache.  Both positive and negative answers are kept,
+ * for as long as the TTL in the answer allows, so that a config file
+ * which names the same server in dozens of entries only looks it up
+ * once.  Names longer than DNS_CACHE_NAMELEN simply aren't cached.
+ */
+#define DNS_CACHE_SIZE		16
+#define DNS_CACHE_NAMELEN	64
+#define DNS_NEG_TTL		60	/* Negative TTL without an SOA (s) */
+#define DNS_MAX_TTL		86400	/* Cap on any TTL (s) */
+
+struct dns_cache_entry {
+    uint32_t ip;		/* Address, or 0 for a negative entry */
+    uint32_t expires;		/* ms_timer() value */
+    uint32_t lastuse;		/* ms_timer() value, for replacement */
+    char name[DNS_CACHE_NAMELEN]; /* Empty if the slot is unused */
+};
+
+static struct dns_cache_entry dns_cache[DNS_CACHE_SIZE];
+static __lowmem struct pxe_dns_stats dns_stats;
+
+/*
+ * Extract the cache key from a hostname, which (like for dns_mangle)
+ * may be terminated by a colon or a slash.  Returns false if the name
+ * is too long to be cached.
+ */
+static bool dns_cache_key(char *key, const char *name)
+{
+    int i;
+
+    for (i = 0; i < DNS_CACHE_NAMELEN; i++) {
+	if (!name[i] || name[i] == ':' || name[i] == '/') {
+	    key[i] = '\0';
+	    return i != 0;
+	}
+	key[i] = name[i];
+    }
+    return false;
+}
+
+/*
+ * Look up a name in the cache.  Returns the entry if present and not
+ * yet expired.
+ */
+static struct dns_cache_entry *dns_cache_find(const char *key)
+{
+    struct dns_cache_entry *ce;
+    uint32_t now = ms_timer();
+
+    for (ce = dns_cache; ce < &dns_cache[DNS_CACHE_SIZE]; ce++) {
+	if (!ce->name[0] || strcasecmp(ce->name, key))
+	    continue;
+
+	if ((int32_t)(ce->expires - now) <= 0) {
+	    /* Stale; free the slot */
+	    ce->name[0] = '\0';
+	    dns_stats.entries--;
+	    return NULL;
+	}
+
+	ce->lastuse = now;
+	return ce;
+    }
+
+    return NULL;
+}
+
+/*
+ * Add an answer to the cache, replacing an unused, expired or the
+ * least recently used entry.
+ */
+static void dns_cache_add(const char *key, uint32_t ip, uint32_t ttl)
+{
+    struct dns_cache_entry *ce, *victim = NULL;
+    uint32_t now = ms_timer();
+
+    if (!ttl)
+	return;
+    if (ttl > DNS_MAX_TTL)
+	ttl = DNS_MAX_TTL;
+
+    for (ce = dns_cache; ce < &dns_cache[DNS_CACHE_SIZE]; ce++) {
+	if (!ce->name[0] || (int32_t)(ce->expires - now) <= 0) {
+	    if (ce->name[0])
+		dns_stats.entries--;
+	    victim = ce;
+	    break;
+	}
+	if (!victim || (int32_t)(ce->lastuse - victim->lastuse) < 0)
+	    victim = ce;
+    }
+
+    if (victim->name[0])
+	dns_stats.evictions++;
+    else
+	dns_stats.entries++;
+
+    strcpy(victim->name, key);
+    victim->ip      = ip;
+    victim->expires = now + ttl * 1000;
+    victim->lastuse = now;
+}
+
+/*
+ * Skip a resource record, including its name.
+ */
+static char *dns_skiprr(char *p)
+{
+    struct dnsrr *rr;
+
+    p = dns_skiplabel(p);
+    rr = (struct dnsrr *)p;
+    return p + sizeof(struct dnsrr) + ntohs(rr->rdlength);
+}
+
+/*
+ * Work out how long to remember a negative answer, per RFC 2308: the
+ * lesser of the SOA record's own TTL and its MINIMUM field, if the
+ * server sent us an SOA in the authority section.  p points to the
+ * start of the authority section.
+ */
+static uint32_t dns_negative_ttl(char *p, int auth)
+{
+    struct dnsrr *rr;
+    uint32_t ttl, minimum;
+    char *rdata;
+
+    while (auth--) {
+	p = dns_skiplabel(p);
+	rr = (struct dnsrr *)p;
+	if (ntohs(rr->type) == TYPE_SOA) {
+	    ttl = ntohl(rr->ttl);
+	    rdata = dns_skiplabel(dns_skiplabel(rr->rdata)); /* MNAME, RNAME */
+	    minimum = ntohl(*(uint32_t *)(rdata + 16));
+	    return ttl < minimum ? ttl : minimum;
+	}
+	p += sizeof(struct dnsrr) + ntohs(rr->rdlength);
+    }
+
+    return DNS_NEG_TTL;
+}
+
 /*
  * Actual resolver function
  * Points to a null-terminated or :-terminated string in _name_
  * and returns the ip addr in _ip_ if it exists and can be found.
  * If _ip_ = 0 on exit, the lookup failed. _name_ will be updated
  *
- * XXX: probably need some caching here.
+ * The query is sent to all configured servers at once, and the first
+ * definitive answer wins.  Servers which come back with an error are
+ * ignored from then on; if all of them do, we give up early.
  */
 uint32_t dns_resolv(const char *name)
 {
     static char __lowmem DNSSendBuf[PKTBUF_SIZE];
     static char __lowmem DNSRecvBuf[PKTBUF_SIZE];
+    static char DNSTarget[256];
+    char key[DNS_CACHE_NAMELEN];
+    bool cacheable;
+    struct dns_cache_entry *ce;
     char *p;
     int err;
     int dots;
     int same;
     int rd_len;
     int ques, reps;    /* number of questions and replies */
+    int rcode;
+    int i, nsrv;
+    uint16_t flags;
     uint8_t timeout;
-    const uint8_t *timeout_ptr = TimeoutTable;
+    const uint8_t *timeout_ptr;
     uint32_t oldtime;
-    uint32_t srv;
-    uint32_t *srv_ptr;
+    uint32_t ttl, rr_ttl;
+    unsigned int failed;	/* Bitmask of servers that gave up on us */
     struct dnshdr *hd1 = (struct dnshdr *)DNSSendBuf;
     struct dnshdr *hd2 = (struct dnshdr *)DNSRecvBuf;
     struct dnsquery *query;
@@ -198,6 +351,19 @@ uint32_t dns_resolv(const char *name)
     if (!dns_server[0])
 	return 0;
 
+    /* Try the cache first */
+    cacheable = dns_cache_key(key, name);
+    if (cacheable && (ce = dns_cache_find(key))) {
+	dns_stats.hits++;
+	if (!ce->ip)
+	    dns_stats.neg_hits++;
+	return ce->ip;
+    }
+    dns_stats.misses++;
+
+    for (nsrv = 0; nsrv < DNS_MAX_SERVERS && dns_server[nsrv]; nsrv++)
+	;
+
     /* Get a local port number */
     local_port = get_port();
 
@@ -224,113 +390,120 @@ uint32_t dns_resolv(const char *name)
     query->qclass = htons(CLASS_IN);
     p += sizeof(struct dnsquery);
 
-    /* Now send it to name server */
+    /* Now send it to the name servers */
+    failed = 0;
     timeout_ptr = TimeoutTable;
-    timeout = *timeout_ptr++;
-    srv_ptr = dns_server;
-    while (timeout) {
-	srv = *srv_ptr++;
-	if (!srv) {
-	    srv_ptr = dns_server;
-	    srv = *srv_ptr++;
+    while ((timeout = *timeout_ptr++)) {
+	for (i = 0; i < nsrv; i++) {
+	    if (failed & (1 << i))
+		continue;
+
+	    udp_write.status      = 0;
+	    udp_write.ip          = dns_server[i];
+	    udp_write.gw          = gateway(dns_server[i]);
+	    udp_write.src_port    = local_port;
+	    udp_write.dst_port    = DNS_PORT;
+	    udp_write.buffer_size = p - DNSSendBuf;
+	    udp_write.buffer      = FAR_PTR(DNSSendBuf);
+	    err = pxe_call(PXENV_UDP_WRITE, &udp_write);
+	    if (!err && !udp_write.status)
+		dns_stats.queries++;
 	}
 
-        udp_write.status      = 0;
-        udp_write.ip          = srv;
-        udp_write.gw          = gateway(srv);
-        udp_write.src_port    = local_port;
-        udp_write.dst_port    = DNS_PORT;
-        udp_write.buffer_size = p - DNSSendBuf;
-        udp_write.buffer      = FAR_PTR(DNSSendBuf);
-        err = pxe_call(PXENV_UDP_WRITE, &udp_write);
-        if (err || udp_write.status)
-            continue;
-
         oldtime = jiffies();
-	do {
-	    if (jiffies() - oldtime >= timeout)
-		goto again;
-
+	while (jiffies() - oldtime < timeout) {
             udp_read.status      = 0;
-            udp_read.src_ip      = srv;
+            udp_read.src_ip      = 0;	/* From any of the servers */
             udp_read.dest_ip     = IPInfo.myip;
             udp_read.s_port      = DNS_PORT;
             udp_read.d_port      = local_port;
             udp_read.buffer_size = PKTBUF_SIZE;
             udp_read.buffer      = FAR_PTR(DNSRecvBuf);
             err = pxe_call(PXENV_UDP_READ, &udp_read);
-	} while (err || udp_read.status || hd2->id != hd1->id);
+	    if (err || udp_read.status || hd2->id != hd1->id)
+		continue;
 
-        if ((hd2->flags ^ 0x80) & htons(0xf80f))
-            goto badness;
-
-        ques = htons(hd2->qdcount);   /* Questions */
-        reps = htons(hd2->ancount);   /* Replies   */
-        p = DNSRecvBuf + sizeof(struct dnshdr);
-        while (ques--) {
-            p = dns_skiplabel(p); /* Skip name */
-            p += 4;               /* Skip question trailer */
-        }
-
-        /* Parse the replies */
-        while (reps--) {
-            same = dns_compare(DNSSendBuf + sizeof(struct dnshdr),
-			       p, DNSRecvBuf);
-            p = dns_skiplabel(p);
-            rr = (struct dnsrr *)p;
-            rd_len = ntohs(rr->rdlength);
-            if (same && ntohs(rr->class) == CLASS_IN) {
-		switch (ntohs(rr->type)) {
-		case TYPE_A:
-		    if (rd_len == 4) {
-			result = *(uint32_t *)rr->rdata;
-			goto done;
-		    }
-		    break;
-		case TYPE_CNAME:
-		    dns_copylabel(DNSSendBuf + sizeof(struct dnshdr),
-				  rr->rdata, DNSRecvBuf);
-		    /*
-		     * We should probably rescan the packet from the top
-		     * here, and technically we might have to send a whole
-		     * new request here...
-		     */
+	    for (i = 0; i < nsrv; i++)
+		if (udp_read.src_ip == dns_server[i])
 		    break;
-		default:
-		    break;
-		}
+	    if (i == nsrv || (failed & (1 << i)))
+		continue;	/* Not one of ours */
+
+	    flags = ntohs(hd2->flags);
+	    rcode = flags & 0x000f;
+	    if ((flags & 0xf800) != 0x8000 || (rcode != 0 && rcode != 3))
+		goto badness;	/* Not a response, or a server failure */
+
+	    ques = ntohs(hd2->qdcount);   /* Questions */
+	    reps = ntohs(hd2->ancount);   /* Replies   */
+	    p = DNSRecvBuf + sizeof(struct dnshdr);
+	    while (ques--) {
+		p = dns_skiplabel(p); /* Skip name */
+		p += 4;               /* Skip question trailer */
 	    }
 
-            /* not the one we want, try next */
-            p += sizeof(struct dnsrr) + rd_len;
-        }
+	    /*
+	     * Parse the replies.  CNAMEs are followed by updating the
+	     * name we are looking for, and the TTL of the answer is the
+	     * shortest TTL anywhere along the chain.
+	     */
+	    dns_copylabel(DNSTarget, DNSSendBuf + sizeof(struct dnshdr),
+			  DNSSendBuf);
+	    ttl = DNS_MAX_TTL;
+	    while (reps--) {
+		same = dns_compare(DNSTarget, p, DNSRecvBuf);
+		p = dns_skiplabel(p);
+		rr = (struct dnsrr *)p;
+		rd_len = ntohs(rr->rdlength);
+		if (same && ntohs(rr->class) == CLASS_IN) {
+		    rr_ttl = ntohl(rr->ttl);
+		    switch (ntohs(rr->type)) {
+		    case TYPE_A:
+			if (rd_len == 4) {
+			    result = *(uint32_t *)rr->rdata;
+			    if (rr_ttl < ttl)
+				ttl = rr_ttl;
+			    if (cacheable)
+				dns_cache_add(key, result, ttl);
+			    goto done;
+			}
+			break;
+		    case TYPE_CNAME:
+			dns_copylabel(DNSTarget, rr->rdata, DNSRecvBuf);
+			if (rr_ttl < ttl)
+			    ttl = rr_ttl;
+			break;
+		    default:
+			break;
+		    }
+		}
 
-    badness:
-        /*
-         *
-         ; We got back no data from this server.
-         ; Unfortunately, for a recursive, non-authoritative
-         ; query there is no such thing as an NXDOMAIN reply,
-         ; which technically means we can't draw any
-         ; conclusions.  However, in practice that means the
-         ; domain doesn't exist.  If this turns out to be a
-         ; problem, we may want to add code to go through all
-         ; the servers before giving up.
-
-         ; If the DNS server wasn't capable of recursion, and
-         ; isn't capable of giving us an authoritative reply
-         ; (i.e. neither AA or RA set), then at least try a
-         ; different setver...
-        */
-        if (hd2->flags == htons(0x480))
-            continue;
+		/* not the one we want, try next */
+		p += sizeof(struct dnsrr) + rd_len;
+	    }
 
-        break; /* failed */
+	    /*
+	     * No address.  For a recursive or authoritative reply, that
+	     * is a definitive "no such name" (NXDOMAIN) or "no such
+	     * record" answer, which we can cache.  Otherwise this server
+	     * just couldn't help us; let the others have a go.
+	     */
+	    if (flags & 0x0480) {	/* AA or RA */
+		if (cacheable)
+		    dns_cache_add(key, 0,
+				  dns_negative_ttl(p, ntohs(hd2->nscount)));
+		goto done;
+	    }
 
-    again:
-	continue;
+	badness:
+	    failed |= 1 << i;
+	    if (failed == (1U << nsrv) - 1)
+		goto done;	/* Nobody left to ask */
+	}
     }
 
+    dns_stats.timeouts++;
+
 done:
     free_port(local_port);	/* Return port number to the free pool */
 
@@ -347,3 +520,14 @@ void pxe_dns_resolv(com32sys_t *regs)
 
     regs->eax.l = dns_resolv(name);
 }
+
+/*
+ * INT 22h AX=0025h: return the DNS cache statistics in ES:BX, and
+ * their size in CX
+ */
+void pxe_dns_stats(com32sys_t *regs)
+{
+    regs->es       = SEG(&dns_stats);
+    regs->ebx.w[0] = OFFS(&dns_stats);
+    regs->ecx.w[0] = sizeof dns_stats;
+}
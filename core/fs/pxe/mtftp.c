@@ -0,0 +1,499 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * mtftp.c
+ *
+ * Multicast TFTP (RFC 2090) receive path, used for mtftp:// URLs.
+ *
+ * The server sends DATA packets to a multicast group; one client at a
+ * time (the "master client") ACKs them, the others just listen.  A
+ * client may join while a transfer is already in progress, so blocks
+ * can arrive in any order.  We keep a bitmap of the blocks we have and
+ * place each block straight into the buffer of the current getfssec
+ * request.  Blocks outside the current request are dropped and picked
+ * up from a later pass, once we become master, or -- if the group goes
+ * quiet -- from a plain unicast transfer of the same file.  (The core
+ * heap is far too small to hold the rest of a kernel or initrd.)
+ */
+
+#include <dprintf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <core.h>
+#include <fs.h>
+#include <minmax.h>
+#include <sys/cpu.h>
+#include "pxe.h"
+
+static __lowmem char mtftp_pkt[PKTBUF_SIZE] __aligned(16);
+
+/*
+ * Program the NIC multicast filter for our group, or clear it if
+ * group == 0.
+ */
+static void mtftp_filter(uint32_t group)
+{
+    static __lowmem t_PXENV_UNDI_GET_MCAST_ADDR get_mcast;
+    static __lowmem t_PXENV_UNDI_SET_MCAST_ADDR set_mcast;
+    uint8_t *mac = set_mcast.R_Mcast_Buf.McastAddr[0];
+    const uint8_t *ip = (const uint8_t *)&group;
+
+    memset(&set_mcast, 0, sizeof set_mcast);
+
+    if (group) {
+	memset(&get_mcast, 0, sizeof get_mcast);
+	get_mcast.InetAddr = group;
+	if (!pxe_call(PXENV_UNDI_GET_MCAST_ADDR, &get_mcast) &&
+	    get_mcast.Status == PXENV_STATUS_SUCCESS) {
+	    memcpy(mac, get_mcast.MediaAddr, sizeof(mac_addr_t));
+	} else {
+	    /* Ethernet mapping per RFC 1112 */
+	    mac[0] = 0x01;
+	    mac[1] = 0x00;
+	    mac[2] = 0x5e;
+	    mac[3] = ip[1] & 0x7f;
+	    mac[4] = ip[2];
+	    mac[5] = ip[3];
+	}
+	set_mcast.R_Mcast_Buf.MCastAddrCount = 1;
+    }
+
+    pxe_call(PXENV_UNDI_SET_MCAST_ADDR, &set_mcast);
+}
+
+/*
+ * Parse the value of a "multicast" option in an OACK:
+ * "<group>,<port>,<mc>".  The group and port may be empty in OACKs
+ * after the first one, which only change the master client status.
+ */
+int mtftp_parse_oack(struct inode *inode, const char *value)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct mtftp *mc = socket->tftp_mtftp;
+    const char *p = value;
+    uint32_t ip;
+    uint32_t port;
+
+    if (!mc) {
+	mc = socket->tftp_mtftp = zalloc(sizeof *mc);
+	if (!mc) {
+	    malloc_error("multicast TFTP state");
+	    return -1;
+	}
+    }
+
+    if (*p != ',') {
+	p = parse_dotquad(p, &ip);
+	if (!p || *p != ',' || ((uint8_t)ip & 0xf0) != 0xe0)
+	    return -1;		/* Not a class D address */
+	mc->mc_ip = ip;
+    }
+    p++;
+
+    if (*p != ',') {
+	port = 0;
+	while (is_digit(*p))
+	    port = port * 10 + *p++ - '0';
+	if (*p != ',' || !port || port > 0xffff)
+	    return -1;
+	mc->mc_port = htons(port);
+    }
+    p++;
+
+    if ((*p != '0' && *p != '1') || p[1])
+	return -1;
+    mc->master = *p - '0';
+
+    return (mc->mc_ip && mc->mc_port) ? 0 : -1;
+}
+
+/*
+ * Find the value of option _name_ in the OACK in mtftp_pkt
+ */
+static const char *mtftp_oack_option(int len, const char *name)
+{
+    char *p   = mtftp_pkt + 2;
+    char *end = mtftp_pkt + len;
+    const char *opt, *val;
+
+    end[-1] = '\0';		/* Guard against an unterminated packet */
+
+    while (p < end) {
+	opt = p;
+	p += strlen(p) + 1;
+	if (p >= end)
+	    break;
+	val = p;
+	p += strlen(p) + 1;
+	if (!strcasecmp(opt, name))
+	    return val;
+    }
+
+    return NULL;
+}
+
+/*
+ * Called once the OACK for a multicast transfer has been parsed.
+ * We need the file size up front, and the file must be small enough
+ * that block numbers don't wrap, since blocks arrive out of order.
+ *
+ * Returns 0 on success; on failure the multicast state is freed and
+ * the caller should retry the request as plain unicast.
+ */
+int mtftp_start(struct inode *inode, const char *rrq, int rrq_len,
+		int rrq_uc_len, uint16_t server_port)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct mtftp *mc = socket->tftp_mtftp;
+    uint32_t blksize = socket->tftp_blksize;
+
+    if (inode->size == (uint32_t)-1 ||
+	inode->size / blksize + 1 > MTFTP_MAX_BLOCKS)
+	goto fail;
+
+    mc->nblocks = inode->size / blksize + 1;
+    mc->bitmap  = zalloc(((mc->nblocks >> 5) + 1) << 2);
+    mc->rrq     = malloc(rrq_len);
+    if (!mc->bitmap || !mc->rrq)
+	goto fail;
+
+    memcpy(mc->rrq, rrq, rrq_len);
+    mc->rrq_len     = rrq_len;
+    mc->rrq_uc_len  = rrq_uc_len;
+    mc->server_port = server_port;
+
+    mtftp_filter(mc->mc_ip);
+    mc->joined = 1;
+
+    dprintf("MTFTP: group %08x:%u, %u blocks, %s\n",
+	    ntohl(mc->mc_ip), ntohs(mc->mc_port), mc->nblocks,
+	    mc->master ? "master" : "listening");
+    return 0;
+
+fail:
+    mtftp_close(inode);
+    return -1;
+}
+
+void mtftp_close(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct mtftp *mc = socket->tftp_mtftp;
+
+    if (!mc)
+	return;
+
+    if (mc->joined)
+	mtftp_filter(0);
+
+    free(mc->bitmap);
+    free(mc->rrq);
+    free(mc);
+    socket->tftp_mtftp = NULL;
+}
+
+/*
+ * (Re-)send our read request, with or without the multicast option
+ */
+static void mtftp_request(struct inode *inode, bool unicast)
+{
+    static __lowmem struct s_PXENV_UDP_WRITE udp_write;
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct mtftp *mc = socket->tftp_mtftp;
+    int len = unicast ? mc->rrq_uc_len : mc->rrq_len;
+
+    memcpy(mtftp_pkt, mc->rrq, len);
+
+    udp_write.src_port    = socket->tftp_localport;
+    udp_write.dst_port    = mc->server_port;
+    udp_write.ip          = socket->tftp_remoteip;
+    udp_write.gw          = gateway(udp_write.ip);
+    udp_write.buffer      = FAR_PTR(mtftp_pkt);
+    udp_write.buffer_size = len;
+
+    pxe_call(PXENV_UDP_WRITE, &udp_write);
+}
+
+/*
+ * Ask the server to (re)send the first block we are missing.  Only
+ * the master client, or a unicast client, is allowed to ACK.
+ */
+static void mtftp_kick(struct inode *inode)
+{
+    struct mtftp *mc = PVT(inode)->tftp_mtftp;
+
+    if (mc->unicast)
+	ack_packet(inode, htons(mc->uc_lastpkt));
+    else if (mc->master)
+	ack_packet(inode, htons(mc->contig));
+}
+
+/*
+ * Give up on the group and fetch the rest of the file by unicast.
+ * We leave the group by sending an ERROR, as RFC 2090 specifies.
+ */
+static void mtftp_fallback(struct inode *inode)
+{
+    struct mtftp *mc = PVT(inode)->tftp_mtftp;
+
+    dprintf("MTFTP: falling back to unicast at block %u\n", mc->contig);
+
+    tftp_error(inode, 0, "No error, leaving group");
+    if (mc->joined) {
+	mtftp_filter(0);
+	mc->joined = 0;
+    }
+
+    mc->unicast    = 1;
+    mc->master     = 0;
+    mc->uc_lastpkt = 0;
+    mtftp_request(inode, true);
+}
+
+/*
+ * Poll for one packet from the server, alternating between our own
+ * port and the multicast group.  Returns the packet length, or -1.
+ */
+static int mtftp_recv(struct inode *inode, uint16_t *s_port, bool *group)
+{
+    static __lowmem struct s_PXENV_UDP_READ udp_read;
+    static bool poll_group;
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct mtftp *mc = socket->tftp_mtftp;
+    int err;
+
+    poll_group = !poll_group && mc->joined;
+
+    memset(&udp_read, 0, sizeof udp_read);
+    udp_read.buffer      = FAR_PTR(mtftp_pkt);
+    udp_read.buffer_size = PKTBUF_SIZE;
+    if (poll_group) {
+	udp_read.dest_ip = mc->mc_ip;
+	udp_read.d_port  = mc->mc_port;
+    } else {
+	udp_read.dest_ip = IPInfo.myip;
+	udp_read.d_port  = socket->tftp_localport;
+    }
+
+    err = pxe_call(PXENV_UDP_READ, &udp_read);
+    if (err || udp_read.status ||
+	udp_read.src_ip != socket->tftp_remoteip ||
+	udp_read.buffer_size < 4)
+	return -1;
+
+    *s_port = udp_read.s_port;
+    *group  = poll_group;
+    return udp_read.buffer_size;
+}
+
+/*
+ * Receive packets until blocks _first_ to _last_ are all present.
+ * _buf_ corresponds to the start of block _first_ and holds
+ * (_end_ - offset of _first_) bytes; the part of a block which
+ * overhangs _end_ is left in the socket packet buffer.
+ */
+static void mtftp_fill(struct inode *inode, char *buf, uint32_t first,
+		       uint32_t last, uint32_t end, uint32_t missing)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct mtftp *mc = socket->tftp_mtftp;
+    uint32_t blksize = socket->tftp_blksize;
+    uint32_t base = (first - 1) * blksize;
+    const uint8_t *timeout_ptr = TimeoutTable;
+    uint8_t timeout = *timeout_ptr++;
+    uint32_t oldtime = jiffies();
+    uint32_t blk, offset, chunk;
+    const char *val;
+    uint16_t s_port;
+    bool group;
+    int len;
+
+    mtftp_kick(inode);
+
+    while (missing) {
+	len = mtftp_recv(inode, &s_port, &group);
+	if (len < 0) {
+	    uint32_t now = jiffies();
+
+	    if (now - oldtime < timeout)
+		continue;
+
+	    oldtime = now;
+	    timeout = *timeout_ptr++;
+	    if (!timeout) {
+		if (mc->unicast)
+		    kaboom();
+		mtftp_fallback(inode);
+		timeout_ptr = TimeoutTable;
+		timeout = *timeout_ptr++;
+	    } else if (mc->master || mc->unicast) {
+		mtftp_kick(inode);
+	    } else {
+		/* A listener re-requests; the server may make us master */
+		mtftp_request(inode, false);
+	    }
+	    continue;
+	}
+
+	switch (*(uint16_t *)mtftp_pkt) {
+	case TFTP_OACK:
+	    if (group)
+		break;
+	    socket->tftp_remoteport = s_port;
+	    if (mc->unicast) {
+		uint32_t v = 0;
+
+		val = mtftp_oack_option(len, "blksize");
+		while (val && is_digit(*val))
+		    v = v * 10 + *val++ - '0';
+		if (val && v != blksize) {
+		    tftp_error(inode, TFTP_EOPTNEG, "Block size changed");
+		    kaboom();
+		}
+	    } else {
+		/* Master client handover */
+		val = mtftp_oack_option(len, "multicast");
+		if (val && mtftp_parse_oack(inode, val))
+		    break;
+	    }
+	    mtftp_kick(inode);
+	    break;
+
+	case TFTP_DATA:
+	    blk = ntohs(*(uint16_t *)(mtftp_pkt + 2));
+	    len -= 4;
+
+	    /* Check the packet before ACKing it, or it is lost for good */
+	    offset = (blk - 1) * blksize;
+	    if (!blk || blk > mc->nblocks ||
+		(uint32_t)len != min(blksize, inode->size - offset))
+		break;		/* Garbled */
+
+	    if (mc->unicast) {
+		if (group || blk != mc->uc_lastpkt + 1)
+		    break;
+		if (blk > last && len)
+		    break;	/* Don't ACK; we'll ask for it next time */
+		socket->tftp_remoteport = s_port;
+		mc->uc_lastpkt = blk;
+		ack_packet(inode, htons(blk));
+	    }
+
+	    if (blk < first || blk > last || test_bit(mc->bitmap, blk))
+		break;
+
+	    chunk = min((uint32_t)len, end - offset);
+	    memcpy(buf + (offset - base), mtftp_pkt + 4, chunk);
+	    if (chunk < (uint32_t)len) {
+		/* Block overhangs this request; keep the tail */
+		socket->tftp_bytesleft = len - chunk;
+		memcpy(socket->tftp_pktbuf, mtftp_pkt + 4 + chunk,
+		       socket->tftp_bytesleft);
+		socket->tftp_dataptr = socket->tftp_pktbuf;
+	    }
+
+	    set_bit(mc->bitmap, blk);
+	    missing--;
+	    while (mc->contig < mc->nblocks &&
+		   test_bit(mc->bitmap, mc->contig + 1))
+		mc->contig++;
+
+	    if (mc->master && !mc->unicast)
+		ack_packet(inode, htons(mc->contig));
+
+	    /* Progress; restart the timeout sequence */
+	    timeout_ptr = TimeoutTable;
+	    timeout = *timeout_ptr++;
+	    oldtime = jiffies();
+	    break;
+
+	case TFTP_ERROR:
+	    if (group)
+		break;
+	    if (mc->unicast) {
+		printf("TFTP server aborted the transfer\n");
+		kaboom();
+	    }
+	    mtftp_fallback(inode);
+	    break;
+
+	default:
+	    break;
+	}
+    }
+}
+
+/*
+ * getfssec for a multicast socket
+ */
+uint32_t mtftp_getfssec(struct file *file, char *buf,
+			int blocks, bool *have_more)
+{
+    struct inode *inode = file->inode;
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct mtftp *mc = socket->tftp_mtftp;
+    uint32_t blksize = socket->tftp_blksize;
+    uint32_t count = blocks << TFTP_BLOCKSIZE_LG2;
+    uint32_t bytes_read = 0;
+    uint32_t chunk, end, first, last, blk, missing;
+
+    /* mtftp_start() never ran; there is no block map to fill */
+    if (!mc->bitmap) {
+	*have_more = 0;
+	return 0;
+    }
+
+    /* Hand out the tail of a block which overhung the previous request */
+    if (socket->tftp_bytesleft) {
+	chunk = min(count, (uint32_t)socket->tftp_bytesleft);
+	memcpy(buf, socket->tftp_dataptr, chunk);
+	socket->tftp_dataptr   += chunk;
+	socket->tftp_bytesleft -= chunk;
+	buf        += chunk;
+	count      -= chunk;
+	bytes_read += chunk;
+	mc->pos    += chunk;
+    }
+
+    /* mc->pos is now block-aligned, unless count ran out above */
+    end = min(mc->pos + count, inode->size);
+    if (end > mc->pos) {
+	first = mc->pos / blksize + 1;
+	last  = (end - 1) / blksize + 1;
+
+	missing = 0;
+	for (blk = first; blk <= last; blk++)
+	    missing += !test_bit(mc->bitmap, blk);
+
+	if (missing)
+	    mtftp_fill(inode, buf, first, last, end, missing);
+
+	bytes_read += end - mc->pos;
+	mc->pos     = end;
+	socket->tftp_filepos = mc->pos + socket->tftp_bytesleft;
+    }
+
+    if (socket->tftp_bytesleft || mc->pos < inode->size) {
+	*have_more = 1;
+    } else {
+	/* Done; let the server move on to the next master client */
+	if (mc->master || mc->unicast)
+	    ack_packet(inode, htons(mc->nblocks));
+	socket->tftp_goteof = 1;
+	mtftp_close(inode);
+	*have_more = 0;
+    }
+
+    return bytes_read;
+}
@@ -21,26 +21,6 @@
 static uint32_t port_number_bitmap[PORT_NUMBER_COUNT/32];
 static uint16_t first_port_number /* = 0 */;
 
-/*
- * Bitmap functions
- */
-static bool test_bit(const uint32_t *bitmap, int32_t index)
-{
-    uint8_t st;
-    asm("btl %2,%1 ; setc %0" : "=qm" (st) : "m" (*bitmap), "r" (index));
-    return st;
-}
-
-static void set_bit(uint32_t *bitmap, int32_t index)
-{
-    asm volatile("btsl %1,%0" : "+m" (*bitmap) : "r" (index) : "memory");
-}
-
-static void clr_bit(uint32_t *bitmap, int32_t index)
-{
-    asm volatile("btcl %1,%0" : "+m" (*bitmap) : "r" (index) : "memory");
-}
-
 /*
  * Get and free a port number (host byte order)
  */
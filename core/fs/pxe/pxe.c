@@ -28,7 +28,12 @@ static bool has_gpxe;
 static uint32_t gpxe_funcs;
 bool have_uuid = false;
 
-/* Common receive buffer */
+/*
+ * Common receive buffer.  Received data is left here, and
+ * pxe_getfssec() copies it straight to its final destination;
+ * only data still unclaimed when we return to the caller is moved
+ * to the socket's private buffer (see stash_packet()).
+ */
 static __lowmem char packet_buf[PKTBUF_SIZE] __aligned(16);
 
 const uint8_t TimeoutTable[] = {
@@ -52,9 +57,6 @@ static const struct tftp_options tftp_options[] =
 };
 static const int tftp_nopts = sizeof tftp_options / sizeof tftp_options[0];
 
-static void tftp_error(struct inode *file, uint16_t errnum,
-		       const char *errstr);
-
 /*
  * Allocate a local UDP port structure and assign it a local port number.
  * Return the inode pointer if success, or null if failure
@@ -109,6 +111,7 @@ static void pxe_close_file(struct file *file)
 	}
     }
 
+    mtftp_close(inode);
     free_socket(inode);
 }
 
@@ -224,7 +227,7 @@ static int gendotquad(char *dst, uint32_t ip)
  * return the the string address after the ip string
  *
  */
-static const char *parse_dotquad(const char *ip_str, uint32_t *res)
+const char *parse_dotquad(const char *ip_str, uint32_t *res)
 {
     const char *p = ip_str;
     uint8_t part = 0;
@@ -278,8 +281,7 @@ int pxe_call(int opcode, void *data)
  * @errnum:	Error number (network byte order)
  * @errstr:	Error string (included in packet)
  */
-static void tftp_error(struct inode *inode, uint16_t errnum,
-		       const char *errstr)
+void tftp_error(struct inode *inode, uint16_t errnum, const char *errstr)
 {
     static __lowmem struct {
 	uint16_t err_op;
@@ -314,7 +316,7 @@ static void tftp_error(struct inode *inode, uint16_t errnum,
  * @param: ack_num, Packet # to ack (network byte order)
  *
  */
-static void ack_packet(struct inode *inode, uint16_t ack_num)
+void ack_packet(struct inode *inode, uint16_t ack_num)
 {
     int err;
     static __lowmem uint16_t ack_packet_buf[2];
@@ -374,6 +376,7 @@ enum pxe_path_type {
     PXE_HOMESERVER,		/* Starting with :: */
     PXE_TFTP,			/* host:: */
     PXE_URL_TFTP,		/* tftp:// */
+    PXE_URL_MTFTP,		/* mtftp:// */
     PXE_URL,			/* Absolute URL syntax */
 };
 
@@ -394,6 +397,8 @@ static enum pxe_path_type pxe_path_type(const char *str)
 	    } else if (p > str && p[1] == '/' && p[2] == '/') {
 		if (!strncasecmp(str, "tftp://", 7))
 		    return PXE_URL_TFTP;
+		else if (!strncasecmp(str, "mtftp://", 8))
+		    return PXE_URL_MTFTP;
 		else
 		    return PXE_URL;
 	    }
@@ -439,9 +444,7 @@ static void get_packet_gpxe(struct inode *inode)
 	    kaboom();
     }
 
-    memcpy(socket->tftp_pktbuf, packet_buf, file_read.BufferSize);
-
-    socket->tftp_dataptr   = socket->tftp_pktbuf;
+    socket->tftp_dataptr   = packet_buf;
     socket->tftp_bytesleft = file_read.BufferSize;
     socket->tftp_filepos  += file_read.BufferSize;
 
@@ -566,8 +569,7 @@ static void fill_buffer(struct inode *inode)
     /* It's the packet we want.  We're also EOF if the size < blocksize */
     socket->tftp_lastpkt = last_pkt;    /* Update last packet number */
     buffersize = udp_read.buffer_size - 4;  /* Skip TFTP header */
-    memcpy(socket->tftp_pktbuf, packet_buf + 4, buffersize);
-    socket->tftp_dataptr = socket->tftp_pktbuf;
+    socket->tftp_dataptr = packet_buf + 4;
     socket->tftp_filepos += buffersize;
     socket->tftp_bytesleft = buffersize;
     if (buffersize < socket->tftp_blksize) {
@@ -581,6 +583,22 @@ static void fill_buffer(struct inode *inode)
 }
 
 
+/*
+ * If the socket still has unclaimed data in the shared packet_buf,
+ * move it to the socket's private buffer before anything else gets
+ * a chance to receive into packet_buf.
+ */
+static void stash_packet(struct pxe_pvt_inode *socket)
+{
+    if (socket->tftp_bytesleft &&
+	socket->tftp_dataptr >= packet_buf &&
+	socket->tftp_dataptr < packet_buf + PKTBUF_SIZE) {
+	memcpy(socket->tftp_pktbuf, socket->tftp_dataptr,
+	       socket->tftp_bytesleft);
+	socket->tftp_dataptr = socket->tftp_pktbuf;
+    }
+}
+
 /**
  * getfssec: Get multiple clusters from a file, given the starting cluster.
  * In this case, get multiple blocks from a specific TCP connection.
@@ -602,6 +620,9 @@ static uint32_t pxe_getfssec(struct file *file, char *buf,
     int chunk;
     int bytes_read = 0;
 
+    if (socket->tftp_mtftp)
+	return mtftp_getfssec(file, buf, blocks, have_more);
+
     count <<= TFTP_BLOCKSIZE_LG2;
     while (count) {
         fill_buffer(inode); /* If we have no 'fresh' buffer, get it */
@@ -622,6 +643,7 @@ static uint32_t pxe_getfssec(struct file *file, char *buf,
 
     if (socket->tftp_bytesleft || (socket->tftp_filepos < inode->size)) {
 	fill_buffer(inode);
+	stash_packet(socket);
         *have_more = 1;
     } else if (socket->tftp_goteof) {
         /*
@@ -671,7 +693,9 @@ static void __pxe_searchdir(const char *filename, struct file *file)
     static __lowmem struct s_PXENV_UDP_READ  udp_read;
     static __lowmem struct s_PXENV_FILE_OPEN file_open;
     static const char rrq_tail[] = "octet\0""tsize\0""0\0""blksize\0""1408";
-    static __lowmem char rrq_packet_buf[2+2*FILENAME_MAX+sizeof rrq_tail];
+    static const char rrq_mcast[] = "multicast\0";
+    static __lowmem char rrq_packet_buf[2+2*FILENAME_MAX+sizeof rrq_tail+
+					sizeof rrq_mcast];
     const struct tftp_options *tftp_opt;
     int i = 0;
     int err;
@@ -688,6 +712,8 @@ static void __pxe_searchdir(const char *filename, struct file *file)
     enum pxe_path_type path_type;
     char fullpath[2*FILENAME_MAX];
     uint16_t server_port = TFTP_PORT;  /* TFTP server port */
+    const char *host;
+    bool want_mcast;
 
     inode = file->inode = NULL;
 	
@@ -721,12 +747,13 @@ static void __pxe_searchdir(const char *filename, struct file *file)
 	break;
 
     case PXE_URL_TFTP:
-	np = filename + 7;
+    case PXE_URL_MTFTP:
+	np = host = filename + (path_type == PXE_URL_MTFTP ? 8 : 7);
 	while (*np && *np != '/' && *np != ':')
 	    np++;
-	if (np > filename + 7) {
-	    if (parse_dotquad(filename + 7, &ip) != np)
-		ip = dns_resolv(filename + 7);
+	if (np > host) {
+	    if (parse_dotquad(host, &ip) != np)
+		ip = dns_resolv(host);
 	}
 	if (*np == ':') {
 	    np++;
@@ -758,6 +785,13 @@ static void __pxe_searchdir(const char *filename, struct file *file)
     memcpy(buf, rrq_tail, sizeof rrq_tail);
     buf += sizeof rrq_tail;
 
+    /* Ask for an RFC 2090 multicast transfer; the server may decline */
+    want_mcast = (path_type == PXE_URL_MTFTP);
+    if (want_mcast) {
+	memcpy(buf, rrq_mcast, sizeof rrq_mcast);
+	buf += sizeof rrq_mcast;
+    }
+
     rrq_len = buf - rrq_packet_buf;
 
     inode = allocate_socket(fs);
@@ -907,10 +941,11 @@ wait_pkt:
 	     * TFTP servers add to the end of the packet, or we have
 	     * no clue how to parse the rest of the packet (what is
 	     * an option name and what is a value?)  In either case,
-	     * discard the rest.
+	     * discard the rest, but still finish setting up the
+	     * transfer below.
 	     */
 	    if (!*opt)
-		goto done;
+		break;
 
             while (buffersize) {
                 if (!*p)
@@ -928,6 +963,20 @@ wait_pkt:
 	    if (!buffersize)
 		break;		/* No option data */
 
+	    if (want_mcast && !strcmp(opt, "multicast")) {
+		const char *val = p;
+
+		while (buffersize && *p) {
+		    p++;
+		    buffersize--;
+		}
+		if (!buffersize || mtftp_parse_oack(inode, val))
+		    goto err_reply;
+		p++;
+		buffersize--;
+		continue;
+	    }
+
             /*
              * Parse option pointed to by options; guaranteed to be
 	     * null-terminated
@@ -958,6 +1007,21 @@ wait_pkt:
             }
 	    *opdata_ptr = opdata;
 	}
+
+	if (socket->tftp_mtftp &&
+	    mtftp_start(inode, rrq_packet_buf, rrq_len,
+			rrq_len - sizeof rrq_mcast, server_port)) {
+	    /*
+	     * The server offered multicast, but we can't use it for
+	     * this file (no tsize, or too many blocks).  Leave the
+	     * group and ask again for a plain transfer.
+	     */
+	    tftp_error(inode, 0, "No error, multicast not usable");
+	    want_mcast = false;
+	    rrq_len -= sizeof rrq_mcast;
+	    timeout_ptr = TimeoutTable;
+	    goto sendreq;
+	}
 	break;
 
     default:
@@ -163,11 +163,58 @@ struct pxe_pvt_inode {
     char    *tftp_dataptr;     /* Pointer to available data */
     uint8_t  tftp_goteof;      /* 1 if the EOF packet received */
     uint8_t  tftp_unused[3];   /* Currently unused */
+    struct mtftp *tftp_mtftp;  /* Multicast state, NULL for unicast */
     char     tftp_pktbuf[PKTBUF_SIZE];
 } __attribute__ ((packed));
 
 #define PVT(i) ((struct pxe_pvt_inode *)((i)->pvt))
 
+/*
+ * Multicast TFTP (RFC 2090) receive state.  Blocks can arrive in any
+ * order, and we may join a transfer which is already in progress, so
+ * we keep track of which blocks we have in a bitmap and place each
+ * one directly into the caller's buffer.
+ */
+#define MTFTP_MAX_BLOCKS 65535	/* Block numbers must not wrap */
+
+struct mtftp {
+    uint32_t mc_ip;		/* Multicast group address */
+    uint16_t mc_port;		/* Multicast group port (NBO) */
+    uint16_t server_port;	/* Server port for (re-)requests (NBO) */
+    uint8_t  master;		/* We are the master client */
+    uint8_t  unicast;		/* Fell back to a unicast transfer */
+    uint8_t  joined;		/* Group is in the NIC multicast filter */
+    uint8_t  unused;
+    uint32_t nblocks;		/* DATA packets in this file, incl. final */
+    uint32_t contig;		/* All blocks up to this one are received */
+    uint32_t uc_lastpkt;	/* Last block ACKed in unicast mode */
+    uint32_t pos;		/* Bytes delivered to the caller */
+    char    *rrq;		/* Copy of our RRQ, for re-requests */
+    uint16_t rrq_len;		/* Length of the RRQ with multicast option */
+    uint16_t rrq_uc_len;	/* Length of the RRQ without it */
+    uint32_t *bitmap;		/* Received blocks, bit N = block N */
+};
+
+/*
+ * Bitmap functions
+ */
+static inline bool test_bit(const uint32_t *bitmap, int32_t index)
+{
+    uint8_t st;
+    asm("btl %2,%1 ; setc %0" : "=qm" (st) : "m" (*bitmap), "r" (index));
+    return st;
+}
+
+static inline void set_bit(uint32_t *bitmap, int32_t index)
+{
+    asm volatile("btsl %1,%0" : "+m" (*bitmap) : "r" (index) : "memory");
+}
+
+static inline void clr_bit(uint32_t *bitmap, int32_t index)
+{
+    asm volatile("btcl %1,%0" : "+m" (*bitmap) : "r" (index) : "memory");
+}
+
 /*
  * Network boot information
  */
@@ -233,6 +280,15 @@ static inline uint32_t gateway(uint32_t ip)
 /* pxe.c */
 bool ip_ok(uint32_t);
 int pxe_call(int, void *);
+const char *parse_dotquad(const char *, uint32_t *);
+void tftp_error(struct inode *, uint16_t, const char *);
+void ack_packet(struct inode *, uint16_t);
+
+/* mtftp.c */
+int mtftp_parse_oack(struct inode *, const char *);
+int mtftp_start(struct inode *, const char *, int, int, uint16_t);
+uint32_t mtftp_getfssec(struct file *, char *, int, bool *);
+void mtftp_close(struct inode *);
 
 /* dhcp_options.c */
 void parse_dhcp(int);
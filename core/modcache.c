@@ -0,0 +1,254 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * modcache.c
+ *
+ * Cache of COM32 module images, so that going back and forth between,
+ * say, vesamenu.c32 and hdt.c32 doesn't load them again every time.
+ *
+ * The cache lives at the top of the high memory managed by Syslinux,
+ * above the packed vkernels; that memory is below neither the COM32
+ * stack nor the COM32 heap, so cached images survive running modules.
+ * An entry is keyed by the current directory and file name, and checked
+ * against the size (the TFTP tsize for PXELINUX), inode number and
+ * modification time of the file just opened.  When space runs out, the
+ * least recently used entries are dropped.
+ */
+
+#include <string.h>
+#include <minmax.h>
+#include <syslinux/align.h>
+#include "core.h"
+#include "fs.h"
+
+#define MODCACHE_MAX		(16 << 20)	/* Largest region */
+#define MODCACHE_SHIFT		4		/* 1/16 of high memory... */
+#define MODCACHE_MIN		(1 << 20)	/* ... or none if < 1 MB */
+#define MODCACHE_ENTRIES	16
+#define MODCACHE_ALIGN		16
+
+struct modcache_key {
+    uint32_t hash;		/* Of the directory and file name */
+    uint32_t size;
+    uint32_t ino;
+    uint32_t mtime;
+};
+
+struct modcache_entry {
+    struct modcache_key key;
+    char *addr;			/* Names, then the image */
+    uint32_t len;		/* Total, aligned */
+    uint32_t namelen;
+    uint32_t stamp;		/* Last use, for LRU */
+};
+
+static char *cache_start, *cache_end;
+static struct modcache_entry entries[MODCACHE_ENTRIES];
+static int nentries;
+static uint32_t lru_clock;
+
+/* Key of the image being loaded after a miss */
+static struct modcache_key pending;
+static char pending_name[CURRENTDIR_MAX + FILENAME_MAX];
+static uint32_t pending_namelen;
+
+/*
+ * Reserve the cache region below the top of high memory.
+ *
+ * Input:	EAX = top of high memory
+ * Output:	EAX = top of the memory below the cache
+ */
+void pm_modcache_reserve(com32sys_t *regs)
+{
+    uint32_t top = regs->eax.l;
+    uint32_t size;
+
+    if (!cache_end) {
+	size = min((top - (1 << 20)) >> MODCACHE_SHIFT, MODCACHE_MAX);
+	size &= ~(MODCACHE_ALIGN - 1);
+	if (top <= (1 << 20) || size < MODCACHE_MIN)
+	    size = 0;
+
+	cache_end = (char *)top;
+	cache_start = cache_end - size;
+    }
+
+    regs->eax.l = (uint32_t)cache_start;
+}
+
+/* FNV-1a */
+static uint32_t name_hash(const char *p, uint32_t len)
+{
+    uint32_t h = 2166136261U;
+
+    while (len--)
+	h = (h ^ (uint8_t)*p++) * 16777619U;
+    return h;
+}
+
+static void drop_entry(int i)
+{
+    memmove(&entries[i], &entries[i + 1],
+	    (--nentries - i) * sizeof entries[0]);
+}
+
+/*
+ * Find room for len bytes: first fit between the entries, which are
+ * kept in address order, evicting the least recently used until it
+ * fits.  Returns the index the new entry goes at, or -1.
+ */
+static int make_room(uint32_t len, char **where)
+{
+    char *p;
+    int i, lru;
+
+    if (len > (uint32_t)(cache_end - cache_start))
+	return -1;
+
+    for (;;) {
+	p = cache_start;
+	for (i = 0; i < nentries; i++) {
+	    if ((uint32_t)(entries[i].addr - p) >= len)
+		break;
+	    p = entries[i].addr + entries[i].len;
+	}
+	if (i < nentries || (uint32_t)(cache_end - p) >= len) {
+	    if (nentries < MODCACHE_ENTRIES) {
+		*where = p;
+		return i;
+	    }
+	}
+
+	/* Evict the least recently used entry and try again */
+	lru = 0;
+	for (i = 1; i < nentries; i++)
+	    if (entries[i].stamp < entries[lru].stamp)
+		lru = i;
+	drop_entry(lru);
+    }
+}
+
+/*
+ * Look for the COM32 module being loaded in the cache.
+ *
+ * Input:	SI  = file handle, as opened
+ *		EAX = file length
+ *		EDI = load address
+ *		DS:BX = file name
+ * Output:	CF clear if found: the image has been copied to EDI, the
+ *		file closed, and EBX = end of the image
+ *		CF set if not: load the file and call pm_modcache_store
+ */
+void pm_modcache_load(com32sys_t *regs)
+{
+    struct file *file = handle_to_file(regs->esi.w[0]);
+    const char *name = MK_PTR(regs->ds, regs->ebx.w[0]);
+    struct modcache_entry *e;
+    size_t dirlen;
+    int i;
+
+    pending.size = 0;
+    set_flags(regs, EFLAGS_CF);
+
+    if (cache_start == cache_end || !file || !file->inode)
+	return;
+
+    /* The size is our main check; no tsize means no caching */
+    if (!regs->eax.l || regs->eax.l == (uint32_t)-1 ||
+	regs->eax.l != file->inode->size)
+	return;
+
+    dirlen = strlen(this_fs->cwd_name) + 1;
+    pending_namelen = dirlen + strlen(name) + 1;
+    if (pending_namelen > sizeof pending_name)
+	return;
+    memcpy(pending_name, this_fs->cwd_name, dirlen);
+    strcpy(pending_name + dirlen, name);
+
+    pending.hash = name_hash(pending_name, pending_namelen);
+    pending.size = regs->eax.l;
+    pending.ino = file->inode->ino;
+    pending.mtime = file->inode->mtime;
+
+    for (i = 0; i < nentries; i++) {
+	e = &entries[i];
+	if (memcmp(&e->key, &pending, sizeof pending) ||
+	    e->namelen != pending_namelen ||
+	    memcmp(e->addr, pending_name, pending_namelen))
+	    continue;
+
+	memcpy((void *)regs->edi.l, e->addr + ALIGN_UP(e->namelen,
+						       MODCACHE_ALIGN),
+	       e->key.size);
+	e->stamp = ++lru_clock;
+
+	/* We didn't need the file after all */
+	_close_file(file);
+	regs->esi.w[0] = 0;
+
+	regs->ebx.l = regs->edi.l + e->key.size;
+	pending.size = 0;
+	set_flags(regs, 0);
+	return;
+    }
+}
+
+/*
+ * Add the COM32 module just loaded to the cache.
+ *
+ * Input:	ESI = image
+ *		ECX = bytes loaded
+ */
+void pm_modcache_store(com32sys_t *regs)
+{
+    struct modcache_entry *e;
+    uint32_t namelen, len;
+    char *where;
+    int i;
+
+    /* Only if pm_modcache_load missed, and we got the whole file */
+    if (!pending.size || regs->ecx.l != pending.size)
+	return;
+
+    namelen = ALIGN_UP(pending_namelen, MODCACHE_ALIGN);
+    len = ALIGN_UP(namelen + pending.size, MODCACHE_ALIGN);
+
+    /* Never the same file twice */
+    for (i = 0; i < nentries; i++) {
+	if (entries[i].key.hash == pending.hash &&
+	    entries[i].namelen == pending_namelen &&
+	    !memcmp(entries[i].addr, pending_name, pending_namelen)) {
+	    drop_entry(i);
+	    break;
+	}
+    }
+
+    i = make_room(len, &where);
+    if (i < 0)
+	return;
+
+    memmove(&entries[i + 1], &entries[i], (nentries - i) * sizeof entries[0]);
+    nentries++;
+
+    e = &entries[i];
+    e->key = pending;
+    e->addr = where;
+    e->len = len;
+    e->namelen = pending_namelen;
+    e->stamp = ++lru_clock;
+
+    memcpy(where, pending_name, pending_namelen);
+    memcpy(where + namelen, (void *)regs->esi.l, pending.size);
+
+    pending.size = 0;
+}
@@ -400,6 +400,13 @@ int libfat_xpread(intptr_t pp, void *buf, size_t secsize,
     return secsize;
 }
 
+int libfat_xpread_multi(intptr_t pp, void *buf, size_t secsize,
+			libfat_sector_t sector, unsigned int nsec)
+{
+    read_device(pp, buf, nsec, sector);
+    return secsize * nsec;
+}
+
 static inline void get_dos_version(void)
 {
     uint16_t ver;
@@ -666,6 +673,7 @@ int main(int argc, char *argv[])
     sectors = calloc(ldlinux_sectors, sizeof *sectors);
     lock_device(2);
     fs = libfat_open(libfat_xpread, dev_fd);
+    libfat_set_readmulti(fs, libfat_xpread_multi);
     ldlinux_cluster = libfat_searchdir(fs, 0, "LDLINUX SYS", NULL);
     secp = sectors;
     nsectors = 0;
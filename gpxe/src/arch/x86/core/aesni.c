@@ -0,0 +1,379 @@
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <gpxe/aes.h>
+
+/** @file
+ *
+ * AES using the AES-NI instruction set extensions
+ *
+ * The round keys are taken from the AXTLS key schedule, so only the
+ * block transforms themselves live here.  CBC encryption is
+ * inherently serial, but CBC decryption is performed four blocks at a
+ * time to hide the latency of the AESDEC instruction.
+ *
+ * gPXE is built without SSE code generation, so the compiler will
+ * never allocate the XMM registers for itself; this is why the inline
+ * assembly below does not (and cannot) list them as clobbered.
+ */
+
+/** CPUID.1:ECX AES-NI feature bit */
+#define CPUID_ECX_AES ( 1 << 25 )
+
+/** EFLAGS CPUID detection flag */
+#define EFLAGS_ID 0x00200000UL
+
+/** CR0 emulate coprocessor bit */
+#define CR0_EM 0x00000004UL
+
+/** CR0 task switched bit */
+#define CR0_TS 0x00000008UL
+
+/** CR4 OS supports FXSAVE/FXRSTOR (and hence SSE) bit */
+#define CR4_OSFXSR 0x00000200UL
+
+/** Saved control register state */
+struct aesni_state {
+	/** Original CR0 */
+	unsigned long cr0;
+	/** Original CR4 */
+	unsigned long cr4;
+};
+
+/** All-zeroes chaining value, used for single-block operations */
+static const uint8_t aesni_zero[AES_BLOCKSIZE];
+
+/**
+ * Check for AES-NI support
+ *
+ * @ret supported	AES-NI instructions are supported
+ */
+static int aesni_supported ( void ) {
+	static int supported = -1;
+	uint32_t eax, ebx, ecx, edx;
+
+	if ( supported >= 0 )
+		return supported;
+	supported = 0;
+
+#ifdef __i386__
+	/* Check for CPUID instruction */
+	{
+		unsigned long f1, f2;
+
+		__asm__ ( "pushfl\n\t"
+			  "pushfl\n\t"
+			  "popl %0\n\t"
+			  "movl %0,%1\n\t"
+			  "xorl %2,%0\n\t"
+			  "pushl %0\n\t"
+			  "popfl\n\t"
+			  "pushfl\n\t"
+			  "popl %0\n\t"
+			  "popfl\n\t"
+			  : "=&r" ( f1 ), "=&r" ( f2 )
+			  : "ir" ( EFLAGS_ID ) );
+		if ( ! ( ( f1 ^ f2 ) & EFLAGS_ID ) )
+			return supported;
+	}
+#endif
+
+	__asm__ ( "cpuid" : "=a" ( eax ), "=b" ( ebx ), "=c" ( ecx ),
+		  "=d" ( edx ) : "0" ( 0 ) );
+	if ( eax < 1 )
+		return supported;
+	__asm__ ( "cpuid" : "=a" ( eax ), "=b" ( ebx ), "=c" ( ecx ),
+		  "=d" ( edx ) : "0" ( 1 ) );
+	if ( ecx & CPUID_ECX_AES ) {
+		DBG ( "AES-NI supported\n" );
+		supported = 1;
+	}
+
+	return supported;
+}
+
+/**
+ * Make SSE instructions usable
+ *
+ * @v state		Control register state to fill in
+ *
+ * The BIOS will typically have left CR4.OSFXSR clear, which would
+ * cause every SSE instruction to raise #UD.  We enable it only for
+ * the duration of each operation, so that the state seen by whatever
+ * we eventually boot is left untouched.
+ */
+static void aesni_begin ( struct aesni_state *state ) {
+
+	__asm__ __volatile__ ( "mov %%cr0, %0" : "=r" ( state->cr0 ) );
+	__asm__ __volatile__ ( "mov %%cr4, %0" : "=r" ( state->cr4 ) );
+	if ( state->cr0 & ( CR0_EM | CR0_TS ) ) {
+		__asm__ __volatile__ ( "mov %0, %%cr0" : :
+				       "r" ( state->cr0 &
+					     ~( CR0_EM | CR0_TS ) ) );
+	}
+	if ( ! ( state->cr4 & CR4_OSFXSR ) ) {
+		__asm__ __volatile__ ( "mov %0, %%cr4" : :
+				       "r" ( state->cr4 | CR4_OSFXSR ) );
+	}
+}
+
+/**
+ * Restore control register state
+ *
+ * @v state		Control register state
+ */
+static void aesni_end ( struct aesni_state *state ) {
+
+	if ( ! ( state->cr4 & CR4_OSFXSR ) )
+		__asm__ __volatile__ ( "mov %0, %%cr4" : : "r" ( state->cr4 ) );
+	if ( state->cr0 & ( CR0_EM | CR0_TS ) )
+		__asm__ __volatile__ ( "mov %0, %%cr0" : : "r" ( state->cr0 ) );
+}
+
+/**
+ * Encrypt a single block, chaining from the previous ciphertext
+ *
+ * @v keys		Round keys
+ * @v rounds		Number of rounds
+ * @v chain		Chaining value (updated to the new ciphertext)
+ * @v src		Plaintext block
+ * @v dst		Ciphertext block
+ */
+static inline void aesni_encrypt_block ( const void *keys,
+					 unsigned int rounds, void *chain,
+					 const void *src, void *dst ) {
+	unsigned int count = ( rounds - 1 );
+
+	__asm__ __volatile__ ( "movdqu (%2), %%xmm0\n\t"
+			       "movdqu (%3), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       "\n1:\n\t"
+			       "add $16, %0\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "aesenc %%xmm1, %%xmm0\n\t"
+			       "dec %1\n\t"
+			       "jnz 1b\n\t"
+			       "movdqu 16(%0), %%xmm1\n\t"
+			       "aesenclast %%xmm1, %%xmm0\n\t"
+			       "movdqu %%xmm0, (%4)\n\t"
+			       "movdqu %%xmm0, (%3)\n\t"
+			       : "+r" ( keys ), "+r" ( count )
+			       : "r" ( src ), "r" ( chain ), "r" ( dst )
+			       : "memory" );
+}
+
+/**
+ * Decrypt a single block, chaining from the previous ciphertext
+ *
+ * @v keys		Round keys
+ * @v rounds		Number of rounds
+ * @v chain		Chaining value (updated to this block's ciphertext)
+ * @v src		Ciphertext block
+ * @v dst		Plaintext block
+ */
+static inline void aesni_decrypt_block ( const void *keys,
+					 unsigned int rounds, void *chain,
+					 const void *src, void *dst ) {
+	unsigned int count = ( rounds - 1 );
+
+	__asm__ __volatile__ ( "movdqu (%2), %%xmm0\n\t"
+			       "movdqa %%xmm0, %%xmm2\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       "\n1:\n\t"
+			       "add $16, %0\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "aesdec %%xmm1, %%xmm0\n\t"
+			       "dec %1\n\t"
+			       "jnz 1b\n\t"
+			       "movdqu 16(%0), %%xmm1\n\t"
+			       "aesdeclast %%xmm1, %%xmm0\n\t"
+			       "movdqu (%3), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       "movdqu %%xmm2, (%3)\n\t"
+			       "movdqu %%xmm0, (%4)\n\t"
+			       : "+r" ( keys ), "+r" ( count )
+			       : "r" ( src ), "r" ( chain ), "r" ( dst )
+			       : "memory" );
+}
+
+/**
+ * Decrypt four consecutive blocks, chaining from the previous ciphertext
+ *
+ * @v keys		Round keys
+ * @v rounds		Number of rounds
+ * @v chain		Chaining value (updated to the last ciphertext block)
+ * @v src		Ciphertext blocks
+ * @v dst		Plaintext blocks
+ *
+ * All reads of @c src happen before any write to @c dst, so the
+ * operation may be performed in place.
+ */
+static inline void aesni_decrypt_block4 ( const void *keys,
+					  unsigned int rounds, void *chain,
+					  const void *src, void *dst ) {
+	unsigned int count = ( rounds - 1 );
+
+	__asm__ __volatile__ ( "movdqu (%0), %%xmm4\n\t"
+			       "movdqu 0(%2), %%xmm0\n\t"
+			       "movdqu 16(%2), %%xmm1\n\t"
+			       "movdqu 32(%2), %%xmm2\n\t"
+			       "movdqu 48(%2), %%xmm3\n\t"
+			       "pxor %%xmm4, %%xmm0\n\t"
+			       "pxor %%xmm4, %%xmm1\n\t"
+			       "pxor %%xmm4, %%xmm2\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       "\n1:\n\t"
+			       "add $16, %0\n\t"
+			       "movdqu (%0), %%xmm4\n\t"
+			       "aesdec %%xmm4, %%xmm0\n\t"
+			       "aesdec %%xmm4, %%xmm1\n\t"
+			       "aesdec %%xmm4, %%xmm2\n\t"
+			       "aesdec %%xmm4, %%xmm3\n\t"
+			       "dec %1\n\t"
+			       "jnz 1b\n\t"
+			       "movdqu 16(%0), %%xmm4\n\t"
+			       "aesdeclast %%xmm4, %%xmm0\n\t"
+			       "aesdeclast %%xmm4, %%xmm1\n\t"
+			       "aesdeclast %%xmm4, %%xmm2\n\t"
+			       "aesdeclast %%xmm4, %%xmm3\n\t"
+			       "movdqu (%3), %%xmm4\n\t"
+			       "pxor %%xmm4, %%xmm0\n\t"
+			       "movdqu 0(%2), %%xmm4\n\t"
+			       "pxor %%xmm4, %%xmm1\n\t"
+			       "movdqu 16(%2), %%xmm4\n\t"
+			       "pxor %%xmm4, %%xmm2\n\t"
+			       "movdqu 32(%2), %%xmm4\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       "movdqu 48(%2), %%xmm4\n\t"
+			       "movdqu %%xmm4, (%3)\n\t"
+			       "movdqu %%xmm0, 0(%4)\n\t"
+			       "movdqu %%xmm1, 16(%4)\n\t"
+			       "movdqu %%xmm2, 32(%4)\n\t"
+			       "movdqu %%xmm3, 48(%4)\n\t"
+			       : "+r" ( keys ), "+r" ( count )
+			       : "r" ( src ), "r" ( chain ), "r" ( dst )
+			       : "memory" );
+}
+
+/**
+ * Prepare AES-NI round keys
+ *
+ * @v aes_ctx		AES context, with AXTLS key schedule already set
+ * @ret ok		AES-NI will be used for this context
+ */
+int __weak_impl ( aesni_setkey ) ( struct aes_context *aes_ctx ) {
+	AES_CTX *axtls_ctx = &aes_ctx->axtls_ctx;
+	unsigned int rounds = axtls_ctx->rounds;
+	struct aesni_state state;
+	uint32_t *enc = ( ( uint32_t * ) aes_ctx->aesni_enc );
+	uint8_t *dec = aes_ctx->aesni_dec;
+	unsigned int i;
+
+	aes_ctx->aesni_rounds = 0;
+	if ( ! aesni_supported() )
+		return 0;
+
+	/* The AXTLS schedule is the standard FIPS-197 expansion,
+	 * stored as host-endian words.
+	 */
+	for ( i = 0 ; i < ( 4 * ( rounds + 1 ) ) ; i++ )
+		enc[i] = htonl ( axtls_ctx->ks[i] );
+
+	/* Build the Equivalent Inverse Cipher schedule for AESDEC */
+	aesni_begin ( &state );
+	memcpy ( dec, &aes_ctx->aesni_enc[ rounds * AES_BLOCKSIZE ],
+		 AES_BLOCKSIZE );
+	for ( i = 1 ; i < rounds ; i++ ) {
+		__asm__ __volatile__ ( "movdqu (%0), %%xmm0\n\t"
+				       "aesimc %%xmm0, %%xmm0\n\t"
+				       "movdqu %%xmm0, (%1)\n\t"
+				       : : "r" ( &aes_ctx->aesni_enc[ ( rounds - i )
+								* AES_BLOCKSIZE ] ),
+				           "r" ( &dec[ i * AES_BLOCKSIZE ] )
+				       : "memory" );
+	}
+	memcpy ( &dec[ rounds * AES_BLOCKSIZE ], aes_ctx->aesni_enc,
+		 AES_BLOCKSIZE );
+	aesni_end ( &state );
+
+	aes_ctx->aesni_rounds = rounds;
+	return 1;
+}
+
+/**
+ * Encrypt data in CBC mode
+ *
+ * @v aes_ctx		AES context
+ * @v chain		Chaining value, or NULL for a single ECB block
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+void __weak_impl ( aesni_encrypt ) ( struct aes_context *aes_ctx,
+				     void *chain, const void *src,
+				     void *dst, size_t len ) {
+	unsigned int rounds = aes_ctx->aesni_rounds;
+	uint8_t zero[AES_BLOCKSIZE];
+	struct aesni_state state;
+
+	aesni_begin ( &state );
+	if ( ! chain ) {
+		memcpy ( zero, aesni_zero, sizeof ( zero ) );
+		aesni_encrypt_block ( aes_ctx->aesni_enc, rounds, zero,
+				      src, dst );
+	} else {
+		while ( len ) {
+			aesni_encrypt_block ( aes_ctx->aesni_enc, rounds,
+					      chain, src, dst );
+			src += AES_BLOCKSIZE;
+			dst += AES_BLOCKSIZE;
+			len -= AES_BLOCKSIZE;
+		}
+	}
+	aesni_end ( &state );
+}
+
+/**
+ * Decrypt data in CBC mode
+ *
+ * @v aes_ctx		AES context
+ * @v chain		Chaining value, or NULL for a single ECB block
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+void __weak_impl ( aesni_decrypt ) ( struct aes_context *aes_ctx,
+				     void *chain, const void *src,
+				     void *dst, size_t len ) {
+	unsigned int rounds = aes_ctx->aesni_rounds;
+	uint8_t zero[AES_BLOCKSIZE];
+	struct aesni_state state;
+
+	aesni_begin ( &state );
+	if ( ! chain ) {
+		memcpy ( zero, aesni_zero, sizeof ( zero ) );
+		aesni_decrypt_block ( aes_ctx->aesni_dec, rounds, zero,
+				      src, dst );
+	} else {
+		while ( len >= ( 4 * AES_BLOCKSIZE ) ) {
+			aesni_decrypt_block4 ( aes_ctx->aesni_dec, rounds,
+					       chain, src, dst );
+			src += ( 4 * AES_BLOCKSIZE );
+			dst += ( 4 * AES_BLOCKSIZE );
+			len -= ( 4 * AES_BLOCKSIZE );
+		}
+		while ( len ) {
+			aesni_decrypt_block ( aes_ctx->aesni_dec, rounds,
+					      chain, src, dst );
+			src += AES_BLOCKSIZE;
+			dst += AES_BLOCKSIZE;
+			len -= AES_BLOCKSIZE;
+		}
+	}
+	aesni_end ( &state );
+}
@@ -32,7 +32,7 @@
 
 /* ----- static functions ----- */
 static void SHA1PadMessage(SHA1_CTX *ctx);
-static void SHA1ProcessMessageBlock(SHA1_CTX *ctx);
+static void SHA1ProcessMessageBlock(SHA1_CTX *ctx, const uint8_t *block);
 
 /**
  * Initialize the SHA1 context 
@@ -51,26 +51,47 @@ void SHA1Init(SHA1_CTX *ctx)
 
 /**
  * Accepts an array of octets as the next portion of the message.
+ *
+ * Whole 64-byte blocks are hashed straight out of the caller's buffer;
+ * only a leading or trailing partial block is staged in Message_Block.
  */
 void SHA1Update(SHA1_CTX *ctx, const uint8_t *msg, int len)
 {
-    while (len--)
-    {
-        ctx->Message_Block[ctx->Message_Block_Index++] = (*msg & 0xFF);
+    uint32_t bits = (uint32_t)len << 3;
+    int frag;
 
-        ctx->Length_Low += 8;
-        if (ctx->Length_Low == 0)
-        {
-            ctx->Length_High++;
-        }
+    ctx->Length_Low += bits;
+    if (ctx->Length_Low < bits)
+    {
+        ctx->Length_High++;
+    }
+    ctx->Length_High += (uint32_t)len >> 29;
 
-        if (ctx->Message_Block_Index == 64)
-        {
-            SHA1ProcessMessageBlock(ctx);
-        }
+    if (ctx->Message_Block_Index)
+    {
+        frag = 64 - ctx->Message_Block_Index;
+        if (frag > len)
+            frag = len;
+        memcpy(&ctx->Message_Block[ctx->Message_Block_Index], msg, frag);
+        ctx->Message_Block_Index += frag;
+        msg += frag;
+        len -= frag;
+
+        if (ctx->Message_Block_Index < 64)
+            return;
+
+        SHA1ProcessMessageBlock(ctx, ctx->Message_Block);
+    }
 
-        msg++;
+    while (len >= 64)
+    {
+        SHA1ProcessMessageBlock(ctx, msg);
+        msg += 64;
+        len -= 64;
     }
+
+    memcpy(ctx->Message_Block, msg, len);
+    ctx->Message_Block_Index = len;
 }
 
 /**
@@ -91,19 +112,44 @@ void SHA1Final(SHA1_CTX *ctx, uint8_t *digest)
     }
 }
 
+/*
+ *  One SHA-1 step.  The caller rotates the roles of the five working
+ *  variables instead of shuffling them, so each step is just one add
+ *  chain and one rotate.
+ */
+#define SHA1_F0(b,c,d)  ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F1(b,c,d)  ((b) ^ (c) ^ (d))
+#define SHA1_F2(b,c,d)  (((b) & (c)) | ((d) & ((b) | (c))))
+#define SHA1_STEP(f,k,a,b,c,d,e,w) \
+    do { \
+        (e) += SHA1CircularShift(5,a) + f(b,c,d) + (k) + (w); \
+        (b) = SHA1CircularShift(30,b); \
+    } while (0)
+#define SHA1_STEP5(f,k,t) \
+    do { \
+        SHA1_STEP(f,k,A,B,C,D,E,W[(t)+0]); \
+        SHA1_STEP(f,k,E,A,B,C,D,W[(t)+1]); \
+        SHA1_STEP(f,k,D,E,A,B,C,W[(t)+2]); \
+        SHA1_STEP(f,k,C,D,E,A,B,W[(t)+3]); \
+        SHA1_STEP(f,k,B,C,D,E,A,W[(t)+4]); \
+    } while (0)
+#define SHA1_STEP20(f,k,t) \
+    do { \
+        SHA1_STEP5(f,k,(t)+0); \
+        SHA1_STEP5(f,k,(t)+5); \
+        SHA1_STEP5(f,k,(t)+10); \
+        SHA1_STEP5(f,k,(t)+15); \
+    } while (0)
+
 /**
- * Process the next 512 bits of the message stored in the array.
+ * Process the next 512 bits of the message.
+ *
+ * The whole 80-word message schedule is expanded up front, leaving the
+ * round function as straight-line code.
  */
-static void SHA1ProcessMessageBlock(SHA1_CTX *ctx)
+static void SHA1ProcessMessageBlock(SHA1_CTX *ctx, const uint8_t *block)
 {
-    const uint32_t K[] =    {       /* Constants defined in SHA-1   */
-                            0x5A827999,
-                            0x6ED9EBA1,
-                            0x8F1BBCDC,
-                            0xCA62C1D6
-                            };
     int        t;                 /* Loop counter                */
-    uint32_t      temp;              /* Temporary word value        */
     uint32_t      W[80];             /* Word sequence               */
     uint32_t      A, B, C, D, E;     /* Word buffers                */
 
@@ -112,10 +158,10 @@ static void SHA1ProcessMessageBlock(SHA1_CTX *ctx)
      */
     for  (t = 0; t < 16; t++)
     {
-        W[t] = ctx->Message_Block[t * 4] << 24;
-        W[t] |= ctx->Message_Block[t * 4 + 1] << 16;
-        W[t] |= ctx->Message_Block[t * 4 + 2] << 8;
-        W[t] |= ctx->Message_Block[t * 4 + 3];
+        W[t] = ((uint32_t)block[t * 4] << 24) |
+               ((uint32_t)block[t * 4 + 1] << 16) |
+               ((uint32_t)block[t * 4 + 2] << 8) |
+               ((uint32_t)block[t * 4 + 3]);
     }
 
     for (t = 16; t < 80; t++)
@@ -129,48 +175,10 @@ static void SHA1ProcessMessageBlock(SHA1_CTX *ctx)
     D = ctx->Intermediate_Hash[3];
     E = ctx->Intermediate_Hash[4];
 
-    for (t = 0; t < 20; t++)
-    {
-        temp =  SHA1CircularShift(5,A) +
-                ((B & C) | ((~B) & D)) + E + W[t] + K[0];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
-
-        B = A;
-        A = temp;
-    }
-
-    for (t = 20; t < 40; t++)
-    {
-        temp = SHA1CircularShift(5,A) + (B ^ C ^ D) + E + W[t] + K[1];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
-        B = A;
-        A = temp;
-    }
-
-    for (t = 40; t < 60; t++)
-    {
-        temp = SHA1CircularShift(5,A) +
-               ((B & C) | (B & D) | (C & D)) + E + W[t] + K[2];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
-        B = A;
-        A = temp;
-    }
-
-    for (t = 60; t < 80; t++)
-    {
-        temp = SHA1CircularShift(5,A) + (B ^ C ^ D) + E + W[t] + K[3];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
-        B = A;
-        A = temp;
-    }
+    SHA1_STEP20(SHA1_F0, 0x5A827999, 0);
+    SHA1_STEP20(SHA1_F1, 0x6ED9EBA1, 20);
+    SHA1_STEP20(SHA1_F2, 0x8F1BBCDC, 40);
+    SHA1_STEP20(SHA1_F1, 0xCA62C1D6, 60);
 
     ctx->Intermediate_Hash[0] += A;
     ctx->Intermediate_Hash[1] += B;
@@ -208,7 +216,7 @@ static void SHA1PadMessage(SHA1_CTX *ctx)
             ctx->Message_Block[ctx->Message_Block_Index++] = 0;
         }
 
-        SHA1ProcessMessageBlock(ctx);
+        SHA1ProcessMessageBlock(ctx, ctx->Message_Block);
 
         while (ctx->Message_Block_Index < 56)
         {
@@ -236,5 +244,5 @@ static void SHA1PadMessage(SHA1_CTX *ctx)
     ctx->Message_Block[61] = ctx->Length_Low >> 16;
     ctx->Message_Block[62] = ctx->Length_Low >> 8;
     ctx->Message_Block[63] = ctx->Length_Low;
-    SHA1ProcessMessageBlock(ctx);
+    SHA1ProcessMessageBlock(ctx, ctx->Message_Block);
 }
@@ -20,6 +20,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <string.h>
 #include <errno.h>
+#include <assert.h>
 #include <byteswap.h>
 #include <gpxe/crypto.h>
 #include <gpxe/cbc.h>
@@ -32,6 +33,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  */
 
+/* Use AES-NI where the CPU supports it */
+REQUEST_OBJECT ( aesni );
+
 /**
  * Set key
  *
@@ -64,6 +68,8 @@ static int aes_setkey ( void *ctx, const void *key, size_t keylen ) {
 	AES_set_key ( &aes_ctx->axtls_ctx, key, iv, mode );
 
 	aes_ctx->decrypting = 0;
+	aes_ctx->aesni_rounds = 0;
+	aesni_setkey ( aes_ctx );
 
 	return 0;
 }
@@ -117,6 +123,10 @@ static void aes_encrypt ( void *ctx, const void *src, void *dst,
 	struct aes_context *aes_ctx = ctx;
 
 	assert ( len == AES_BLOCKSIZE );
+	if ( aes_ctx->aesni_rounds ) {
+		aesni_encrypt ( aes_ctx, NULL, src, dst, len );
+		return;
+	}
 	if ( aes_ctx->decrypting )
 		assert ( 0 );
 	aes_call_axtls ( &aes_ctx->axtls_ctx, src, dst, AES_encrypt );
@@ -135,6 +145,10 @@ static void aes_decrypt ( void *ctx, const void *src, void *dst,
 	struct aes_context *aes_ctx = ctx;
 
 	assert ( len == AES_BLOCKSIZE );
+	if ( aes_ctx->aesni_rounds ) {
+		aesni_decrypt ( aes_ctx, NULL, src, dst, len );
+		return;
+	}
 	if ( ! aes_ctx->decrypting ) {
 		AES_convert_key ( &aes_ctx->axtls_ctx );
 		aes_ctx->decrypting = 1;
@@ -153,6 +167,96 @@ struct cipher_algorithm aes_algorithm = {
 	.decrypt = aes_decrypt,
 };
 
-/* AES with cipher-block chaining */
-CBC_CIPHER ( aes_cbc, aes_cbc_algorithm,
-	     aes_algorithm, struct aes_context, AES_BLOCKSIZE );
+/** AES context with cipher-block chaining */
+struct aes_cbc_context {
+	/** Underlying AES context */
+	struct aes_context raw_ctx;
+	/** CBC chaining value */
+	uint8_t cbc_ctx[AES_BLOCKSIZE];
+};
+
+/**
+ * Set key for AES in CBC mode
+ *
+ * @v ctx		Context
+ * @v key		Key
+ * @v keylen		Key length
+ * @ret rc		Return status code
+ */
+static int aes_cbc_setkey ( void *ctx, const void *key, size_t keylen ) {
+	struct aes_cbc_context *aes_cbc_ctx = ctx;
+
+	return cbc_setkey ( &aes_cbc_ctx->raw_ctx, key, keylen,
+			    &aes_algorithm, &aes_cbc_ctx->cbc_ctx );
+}
+
+/**
+ * Set initialisation vector for AES in CBC mode
+ *
+ * @v ctx		Context
+ * @v iv		Initialisation vector
+ */
+static void aes_cbc_setiv ( void *ctx, const void *iv ) {
+	struct aes_cbc_context *aes_cbc_ctx = ctx;
+
+	cbc_setiv ( &aes_cbc_ctx->raw_ctx, iv, &aes_algorithm,
+		    &aes_cbc_ctx->cbc_ctx );
+}
+
+/**
+ * Encrypt data using AES in CBC mode
+ *
+ * @v ctx		Context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ *
+ * With AES-NI the whole buffer is handed over in one go, rather than
+ * one block at a time through the generic CBC code.
+ */
+static void aes_cbc_encrypt ( void *ctx, const void *src, void *dst,
+			      size_t len ) {
+	struct aes_cbc_context *aes_cbc_ctx = ctx;
+
+	if ( aes_cbc_ctx->raw_ctx.aesni_rounds ) {
+		assert ( ( len % AES_BLOCKSIZE ) == 0 );
+		aesni_encrypt ( &aes_cbc_ctx->raw_ctx, aes_cbc_ctx->cbc_ctx,
+				src, dst, len );
+		return;
+	}
+	cbc_encrypt ( &aes_cbc_ctx->raw_ctx, src, dst, len,
+		      &aes_algorithm, &aes_cbc_ctx->cbc_ctx );
+}
+
+/**
+ * Decrypt data using AES in CBC mode
+ *
+ * @v ctx		Context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aes_cbc_decrypt ( void *ctx, const void *src, void *dst,
+			      size_t len ) {
+	struct aes_cbc_context *aes_cbc_ctx = ctx;
+
+	if ( aes_cbc_ctx->raw_ctx.aesni_rounds ) {
+		assert ( ( len % AES_BLOCKSIZE ) == 0 );
+		aesni_decrypt ( &aes_cbc_ctx->raw_ctx, aes_cbc_ctx->cbc_ctx,
+				src, dst, len );
+		return;
+	}
+	cbc_decrypt ( &aes_cbc_ctx->raw_ctx, src, dst, len,
+		      &aes_algorithm, &aes_cbc_ctx->cbc_ctx );
+}
+
+/** AES with cipher-block chaining */
+struct cipher_algorithm aes_cbc_algorithm = {
+	.name		= "aes_cbc",
+	.ctxsize	= sizeof ( struct aes_cbc_context ),
+	.blocksize	= AES_BLOCKSIZE,
+	.setkey		= aes_cbc_setkey,
+	.setiv		= aes_cbc_setiv,
+	.encrypt	= aes_cbc_encrypt,
+	.decrypt	= aes_cbc_decrypt,
+};
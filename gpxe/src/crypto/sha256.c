@@ -0,0 +1,209 @@
+/*
+ * SHA-256 Secure Hash Algorithm, as defined in FIPS PUB 180-2.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <gpxe/crypto.h>
+#include <gpxe/sha256.h>
+
+/** @file
+ *
+ * SHA-256 algorithm
+ *
+ * The 64-word message schedule is expanded in full before the
+ * compression rounds, which then run from the constant table without
+ * any further data-dependent indexing.
+ */
+
+/** SHA-256 round constants */
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/** SHA-256 initial hash value */
+static const uint32_t sha256_init_hash[SHA256_HASH_WORDS] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#define ROR32( x, n ) ( ( (x) >> (n) ) | ( (x) << ( 32 - (n) ) ) )
+#define SIGMA0( x ) ( ROR32 ( x, 2 ) ^ ROR32 ( x, 13 ) ^ ROR32 ( x, 22 ) )
+#define SIGMA1( x ) ( ROR32 ( x, 6 ) ^ ROR32 ( x, 11 ) ^ ROR32 ( x, 25 ) )
+#define sigma0( x ) ( ROR32 ( x, 7 ) ^ ROR32 ( x, 18 ) ^ ( (x) >> 3 ) )
+#define sigma1( x ) ( ROR32 ( x, 17 ) ^ ROR32 ( x, 19 ) ^ ( (x) >> 10 ) )
+#define CH( x, y, z ) ( (z) ^ ( (x) & ( (y) ^ (z) ) ) )
+#define MAJ( x, y, z ) ( ( (x) & (y) ) | ( (z) & ( (x) | (y) ) ) )
+
+/**
+ * One SHA-256 round
+ *
+ * Rather than shuffling all eight working variables on every round,
+ * the caller rotates their roles; each round then only updates @c d
+ * and @c h.
+ */
+#define SHA256_ROUND( a, b, c, d, e, f, g, h, i ) do {			\
+	uint32_t t1 = ( (h) + SIGMA1 ( e ) + CH ( e, f, g ) +		\
+			sha256_k[i] + w[i] );				\
+	(d) += t1;							\
+	(h) = ( t1 + SIGMA0 ( a ) + MAJ ( a, b, c ) );			\
+	} while ( 0 )
+
+/**
+ * Process one 64-byte block
+ *
+ * @v ctx		SHA-256 context
+ * @v data		Data block
+ */
+static void sha256_transform ( struct sha256_ctx *ctx, const void *data ) {
+	const uint32_t *in = data;
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h;
+	unsigned int i;
+
+	for ( i = 0 ; i < 16 ; i++ )
+		w[i] = be32_to_cpu ( in[i] );
+	for ( ; i < 64 ; i++ ) {
+		w[i] = ( sigma1 ( w[ i - 2 ] ) + w[ i - 7 ] +
+			 sigma0 ( w[ i - 15 ] ) + w[ i - 16 ] );
+	}
+
+	a = ctx->hash[0];
+	b = ctx->hash[1];
+	c = ctx->hash[2];
+	d = ctx->hash[3];
+	e = ctx->hash[4];
+	f = ctx->hash[5];
+	g = ctx->hash[6];
+	h = ctx->hash[7];
+
+	for ( i = 0 ; i < 64 ; i += 8 ) {
+		SHA256_ROUND ( a, b, c, d, e, f, g, h, i + 0 );
+		SHA256_ROUND ( h, a, b, c, d, e, f, g, i + 1 );
+		SHA256_ROUND ( g, h, a, b, c, d, e, f, i + 2 );
+		SHA256_ROUND ( f, g, h, a, b, c, d, e, i + 3 );
+		SHA256_ROUND ( e, f, g, h, a, b, c, d, i + 4 );
+		SHA256_ROUND ( d, e, f, g, h, a, b, c, i + 5 );
+		SHA256_ROUND ( c, d, e, f, g, h, a, b, i + 6 );
+		SHA256_ROUND ( b, c, d, e, f, g, h, a, i + 7 );
+	}
+
+	ctx->hash[0] += a;
+	ctx->hash[1] += b;
+	ctx->hash[2] += c;
+	ctx->hash[3] += d;
+	ctx->hash[4] += e;
+	ctx->hash[5] += f;
+	ctx->hash[6] += g;
+	ctx->hash[7] += h;
+}
+
+static void sha256_init ( void *context ) {
+	struct sha256_ctx *ctx = context;
+
+	memcpy ( ctx->hash, sha256_init_hash, sizeof ( ctx->hash ) );
+	ctx->byte_count = 0;
+}
+
+static void sha256_update ( void *context, const void *data, size_t len ) {
+	struct sha256_ctx *ctx = context;
+	size_t used = ( ctx->byte_count & ( SHA256_BLOCK_SIZE - 1 ) );
+	size_t frag;
+
+	ctx->byte_count += len;
+
+	/* Top up any partial block first */
+	if ( used ) {
+		frag = ( SHA256_BLOCK_SIZE - used );
+		if ( frag > len )
+			frag = len;
+		memcpy ( &ctx->block[used], data, frag );
+		data += frag;
+		len -= frag;
+		if ( ( used + frag ) < SHA256_BLOCK_SIZE )
+			return;
+		sha256_transform ( ctx, ctx->block );
+	}
+
+	/* Hash whole blocks directly from the caller's buffer */
+	while ( len >= SHA256_BLOCK_SIZE ) {
+		if ( ( ( intptr_t ) data ) & ( sizeof ( uint32_t ) - 1 ) ) {
+			memcpy ( ctx->block, data, SHA256_BLOCK_SIZE );
+			sha256_transform ( ctx, ctx->block );
+		} else {
+			sha256_transform ( ctx, data );
+		}
+		data += SHA256_BLOCK_SIZE;
+		len -= SHA256_BLOCK_SIZE;
+	}
+
+	memcpy ( ctx->block, data, len );
+}
+
+static void sha256_final ( void *context, void *out ) {
+	struct sha256_ctx *ctx = context;
+	size_t used = ( ctx->byte_count & ( SHA256_BLOCK_SIZE - 1 ) );
+	uint64_t bits = cpu_to_be64 ( ctx->byte_count << 3 );
+	uint32_t digest[SHA256_HASH_WORDS];
+	unsigned int i;
+
+	ctx->block[used++] = 0x80;
+	if ( used > ( SHA256_BLOCK_SIZE - sizeof ( bits ) ) ) {
+		memset ( &ctx->block[used], 0, ( SHA256_BLOCK_SIZE - used ) );
+		sha256_transform ( ctx, ctx->block );
+		used = 0;
+	}
+	memset ( &ctx->block[used], 0,
+		 ( SHA256_BLOCK_SIZE - sizeof ( bits ) - used ) );
+	memcpy ( &ctx->block[ SHA256_BLOCK_SIZE - sizeof ( bits ) ], &bits,
+		 sizeof ( bits ) );
+	sha256_transform ( ctx, ctx->block );
+
+	for ( i = 0 ; i < SHA256_HASH_WORDS ; i++ )
+		digest[i] = cpu_to_be32 ( ctx->hash[i] );
+	memcpy ( out, digest, sizeof ( digest ) );
+
+	memset ( ctx, 0, sizeof ( *ctx ) );
+}
+
+struct digest_algorithm sha256_algorithm = {
+	.name		= "sha256",
+	.ctxsize	= SHA256_CTX_SIZE,
+	.blocksize	= SHA256_BLOCK_SIZE,
+	.digestsize	= SHA256_DIGEST_SIZE,
+	.init		= sha256_init,
+	.update		= sha256_update,
+	.final		= sha256_final,
+};
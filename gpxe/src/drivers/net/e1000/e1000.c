@@ -302,6 +302,7 @@ int e1000_refill_rx_ring ( struct e1000_adapter *adapter )
 {
 	int i, rx_curr;
 	int rc = 0;
+	int rx_tail = -1;
 	struct e1000_rx_desc *rx_curr_desc;
 	struct e1000_hw *hw = &adapter->hw;
 	struct io_buffer *iob;
@@ -329,10 +330,14 @@ int e1000_refill_rx_ring ( struct e1000_adapter *adapter )
 			break;
 		} else {
 			rx_curr_desc->buffer_addr = virt_to_bus ( iob->data );
-
-			E1000_WRITE_REG ( hw, RDT, rx_curr );
+			rx_tail = rx_curr;
 		}
 	}
+
+	/* Post all refilled descriptors with a single tail update */
+	if ( rx_tail >= 0 )
+		E1000_WRITE_REG ( hw, RDT, rx_tail );
+
 	return rc;
 }
 
@@ -696,6 +701,7 @@ e1000_poll ( struct net_device *netdev )
 	uint32_t rx_err;
 	struct e1000_tx_desc *tx_curr_desc;
 	struct e1000_rx_desc *rx_curr_desc;
+	struct netdev_rx_batch batch;
 	uint32_t i;
 
 	DBGP ( "e1000_poll\n" );
@@ -742,9 +748,10 @@ e1000_poll ( struct net_device *netdev )
 		adapter->tx_head = ( adapter->tx_head + 1 ) % NUM_TX_DESC;		
 	}
 	
-	/* Process received packets 
+	/* Process received packets, handing them up in one burst
 	 */
-	while ( 1 ) {
+	netdev_rx_batch_init ( &batch );
+	while ( ! netdev_rx_batch_full ( &batch ) ) {
 	
 		i = adapter->rx_curr;
 		
@@ -777,8 +784,8 @@ e1000_poll ( struct net_device *netdev )
 			DBG ( "e1000_poll: Corrupted packet received!"
 			      " rx_err: %#08x\n", rx_err );
 		} else 	{
-			/* Add this packet to the receive queue. */
-			netdev_rx ( netdev, adapter->rx_iobuf[i] );
+			/* Add this packet to the burst. */
+			netdev_rx_batch_add ( &batch, adapter->rx_iobuf[i] );
 		}
 		adapter->rx_iobuf[i] = NULL;
 
@@ -786,6 +793,7 @@ e1000_poll ( struct net_device *netdev )
 
 		adapter->rx_curr = ( adapter->rx_curr + 1 ) % NUM_RX_DESC;
 	}
+	netdev_rx_batch ( netdev, &batch );
 	e1000_refill_rx_ring(adapter);
 }
 
@@ -1697,7 +1697,7 @@ static void rtl8169_refill_rx_ring ( struct rtl8169_private *tp )
 
 		/* Don't touch descriptors with iobufs, they still need to be
 		   processed by the poll routine */
-		if ( tp->rx_iobuf[tp->rx_curr] != NULL )
+		if ( tp->rx_iobuf[i] != NULL )
 			continue;
 
 		/** If we can't get an iobuf for this descriptor
@@ -1748,12 +1748,17 @@ rtl8169_process_rx_packets ( struct net_device *netdev )
 	uint32_t rx_status;
 	uint16_t rx_len;
 	struct RxDesc *rx_curr_desc;
+	struct netdev_rx_batch batch;
 	int i;
 
 	DBGP ( "rtl8169_process_rx_packets\n" );
 
+	netdev_rx_batch_init ( &batch );
 	for ( i = 0; i < NUM_RX_DESC; i++ ) {
 
+		if ( netdev_rx_batch_full ( &batch ) )
+			break;
+
 		rx_curr_desc = tp->rx_base  + tp->rx_curr;
 
 		rx_status = rx_curr_desc->opts1;
@@ -1788,8 +1793,9 @@ rtl8169_process_rx_packets ( struct net_device *netdev )
 			/* Adjust size of the iobuf to reflect received data */
 			iob_put ( tp->rx_iobuf[tp->rx_curr], rx_len );
 
-			/* Add this packet to the receive queue.  */
-			netdev_rx ( netdev, tp->rx_iobuf[tp->rx_curr] );
+			/* Add this packet to the burst.  */
+			netdev_rx_batch_add ( &batch,
+					      tp->rx_iobuf[tp->rx_curr] );
 		}
 
 		/* Invalidate this iobuf and descriptor */
@@ -1799,6 +1805,7 @@ rtl8169_process_rx_packets ( struct net_device *netdev )
 		/* Update pointer to next available rx descriptor */
 		tp->rx_curr = ( tp->rx_curr + 1 ) % NUM_RX_DESC;
 	}
+	netdev_rx_batch ( netdev, &batch );
 	rtl8169_refill_rx_ring ( tp );
 }
 
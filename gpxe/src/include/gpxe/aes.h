@@ -3,6 +3,9 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stddef.h>
+#include <stdint.h>
+
 struct cipher_algorithm;
 
 /** Basic AES blocksize */
@@ -16,6 +19,12 @@ struct aes_context {
 	AES_CTX axtls_ctx;
 	/** Cipher is being used for decrypting */
 	int decrypting;
+	/** Number of AES-NI rounds, or zero if AES-NI is not in use */
+	unsigned int aesni_rounds;
+	/** AES-NI encryption round keys */
+	uint8_t aesni_enc[ ( AES_MAXROUNDS + 1 ) * AES_BLOCKSIZE ];
+	/** AES-NI decryption round keys */
+	uint8_t aesni_dec[ ( AES_MAXROUNDS + 1 ) * AES_BLOCKSIZE ];
 };
 
 /** AES context size */
@@ -27,4 +36,17 @@ extern struct cipher_algorithm aes_cbc_algorithm;
 int aes_wrap ( const void *kek, const void *src, void *dest, int nblk );
 int aes_unwrap ( const void *kek, const void *src, void *dest, int nblk );
 
+/* AES-NI acceleration, available only on x86 */
+
+__weak_decl ( int, aesni_setkey, ( struct aes_context *aes_ctx ),
+	      ( aes_ctx ), 0 );
+__weak_decl ( void, aesni_encrypt, ( struct aes_context *aes_ctx,
+				     void *chain, const void *src,
+				     void *dst, size_t len ),
+	      ( aes_ctx, chain, src, dst, len ), );
+__weak_decl ( void, aesni_decrypt, ( struct aes_context *aes_ctx,
+				     void *chain, const void *src,
+				     void *dst, size_t len ),
+	      ( aes_ctx, chain, src, dst, len ), );
+
 #endif /* _GPXE_AES_H */
@@ -19,6 +19,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #define DNS_TYPE_A		1
 #define DNS_TYPE_CNAME		5
+#define DNS_TYPE_SOA		6
 #define DNS_TYPE_ANY		255
 
 #define DNS_CLASS_IN		1
@@ -42,6 +43,14 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define	DNS_PORT		53
 #define	DNS_MAX_RETRIES		3
 #define	DNS_MAX_CNAME_RECURSION	0x30
+#define DNS_MAX_SERVERS		4
+
+/** Number of entries in the DNS response cache */
+#define DNS_CACHE_SIZE		16
+/** Time to remember a negative answer with no SOA record, in seconds */
+#define DNS_NEGATIVE_TTL	60
+/** Upper limit on the time to remember any answer, in seconds */
+#define DNS_MAX_TTL		86400
 
 /*
  * DNS protocol structures
@@ -89,4 +98,22 @@ union dns_rr_info {
 	struct dns_rr_info_cname cname;
 };
 
+/** DNS cache statistics */
+struct dns_cache_stats {
+	/** Lookups answered from the cache */
+	unsigned long hits;
+	/** Of which were cached negative answers */
+	unsigned long neg_hits;
+	/** Lookups that went to the network */
+	unsigned long misses;
+	/** Query packets sent */
+	unsigned long queries;
+	/** Names currently in the cache */
+	unsigned long entries;
+	/** Live entries replaced to make room */
+	unsigned long evictions;
+};
+
+extern struct dns_cache_stats dns_stats;
+
 #endif /* _GPXE_DNS_H */
@@ -131,6 +131,28 @@ static inline int list_empty ( const struct list_head *head ) {
 	return head->next == head;
 }
 
+/**
+ * Move all entries of one list to the tail of another
+ *
+ * @v list	List whose entries are to be moved
+ * @v head	List head to add them before
+ *
+ * After this, @c list is empty.
+ */
+static inline void list_splice_tail ( struct list_head *list,
+				      struct list_head *head ) {
+	struct list_head *first = list->next;
+	struct list_head *last = list->prev;
+
+	if ( list_empty ( list ) )
+		return;
+	first->prev = head->prev;
+	head->prev->next = first;
+	last->next = head;
+	head->prev = last;
+	INIT_LIST_HEAD ( list );
+}
+
 /**
  * Get the containing struct for this entry
  *
@@ -11,11 +11,11 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
 #include <gpxe/list.h>
+#include <gpxe/iobuf.h>
 #include <gpxe/tables.h>
 #include <gpxe/refcnt.h>
 #include <gpxe/settings.h>
 
-struct io_buffer;
 struct net_device;
 struct net_protocol;
 struct ll_protocol;
@@ -214,7 +214,10 @@ struct net_device_operations {
 	 *
 	 * This method should cause the hardware to check for
 	 * completed transmissions and received packets.  Any received
-	 * packets should be delivered via netdev_rx().
+	 * packets should be delivered via netdev_rx(), or collected
+	 * into a struct netdev_rx_batch and delivered in one go via
+	 * netdev_rx_batch().  Drivers should not hand up more than
+	 * NETDEV_RX_BATCH packets per call.
 	 *
 	 * This method is guaranteed to be called only when the device
 	 * is open.
@@ -228,6 +231,22 @@ struct net_device_operations {
 	void ( * irq ) ( struct net_device *netdev, int enable );
 };
 
+/** Maximum number of received packets handed up per poll
+ *
+ * net_step() processes this many packets from each device's RX
+ * queue per step, and drivers should return at most this many
+ * packets from a single call to their poll() method.
+ */
+#define NETDEV_RX_BATCH 16
+
+/** A burst of received packets, collected by a driver during poll() */
+struct netdev_rx_batch {
+	/** List of received I/O buffers */
+	struct list_head list;
+	/** Number of I/O buffers in the list */
+	unsigned int count;
+};
+
 /** Network device error */
 struct net_device_error {
 	/** Error status code */
@@ -448,6 +467,44 @@ netdev_settings_init ( struct net_device *netdev ) {
 	netdev->settings.settings.op = &netdev_settings_operations;
 }
 
+/**
+ * Initialise a burst of received packets
+ *
+ * @v batch		RX batch
+ */
+static inline __attribute__ (( always_inline )) void
+netdev_rx_batch_init ( struct netdev_rx_batch *batch ) {
+	INIT_LIST_HEAD ( &batch->list );
+	batch->count = 0;
+}
+
+/**
+ * Add a received packet to a burst
+ *
+ * @v batch		RX batch
+ * @v iobuf		I/O buffer
+ *
+ * This takes ownership of the I/O buffer; it will be handed up to
+ * the network stack by netdev_rx_batch().
+ */
+static inline __attribute__ (( always_inline )) void
+netdev_rx_batch_add ( struct netdev_rx_batch *batch,
+		      struct io_buffer *iobuf ) {
+	list_add_tail ( &iobuf->list, &batch->list );
+	batch->count++;
+}
+
+/**
+ * Check whether a burst of received packets is full
+ *
+ * @v batch		RX batch
+ * @ret full		Batch has reached NETDEV_RX_BATCH packets
+ */
+static inline __attribute__ (( always_inline )) int
+netdev_rx_batch_full ( struct netdev_rx_batch *batch ) {
+	return ( batch->count >= NETDEV_RX_BATCH );
+}
+
 /**
  * Mark network device as having link up
  *
@@ -488,6 +545,8 @@ extern void netdev_tx_complete_next_err ( struct net_device *netdev, int rc );
 extern void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf );
 extern void netdev_rx_err ( struct net_device *netdev,
 			    struct io_buffer *iobuf, int rc );
+extern void netdev_rx_batch ( struct net_device *netdev,
+			      struct netdev_rx_batch *batch );
 extern void netdev_poll ( struct net_device *netdev );
 extern struct io_buffer * netdev_rx_dequeue ( struct net_device *netdev );
 extern struct net_device * alloc_netdev ( size_t priv_size );
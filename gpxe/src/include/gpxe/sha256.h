@@ -0,0 +1,34 @@
+#ifndef _GPXE_SHA256_H
+#define _GPXE_SHA256_H
+
+/** @file
+ *
+ * SHA-256 algorithm
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+struct digest_algorithm;
+
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE	32
+#define SHA256_BLOCK_SIZE	64
+#define SHA256_HASH_WORDS	8
+
+/** SHA-256 context */
+struct sha256_ctx {
+	/** Intermediate hash value */
+	uint32_t hash[SHA256_HASH_WORDS];
+	/** Partial data block */
+	uint8_t block[SHA256_BLOCK_SIZE];
+	/** Total number of bytes hashed */
+	uint64_t byte_count;
+};
+
+#define SHA256_CTX_SIZE sizeof ( struct sha256_ctx )
+
+extern struct digest_algorithm sha256_algorithm;
+
+#endif /* _GPXE_SHA256_H */
@@ -227,6 +227,33 @@ void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	netdev_record_stat ( &netdev->rx_stats, 0 );
 }
 
+/**
+ * Add a burst of packets to network device's RX queue
+ *
+ * @v netdev		Network device
+ * @v batch		RX batch
+ *
+ * Equivalent to calling netdev_rx() on each packet of the batch in
+ * turn, but moves the whole burst onto the RX queue at once.  The
+ * batch is left empty.
+ */
+void netdev_rx_batch ( struct net_device *netdev,
+		       struct netdev_rx_batch *batch ) {
+
+	if ( ! batch->count )
+		return;
+
+	DBGC ( netdev, "NETDEV %p received burst of %d packets\n",
+	       netdev, batch->count );
+
+	/* Enqueue packets */
+	list_splice_tail ( &batch->list, &netdev->rx_queue );
+
+	/* Update statistics counter */
+	netdev->rx_stats.good += batch->count;
+	batch->count = 0;
+}
+
 /**
  * Discard received packet
  *
@@ -592,6 +619,7 @@ static void net_step ( struct process *process __unused ) {
 	const void *ll_dest;
 	const void *ll_source;
 	uint16_t net_proto;
+	unsigned int budget;
 	int rc;
 
 	/* Poll and process each network device */
@@ -600,13 +628,18 @@ static void net_step ( struct process *process __unused ) {
 		/* Poll for new packets */
 		netdev_poll ( netdev );
 
-		/* Process at most one received packet.  Give priority
-		 * to getting packets out of the NIC over processing
-		 * the received packets, because we advertise a window
-		 * that assumes that we can receive packets from the
-		 * NIC faster than they arrive.
+		/* Process at most one burst of received packets.
+		 * Give priority to getting packets out of the NIC
+		 * over processing the received packets, because we
+		 * advertise a window that assumes that we can receive
+		 * packets from the NIC faster than they arrive; but
+		 * don't pay for a whole trip around the process loop
+		 * for every single packet.
 		 */
-		if ( ( iobuf = netdev_rx_dequeue ( netdev ) ) ) {
+		for ( budget = NETDEV_RX_BATCH ; budget ; budget-- ) {
+
+			if ( ! ( iobuf = netdev_rx_dequeue ( netdev ) ) )
+				break;
 
 			DBGC ( netdev, "NETDEV %p processing %p (%p+%zx)\n",
 			       netdev, iobuf, iobuf->data,
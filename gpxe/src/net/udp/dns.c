@@ -24,6 +24,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <errno.h>
 #include <byteswap.h>
@@ -32,6 +33,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <gpxe/open.h>
 #include <gpxe/resolv.h>
 #include <gpxe/retry.h>
+#include <gpxe/process.h>
+#include <gpxe/timer.h>
+#include <gpxe/iobuf.h>
 #include <gpxe/tcpip.h>
 #include <gpxe/settings.h>
 #include <gpxe/features.h>
@@ -45,10 +49,11 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 FEATURE ( FEATURE_PROTOCOL, "DNS", DHCP_EB_FEATURE_DNS, 1 );
 
-/** The DNS server */
-static struct sockaddr_tcpip nameserver = {
-	.st_port = htons ( DNS_PORT ),
-};
+/** The DNS servers */
+static struct sockaddr_tcpip nameservers[DNS_MAX_SERVERS];
+
+/** Number of DNS servers */
+static unsigned int num_nameservers;
 
 /** The local domain */
 static char *localdomain;
@@ -63,7 +68,11 @@ struct dns_request {
 	struct xfer_interface socket;
 	/** Retry timer */
 	struct retry_timer timer;
+	/** Process used to complete requests answered from the cache */
+	struct process process;
 
+	/** Fully-qualified name being resolved */
+	char *fqdn;
 	/** Socket address to fill in with resolved address */
 	struct sockaddr sa;
 	/** Current query packet */
@@ -76,8 +85,151 @@ struct dns_request {
 	struct dns_query_info *qinfo;
 	/** Recursion counter */
 	unsigned int recursion;
+	/** Lowest TTL seen along the CNAME chain, in seconds */
+	uint32_t ttl;
+	/** Status code for a request answered from the cache */
+	int cached_rc;
 };
 
+/******************************************************************************
+ *
+ * Response cache
+ *
+ ******************************************************************************
+ */
+
+/** A DNS cache entry */
+struct dns_cache_entry {
+	/** Fully-qualified name, or NULL if entry is unused */
+	char *name;
+	/** Address, or INADDR_NONE for a negative entry */
+	struct in_addr in_addr;
+	/** Expiry time, in ticks */
+	unsigned long expiry;
+	/** Time of last use, in ticks */
+	unsigned long lastuse;
+};
+
+/** DNS response cache */
+static struct dns_cache_entry dns_cache[DNS_CACHE_SIZE];
+
+/** DNS cache statistics */
+struct dns_cache_stats dns_stats;
+
+/**
+ * Discard DNS cache entry
+ *
+ * @v entry		Cache entry
+ */
+static void dns_cache_discard ( struct dns_cache_entry *entry ) {
+	free ( entry->name );
+	entry->name = NULL;
+	dns_stats.entries--;
+}
+
+/**
+ * Find DNS cache entry
+ *
+ * @v name		Fully-qualified name
+ * @ret entry		Cache entry, or NULL if not cached
+ */
+static struct dns_cache_entry * dns_cache_find ( const char *name ) {
+	struct dns_cache_entry *entry;
+	unsigned long now = currticks();
+	unsigned int i;
+
+	for ( i = 0 ; i < DNS_CACHE_SIZE ; i++ ) {
+		entry = &dns_cache[i];
+		if ( ( ! entry->name ) || strcasecmp ( entry->name, name ) )
+			continue;
+		if ( ( signed long ) ( entry->expiry - now ) <= 0 ) {
+			dns_cache_discard ( entry );
+			return NULL;
+		}
+		entry->lastuse = now;
+		return entry;
+	}
+	return NULL;
+}
+
+/**
+ * Add answer to DNS cache
+ *
+ * @v name		Fully-qualified name
+ * @v in_addr		Address, or INADDR_NONE for a negative answer
+ * @v ttl		Time to live, in seconds
+ *
+ * An unused or expired entry is reused if possible; otherwise the
+ * least recently used entry is replaced.  Failure to allocate memory
+ * just means that the answer does not get cached.
+ */
+static void dns_cache_add ( const char *name, struct in_addr in_addr,
+			    uint32_t ttl ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *victim = NULL;
+	unsigned long now = currticks();
+	char *copy;
+	unsigned int i;
+
+	if ( ! ttl )
+		return;
+	if ( ttl > DNS_MAX_TTL )
+		ttl = DNS_MAX_TTL;
+
+	copy = strdup ( name );
+	if ( ! copy )
+		return;
+
+	for ( i = 0 ; i < DNS_CACHE_SIZE ; i++ ) {
+		entry = &dns_cache[i];
+		if ( ( ! entry->name ) ||
+		     ( ( signed long ) ( entry->expiry - now ) <= 0 ) ) {
+			victim = entry;
+			break;
+		}
+		if ( ( ! victim ) ||
+		     ( ( signed long ) ( entry->lastuse -
+					 victim->lastuse ) < 0 ) ) {
+			victim = entry;
+		}
+	}
+
+	if ( victim->name ) {
+		if ( ( signed long ) ( victim->expiry - now ) > 0 )
+			dns_stats.evictions++;
+		dns_cache_discard ( victim );
+	}
+	victim->name = copy;
+	victim->in_addr = in_addr;
+	victim->expiry = ( now + ( ttl * TICKS_PER_SEC ) );
+	victim->lastuse = now;
+	dns_stats.entries++;
+
+	DBG ( "DNS cached %s as %s for %ds\n", name,
+	      ( ( in_addr.s_addr == INADDR_NONE ) ?
+		"nonexistent" : inet_ntoa ( in_addr ) ), ttl );
+}
+
+/******************************************************************************
+ *
+ * Queries
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Free DNS request
+ *
+ * @v refcnt		Reference counter
+ */
+static void dns_free ( struct refcnt *refcnt ) {
+	struct dns_request *dns =
+		container_of ( refcnt, struct dns_request, refcnt );
+
+	free ( dns->fqdn );
+	free ( dns );
+}
+
 /**
  * Mark DNS request as complete
  *
@@ -185,6 +337,46 @@ static union dns_rr_info * dns_find_rr ( struct dns_request *dns,
 	return NULL;
 }
 
+/**
+ * Determine how long to remember a negative answer
+ *
+ * @v reply		DNS reply
+ * @ret ttl		Time to live, in seconds
+ *
+ * Per RFC 2308, this is the lesser of the TTL of the SOA record in
+ * the authority section and its MINIMUM field.
+ */
+static uint32_t dns_negative_ttl ( const struct dns_header *reply ) {
+	const char *p = ( ( char * ) reply ) + sizeof ( struct dns_header );
+	const union dns_rr_info *rr_info;
+	const char *rdata;
+	uint32_t ttl, minimum;
+	int i;
+
+	for ( i = ntohs ( reply->qdcount ) ; i > 0 ; i-- )
+		p = dns_skip_name ( p ) + sizeof ( struct dns_query_info );
+	for ( i = ntohs ( reply->ancount ) ; i > 0 ; i-- ) {
+		rr_info = ( ( union dns_rr_info * ) dns_skip_name ( p ) );
+		p = ( ( ( char * ) rr_info ) + sizeof ( rr_info->common ) +
+		      ntohs ( rr_info->common.rdlength ) );
+	}
+	for ( i = ntohs ( reply->nscount ) ; i > 0 ; i-- ) {
+		rr_info = ( ( union dns_rr_info * ) dns_skip_name ( p ) );
+		if ( rr_info->common.type == htons ( DNS_TYPE_SOA ) ) {
+			/* Skip MNAME, RNAME, SERIAL, REFRESH, RETRY, EXPIRE */
+			rdata = ( ( ( char * ) rr_info ) +
+				  sizeof ( rr_info->common ) );
+			rdata = dns_skip_name ( dns_skip_name ( rdata ) );
+			minimum = ntohl ( *( ( uint32_t * ) ( rdata + 16 ) ) );
+			ttl = ntohl ( rr_info->common.ttl );
+			return ( ( ttl < minimum ) ? ttl : minimum );
+		}
+		p = ( ( ( char * ) rr_info ) + sizeof ( rr_info->common ) +
+		      ntohs ( rr_info->common.rdlength ) );
+	}
+	return DNS_NEGATIVE_TTL;
+}
+
 /**
  * Append DHCP domain name if available and name is not fully qualified
  *
@@ -286,7 +478,11 @@ static char * dns_decompress_name ( const struct dns_header *reply,
  */
 static int dns_send_packet ( struct dns_request *dns ) {
 	static unsigned int qid = 0;
+	struct xfer_metadata meta;
+	struct io_buffer *iobuf;
 	size_t qlen;
+	unsigned int i;
+	int rc = 0;
 
 	/* Increment query ID */
 	dns->query.dns.id = htons ( ++qid );
@@ -296,10 +492,25 @@ static int dns_send_packet ( struct dns_request *dns ) {
 	/* Start retransmission timer */
 	start_timer ( &dns->timer );
 
-	/* Send the data */
+	/* Send the query to every server at once; the first useful
+	 * reply wins.
+	 */
 	qlen = ( ( ( void * ) dns->qinfo ) - ( ( void * ) &dns->query )
 		 + sizeof ( dns->qinfo ) );
-	return xfer_deliver_raw ( &dns->socket, &dns->query, qlen );
+	for ( i = 0 ; i < num_nameservers ; i++ ) {
+		iobuf = xfer_alloc_iob ( &dns->socket, qlen );
+		if ( ! iobuf ) {
+			rc = -ENOMEM;
+			continue;
+		}
+		memcpy ( iob_put ( iobuf, qlen ), &dns->query, qlen );
+		memset ( &meta, 0, sizeof ( meta ) );
+		meta.dest = ( ( struct sockaddr * ) &nameservers[i] );
+		if ( ( rc = xfer_deliver_iob_meta ( &dns->socket, iobuf,
+						    &meta ) ) == 0 )
+			dns_stats.queries++;
+	}
+	return rc;
 }
 
 /**
@@ -335,6 +546,9 @@ static int dns_xfer_deliver_raw ( struct xfer_interface *socket,
 	union dns_rr_info *rr_info;
 	struct sockaddr_in *sin;
 	unsigned int qtype = dns->qinfo->qtype;
+	struct in_addr none = { .s_addr = INADDR_NONE };
+	uint32_t ttl;
+	int rcode;
 
 	/* Sanity check */
 	if ( len < sizeof ( *reply ) ) {
@@ -353,6 +567,16 @@ static int dns_xfer_deliver_raw ( struct xfer_interface *socket,
 
 	DBGC ( dns, "DNS %p received reply ID %d\n", dns, ntohs ( reply->id ));
 
+	/* A server that could not answer (e.g. SERVFAIL or REFUSED)
+	 * does not get the last word; keep waiting for the others.
+	 */
+	rcode = DNS_FLAG_RCODE ( ntohs ( reply->flags ) );
+	if ( ( rcode != DNS_FLAG_RCODE_OK ) && ( rcode != DNS_FLAG_RCODE_NX ) ) {
+		DBGC ( dns, "DNS %p ignoring reply with RCODE %d\n",
+		       dns, rcode );
+		return 0;
+	}
+
 	/* Stop the retry timer.  After this point, each code path
 	 * must either restart the timer by calling dns_send_packet(),
 	 * or mark the DNS operation as complete by calling
@@ -360,12 +584,23 @@ static int dns_xfer_deliver_raw ( struct xfer_interface *socket,
 	 */
 	stop_timer ( &dns->timer );
 
+	/* The name does not exist; no point in asking for a CNAME */
+	if ( rcode == DNS_FLAG_RCODE_NX ) {
+		DBGC ( dns, "DNS %p name does not exist\n", dns );
+		dns_cache_add ( dns->fqdn, none, dns_negative_ttl ( reply ) );
+		dns_done ( dns, -ENXIO );
+		return 0;
+	}
+
 	/* Search through response for useful answers.  Do this
 	 * multiple times, to take advantage of useful nameservers
 	 * which send us e.g. the CNAME *and* the A record for the
 	 * pointed-to name.
 	 */
 	while ( ( rr_info = dns_find_rr ( dns, reply ) ) ) {
+		ttl = ntohl ( rr_info->common.ttl );
+		if ( ttl < dns->ttl )
+			dns->ttl = ttl;
 		switch ( rr_info->common.type ) {
 
 		case htons ( DNS_TYPE_A ):
@@ -376,6 +611,7 @@ static int dns_xfer_deliver_raw ( struct xfer_interface *socket,
 			sin = ( struct sockaddr_in * ) &dns->sa;
 			sin->sin_family = AF_INET;
 			sin->sin_addr = rr_info->a.in_addr;
+			dns_cache_add ( dns->fqdn, sin->sin_addr, dns->ttl );
 
 			/* Mark operation as complete */
 			dns_done ( dns, 0 );
@@ -431,6 +667,8 @@ static int dns_xfer_deliver_raw ( struct xfer_interface *socket,
 			return 0;
 		} else {
 			DBGC ( dns, "DNS %p found no CNAME record\n", dns );
+			dns_cache_add ( dns->fqdn, none,
+					dns_negative_ttl ( reply ) );
 			dns_done ( dns, -ENXIO );
 			return 0;
 		}
@@ -468,6 +706,19 @@ static struct xfer_interface_operations dns_socket_operations = {
 	.deliver_raw	= dns_xfer_deliver_raw,
 };
 
+/**
+ * Complete a DNS request answered from the cache
+ *
+ * @v process		Process
+ */
+static void dns_cache_step ( struct process *process ) {
+	struct dns_request *dns =
+		container_of ( process, struct dns_request, process );
+
+	process_del ( process );
+	dns_done ( dns, dns->cached_rc );
+}
+
 /**
  * Resolve name using DNS
  *
@@ -479,11 +730,13 @@ static struct xfer_interface_operations dns_socket_operations = {
 static int dns_resolv ( struct resolv_interface *resolv,
 			const char *name, struct sockaddr *sa ) {
 	struct dns_request *dns;
+	struct dns_cache_entry *entry;
+	struct sockaddr_in *sin;
 	char *fqdn;
 	int rc;
 
 	/* Fail immediately if no DNS servers */
-	if ( ! nameserver.st_family ) {
+	if ( ! num_nameservers ) {
 		DBG ( "DNS not attempting to resolve \"%s\": "
 		      "no DNS servers\n", name );
 		rc = -ENXIO;
@@ -503,10 +756,32 @@ static int dns_resolv ( struct resolv_interface *resolv,
 		rc = -ENOMEM;
 		goto err_alloc_dns;
 	}
+	dns->refcnt.free = dns_free;
 	resolv_init ( &dns->resolv, &null_resolv_ops, &dns->refcnt );
 	xfer_init ( &dns->socket, &dns_socket_operations, &dns->refcnt );
 	dns->timer.expired = dns_timer_expired;
 	memcpy ( &dns->sa, sa, sizeof ( dns->sa ) );
+	dns->fqdn = fqdn;
+	dns->ttl = DNS_MAX_TTL;
+
+	/* Answer from the cache if we can */
+	if ( ( entry = dns_cache_find ( fqdn ) ) ) {
+		if ( entry->in_addr.s_addr == INADDR_NONE ) {
+			dns_stats.neg_hits++;
+			dns->cached_rc = -ENXIO;
+		} else {
+			sin = ( struct sockaddr_in * ) &dns->sa;
+			sin->sin_family = AF_INET;
+			sin->sin_addr = entry->in_addr;
+		}
+		dns_stats.hits++;
+		DBGC ( dns, "DNS %p found %s in cache\n", dns, fqdn );
+		process_init ( &dns->process, dns_cache_step, &dns->refcnt );
+		resolv_plug_plug ( &dns->resolv, resolv );
+		ref_put ( &dns->refcnt );
+		return 0;
+	}
+	dns_stats.misses++;
 
 	/* Create query */
 	dns->query.dns.flags = htons ( DNS_FLAG_QUERY | DNS_FLAG_OPCODE_QUERY |
@@ -518,7 +793,7 @@ static int dns_resolv ( struct resolv_interface *resolv,
 
 	/* Open UDP connection */
 	if ( ( rc = xfer_open_socket ( &dns->socket, SOCK_DGRAM,
-				       ( struct sockaddr * ) &nameserver,
+				       ( struct sockaddr * ) &nameservers[0],
 				       NULL ) ) != 0 ) {
 		DBGC ( dns, "DNS %p could not open socket: %s\n",
 		       dns, strerror ( rc ) );
@@ -531,14 +806,14 @@ static int dns_resolv ( struct resolv_interface *resolv,
 	/* Attach parent interface, mortalise self, and return */
 	resolv_plug_plug ( &dns->resolv, resolv );
 	ref_put ( &dns->refcnt );
-	free ( fqdn );
 	return 0;	
 
  err_open_socket:
- err_alloc_dns:
 	ref_put ( &dns->refcnt );
- err_qualify_name:
+	return rc;
+ err_alloc_dns:
 	free ( fqdn );
+ err_qualify_name:
  err_no_nameserver:
 	return rc;
 }
@@ -578,13 +853,23 @@ struct setting domain_setting __setting = {
  * @ret rc		Return status code
  */
 static int apply_dns_settings ( void ) {
-	struct sockaddr_in *sin_nameserver =
-		( struct sockaddr_in * ) &nameserver;
+	struct in_addr addrs[DNS_MAX_SERVERS];
+	struct sockaddr_in *sin_nameserver;
+	unsigned int i;
 	int len;
 
-	if ( ( len = fetch_ipv4_setting ( NULL, &dns_setting,
-					  &sin_nameserver->sin_addr ) ) >= 0 ){
+	num_nameservers = 0;
+	if ( ( len = fetch_setting ( NULL, &dns_setting, addrs,
+				     sizeof ( addrs ) ) ) >= 0 ) {
+		num_nameservers = ( len / sizeof ( addrs[0] ) );
+		if ( num_nameservers > DNS_MAX_SERVERS )
+			num_nameservers = DNS_MAX_SERVERS;
+	}
+	for ( i = 0 ; i < num_nameservers ; i++ ) {
+		sin_nameserver = ( struct sockaddr_in * ) &nameservers[i];
 		sin_nameserver->sin_family = AF_INET;
+		sin_nameserver->sin_port = htons ( DNS_PORT );
+		sin_nameserver->sin_addr = addrs[i];
 		DBG ( "DNS using nameserver %s\n",
 		      inet_ntoa ( sin_nameserver->sin_addr ) );
 	}
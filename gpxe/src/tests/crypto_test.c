@@ -0,0 +1,266 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <gpxe/crypto.h>
+#include <gpxe/aes.h>
+#include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
+#include <gpxe/timer.h>
+
+/*
+ * Known-answer tests and throughput benchmark for the ciphers and
+ * digests used by TLS.
+ *
+ * The AES vectors are from NIST SP 800-38A (F.2.1 and F.2.5), and the
+ * digest vectors are the FIPS 180-2 one- and two-block examples.  The
+ * AES tests go through aes_cbc_algorithm, so they exercise whichever
+ * of the AES-NI or AXTLS paths the CPU ends up using.
+ */
+
+#define CRYPTO_TEST_LEN 16384
+#define CRYPTO_TEST_ITERATIONS 256
+
+struct cipher_test {
+	const char *name;
+	const uint8_t *key;
+	size_t keylen;
+	const uint8_t *iv;
+	const uint8_t *plaintext;
+	const uint8_t *ciphertext;
+	size_t len;
+};
+
+struct digest_test {
+	struct digest_algorithm *digest;
+	const char *data;
+	const uint8_t *expected;
+};
+
+static const uint8_t aes_cbc_iv[16] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+
+static const uint8_t aes_cbc_plaintext[64] = {
+	0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+	0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+	0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+	0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+	0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+	0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+	0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+	0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+
+static const uint8_t aes128_key[16] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static const uint8_t aes128_cbc_ciphertext[64] = {
+	0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+	0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+	0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+	0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+	0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b,
+	0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+	0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09,
+	0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7,
+};
+
+static const uint8_t aes256_key[32] = {
+	0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
+	0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+	0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+	0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4,
+};
+
+static const uint8_t aes256_cbc_ciphertext[64] = {
+	0xf5, 0x8c, 0x4c, 0x04, 0xd6, 0xe5, 0xf1, 0xba,
+	0x77, 0x9e, 0xab, 0xfb, 0x5f, 0x7b, 0xfb, 0xd6,
+	0x9c, 0xfc, 0x4e, 0x96, 0x7e, 0xdb, 0x80, 0x8d,
+	0x67, 0x9f, 0x77, 0x7b, 0xc6, 0x70, 0x2c, 0x7d,
+	0x39, 0xf2, 0x33, 0x69, 0xa9, 0xd9, 0xba, 0xcf,
+	0xa5, 0x30, 0xe2, 0x63, 0x04, 0x23, 0x14, 0x61,
+	0xb2, 0xeb, 0x05, 0xe2, 0xc3, 0x9b, 0xe9, 0xfc,
+	0xda, 0x6c, 0x19, 0x07, 0x8c, 0x6a, 0x9d, 0x1b,
+};
+
+static const uint8_t sha1_abc[20] = {
+	0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+	0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d,
+};
+
+static const uint8_t sha1_two_block[20] = {
+	0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+	0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1,
+};
+
+static const uint8_t sha256_abc[32] = {
+	0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+	0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+	0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+	0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+};
+
+static const uint8_t sha256_two_block[32] = {
+	0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+	0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+	0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+	0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
+};
+
+#define TWO_BLOCK_MESSAGE \
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+
+static struct cipher_test cipher_tests[] = {
+	{ "aes128_cbc", aes128_key, sizeof ( aes128_key ), aes_cbc_iv,
+	  aes_cbc_plaintext, aes128_cbc_ciphertext,
+	  sizeof ( aes_cbc_plaintext ) },
+	{ "aes256_cbc", aes256_key, sizeof ( aes256_key ), aes_cbc_iv,
+	  aes_cbc_plaintext, aes256_cbc_ciphertext,
+	  sizeof ( aes_cbc_plaintext ) },
+};
+
+static struct digest_test digest_tests[] = {
+	{ &sha1_algorithm, "abc", sha1_abc },
+	{ &sha1_algorithm, TWO_BLOCK_MESSAGE, sha1_two_block },
+	{ &sha256_algorithm, "abc", sha256_abc },
+	{ &sha256_algorithm, TWO_BLOCK_MESSAGE, sha256_two_block },
+};
+
+static int test_cipher ( struct cipher_test *test ) {
+	uint8_t ctx[aes_cbc_algorithm.ctxsize];
+	uint8_t buf[test->len];
+	size_t offset;
+
+	/* Encrypt in one call */
+	cipher_setkey ( &aes_cbc_algorithm, ctx, test->key, test->keylen );
+	cipher_setiv ( &aes_cbc_algorithm, ctx, test->iv );
+	cipher_encrypt ( &aes_cbc_algorithm, ctx, test->plaintext, buf,
+			 test->len );
+	if ( memcmp ( buf, test->ciphertext, test->len ) != 0 ) {
+		printf ( "%s encryption failed\n", test->name );
+		return -1;
+	}
+
+	/* Decrypt in place, one block at a time, to check chaining */
+	cipher_setiv ( &aes_cbc_algorithm, ctx, test->iv );
+	for ( offset = 0 ; offset < test->len ; offset += AES_BLOCKSIZE ) {
+		cipher_decrypt ( &aes_cbc_algorithm, ctx, &buf[offset],
+				 &buf[offset], AES_BLOCKSIZE );
+	}
+	if ( memcmp ( buf, test->plaintext, test->len ) != 0 ) {
+		printf ( "%s decryption failed\n", test->name );
+		return -1;
+	}
+
+	return 0;
+}
+
+static int test_digest ( struct digest_test *test ) {
+	struct digest_algorithm *digest = test->digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t out[digest->digestsize];
+	size_t len = strlen ( test->data );
+	size_t split;
+
+	/* Try every split point, to cover the partial-block paths */
+	for ( split = 0 ; split <= len ; split++ ) {
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, test->data, split );
+		digest_update ( digest, ctx, ( test->data + split ),
+				( len - split ) );
+		digest_final ( digest, ctx, out );
+		if ( memcmp ( out, test->expected, sizeof ( out ) ) != 0 ) {
+			printf ( "%s(\"%s\") failed at split %zd\n",
+				 digest->name, test->data, split );
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void report ( const char *name, unsigned long elapsed ) {
+	unsigned long bytes = ( CRYPTO_TEST_LEN * CRYPTO_TEST_ITERATIONS );
+
+	if ( ! elapsed )
+		elapsed = 1;
+	printf ( "%-16s %ld kB/s\n", name,
+		 ( bytes / 1024 * TICKS_PER_SEC / elapsed ) );
+}
+
+static void bench_cipher ( struct cipher_test *test, void *buf ) {
+	uint8_t ctx[aes_cbc_algorithm.ctxsize];
+	unsigned long start;
+	unsigned int i;
+
+	cipher_setkey ( &aes_cbc_algorithm, ctx, test->key, test->keylen );
+	cipher_setiv ( &aes_cbc_algorithm, ctx, test->iv );
+
+	start = currticks();
+	for ( i = 0 ; i < CRYPTO_TEST_ITERATIONS ; i++ ) {
+		cipher_encrypt ( &aes_cbc_algorithm, ctx, buf, buf,
+				 CRYPTO_TEST_LEN );
+	}
+	report ( test->name, ( currticks() - start ) );
+
+	start = currticks();
+	for ( i = 0 ; i < CRYPTO_TEST_ITERATIONS ; i++ ) {
+		cipher_decrypt ( &aes_cbc_algorithm, ctx, buf, buf,
+				 CRYPTO_TEST_LEN );
+	}
+	report ( "(decrypt)", ( currticks() - start ) );
+}
+
+static void bench_digest ( struct digest_algorithm *digest, void *buf ) {
+	uint8_t ctx[digest->ctxsize];
+	uint8_t out[digest->digestsize];
+	unsigned long start;
+	unsigned int i;
+
+	start = currticks();
+	digest_init ( digest, ctx );
+	for ( i = 0 ; i < CRYPTO_TEST_ITERATIONS ; i++ )
+		digest_update ( digest, ctx, buf, CRYPTO_TEST_LEN );
+	digest_final ( digest, ctx, out );
+	report ( digest->name, ( currticks() - start ) );
+}
+
+int crypto_test ( void ) {
+	unsigned int i;
+	void *buf;
+	int rc = 0;
+
+	for ( i = 0 ; i < ( sizeof ( cipher_tests ) /
+			    sizeof ( cipher_tests[0] ) ) ; i++ ) {
+		if ( test_cipher ( &cipher_tests[i] ) != 0 )
+			rc = -1;
+	}
+	for ( i = 0 ; i < ( sizeof ( digest_tests ) /
+			    sizeof ( digest_tests[0] ) ) ; i++ ) {
+		if ( test_digest ( &digest_tests[i] ) != 0 )
+			rc = -1;
+	}
+	if ( rc != 0 )
+		return rc;
+	printf ( "Crypto known-answer tests passed\n" );
+
+	buf = malloc ( CRYPTO_TEST_LEN );
+	if ( ! buf ) {
+		printf ( "Could not allocate benchmark buffer\n" );
+		return -1;
+	}
+	memset ( buf, 0x5a, CRYPTO_TEST_LEN );
+	for ( i = 0 ; i < ( sizeof ( cipher_tests ) /
+			    sizeof ( cipher_tests[0] ) ) ; i++ ) {
+		bench_cipher ( &cipher_tests[i], buf );
+	}
+	bench_digest ( &sha1_algorithm, buf );
+	bench_digest ( &sha256_algorithm, buf );
+	free ( buf );
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/netdevice.h>
+#include <gpxe/timer.h>
+
+/*
+ * Benchmark of the network device receive path.
+ *
+ * A loopback device in the style of nullnet "receives" a burst of
+ * minimum-sized frames on every poll, either one packet at a time via
+ * netdev_rx() or as a single burst via netdev_rx_batch().  We then
+ * drain the RX queue the same way net_step() does, and report the
+ * achieved packets per second for each burst size.
+ */
+
+#define RXBATCH_TEST_PACKETS 200000
+#define RXBATCH_TEST_LEN 60
+
+struct rxbatch_test_priv {
+	/** Packets to hand up per poll */
+	unsigned int burst;
+};
+
+static int rxbatch_test_open ( struct net_device *netdev __unused ) {
+	return 0;
+}
+
+static void rxbatch_test_close ( struct net_device *netdev __unused ) {
+	/* Do nothing */
+}
+
+static int rxbatch_test_transmit ( struct net_device *netdev,
+				   struct io_buffer *iobuf ) {
+	/* Discard */
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+static void rxbatch_test_poll ( struct net_device *netdev ) {
+	struct rxbatch_test_priv *priv = netdev->priv;
+	struct netdev_rx_batch batch;
+	struct io_buffer *iobuf;
+	unsigned int i;
+
+	netdev_rx_batch_init ( &batch );
+	for ( i = 0 ; i < priv->burst ; i++ ) {
+		if ( ! ( iobuf = alloc_iob ( RXBATCH_TEST_LEN ) ) )
+			break;
+		memset ( iob_put ( iobuf, RXBATCH_TEST_LEN ), 0,
+			 RXBATCH_TEST_LEN );
+		if ( priv->burst == 1 ) {
+			netdev_rx ( netdev, iobuf );
+		} else {
+			netdev_rx_batch_add ( &batch, iobuf );
+		}
+	}
+	netdev_rx_batch ( netdev, &batch );
+}
+
+static void rxbatch_test_irq ( struct net_device *netdev __unused,
+			       int enable __unused ) {
+	/* Do nothing */
+}
+
+static struct net_device_operations rxbatch_test_operations = {
+	.open		= rxbatch_test_open,
+	.close		= rxbatch_test_close,
+	.transmit	= rxbatch_test_transmit,
+	.poll		= rxbatch_test_poll,
+	.irq		= rxbatch_test_irq,
+};
+
+static void rxbatch_test_run ( struct net_device *netdev,
+			       unsigned int burst ) {
+	struct rxbatch_test_priv *priv = netdev->priv;
+	struct io_buffer *iobuf;
+	unsigned long start, elapsed;
+	unsigned int received = 0;
+	unsigned int budget;
+
+	priv->burst = burst;
+	start = currticks();
+	while ( received < RXBATCH_TEST_PACKETS ) {
+		netdev_poll ( netdev );
+		for ( budget = NETDEV_RX_BATCH ; budget ; budget-- ) {
+			if ( ! ( iobuf = netdev_rx_dequeue ( netdev ) ) )
+				break;
+			free_iob ( iobuf );
+			received++;
+		}
+	}
+	elapsed = ( currticks() - start );
+	if ( ! elapsed )
+		elapsed = 1;
+
+	printf ( "burst %2d: %d packets in %ld ticks, %ld packets/sec\n",
+		 burst, received, elapsed,
+		 ( ( unsigned long ) received * TICKS_PER_SEC / elapsed ) );
+}
+
+void rxbatch_test ( void ) {
+	struct net_device *netdev;
+	unsigned int burst;
+
+	netdev = alloc_netdev ( sizeof ( struct rxbatch_test_priv ) );
+	if ( ! netdev ) {
+		printf ( "Could not allocate test device\n" );
+		return;
+	}
+	netdev_init ( netdev, &rxbatch_test_operations );
+	netdev->state |= NETDEV_OPEN;
+
+	for ( burst = 1 ; burst <= NETDEV_RX_BATCH ; burst <<= 1 )
+		rxbatch_test_run ( netdev, burst );
+
+	netdev->state &= ~NETDEV_OPEN;
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
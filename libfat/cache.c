@@ -13,53 +13,207 @@
 /*
  * cache.c
  *
- * Simple sector cache
+ * Sector cache: a fixed number of sectors, found through a hash table
+ * and reused least recently used first.  If the caller can read several
+ * sectors at once, a miss in what looks like a sequential read also
+ * reads the sectors following it.
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "libfatint.h"
 
-void *libfat_get_sector(struct libfat_filesystem *fs, libfat_sector_t n)
+#define NO_SECTOR ((libfat_sector_t)-1)
+
+static inline struct libfat_sector **hash_bucket(struct libfat_filesystem *fs,
+						 libfat_sector_t n)
+{
+    return &fs->hash[(unsigned int)n & (LIBFAT_CACHE_HASH - 1)];
+}
+
+static struct libfat_sector *cache_find(struct libfat_filesystem *fs,
+					libfat_sector_t n)
 {
     struct libfat_sector *ls;
 
-    for (ls = fs->sectors; ls; ls = ls->next) {
+    for (ls = *hash_bucket(fs, n); ls; ls = ls->hnext) {
 	if (ls->n == n)
-	    return ls->data;	/* Found in cache */
+	    return ls;
     }
 
-    /* Not found in cache */
-    ls = malloc(sizeof(struct libfat_sector));
-    if (!ls) {
-	libfat_flush(fs);
-	ls = malloc(sizeof(struct libfat_sector));
+    return NULL;
+}
+
+static void cache_unhash(struct libfat_filesystem *fs, struct libfat_sector *ls)
+{
+    struct libfat_sector **lsp;
+
+    if (ls->n == NO_SECTOR)
+	return;
+
+    for (lsp = hash_bucket(fs, ls->n); *lsp != ls; lsp = &(*lsp)->hnext) ;
+    *lsp = ls->hnext;
+    ls->n = NO_SECTOR;
+}
+
+static void lru_remove(struct libfat_filesystem *fs, struct libfat_sector *ls)
+{
+    if (ls->prev)
+	ls->prev->next = ls->next;
+    else
+	fs->lru_first = ls->next;
+
+    if (ls->next)
+	ls->next->prev = ls->prev;
+    else
+	fs->lru_last = ls->prev;
+}
 
-	if (!ls)
-	    return NULL;	/* Can't allocate memory */
+static void lru_add_first(struct libfat_filesystem *fs,
+			  struct libfat_sector *ls)
+{
+    ls->prev = NULL;
+    ls->next = fs->lru_first;
+    if (ls->next)
+	ls->next->prev = ls;
+    else
+	fs->lru_last = ls;
+    fs->lru_first = ls;
+}
+
+static void lru_add_last(struct libfat_filesystem *fs,
+			 struct libfat_sector *ls)
+{
+    ls->next = NULL;
+    ls->prev = fs->lru_last;
+    if (ls->prev)
+	ls->prev->next = ls;
+    else
+	fs->lru_first = ls;
+    fs->lru_last = ls;
+}
+
+/*
+ * Reuse the least recently used entry for sector n, and make it the
+ * most recently used one.
+ */
+static struct libfat_sector *cache_alloc(struct libfat_filesystem *fs,
+					 libfat_sector_t n)
+{
+    struct libfat_sector *ls = fs->lru_last;
+    struct libfat_sector **bucket = hash_bucket(fs, n);
+
+    cache_unhash(fs, ls);
+    lru_remove(fs, ls);
+    lru_add_first(fs, ls);
+
+    ls->n = n;
+    ls->hnext = *bucket;
+    *bucket = ls;
+
+    return ls;
+}
+
+void *libfat_get_sector(struct libfat_filesystem *fs, libfat_sector_t n)
+{
+    struct libfat_sector *ls;
+    unsigned int i, nsec;
+
+    ls = cache_find(fs, n);
+    if (ls) {
+	if (ls != fs->lru_first) {
+	    lru_remove(fs, ls);
+	    lru_add_first(fs, ls);
+	}
+	return ls->data;	/* Found in cache */
+    }
+
+    /*
+     * Not found in cache.  If the sector before it is cached, this
+     * looks like a sequential read, so read ahead, up to the next
+     * cached sector.
+     */
+    nsec = 1;
+    if (fs->readmulti && n && cache_find(fs, n - 1)) {
+	while (nsec < fs->readahead && n + nsec < fs->end &&
+	       !cache_find(fs, n + nsec))
+	    nsec++;
     }
 
+    /*
+     * If the readahead comes up short, e.g. near the end of the device,
+     * fall back to reading just the sector we were asked for.
+     */
+    if (nsec > 1 &&
+	fs->readmulti(fs->readptr, fs->rabuf, LIBFAT_SECTOR_SIZE, n, nsec)
+	== (int)(nsec << LIBFAT_SECTOR_SHIFT)) {
+	/* Backwards, so sector n ends up the most recently used */
+	for (i = nsec; i--;) {
+	    ls = cache_alloc(fs, n + i);
+	    memcpy(ls->data, fs->rabuf + (i << LIBFAT_SECTOR_SHIFT),
+		   LIBFAT_SECTOR_SIZE);
+	}
+	return ls->data;
+    }
+
+    ls = cache_alloc(fs, n);
     if (fs->read(fs->readptr, ls->data, LIBFAT_SECTOR_SIZE, n)
 	!= LIBFAT_SECTOR_SIZE) {
-	free(ls);
-	return NULL;		/* I/O error */
+	/* I/O error; give the entry back */
+	cache_unhash(fs, ls);
+	lru_remove(fs, ls);
+	lru_add_last(fs, ls);
+	return NULL;
     }
 
-    ls->n = n;
-    ls->next = fs->sectors;
-    fs->sectors = ls;
-
     return ls->data;
 }
 
 void libfat_flush(struct libfat_filesystem *fs)
 {
-    struct libfat_sector *ls, *lsnext;
+    struct libfat_sector *ls;
 
-    lsnext = fs->sectors;
-    fs->sectors = NULL;
+    for (ls = fs->lru_first; ls; ls = ls->next)
+	ls->n = NO_SECTOR;
+
+    memset(fs->hash, 0, sizeof fs->hash);
+}
+
+/*
+ * Allocate the cache, as big as memory allows, and the readahead
+ * buffer along with it.  Returns -1 if out of memory.
+ */
+int libfat_cache_init(struct libfat_filesystem *fs)
+{
+    unsigned int nsectors, i;
+
+    for (nsectors = LIBFAT_CACHE_SECTORS;; nsectors >>= 1) {
+	fs->readahead = nsectors / 2;
+	if (fs->readahead > LIBFAT_READAHEAD)
+	    fs->readahead = LIBFAT_READAHEAD;
+
+	fs->sectors = malloc(nsectors * sizeof(struct libfat_sector) +
+			     (fs->readahead << LIBFAT_SECTOR_SHIFT));
+	if (fs->sectors)
+	    break;
+	if (nsectors <= LIBFAT_CACHE_MIN)
+	    return -1;		/* Can't allocate memory */
+    }
+
+    fs->rabuf = (char *)&fs->sectors[nsectors];
 
-    for (ls = lsnext; ls; ls = lsnext) {
-	lsnext = ls->next;
-	free(ls);
+    fs->lru_first = fs->lru_last = NULL;
+    for (i = 0; i < nsectors; i++) {
+	fs->sectors[i].n = NO_SECTOR;
+	lru_add_last(fs, &fs->sectors[i]);
     }
+    memset(fs->hash, 0, sizeof fs->hash);
+
+    return 0;
+}
+
+void libfat_cache_free(struct libfat_filesystem *fs)
+{
+    free(fs->sectors);
+    fs->sectors = NULL;
 }
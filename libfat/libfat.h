@@ -51,6 +51,21 @@ struct libfat_filesystem
 
 void libfat_close(struct libfat_filesystem *);
 
+/*
+ * Optionally, provide a function to read several consecutive sectors
+ * at once, in the format:
+ * int readmultifunc(intptr_t readptr, void *buf, size_t secsize,
+ *                   libfat_sector_t secno, unsigned int nsec)
+ *
+ * A return value of != secsize*nsec is treated as error.  With it,
+ * a cache miss reads ahead, since FAT chains and directories are
+ * mostly read in order.
+ */
+void libfat_set_readmulti(struct libfat_filesystem *fs,
+			  int (*readmultifunc) (intptr_t, void *, size_t,
+						libfat_sector_t,
+						unsigned int));
+
 /*
  * Convert a cluster number (or 0 for the root directory) to a
  * sector number.  Return -1 on failure.
@@ -71,7 +86,8 @@ libfat_sector_t libfat_nextsector(struct libfat_filesystem *fs,
 void libfat_flush(struct libfat_filesystem *fs);
 
 /*
- * Get a pointer to a specific sector.
+ * Get a pointer to a specific sector.  The pointer is only valid
+ * until the next call into libfat.
  */
 void *libfat_get_sector(struct libfat_filesystem *fs, libfat_sector_t n);
 
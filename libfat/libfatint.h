@@ -22,9 +22,16 @@
 #include "libfat.h"
 #include "fat.h"
 
+/* Sector cache parameters */
+#define LIBFAT_CACHE_SECTORS	256	/* Sectors to cache, at most... */
+#define LIBFAT_CACHE_MIN	8	/* ... and at least */
+#define LIBFAT_CACHE_HASH	64	/* Hash buckets, must be a power of 2 */
+#define LIBFAT_READAHEAD	16	/* Sectors to read at once, at most */
+
 struct libfat_sector {
-    libfat_sector_t n;		/* Sector number */
-    struct libfat_sector *next;	/* Next in list */
+    libfat_sector_t n;		/* Sector number, or -1 if unused */
+    struct libfat_sector *hnext;	/* Next in hash chain */
+    struct libfat_sector *prev, *next;	/* LRU list, most recent first */
     char data[LIBFAT_SECTOR_SIZE];
 };
 
@@ -36,6 +43,8 @@ enum fat_type {
 
 struct libfat_filesystem {
     int (*read) (intptr_t, void *, size_t, libfat_sector_t);
+    int (*readmulti) (intptr_t, void *, size_t, libfat_sector_t,
+		      unsigned int);
     intptr_t readptr;
 
     enum fat_type fat_type;
@@ -49,7 +58,15 @@ struct libfat_filesystem {
     libfat_sector_t data;	/* Start of data area */
     libfat_sector_t end;	/* End of filesystem */
 
-    struct libfat_sector *sectors;
+    /* Sector cache */
+    struct libfat_sector *sectors;	/* All the cache entries */
+    struct libfat_sector *lru_first, *lru_last;
+    struct libfat_sector *hash[LIBFAT_CACHE_HASH];
+    unsigned int readahead;	/* Sectors to read ahead, at most */
+    char *rabuf;		/* Buffer for reading ahead */
 };
 
+int libfat_cache_init(struct libfat_filesystem *fs);
+void libfat_cache_free(struct libfat_filesystem *fs);
+
 #endif /* LIBFATINT_H */
@@ -35,9 +35,13 @@ libfat_open(int (*readfunc) (intptr_t, void *, size_t, libfat_sector_t),
     if (!fs)
 	goto barf;
 
-    fs->sectors = NULL;
     fs->read = readfunc;
+    fs->readmulti = NULL;
     fs->readptr = readptr;
+    fs->end = 0;		/* No readahead until we know the size */
+
+    if (libfat_cache_init(fs))
+	goto barf;
 
     bs = libfat_get_sector(fs, 0);
     if (!bs)
@@ -105,13 +109,23 @@ libfat_open(int (*readfunc) (intptr_t, void *, size_t, libfat_sector_t),
     return fs;			/* All good */
 
 barf:
-    if (fs)
+    if (fs) {
+	libfat_cache_free(fs);
 	free(fs);
+    }
     return NULL;
 }
 
+void libfat_set_readmulti(struct libfat_filesystem *fs,
+			  int (*readmultifunc) (intptr_t, void *, size_t,
+						libfat_sector_t,
+						unsigned int))
+{
+    fs->readmulti = readmultifunc;
+}
+
 void libfat_close(struct libfat_filesystem *fs)
 {
-    libfat_flush(fs);
+    libfat_cache_free(fs);
     free(fs);
 }
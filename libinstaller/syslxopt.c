@@ -45,6 +45,8 @@ struct sys_options opt = {
     .activate_partition = 0,
     .force = 0,
     .bootsecfile = NULL,
+    .batch = NULL,
+    .jobs = 0,
 };
 
 const struct option long_options[] = {
@@ -66,6 +68,10 @@ const struct option long_options[] = {
     {"menu-save", 1, NULL, 'M'},
     {"mbr", 0, NULL, 'm'},	/* DOS/Win32 only */
     {"active", 0, NULL, 'a'},	/* DOS/Win32 only */
+#ifdef SYSLXOPT_BATCH
+    {"batch", 1, NULL, OPT_BATCH},
+    {"jobs", 1, NULL, OPT_JOBS},
+#endif
     {0, 0, 0, 0}
 };
 
@@ -77,10 +83,21 @@ void __attribute__ ((noreturn)) usage(int rv, enum syslinux_mode mode)
     case MODE_SYSLINUX:
 	/* For unmounted fs installation (syslinux) */
 	fprintf(stderr,
-	    "Usage: %s [options] device\n"
-	    "  --offset     -t  Offset of the file system on the device \n"
-	    "  --directory  -d  Directory for installation target\n",
+	    "Usage: %s [options] device\n",
+	    program);
+#ifdef SYSLXOPT_BATCH
+	fprintf(stderr,
+	    "       %s [options] --batch=manifest\n",
 	    program);
+#endif
+	fprintf(stderr,
+	    "  --offset     -t  Offset of the file system on the device \n"
+	    "  --directory  -d  Directory for installation target\n");
+#ifdef SYSLXOPT_BATCH
+	fprintf(stderr,
+	    "  --batch=file     Install on each device or image listed in file\n"
+	    "  --jobs=#         Number of batch installs to run at once\n");
+#endif
 	break;
 
     case MODE_EXTLINUX:
@@ -210,6 +227,19 @@ void parse_options(int argc, char *argv[], enum syslinux_mode mode)
 	case 'a':
 	    opt.activate_partition = 1;
 	    break;
+#ifdef SYSLXOPT_BATCH
+	case OPT_BATCH:
+	    opt.batch = optarg;
+	    break;
+	case OPT_JOBS:
+	    opt.jobs = strtoul(optarg, NULL, 0);
+	    if (opt.jobs < 1) {
+		fprintf(stderr, "%s: invalid number of jobs: %s\n",
+			program, optarg);
+		exit(EX_USAGE);
+	    }
+	    break;
+#endif
 	case 'v':
 	    fprintf(stderr,
 		    "%s " VERSION_STR "  Copyright 1994-" YEAR_STR
@@ -224,7 +254,8 @@ void parse_options(int argc, char *argv[], enum syslinux_mode mode)
     switch (mode) {
     case MODE_SYSLINUX:
     case MODE_SYSLINUX_DOSWIN:
-	opt.device = argv[optind++];
+	if (!opt.batch)
+	    opt.device = argv[optind++];
 	break;
     case MODE_EXTLINUX:
 	if (!opt.directory)
@@ -18,12 +18,16 @@ struct sys_options {
     int install_mbr;
     int activate_partition;
     const char *bootsecfile;
+    const char *batch;		/* Only with SYSLXOPT_BATCH */
+    int jobs;
 };
 
 enum long_only_opt {
     OPT_NONE,
     OPT_RESET_ADV,
     OPT_ONCE,
+    OPT_BATCH,
+    OPT_JOBS,
 };
 
 enum syslinux_mode {
@@ -34,8 +34,10 @@
 #define _XOPEN_SOURCE 500	/* For pread() pwrite() */
 #define _FILE_OFFSET_BITS 64
 #include <alloca.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <paths.h>
 #include <stdio.h>
 #include <string.h>
@@ -43,6 +45,7 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/mount.h>
@@ -238,7 +241,57 @@ int modify_existing_adv(const char *path)
     return 0;
 }
 
-int main(int argc, char *argv[])
+/*
+ * In batch mode, rather than sync after each install, sync everything
+ * once at the end.
+ */
+static void batch_sync(void)
+{
+    if (!opt.batch)
+	sync();
+}
+
+/*
+ * In batch mode, write the sectors we patch on the device with
+ * O_DIRECT, so they don't add to what the final sync has to write.
+ * If the device or file doesn't take 512-byte direct writes, fall
+ * back to ordinary ones.
+ */
+static int direct_fd = -1;
+static void *direct_buf;
+
+static void open_direct(const char *device)
+{
+    if (!direct_buf && posix_memalign(&direct_buf, 4096, SECTOR_SIZE))
+	return;
+
+    direct_fd = open(device, O_RDWR | O_DIRECT);
+}
+
+static void close_direct(void)
+{
+    if (direct_fd >= 0) {
+	close(direct_fd);
+	direct_fd = -1;
+    }
+}
+
+static void write_sector(int dev_fd, const void *buf, off_t offset)
+{
+    if (direct_fd >= 0) {
+	memcpy(direct_buf, buf, SECTOR_SIZE);
+	if (pwrite(direct_fd, direct_buf, SECTOR_SIZE, offset) == SECTOR_SIZE)
+	    return;
+	close_direct();
+    }
+
+    xpwrite(dev_fd, buf, SECTOR_SIZE, offset);
+}
+
+/*
+ * Install on opt.device
+ */
+static int install_device(const char *subdir)
 {
     static unsigned char sectbuf[SECTOR_SIZE];
     int dev_fd, fd;
@@ -247,7 +300,6 @@ int main(int argc, char *argv[])
     char mntname[128];
     char *ldlinux_name;
     char *ldlinux_path;
-    char *subdir;
     sector_t *sectors = NULL;
     int ldlinux_sectors = (boot_image_len + SECTOR_SIZE - 1) >> SECTOR_SHIFT;
     const char *errmsg;
@@ -255,28 +307,6 @@ int main(int argc, char *argv[])
     int patch_sectors;
     int i;
 
-    mypid = getpid();
-    umask(077);
-    parse_options(argc, argv, MODE_SYSLINUX);
-
-    /* Note: subdir is guaranteed to start and end in / */
-    if (opt.directory && opt.directory[0]) {
-	int len = strlen(opt.directory);
-	int rv = asprintf(&subdir, "%s%s%s",
-			  opt.directory[0] == '/' ? "" : "/",
-			  opt.directory,
-			  opt.directory[len-1] == '/' ? "" : "/");
-	if (rv < 0 || !subdir) {
-	    perror(program);
-	    exit(1);
-	}
-    } else {
-	subdir = "/";
-    }
-
-    if (!opt.device || opt.install_mbr || opt.activate_partition)
-	usage(EX_USAGE, MODE_SYSLINUX);
-
     /*
      * First make sure we can open the device at all, and that we have
      * read/write permission.
@@ -387,15 +417,15 @@ int main(int argc, char *argv[])
 	if (opt.reset_adv || opt.set_once) {
 	    modify_existing_adv(ldlinux_path);
 	    do_umount(mntpath, mnt_cookie);
-	    sync();
+	    batch_sync();
 	    rmdir(mntpath);
 	    exit(0);
     } else if (opt.update_only && !syslinux_already_installed(dev_fd)) {
         fprintf(stderr, "%s: no previous syslinux boot sector found\n",
-                argv[0]);
+                program);
         exit(1);
 	} else {
-	    fprintf(stderr, "%s: please specify --install or --update for the future\n", argv[0]);
+	    fprintf(stderr, "%s: please specify --install or --update for the future\n", program);
 	    opt.update_only = 0;
 	}
     }
@@ -449,11 +479,11 @@ int main(int argc, char *argv[])
 	exit(1);
     }
     close(fd);
-    sync();
+    batch_sync();
 
 umount:
     do_umount(mntpath, mnt_cookie);
-    sync();
+    batch_sync();
     rmdir(mntpath);
 
     if (err)
@@ -466,12 +496,15 @@ umount:
 		       opt.raid_mode, subdir, NULL);
     patch_sectors = (i + SECTOR_SIZE - 1) >> SECTOR_SHIFT;
 
+    if (opt.batch)
+	open_direct(opt.device);
+
     /*
      * Write the now-patched first sectors of ldlinux.sys
      */
     for (i = 0; i < patch_sectors; i++) {
-	xpwrite(dev_fd, boot_image + i * SECTOR_SIZE, SECTOR_SIZE,
-		opt.offset + ((off_t) sectors[i] << SECTOR_SHIFT));
+	write_sector(dev_fd, boot_image + i * SECTOR_SIZE,
+		     opt.offset + ((off_t) sectors[i] << SECTOR_SHIFT));
     }
 
     /*
@@ -485,12 +518,188 @@ umount:
     syslinux_make_bootsect(sectbuf, fs_type);
 
     /* Write new boot sector */
-    xpwrite(dev_fd, sectbuf, SECTOR_SIZE, opt.offset);
+    write_sector(dev_fd, sectbuf, opt.offset);
 
+    close_direct();
     close(dev_fd);
-    sync();
+    batch_sync();
 
     /* Done! */
 
     return 0;
 }
+
+/*
+ * Batch mode: install on each device or image listed in the file
+ * opt.batch ("-" for stdin), one per line, running up to opt.jobs
+ * installs at once.  Each install runs in a process of its own, since
+ * the installer patches the boot image and the ADV for each target.
+ */
+struct batch_job {
+    pid_t pid;			/* 0 if this slot is free */
+    const char *device;
+    struct timeval start;
+};
+
+static double ms_since(const struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+	(now.tv_usec - start->tv_usec) / 1000.0;
+}
+
+static char **read_manifest(const char *file, int *ntargets)
+{
+    FILE *f;
+    char line[PATH_MAX + 2], *p, *ep;
+    char **targets = NULL;
+    int n = 0, max = 0;
+
+    f = strcmp(file, "-") ? fopen(file, "r") : stdin;
+    if (!f) {
+	perror(file);
+	exit(1);
+    }
+
+    while (fgets(line, sizeof line, f)) {
+	p = line + strspn(line, " \t");
+	ep = strchr(p, '\0');
+	while (ep > p && isspace((unsigned char)ep[-1]))
+	    *--ep = '\0';
+	if (!*p || *p == '#')
+	    continue;
+
+	if (n >= max) {
+	    max = max ? max * 2 : 64;
+	    targets = realloc(targets, max * sizeof *targets);
+	    if (!targets)
+		die("out of memory");
+	}
+	targets[n] = strdup(p);
+	if (!targets[n])
+	    die("out of memory");
+	n++;
+    }
+
+    if (f != stdin)
+	fclose(f);
+
+    *ntargets = n;
+    return targets;
+}
+
+static int batch_install(const char *subdir)
+{
+    char **targets;
+    struct batch_job *jobs;
+    int ntargets, njobs, next = 0, running = 0, failed = 0;
+    int i, status, ok;
+    struct timeval start;
+    double total;
+    pid_t pid;
+
+    targets = read_manifest(opt.batch, &ntargets);
+    if (!ntargets)
+	die("no targets in batch file");
+
+    njobs = opt.jobs ? opt.jobs : sysconf(_SC_NPROCESSORS_ONLN);
+    if (njobs < 1)
+	njobs = 1;
+    if (njobs > ntargets)
+	njobs = ntargets;
+
+    jobs = calloc(njobs, sizeof *jobs);
+    if (!jobs)
+	die("out of memory");
+
+    gettimeofday(&start, NULL);
+
+    while (next < ntargets || running) {
+	while (next < ntargets && running < njobs) {
+	    for (i = 0; jobs[i].pid; i++) ;
+
+	    jobs[i].device = targets[next++];
+	    gettimeofday(&jobs[i].start, NULL);
+
+	    fflush(NULL);
+	    pid = fork();
+	    if (pid < 0) {
+		die("cannot fork");
+	    } else if (pid == 0) {
+		mypid = getpid();
+		opt.device = jobs[i].device;
+		exit(install_device(subdir));
+	    }
+
+	    jobs[i].pid = pid;
+	    running++;
+	}
+
+	pid = wait(&status);
+	if (pid < 0) {
+	    if (errno == EINTR)
+		continue;
+	    die("wait failed");
+	}
+
+	for (i = 0; i < njobs; i++) {
+	    if (jobs[i].pid == pid)
+		break;
+	}
+	if (i >= njobs)
+	    continue;
+
+	ok = WIFEXITED(status) && !WEXITSTATUS(status);
+	if (!ok)
+	    failed++;
+	printf("%s: %s, %.1f ms\n", jobs[i].device,
+	       ok ? "ok" : "FAILED", ms_since(&jobs[i].start));
+
+	jobs[i].pid = 0;
+	running--;
+    }
+
+    total = ms_since(&start);
+    sync();
+
+    printf("%d targets, %d failed, %d at once: %.1f ms, "
+	   "final sync %.1f ms\n", ntargets, failed, njobs, total,
+	   ms_since(&start) - total);
+
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char *subdir;
+
+    mypid = getpid();
+    umask(077);
+    parse_options(argc, argv, MODE_SYSLINUX);
+
+    /* Note: subdir is guaranteed to start and end in / */
+    if (opt.directory && opt.directory[0]) {
+	int len = strlen(opt.directory);
+	int rv = asprintf(&subdir, "%s%s%s",
+			  opt.directory[0] == '/' ? "" : "/",
+			  opt.directory,
+			  opt.directory[len-1] == '/' ? "" : "/");
+	if (rv < 0 || !subdir) {
+	    perror(program);
+	    exit(1);
+	}
+    } else {
+	subdir = "/";
+    }
+
+    if ((!opt.device && !opt.batch) || opt.install_mbr ||
+	opt.activate_partition)
+	usage(EX_USAGE, MODE_SYSLINUX);
+
+    if (opt.batch)
+	return batch_install(subdir);
+
+    return install_device(subdir);
+}
@@ -0,0 +1,263 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * blkimg.c
+ *
+ * Installer side of block-mapped images (see blkimg.h.)  The image
+ * stays in memory the way it was loaded; we only turn the map offsets
+ * into linear addresses and set aside room for the decompressed-block
+ * cache and the write pool.  The actual decoding is done on demand by
+ * the INT 13h handler.
+ */
+
+#include <stdint.h>
+#include "e820.h"
+#include "conio.h"
+#include "memdisk.h"
+#include "blkimg.h"
+
+/* Pull in structures common to MEMDISK and MDISKCHK.COM */
+#include "mstructs.h"
+
+extern const char _end[];		/* Symbol signalling end of data */
+
+#define BLKIMG_ALIGN	4096
+
+/* Buffer holding the decoded start of the disk, for the geometry probe */
+static uint8_t probe_buf[BLKIMG_PROBE_SIZE];
+
+/*
+ * Decode an LZ4 block.  Returns the number of bytes produced, or -1 if
+ * the data is corrupt or would overrun the output buffer.
+ */
+static int lz4_decode(const uint8_t *src, uint32_t srclen,
+		      uint8_t *dst, uint32_t dstlen)
+{
+    const uint8_t *ip = src, *iend = src + srclen;
+    uint8_t *op = dst, *oend = dst + dstlen;
+    const uint8_t *ref;
+    uint32_t len;
+    uint8_t token, c;
+
+    while (ip < iend) {
+	token = *ip++;
+
+	len = token >> 4;
+	if (len == 15) {
+	    do {
+		if (ip >= iend)
+		    return -1;
+		c = *ip++;
+		len += c;
+	    } while (c == 255);
+	}
+	if (len > (uint32_t)(iend - ip) || len > (uint32_t)(oend - op))
+	    return -1;
+	memcpy(op, ip, len);
+	op += len;
+	ip += len;
+
+	if (ip >= iend)
+	    break;		/* Last sequence has no match */
+
+	if (iend - ip < 2)
+	    return -1;
+	ref = op - (ip[0] + (ip[1] << 8));
+	ip += 2;
+	if (ref < dst || ref == op)
+	    return -1;
+
+	len = token & 15;
+	if (len == 15) {
+	    do {
+		if (ip >= iend)
+		    return -1;
+		c = *ip++;
+		len += c;
+	    } while (c == 255);
+	}
+	len += 4;
+	if (len > (uint32_t)(oend - op))
+	    return -1;
+	while (len--)
+	    *op++ = *ref++;	/* Overlapping copy is intentional */
+    }
+
+    return op - dst;
+}
+
+/*
+ * Check to see if this is a block-mapped image, and sanity-check
+ * the header if so.
+ */
+const struct blkimg_header *blkimg_check(uint32_t where, uint32_t size)
+{
+    const struct blkimg_header *hdr = (const struct blkimg_header *)where;
+    uint64_t nblocks;
+
+    if (size < sizeof *hdr || hdr->magic != BLKIMG_MAGIC)
+	return NULL;
+
+    if (hdr->version != BLKIMG_VERSION)
+	die("MEMDISK: unsupported block image version %u\n", hdr->version);
+
+    if (hdr->block_shift < BLKIMG_MIN_SHIFT ||
+	hdr->block_shift > BLKIMG_MAX_SHIFT || hdr->flags)
+	die("MEMDISK: invalid block image header\n");
+
+    if (!hdr->disk_size || hdr->disk_size > 0xFFFFFFFF)
+	die("MEMDISK: block image disk size not supported\n");
+
+    nblocks = (hdr->disk_size + (1 << hdr->block_shift) - 1)
+	>> hdr->block_shift;
+    if (hdr->nblocks != nblocks ||
+	(uint64_t)hdr->map_offset + nblocks * sizeof(struct blkimg_entry)
+	> size)
+	die("MEMDISK: block image map is truncated\n");
+
+    return hdr;
+}
+
+/*
+ * Decode the start of the disk into a flat buffer, so the geometry
+ * probe and the boot sector loader can look at it.  Returns the
+ * address of the buffer, which holds BLKIMG_PROBE_SIZE bytes.
+ */
+uint32_t blkimg_probe(const struct blkimg_header *hdr, uint32_t where)
+{
+    const struct blkimg_entry *map =
+	(const struct blkimg_entry *)(where + hdr->map_offset);
+    uint32_t bsize = 1 << hdr->block_shift;
+    uint32_t block, nblocks;
+    uint8_t *p = probe_buf;
+
+    /* BLKIMG_PROBE_SIZE is a multiple of any legal block size */
+    nblocks = BLKIMG_PROBE_SIZE >> hdr->block_shift;
+    if (nblocks > hdr->nblocks)
+	nblocks = hdr->nblocks;
+
+    memset(probe_buf, 0, sizeof probe_buf);
+
+    for (block = 0; block < nblocks; block++) {
+	if (!map[block].offset)
+	    ;			/* All zero */
+	else if (!map[block].length)
+	    memcpy(p, (const void *)(where + map[block].offset), bsize);
+	else if (lz4_decode((const uint8_t *)(where + map[block].offset),
+			    map[block].length, p, bsize) != (int)bsize)
+	    die("MEMDISK: block image data is corrupt (block %u)\n", block);
+	p += bsize;
+    }
+
+    return (uint32_t)probe_buf;
+}
+
+/*
+ * Reserve a chunk of high memory, as high as possible.  Returns 0 if
+ * there is no room.
+ */
+uint32_t reserve_highmem(uint32_t len)
+{
+    uint32_t startrange, endrange, where;
+    int i;
+
+    for (i = nranges - 1; i >= 0; i--) {
+	/* Must be memory, below 4 GB */
+	if (ranges[i].type != 1 || ranges[i].start >= 0xFFFFFFFF)
+	    continue;
+
+	startrange = (uint32_t) ranges[i].start;
+
+	/* Range end (0 for end means 2^64) */
+	endrange = ((ranges[i + 1].start >= 0xFFFFFFFF ||
+		     ranges[i + 1].start == 0)
+		    ? 0xFFFFFFFF : (uint32_t) ranges[i + 1].start);
+
+	/* Make sure we don't overwrite ourselves */
+	if (startrange < (uint32_t) _end)
+	    startrange = (uint32_t) _end;
+
+	if (startrange >= endrange || endrange - startrange < len)
+	    continue;
+
+	where = (endrange - len) & ~(BLKIMG_ALIGN - 1);
+	if (where < startrange)
+	    continue;
+
+	insertrange(where, len, 2);
+	parse_mem();
+	return where;
+    }
+
+    return 0;
+}
+
+/*
+ * Set up the patch area for a block-mapped image: convert the block
+ * map to linear addresses and allocate the decompressed-block cache
+ * and the write pool.  Returns nonzero if the disk can be written to.
+ */
+int blkimg_setup(const struct blkimg_header *hdr, uint32_t where,
+		 uint32_t size, unsigned int cachecnt, uint32_t poolsize,
+		 struct patch_area *pptr)
+{
+    struct blkimg_entry *map = (struct blkimg_entry *)(where + hdr->map_offset);
+    uint32_t bsize = 1 << hdr->block_shift;
+    uint32_t block, len, nzero = 0, nzip = 0;
+
+    for (block = 0; block < hdr->nblocks; block++) {
+	if (!map[block].offset && !map[block].length) {
+	    nzero++;		/* All zero, takes no memory */
+	    continue;
+	}
+	if (map[block].length)
+	    nzip++;
+	len = map[block].length ? map[block].length : bsize;
+	if (map[block].length >= bsize || map[block].offset < sizeof *hdr ||
+	    map[block].offset > size || size - map[block].offset < len)
+	    die("MEMDISK: block image map is corrupt (block %u)\n", block);
+	map[block].offset += where;
+    }
+
+    if (cachecnt < 1)
+	cachecnt = 1;
+    if (cachecnt > BLKIMG_MAX_CACHE)
+	cachecnt = BLKIMG_MAX_CACHE;
+
+    pptr->blkmap = (uint32_t)map;
+    pptr->blkshift = hdr->block_shift;
+    pptr->blkcachecnt = cachecnt;
+    pptr->blkcache = reserve_highmem(cachecnt << hdr->block_shift);
+    pptr->blkzero = reserve_highmem(bsize);
+    if (!pptr->blkcache || !pptr->blkzero)
+	die("MEMDISK: not enough memory for the block cache\n");
+    memset((void *)pptr->blkzero, 0, bsize);
+
+    printf("Block image: %u blocks of %u bytes (%u compressed, %u zero), "
+	   "cache %uK at 0x%08x\n", hdr->nblocks, bsize, nzip, nzero,
+	   (cachecnt << hdr->block_shift) >> 10, pptr->blkcache);
+
+    poolsize = (poolsize + bsize - 1) & ~(bsize - 1);
+    if (poolsize) {
+	pptr->blkpool = reserve_highmem(poolsize);
+	if (!pptr->blkpool)
+	    die("MEMDISK: not enough memory for a %uK write pool\n",
+		poolsize >> 10);
+	pptr->blkpoolend = pptr->blkpool + poolsize;
+	printf("Block write pool %uK at 0x%08x\n", poolsize >> 10,
+	       pptr->blkpool);
+    }
+
+    /* Blocks which are not stored as-is need the pool to be written */
+    return poolsize || !(nzero + nzip);
+}
@@ -0,0 +1,64 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * blkimg.h
+ *
+ * Format of a MEMDISK block-mapped image.  This is shared between
+ * MEMDISK and the host-side utilities which generate such images.
+ *
+ * The image is a header, followed by a block map, followed by the
+ * block data.  The virtual disk is divided into blocks of
+ * (1 << block_shift) bytes, each of which has one map entry.  A block
+ * is all zero (an entry of 0, 0), stored as-is (length == 0) or
+ * compressed in the LZ4 block format, so each block can be decoded
+ * independently of the others.  All fields are little endian.
+ */
+
+#ifndef MEMDISK_BLKIMG_H
+#define MEMDISK_BLKIMG_H
+
+#include <stdint.h>
+
+#define BLKIMG_MAGIC		0x4b42444d	/* "MDBK" */
+#define BLKIMG_VERSION		1
+
+#define BLKIMG_MIN_SHIFT	9
+#define BLKIMG_MAX_SHIFT	14	/* Decoder buffers must fit in 64K */
+#define BLKIMG_DEF_SHIFT	13
+
+/* MEMDISK implementation limits */
+#define BLKIMG_PROBE_SIZE	(1 << BLKIMG_MAX_SHIFT)	/* Decoded for probing */
+#define BLKIMG_DEF_CACHE	16	/* Default decompressed-block cache */
+#define BLKIMG_MAX_CACHE	32	/* Must match BLK_MAX_CACHE in memdisk.inc */
+
+struct blkimg_header {
+    uint32_t magic;		/* BLKIMG_MAGIC */
+    uint16_t version;		/* BLKIMG_VERSION */
+    uint8_t block_shift;	/* log2(block size) */
+    uint8_t flags;		/* Reserved, must be zero */
+    uint32_t map_offset;	/* Byte offset of the block map */
+    uint32_t nblocks;		/* Number of map entries */
+    uint64_t disk_size;		/* Size of the virtual disk in bytes */
+    uint32_t reserved[2];
+};
+
+/*
+ * An entry of 0, 0 is an all-zero block with no data; MEMDISK maps it
+ * to a shared block of zeroes (address 0 in its runtime block table).
+ */
+struct blkimg_entry {
+    uint32_t offset;		/* Byte offset of the block data, 0 = zero */
+    uint32_t length;		/* Compressed length, 0 = stored as-is */
+};
+
+#endif /* MEMDISK_BLKIMG_H */
@@ -128,10 +128,23 @@ static inline void cli(void)
 }
 
 /* Decompression */
-extern int check_zip(void *indata, uint32_t size, uint32_t * zbytes_p,
-		     uint32_t * dbytes_p, uint32_t * orig_crc,
-		     uint32_t * offset_p);
-extern void *unzip(void *indata, uint32_t zbytes, uint32_t dbytes,
-		   uint32_t orig_crc, void *target);
+#include "unzip.h"
+
+/* Block-mapped images */
+struct blkimg_header;
+struct patch_area;
+extern const struct blkimg_header *blkimg_check(uint32_t where, uint32_t size);
+extern uint32_t blkimg_probe(const struct blkimg_header *hdr, uint32_t where);
+extern int blkimg_setup(const struct blkimg_header *hdr, uint32_t where,
+			uint32_t size, unsigned int cachecnt,
+			uint32_t poolsize, struct patch_area *pptr);
+extern uint32_t reserve_highmem(uint32_t len);
+
+/* Copy-on-write overlay; the low memory layout must match memdisk.inc */
+#define OVL_FILTER_BITS	16384
+#define OVL_GROUP	8
+#define OVL_LOWMEM	(OVL_FILTER_BITS/8 + OVL_GROUP*8 + 8)
+extern void overlay_setup(uint32_t size, unsigned int sector_shift,
+			  struct patch_area *pptr);
 
 #endif
@@ -172,6 +172,24 @@ struct patch_area {
     uint16_t mystack;
     uint16_t statusptr;
 
+    /* Block-mapped images only (see blkimg.h) */
+    uint32_t blkmap;		/* Linear address of block map, 0 if flat */
+    uint32_t blkcache;		/* Linear address of decoded-block cache */
+    uint16_t blkbufseg;		/* Segment of the decoder buffers */
+    uint8_t blkshift;		/* log2(block size) */
+    uint8_t blkcachecnt;	/* Number of decoded-block cache slots */
+    uint32_t blkzero;		/* Linear address of a block of zeroes */
+    uint32_t blkpool;		/* Next free block in the write pool */
+    uint32_t blkpoolend;	/* End of the write pool */
+
+    /* Copy-on-write overlay only */
+    uint32_t ovltable;		/* Linear address of hash table, 0 if none */
+    uint32_t ovlmask;		/* Hash table entries - 1 */
+    uint32_t ovlnext;		/* Next free overlay sector */
+    uint32_t ovlend;		/* End of the overlay sectors */
+    uint16_t ovlseg;		/* Segment of the overlay bitmap */
+    uint16_t _pad4;		/* Pad to DWORD */
+
     dpt_t dpt;
     struct edd_dpt edd_dpt;
     struct edd4_cd_pkt cd_pkt;	/* Only really in a memdisk_iso_* hook */
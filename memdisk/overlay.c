@@ -0,0 +1,66 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * overlay.c
+ *
+ * Installer side of the copy-on-write overlay.  With an overlay, the
+ * disk image itself is never written: each sector written is stored
+ * in a separate pool of sectors instead, and looked up through a hash
+ * table by the INT 13h handler.  This lets many boots share one
+ * read-only (possibly compressed) base image, with only the sectors
+ * which actually get written taking extra memory.
+ */
+
+#include <stdint.h>
+#include "e820.h"
+#include "conio.h"
+#include "memdisk.h"
+
+/* Pull in structures common to MEMDISK and MDISKCHK.COM */
+#include "mstructs.h"
+
+/*
+ * Allocate an overlay of size bytes worth of sectors, and a hash table
+ * with at least twice as many entries, so lookups stay short and the
+ * table can never fill up.  The low memory part (the bitmap of written
+ * sectors) is set up later, together with the rest of low memory.
+ */
+void overlay_setup(uint32_t size, unsigned int sector_shift,
+		   struct patch_area *pptr)
+{
+    uint32_t nsect = size >> sector_shift;
+    uint32_t entries = OVL_GROUP;
+    uint32_t tablesize;
+
+    if (!nsect)
+	return;
+    if (nsect > (1 << 24))
+	nsect = 1 << 24;	/* Keeps the table size below 4 GB */
+
+    while (entries < 2 * nsect)
+	entries <<= 1;
+    tablesize = entries * 8;	/* dd sector+1, dd address */
+
+    pptr->ovltable = reserve_highmem(tablesize);
+    pptr->ovlnext = reserve_highmem(nsect << sector_shift);
+    if (!pptr->ovltable || !pptr->ovlnext)
+	die("MEMDISK: not enough memory for a %uK overlay\n",
+	    (nsect << sector_shift) >> 10);
+
+    memset((void *)pptr->ovltable, 0, tablesize);
+    pptr->ovlmask = entries - 1;
+    pptr->ovlend = pptr->ovlnext + (nsect << sector_shift);
+
+    printf("Overlay: %u sectors at 0x%08x, table %uK at 0x%08x\n",
+	   nsect, pptr->ovlnext, tablesize >> 10, pptr->ovltable);
+}
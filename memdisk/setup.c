@@ -22,6 +22,7 @@
 #include "conio.h"
 #include "version.h"
 #include "memdisk.h"
+#include "blkimg.h"
 #include "../version.h"
 
 const char memdisk_version[] = "MEMDISK " VERSION_STR " " DATE;
@@ -117,7 +118,7 @@ static const char *getcmditem(const char *what)
 }
 
 /*
- * Check to see if this is a gzip image
+ * Check to see if this is a compressed (gzip, zip, xz or lzop) image
  */
 #define UNZIP_ALIGN 512
 
@@ -127,18 +128,22 @@ void unzip_if_needed(uint32_t * where_p, uint32_t * size_p)
 {
     uint32_t where = *where_p;
     uint32_t size = *size_p;
-    uint32_t zbytes;
+    struct zimage zi;
     uint32_t startrange, endrange;
     uint32_t gzdatasize, gzwhere;
-    uint32_t orig_crc, offset;
     uint32_t target = 0;
     int i, okmem;
+    static const char *const zformats[] = {
+	[ZFMT_GZIP] = "gzip",
+	[ZFMT_XZ] = "xz",
+	[ZFMT_LZO] = "lzop",
+    };
 
-    /* Is it a gzip image? */
-    if (check_zip((void *)where, size, &zbytes, &gzdatasize,
-		  &orig_crc, &offset) == 0) {
+    /* Is it a compressed image? */
+    if (check_zip((void *)where, size, &zi) == 0) {
+	gzdatasize = zi.dbytes;
 
-	if (offset + zbytes > size) {
+	if (zi.offset > size || zi.zbytes > size - zi.offset) {
 	    /*
 	     * Assertion failure; check_zip is supposed to guarantee this
 	     * never happens.
@@ -225,12 +230,12 @@ void unzip_if_needed(uint32_t * where_p, uint32_t * size_p)
 	    die("Not enough memory to decompress image (need 0x%08x bytes)\n",
 		gzdatasize);
 
-	printf("gzip image: decompressed addr 0x%08x, len 0x%08x: ",
-	       target, gzdatasize);
+	printf("%s image: decompressed addr 0x%08x, len 0x%08x: ",
+	       zformats[zi.format], target, gzdatasize);
 
 	*size_p = gzdatasize;
-	*where_p = (uint32_t) unzip((void *)(where + offset), zbytes,
-				    gzdatasize, orig_crc, (void *)target);
+	*where_p = (uint32_t) unzip((void *)where, &zi, (void *)target);
+	puts("ok\n");
     }
 }
 
@@ -766,6 +771,11 @@ void setup(const struct real_mode_args *rm_args_ptr)
     const struct edd4_bootcat *boot_cat = 0;
     com32sys_t regs;
     uint32_t ramdisk_image, ramdisk_size;
+    uint32_t image_base, image_size;
+    const struct blkimg_header *blkimg;
+    unsigned int blkbuf_len = 0, ovlbuf_len = 0;
+    uint32_t bufseg;
+    int writable = 1;
     uint32_t boot_base, rm_base;
     int bios_drives;
     int do_edd = 1;		/* 0 = no, 1 = yes, default is yes */
@@ -796,7 +806,22 @@ void setup(const struct real_mode_args *rm_args_ptr)
 
     unzip_if_needed(&ramdisk_image, &ramdisk_size);
 
-    geometry = get_disk_image_geometry(ramdisk_image, ramdisk_size);
+    /* A block-mapped image is probed via a decoded copy of its start */
+    blkimg = blkimg_check(ramdisk_image, ramdisk_size);
+    if (blkimg) {
+	if (getcmditem("iso") != CMD_NOTFOUND)
+	    die("MEMDISK: iso is not supported with block-mapped images\n");
+	image_base = blkimg_probe(blkimg, ramdisk_image);
+	image_size = blkimg->disk_size;
+    } else {
+	image_base = ramdisk_image;
+	image_size = ramdisk_size;
+    }
+
+    geometry = get_disk_image_geometry(image_base, image_size);
+
+    if (blkimg && geometry->offset > BLKIMG_PROBE_SIZE - 512)
+	die("MEMDISK: offset too large for a block-mapped image\n");
 
     if (getcmditem("edd") != CMD_NOTFOUND ||
 	getcmditem("ebios") != CMD_NOTFOUND)
@@ -853,7 +878,9 @@ void setup(const struct real_mode_args *rm_args_ptr)
     pptr->heads = geometry->h;
     pptr->sectors = geometry->s;
     pptr->mdi.disksize = geometry->sectors;
-    pptr->mdi.diskbuf = ramdisk_image + geometry->offset;
+    /* For a block-mapped image, there is no flat copy in memory */
+    pptr->mdi.diskbuf = blkimg ? geometry->offset
+	: ramdisk_image + geometry->offset;
     pptr->mdi.sector_shift = geometry->sector_shift;
     pptr->statusptr = (geometry->driveno & 0x80) ? 0x474 : 0x441;
 
@@ -881,6 +908,28 @@ void setup(const struct real_mode_args *rm_args_ptr)
 	pptr->configflags |= CONFIG_SAFEINT;
     }
 
+    if (blkimg) {
+	unsigned int cachecnt = BLKIMG_DEF_CACHE;
+	uint32_t poolsize = 0;
+
+	if (CMD_HASDATA(p = getcmditem("blkcache")))
+	    cachecnt = atou(p);
+	if (CMD_HASDATA(p = getcmditem("blkpool")))
+	    poolsize = min(suffix_number(p), UINT32_MAX);
+	writable = blkimg_setup(blkimg, ramdisk_image, ramdisk_size,
+				cachecnt, poolsize, pptr);
+    }
+
+    if (CMD_HASDATA(p = getcmditem("overlay"))) {
+	overlay_setup(min(suffix_number(p), UINT32_MAX),
+		      geometry->sector_shift, pptr);
+	if (pptr->ovltable)
+	    writable = 1;	/* Writes never reach the image itself */
+    }
+
+    if (!writable)
+	pptr->configflags |= CONFIG_READONLY;
+
     printf("Disk is %s%d, %u%s K, C/H/S = %u/%u/%u (%s/%s), EDD %s, %s\n",
 	   (geometry->driveno & 0x80) ? "hd" : "fd",
 	   geometry->driveno & 0x7f,
@@ -959,7 +1008,9 @@ void setup(const struct real_mode_args *rm_args_ptr)
 	    pptr->edd_dpt.flags |= 0x0014;
 	}
 
-	pptr->edd_dpt.devpath[0] = pptr->mdi.diskbuf;
+	/* A block-mapped image has no flat copy for this to point to */
+	if (!blkimg)
+	    pptr->edd_dpt.devpath[0] = pptr->mdi.diskbuf;
 	pptr->edd_dpt.chksum = -checksum_buf(&pptr->edd_dpt.dpikey, 73 - 30);
     }
 
@@ -993,9 +1044,24 @@ void setup(const struct real_mode_args *rm_args_ptr)
     cmdline_len = strlen(shdr->cmdline) + 1;
     total_size += cmdline_len;		/* Command line */
     stack_len = stack_needed();
+    if (blkimg || pptr->ovltable)
+	stack_len += 256;	/* The block decoder and overlay nest deeper */
     total_size += stack_len;		/* Stack */
+    if (blkimg) {
+	/* Cache tags, decoder input and output buffers, paragraph aligned */
+	blkbuf_len = BLKIMG_MAX_CACHE * 8 + (2 << pptr->blkshift) + 15;
+	total_size += blkbuf_len;
+    }
+    if (pptr->ovltable) {
+	ovlbuf_len = OVL_LOWMEM + 15;
+	total_size += ovlbuf_len;
+    }
     printf("Code %u, meminfo %u, cmdline %u, stack %u\n",
 	   hptr->total_size, e820_len, cmdline_len, stack_len);
+    if (blkbuf_len)
+	printf("Block decoder buffers %u\n", blkbuf_len);
+    if (ovlbuf_len)
+	printf("Overlay buffers %u\n", ovlbuf_len);
     printf("Total size needed = %u bytes, allocating %uK\n",
 	   total_size, (total_size + 0x3ff) >> 10);
 
@@ -1032,6 +1098,15 @@ void setup(const struct real_mode_args *rm_args_ptr)
     /* Anything beyond the end is for the stack */
     pptr->mystack = (uint16_t) (stddosmem - driveraddr);
 
+    /* The block decoder and overlay buffers go after the command line */
+    bufseg = driverseg + ((bin_size + e820_len + cmdline_len + 15) >> 4);
+    if (blkbuf_len) {
+	pptr->blkbufseg = bufseg;
+	bufseg += blkbuf_len >> 4;
+    }
+    if (ovlbuf_len)
+	pptr->ovlseg = bufseg;
+
     pptr->mdi.oldint13.uint32 = rdz_32(BIOS_INT13);
     pptr->mdi.oldint15.uint32 = rdz_32(BIOS_INT15);
 
@@ -1129,6 +1204,14 @@ void setup(const struct real_mode_args *rm_args_ptr)
 	dpp = mempcpy(dpp, shdr->cmdline, cmdline_len);
     }
 
+    /* Start out with an empty block cache */
+    if (blkbuf_len)
+	memset((void *)(pptr->blkbufseg << 4), 0, BLKIMG_MAX_CACHE * 8);
+
+    /* ... and an empty overlay */
+    if (ovlbuf_len)
+	memset((void *)(pptr->ovlseg << 4), 0, OVL_LOWMEM);
+
     /* Note the previous INT 13h hook in the "safe hook" structure */
     hptr->safe_hook.old_hook.uint32 = pptr->mdi.oldint13.uint32;
 
@@ -1212,7 +1295,7 @@ void setup(const struct real_mode_args *rm_args_ptr)
     puts("Loading boot sector... ");
 
     memcpy((void *)boot_base,
-	   (char *)pptr->mdi.diskbuf + geometry->boot_lba * 512,
+	   (char *)image_base + geometry->offset + geometry->boot_lba * 512,
 	   boot_len);
 
     if (getcmditem("pause") != CMD_NOTFOUND) {
@@ -0,0 +1,234 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * unlzo.c
+ *
+ * Decoder for lzop images, using the LZO1X decompressor from the LZO
+ * library in lzo/.  Each lzop block is decompressed straight into its
+ * final place in the output.
+ */
+
+#include <stdint.h>
+#ifdef TEST
+# include <string.h>
+# include <stdio.h>
+extern void __attribute__ ((noreturn)) die(const char *, ...);
+#else
+# include "memdisk.h"
+# include "conio.h"
+#endif
+#include "unzip.h"
+#include "zlib.h"		/* For crc32() and adler32() */
+#include <lzo/lzo1x.h>
+
+static void __attribute__ ((noreturn)) error(const char *x)
+{
+    die("failed\nDecompression error: %s\n", x);
+}
+
+static const uint8_t lzop_magic[9] = {
+    0x89, 'L', 'Z', 'O', 0x00, 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+/* Header flags */
+#define F_ADLER32_D	0x00000001
+#define F_ADLER32_C	0x00000002
+#define F_H_EXTRA_FIELD	0x00000040
+#define F_CRC32_D	0x00000100
+#define F_CRC32_C	0x00000200
+#define F_MULTIPART	0x00000400
+#define F_H_FILTER	0x00000800
+#define F_H_CRC32	0x00001000
+
+/* Methods, all of which are LZO1X */
+#define M_LZO1X_1	1
+#define M_LZO1X_1_15	2
+#define M_LZO1X_999	3
+
+#define LZOP_MAX_BLOCK	(64 << 20)
+
+static inline uint32_t get_be16(const uint8_t *p)
+{
+    return (p[0] << 8) + p[1];
+}
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+}
+
+/*
+ * Parse the lzop file header.  Returns its length, or 0 if this is not
+ * an lzop file we can handle.
+ */
+static uint32_t lzop_header(const uint8_t *p, uint32_t size, uint32_t *flagsp)
+{
+    const uint8_t *ip = p + sizeof lzop_magic, *end = p + size;
+    uint32_t version, flags, hcheck, len;
+    unsigned int method;
+
+    if (size < sizeof lzop_magic + 34 ||
+	memcmp(p, lzop_magic, sizeof lzop_magic))
+	return 0;
+
+    version = get_be16(ip);
+    ip += 4;			/* Version, library version */
+    if (version >= 0x0940)
+	ip += 2;		/* Version needed to extract */
+    method = *ip++;
+    if (version >= 0x0940)
+	ip++;			/* Level */
+    flags = get_be32(ip);
+    ip += 4;
+    if (flags & F_H_FILTER)
+	ip += 4;
+    ip += 8;			/* Mode, mtime */
+    if (version >= 0x0940)
+	ip += 4;		/* High half of mtime */
+    ip += 1 + *ip;		/* Name */
+
+    if (ip + 4 > end)
+	return 0;
+    hcheck = (flags & F_H_CRC32) ? crc32(0, p + sizeof lzop_magic,
+					 ip - p - sizeof lzop_magic)
+	: adler32(1, p + sizeof lzop_magic, ip - p - sizeof lzop_magic);
+    if (hcheck != get_be32(ip))
+	error("lzop file header corrupt");
+    ip += 4;
+
+    if (flags & F_H_EXTRA_FIELD) {
+	if (ip + 4 > end)
+	    return 0;
+	len = get_be32(ip);
+	if (len > (uint32_t)(end - ip) - 8)
+	    return 0;
+	ip += 4 + len + 4;	/* Length, data, checksum */
+    }
+
+    if (method < M_LZO1X_1 || method > M_LZO1X_999)
+	error("lzop file uses unsupported method");
+    if (flags & (F_MULTIPART | F_H_FILTER))
+	error("lzop file has unsupported flags");
+
+    *flagsp = flags;
+    return ip - p;
+}
+
+/* Bytes of checksums following a block header */
+static uint32_t lzop_checks(uint32_t flags, uint32_t dlen, uint32_t clen)
+{
+    uint32_t n = 0;
+
+    if (flags & F_ADLER32_D)
+	n += 4;
+    if (flags & F_CRC32_D)
+	n += 4;
+    if (clen < dlen) {
+	if (flags & F_ADLER32_C)
+	    n += 4;
+	if (flags & F_CRC32_C)
+	    n += 4;
+    }
+    return n;
+}
+
+/*
+ * Check for an lzop image.  The uncompressed size is the sum of the
+ * block sizes, so walk the block headers.
+ */
+int check_lzo(const uint8_t *indata, uint32_t size, struct zimage *zi)
+{
+    uint32_t flags, dlen, clen, pos;
+    uint64_t dbytes = 0;
+
+    pos = lzop_header(indata, size, &flags);
+    if (!pos)
+	return -1;
+
+    for (;;) {
+	if (size - pos < 4)
+	    error("lzop file corrupt");
+	dlen = get_be32(indata + pos);
+	pos += 4;
+	if (!dlen)
+	    break;		/* End of file */
+
+	if (size - pos < 4)
+	    error("lzop file corrupt");
+	clen = get_be32(indata + pos);
+	pos += 4;
+	if (dlen > LZOP_MAX_BLOCK || clen > dlen)
+	    error("lzop file corrupt");
+	pos += lzop_checks(flags, dlen, clen);
+	if (pos > size || clen > size - pos)
+	    error("lzop file corrupt");
+	pos += clen;
+	dbytes += dlen;
+    }
+
+    if (!dbytes || dbytes > 0xFFFFFFFF)
+	error("lzop file size not supported");
+
+    zi->format = ZFMT_LZO;
+    zi->offset = 0;
+    zi->zbytes = pos;
+    zi->dbytes = dbytes;
+    zi->crc = 0;
+    return 0;
+}
+
+/*
+ * Decompress an lzop image into out, which has room for zi->dbytes
+ * bytes.  The checksums of the uncompressed data are verified.
+ */
+void unlzo(const uint8_t *in, const struct zimage *zi, uint8_t *out)
+{
+    const uint8_t *ip, *dcheck;
+    uint8_t *op = out, *oend = out + zi->dbytes;
+    uint32_t flags, dlen, clen;
+    lzo_uint olen;
+
+    ip = in + lzop_header(in, zi->zbytes, &flags);
+
+    while ((dlen = get_be32(ip))) {
+	clen = get_be32(ip + 4);
+	dcheck = ip + 8;
+	ip = dcheck + lzop_checks(flags, dlen, clen);
+
+	if (dlen > (uint32_t)(oend - op))
+	    error("output buffer overrun");
+
+	if (clen == dlen) {
+	    memcpy(op, ip, dlen);	/* Stored block */
+	} else {
+	    olen = dlen;
+	    if (lzo1x_decompress_safe(ip, clen, op, &olen, NULL) != LZO_E_OK
+		|| olen != dlen)
+		error("corrupt LZO data");
+	}
+
+	if ((flags & F_ADLER32_D) &&
+	    adler32(1, op, dlen) != get_be32(dcheck))
+	    error("adler32 error");
+	if ((flags & F_CRC32_D) &&
+	    crc32(0, op, dlen) != get_be32(dcheck + 4 *
+					   !!(flags & F_ADLER32_D)))
+	    error("crc error");
+
+	ip += clen;
+	op += dlen;
+    }
+
+    if (op != oend)
+	error("uncompressed data length error");
+}
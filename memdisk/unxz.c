@@ -0,0 +1,781 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * unxz.c
+ *
+ * Decoder for xz (LZMA2) images.
+ *
+ * Since the whole image is decoded into its final location in one
+ * go, the output buffer itself serves as the LZMA dictionary: no
+ * separate dictionary is allocated, and matches are copied straight
+ * from earlier output.  Only the filter chain xz uses by default (a
+ * single LZMA2 filter) is supported; the integrity check is verified
+ * for CRC32 and CRC64, and skipped for SHA-256.
+ */
+
+#include <stdint.h>
+#ifdef TEST
+# include <string.h>
+# include <stdio.h>
+extern void __attribute__ ((noreturn)) die(const char *, ...);
+#else
+# include "memdisk.h"
+# include "conio.h"
+#endif
+#include "unzip.h"
+#include "zlib.h"		/* For crc32() */
+
+static void __attribute__ ((noreturn)) error(const char *x)
+{
+    die("failed\nDecompression error: %s\n", x);
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] + (p[1] << 8) + (p[2] << 16) + ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t get_le64(const uint8_t *p)
+{
+    return get_le32(p) + ((uint64_t)get_le32(p + 4) << 32);
+}
+
+/* ---------------------------------------------------------------------
+ * LZMA decoder
+ * --------------------------------------------------------------------- */
+
+#define STATES			12
+#define LIT_STATES		7	/* States below this follow a literal */
+#define POS_STATES_MAX		(1 << 4)
+#define LCLP_MAX		4	/* LZMA2 limit */
+#define LITERAL_CODER_SIZE	0x300
+#define MATCH_LEN_MIN		2
+#define LEN_LOW_SYMBOLS		8
+#define LEN_MID_SYMBOLS		8
+#define LEN_HIGH_SYMBOLS	256
+#define DIST_STATES		4
+#define DIST_SLOTS		64
+#define DIST_MODEL_START	4
+#define DIST_MODEL_END		14
+#define FULL_DISTANCES		(1 << (DIST_MODEL_END / 2))
+#define ALIGN_BITS		4
+#define ALIGN_SIZE		(1 << ALIGN_BITS)
+
+#define RC_SHIFT_BITS		8
+#define RC_TOP_VALUE		(1 << 24)
+#define RC_BIT_MODEL_TOTAL_BITS	11
+#define RC_BIT_MODEL_TOTAL	(1 << RC_BIT_MODEL_TOTAL_BITS)
+#define RC_MOVE_BITS		5
+
+typedef uint16_t prob_t;
+
+struct length_coder {
+    prob_t choice;
+    prob_t choice2;
+    prob_t low[POS_STATES_MAX][LEN_LOW_SYMBOLS];
+    prob_t mid[POS_STATES_MAX][LEN_MID_SYMBOLS];
+    prob_t high[LEN_HIGH_SYMBOLS];
+};
+
+/* All probabilities, so they can be reset in one go */
+struct lzma_probs {
+    prob_t is_match[STATES][POS_STATES_MAX];
+    prob_t is_rep[STATES];
+    prob_t is_rep0[STATES];
+    prob_t is_rep1[STATES];
+    prob_t is_rep2[STATES];
+    prob_t is_rep0_long[STATES][POS_STATES_MAX];
+    prob_t dist_slot[DIST_STATES][DIST_SLOTS];
+    prob_t dist_special[FULL_DISTANCES - DIST_MODEL_END];
+    prob_t dist_align[ALIGN_SIZE];
+    struct length_coder match_len;
+    struct length_coder rep_len;
+    prob_t literal[LITERAL_CODER_SIZE << LCLP_MAX];
+};
+
+struct rc_dec {
+    const uint8_t *in, *in_end;
+    uint32_t range;
+    uint32_t code;
+};
+
+struct lzma_dec {
+    struct rc_dec rc;
+    uint8_t *dict;		/* Start of the current dictionary */
+    uint8_t *out;		/* Output pointer */
+    uint8_t *out_end;		/* End of the output buffer */
+    uint32_t rep0, rep1, rep2, rep3;
+    unsigned int state;
+    unsigned int lc, lp_mask, pb_mask;
+};
+
+static struct lzma_probs probs;
+
+static void rc_init(struct rc_dec *rc, const uint8_t *in, size_t len)
+{
+    if (len < 5 || in[0])
+	error("corrupt LZMA data");
+    rc->code = ((uint32_t)in[1] << 24) + (in[2] << 16) + (in[3] << 8) + in[4];
+    rc->range = 0xFFFFFFFF;
+    rc->in = in + 5;
+    rc->in_end = in + len;
+}
+
+static inline void rc_normalize(struct rc_dec *rc)
+{
+    if (rc->range < RC_TOP_VALUE) {
+	if (rc->in >= rc->in_end)
+	    error("ran out of input data");
+	rc->range <<= RC_SHIFT_BITS;
+	rc->code = (rc->code << RC_SHIFT_BITS) + *rc->in++;
+    }
+}
+
+static inline int rc_bit(struct rc_dec *rc, prob_t *prob)
+{
+    uint32_t bound;
+    int bit;
+
+    rc_normalize(rc);
+    bound = (rc->range >> RC_BIT_MODEL_TOTAL_BITS) * *prob;
+    if (rc->code < bound) {
+	rc->range = bound;
+	*prob += (RC_BIT_MODEL_TOTAL - *prob) >> RC_MOVE_BITS;
+	bit = 0;
+    } else {
+	rc->range -= bound;
+	rc->code -= bound;
+	*prob -= *prob >> RC_MOVE_BITS;
+	bit = 1;
+    }
+    return bit;
+}
+
+/* Decode a bittree of log2(limit) bits, returning [limit, 2*limit) */
+static inline uint32_t rc_bittree(struct rc_dec *rc, prob_t *probs,
+				  uint32_t limit)
+{
+    uint32_t symbol = 1;
+
+    do {
+	symbol = (symbol << 1) + rc_bit(rc, &probs[symbol]);
+    } while (symbol < limit);
+
+    return symbol;
+}
+
+/* Decode a reverse bittree of limit bits, adding the result to *dest */
+static inline void rc_bittree_reverse(struct rc_dec *rc, prob_t *probs,
+				      uint32_t *dest, uint32_t limit)
+{
+    uint32_t symbol = 1;
+    uint32_t i = 0;
+
+    do {
+	if (rc_bit(rc, &probs[symbol])) {
+	    symbol = (symbol << 1) + 1;
+	    *dest += 1 << i;
+	} else {
+	    symbol <<= 1;
+	}
+    } while (++i < limit);
+}
+
+static inline void rc_direct(struct rc_dec *rc, uint32_t *dest, uint32_t n)
+{
+    uint32_t mask;
+
+    do {
+	rc_normalize(rc);
+	rc->range >>= 1;
+	rc->code -= rc->range;
+	mask = (uint32_t)0 - (rc->code >> 31);
+	rc->code += rc->range & mask;
+	*dest = (*dest << 1) + (mask + 1);
+    } while (--n);
+}
+
+static void lzma_reset(struct lzma_dec *s)
+{
+    prob_t *p = (prob_t *)&probs;
+    size_t i;
+
+    s->state = 0;
+    s->rep0 = s->rep1 = s->rep2 = s->rep3 = 0;
+
+    for (i = 0; i < sizeof probs / sizeof(prob_t); i++)
+	p[i] = RC_BIT_MODEL_TOTAL / 2;
+}
+
+/* Set lc/lp/pb from an LZMA properties byte */
+static void lzma_props(struct lzma_dec *s, unsigned int props)
+{
+    unsigned int lc, lp, pb;
+
+    if (props > (4 * 5 + 4) * 9 + 8)
+	error("corrupt LZMA properties");
+
+    pb = props / (9 * 5);
+    props -= pb * 9 * 5;
+    lp = props / 9;
+    lc = props - lp * 9;
+
+    if (lc + lp > LCLP_MAX)
+	error("unsupported LZMA properties (lc + lp > 4)");
+
+    s->lc = lc;
+    s->lp_mask = (1 << lp) - 1;
+    s->pb_mask = (1 << pb) - 1;
+}
+
+static uint32_t lzma_len(struct lzma_dec *s, struct length_coder *l,
+			 uint32_t pos_state)
+{
+    struct rc_dec *rc = &s->rc;
+
+    if (!rc_bit(rc, &l->choice))
+	return MATCH_LEN_MIN - LEN_LOW_SYMBOLS +
+	    rc_bittree(rc, l->low[pos_state], LEN_LOW_SYMBOLS);
+    else if (!rc_bit(rc, &l->choice2))
+	return MATCH_LEN_MIN + LEN_LOW_SYMBOLS - LEN_MID_SYMBOLS +
+	    rc_bittree(rc, l->mid[pos_state], LEN_MID_SYMBOLS);
+    else
+	return MATCH_LEN_MIN + LEN_LOW_SYMBOLS + LEN_MID_SYMBOLS -
+	    LEN_HIGH_SYMBOLS + rc_bittree(rc, l->high, LEN_HIGH_SYMBOLS);
+}
+
+static void lzma_literal(struct lzma_dec *s)
+{
+    struct rc_dec *rc = &s->rc;
+    uint32_t pos = s->out - s->dict;
+    uint32_t prev = pos ? s->out[-1] : 0;
+    uint32_t symbol = 1;
+    uint32_t match_byte, match_bit, offset, i;
+    prob_t *p;
+
+    p = probs.literal + LITERAL_CODER_SIZE *
+	(((pos & s->lp_mask) << s->lc) + (prev >> (8 - s->lc)));
+
+    if (s->state < LIT_STATES) {
+	symbol = rc_bittree(rc, p, 0x100);
+    } else {
+	match_byte = s->out[-(int32_t)s->rep0 - 1] << 1;
+	offset = 0x100;
+	do {
+	    match_bit = match_byte & offset;
+	    match_byte <<= 1;
+	    i = offset + match_bit + symbol;
+	    if (rc_bit(rc, &p[i])) {
+		symbol = (symbol << 1) + 1;
+		offset &= match_bit;
+	    } else {
+		symbol <<= 1;
+		offset &= ~match_bit;
+	    }
+	} while (symbol < 0x100);
+    }
+
+    *s->out++ = symbol;
+
+    if (s->state <= 3)
+	s->state = 0;
+    else if (s->state <= 9)
+	s->state -= 3;
+    else
+	s->state -= 6;
+}
+
+/*
+ * Decode symbols until the output reaches end.  Returns 1 if an end
+ * of payload marker was found (not allowed in LZMA2), 0 otherwise.
+ */
+static int lzma_decode(struct lzma_dec *s, uint8_t *end)
+{
+    struct rc_dec *rc = &s->rc;
+    uint32_t pos_state, len, dist_slot, limit, tmp;
+    prob_t *p;
+
+    while (s->out < end) {
+	pos_state = (s->out - s->dict) & s->pb_mask;
+
+	if (!rc_bit(rc, &probs.is_match[s->state][pos_state])) {
+	    if (s->out == s->dict && s->state >= LIT_STATES)
+		error("corrupt LZMA data");
+	    lzma_literal(s);
+	    continue;
+	}
+
+	if (rc_bit(rc, &probs.is_rep[s->state])) {
+	    /* Repeated match */
+	    if (s->out == s->dict)
+		error("corrupt LZMA data");
+
+	    if (!rc_bit(rc, &probs.is_rep0[s->state])) {
+		if (!rc_bit(rc, &probs.is_rep0_long[s->state][pos_state])) {
+		    /* Short rep: one byte at distance rep0 */
+		    if (s->rep0 >= (uint32_t)(s->out - s->dict))
+			error("corrupt LZMA data");
+		    s->state = s->state < LIT_STATES ? 9 : 11;
+		    *s->out = s->out[-(int32_t)s->rep0 - 1];
+		    s->out++;
+		    continue;
+		}
+	    } else {
+		if (!rc_bit(rc, &probs.is_rep1[s->state])) {
+		    tmp = s->rep1;
+		} else {
+		    if (!rc_bit(rc, &probs.is_rep2[s->state])) {
+			tmp = s->rep2;
+		    } else {
+			tmp = s->rep3;
+			s->rep3 = s->rep2;
+		    }
+		    s->rep2 = s->rep1;
+		}
+		s->rep1 = s->rep0;
+		s->rep0 = tmp;
+	    }
+
+	    s->state = s->state < LIT_STATES ? 8 : 11;
+	    len = lzma_len(s, &probs.rep_len, pos_state);
+	} else {
+	    /* New match */
+	    s->rep3 = s->rep2;
+	    s->rep2 = s->rep1;
+	    s->rep1 = s->rep0;
+
+	    len = lzma_len(s, &probs.match_len, pos_state);
+	    s->state = s->state < LIT_STATES ? 7 : 10;
+
+	    tmp = len - MATCH_LEN_MIN;
+	    p = probs.dist_slot[tmp < DIST_STATES ? tmp : DIST_STATES - 1];
+	    dist_slot = rc_bittree(rc, p, DIST_SLOTS) - DIST_SLOTS;
+
+	    if (dist_slot < DIST_MODEL_START) {
+		s->rep0 = dist_slot;
+	    } else {
+		limit = (dist_slot >> 1) - 1;
+		s->rep0 = 2 + (dist_slot & 1);
+
+		if (dist_slot < DIST_MODEL_END) {
+		    s->rep0 <<= limit;
+		    p = probs.dist_special + s->rep0 - dist_slot - 1;
+		    rc_bittree_reverse(rc, p, &s->rep0, limit);
+		} else {
+		    rc_direct(rc, &s->rep0, limit - ALIGN_BITS);
+		    s->rep0 <<= ALIGN_BITS;
+		    rc_bittree_reverse(rc, probs.dist_align, &s->rep0,
+				       ALIGN_BITS);
+		    if (s->rep0 == 0xFFFFFFFF)
+			return 1;	/* End of payload marker */
+		}
+	    }
+	}
+
+	/* Copy the match from earlier output */
+	if (s->rep0 >= (uint32_t)(s->out - s->dict))
+	    error("corrupt LZMA data");
+	if (len > (uint32_t)(end - s->out))
+	    error("corrupt LZMA data");
+
+	tmp = s->rep0 + 1;
+	if (tmp >= len) {
+	    memcpy(s->out, s->out - tmp, len);
+	    s->out += len;
+	} else {
+	    /* Overlapping match: a run */
+	    const uint8_t *from = s->out - tmp;
+	    while (len--)
+		*s->out++ = *from++;
+	}
+    }
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------
+ * LZMA2
+ * --------------------------------------------------------------------- */
+
+/*
+ * Decode an LZMA2 stream of at most len bytes.  Returns the number of
+ * input bytes used.
+ */
+static size_t unlzma2(struct lzma_dec *s, const uint8_t *in, size_t len)
+{
+    const uint8_t *ip = in, *iend = in + len;
+    uint32_t control, usize, csize;
+    int need_dict_reset = 1, need_props = 1;
+
+    for (;;) {
+	if (ip >= iend)
+	    error("ran out of input data");
+	control = *ip++;
+
+	if (control == 0x00)
+	    break;		/* End of LZMA2 stream */
+
+	if (control >= 0xE0 || control == 0x01) {
+	    s->dict = s->out;	/* Dictionary reset */
+	    need_dict_reset = 0;
+	    need_props = 1;	/* ... which must come with a state reset */
+	} else if (need_dict_reset) {
+	    error("corrupt LZMA2 data");
+	}
+
+	if (control < 0x80) {
+	    /* Uncompressed chunk */
+	    if (control > 0x02 || iend - ip < 2)
+		error("corrupt LZMA2 data");
+	    usize = ((ip[0] << 8) + ip[1]) + 1;
+	    ip += 2;
+	    if (usize > (uint32_t)(iend - ip) ||
+		usize > (uint32_t)(s->out_end - s->out))
+		error("corrupt LZMA2 data");
+	    memcpy(s->out, ip, usize);
+	    s->out += usize;
+	    ip += usize;
+	    continue;
+	}
+
+	/* LZMA chunk */
+	if (iend - ip < 4)
+	    error("ran out of input data");
+	usize = ((control & 0x1F) << 16) + (ip[0] << 8) + ip[1] + 1;
+	csize = (ip[2] << 8) + ip[3] + 1;
+	ip += 4;
+
+	if (control >= 0xC0) {
+	    if (ip >= iend)
+		error("ran out of input data");
+	    lzma_props(s, *ip++);
+	    need_props = 0;
+	} else if (need_props) {
+	    error("corrupt LZMA2 data");
+	}
+	if (control >= 0xA0)
+	    lzma_reset(s);
+
+	if (csize > (uint32_t)(iend - ip) ||
+	    usize > (uint32_t)(s->out_end - s->out))
+	    error("corrupt LZMA2 data");
+
+	/* The chunk must end with the range coder flushed */
+	rc_init(&s->rc, ip, csize);
+	if (lzma_decode(s, s->out + usize))
+	    error("corrupt LZMA2 data");
+	rc_normalize(&s->rc);
+	if (s->rc.in != ip + csize || s->rc.code)
+	    error("corrupt LZMA2 data");
+	ip += csize;
+    }
+
+    return ip - in;
+}
+
+/* ---------------------------------------------------------------------
+ * xz container
+ * --------------------------------------------------------------------- */
+
+#define XZ_HEADER_SIZE		12
+#define XZ_FOOTER_SIZE		12
+
+#define XZ_CHECK_NONE		0
+#define XZ_CHECK_CRC32		1
+#define XZ_CHECK_CRC64		4
+#define XZ_CHECK_SHA256		10
+
+#define XZ_FILTER_LZMA2		0x21
+
+static const uint8_t xz_magic[6] = { 0xFD, '7', 'z', 'X', 'Z', 0 };
+
+/* Size of the check field for each check type */
+static unsigned int xz_check_size(unsigned int type)
+{
+    return type ? 4 << ((type - 1) / 3) : 0;
+}
+
+/* Decode a variable-length integer; returns 0 on error */
+static size_t xz_vli(const uint8_t *p, const uint8_t *end, uint64_t *val)
+{
+    const uint8_t *q = p;
+    unsigned int shift = 0;
+
+    *val = 0;
+    do {
+	if (q >= end || shift > 56)
+	    return 0;
+	*val |= (uint64_t)(*q & 0x7F) << shift;
+	shift += 7;
+    } while (*q++ & 0x80);
+
+    return q - p;
+}
+
+/*
+ * Parse the index of the stream ending at end (which points to the
+ * stream footer.)  Returns the start of the stream, or NULL if this
+ * does not look like an xz stream; adds the uncompressed size to
+ * *dbytes.
+ */
+static const uint8_t *xz_parse_stream(const uint8_t *start,
+				      const uint8_t *footer,
+				      uint64_t *dbytes)
+{
+    const uint8_t *index, *ip;
+    uint64_t records, unpadded, usize, blocks = 0;
+    uint32_t backward;
+    size_t n;
+
+    if (footer - start < XZ_HEADER_SIZE ||
+	footer[10] != 'Y' || footer[11] != 'Z' ||
+	crc32(0, footer + 4, 6) != get_le32(footer))
+	return NULL;
+
+    backward = (get_le32(footer + 4) + 1) * 4;
+    if (backward > (uint32_t)(footer - start) - XZ_HEADER_SIZE)
+	return NULL;
+    index = footer - backward;
+
+    if (index[0] != 0 || crc32(0, index, backward - 4) !=
+	get_le32(footer - 4))
+	return NULL;
+
+    ip = index + 1;
+    if (!(n = xz_vli(ip, footer - 4, &records)))
+	return NULL;
+    ip += n;
+
+    while (records--) {
+	if (!(n = xz_vli(ip, footer - 4, &unpadded)))
+	    return NULL;
+	ip += n;
+	if (!(n = xz_vli(ip, footer - 4, &usize)))
+	    return NULL;
+	ip += n;
+	blocks += (unpadded + 3) & ~(uint64_t)3;
+	*dbytes += usize;
+    }
+
+    if (blocks > (uint64_t)(index - start) - XZ_HEADER_SIZE)
+	return NULL;
+
+    start = index - blocks - XZ_HEADER_SIZE;
+    if (memcmp(start, xz_magic, sizeof xz_magic) ||
+	memcmp(start + 6, footer + 8, 2))
+	return NULL;
+
+    return start;
+}
+
+/*
+ * Check for an xz image.  The uncompressed size is only recorded in
+ * the index at the end of each stream, so walk the streams backwards.
+ */
+int check_xz(const uint8_t *indata, uint32_t size, struct zimage *zi)
+{
+    const uint8_t *end = indata + size;
+    uint64_t dbytes = 0;
+
+    if (size < XZ_HEADER_SIZE + XZ_FOOTER_SIZE ||
+	memcmp(indata, xz_magic, sizeof xz_magic))
+	return -1;
+
+    while (end > indata) {
+	/* Skip stream padding */
+	while (end - indata >= 4 && !get_le32(end - 4))
+	    end -= 4;
+	if (end - indata < XZ_HEADER_SIZE + XZ_FOOTER_SIZE ||
+	    !(end = xz_parse_stream(indata, end - XZ_FOOTER_SIZE, &dbytes)))
+	    error("xz file corrupt");
+    }
+
+    if (!dbytes || dbytes > 0xFFFFFFFF)
+	error("xz file size not supported");
+
+    zi->format = ZFMT_XZ;
+    zi->offset = 0;
+    zi->zbytes = size;
+    zi->dbytes = dbytes;
+    zi->crc = 0;
+    return 0;
+}
+
+static uint64_t crc64_table[256];
+
+static uint64_t crc64(const uint8_t *p, size_t len)
+{
+    uint64_t crc = ~(uint64_t)0;
+    uint64_t c;
+    int i, j;
+
+    if (!crc64_table[1]) {
+	for (i = 0; i < 256; i++) {
+	    c = i;
+	    for (j = 0; j < 8; j++)
+		c = (c >> 1) ^ (0xC96C5795D7870F42ULL & -(c & 1));
+	    crc64_table[i] = c;
+	}
+    }
+
+    while (len--)
+	crc = crc64_table[(uint8_t)crc ^ *p++] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+/* Decode one block; returns the number of input bytes used */
+static size_t xz_block(struct lzma_dec *s, const uint8_t *in,
+		       const uint8_t *iend, unsigned int check)
+{
+    const uint8_t *ip = in, *hend;
+    uint8_t *start = s->out;
+    uint64_t csize = 0, usize = 0, id, psize;
+    unsigned int hsize, flags, csum;
+    size_t n;
+
+    hsize = (in[0] + 1) * 4;
+    if (in[0] == 0 || hsize > (size_t)(iend - in) ||
+	crc32(0, in, hsize - 4) != get_le32(in + hsize - 4))
+	error("xz file corrupt");
+    hend = in + hsize - 4;
+    flags = in[1];
+    ip = in + 2;
+
+    if ((flags & 0x03) || (flags & 0x3C))
+	error("xz filter chain not supported (only LZMA2)");
+    if ((flags & 0x40) && !(n = xz_vli(ip, hend, &csize)))
+	error("xz file corrupt");
+    ip += (flags & 0x40) ? n : 0;
+    if ((flags & 0x80) && !(n = xz_vli(ip, hend, &usize)))
+	error("xz file corrupt");
+    ip += (flags & 0x80) ? n : 0;
+
+    if (!(n = xz_vli(ip, hend, &id)) || id != XZ_FILTER_LZMA2)
+	error("xz filter chain not supported (only LZMA2)");
+    ip += n;
+    if (!(n = xz_vli(ip, hend, &psize)) || psize != 1 || ip + n >= hend)
+	error("xz file corrupt");
+    ip += n + 1;		/* Dictionary size: we don't need it */
+
+    while (ip < hend)
+	if (*ip++)
+	    error("xz file corrupt");
+
+    ip = in + hsize;
+    n = unlzma2(s, ip, iend - ip);
+    if ((flags & 0x40) && csize != n)
+	error("xz file corrupt");
+    if ((flags & 0x80) && usize != (uint64_t)(s->out - start))
+	error("xz file corrupt");
+    ip += n;
+
+    /* Block padding */
+    while ((ip - in) & 3) {
+	if (ip >= iend || *ip++)
+	    error("xz file corrupt");
+    }
+
+    csum = xz_check_size(check);
+    if (csum > (size_t)(iend - ip))
+	error("ran out of input data");
+
+    if (check == XZ_CHECK_CRC32) {
+	if (crc32(0, start, s->out - start) != get_le32(ip))
+	    error("crc error");
+    } else if (check == XZ_CHECK_CRC64) {
+	if (crc64(start, s->out - start) != get_le64(ip))
+	    error("crc error");
+    }
+
+    return ip + csum - in;
+}
+
+/* Size of the index starting at index, including its CRC32 */
+static size_t xz_index_size(const uint8_t *index, const uint8_t *end)
+{
+    const uint8_t *ip = index + 1;
+    uint64_t records, val;
+    size_t n;
+
+    if (!(n = xz_vli(ip, end, &records)))
+	error("xz file corrupt");
+    ip += n;
+
+    /* Each record is the unpadded and the uncompressed block size */
+    for (records *= 2; records; records--) {
+	if (!(n = xz_vli(ip, end, &val)))
+	    error("xz file corrupt");
+	ip += n;
+    }
+
+    return ((ip - index + 3) & ~3) + 4;
+}
+
+/* Decode an xz image, as found by check_xz() */
+static void unxz_streams(struct lzma_dec *s, const uint8_t *in,
+			 const uint8_t *iend)
+{
+    const uint8_t *ip = in;
+    unsigned int check;
+
+    while (ip < iend) {
+	if (iend - ip < 4)
+	    error("xz file corrupt");
+
+	/* Stream padding */
+	if (!get_le32(ip)) {
+	    ip += 4;
+	    continue;
+	}
+
+	if (iend - ip < XZ_HEADER_SIZE)
+	    error("xz file corrupt");
+
+	/* Stream header; the index was validated by check_xz() */
+	check = ip[7] & 0x0F;
+	if (ip[6] || (ip[7] & 0xF0) ||
+	    crc32(0, ip + 6, 2) != get_le32(ip + 8))
+	    error("xz file corrupt");
+	if (check != XZ_CHECK_NONE && check != XZ_CHECK_CRC32 &&
+	    check != XZ_CHECK_CRC64 && check != XZ_CHECK_SHA256)
+	    error("xz check type not supported");
+	ip += XZ_HEADER_SIZE;
+
+	/* Blocks, until the index */
+	while (ip < iend && *ip)
+	    ip += xz_block(s, ip, iend, check);
+
+	/* Skip the index and footer, which check_xz() looked at */
+	if (ip >= iend)
+	    error("xz file corrupt");
+	ip += xz_index_size(ip, iend) + XZ_FOOTER_SIZE;
+    }
+}
+
+/*
+ * Decompress an xz image into out, which has room for zi->dbytes bytes.
+ */
+void unxz(const uint8_t *in, const struct zimage *zi, uint8_t *out)
+{
+    struct lzma_dec s;
+
+    memset(&s, 0, sizeof s);
+    s.dict = s.out = out;
+    s.out_end = out + zi->dbytes;
+
+    unxz_streams(&s, in, in + zi->zbytes);
+
+    if (s.out != s.out_end)
+	error("uncompressed data length error");
+}
@@ -1,182 +1,68 @@
-/*
- * unzip.c
+/* ----------------------------------------------------------------------- *
  *
- * This is a collection of several routines from gzip-1.0.3
- * adapted for Linux.
+ *   Copyright 2003-2009 H. Peter Anvin - All Rights Reserved
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
  *
- * malloc by Hannu Savolainen 1993 and Matthias Urlichs 1994
- * puts by Nick Holloway 1993, better puts by Martin Mares 1995
- * High loaded stuff by Hans Lermen & Werner Almesberger, Feb. 1996
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
  *
- * Adapted for MEMDISK by H. Peter Anvin, April 2003
- */
-
-#include <stdint.h>
-#include "memdisk.h"
-#include "conio.h"
-
-#undef DEBUG			/* Means something different for this file */
+ * ----------------------------------------------------------------------- */
 
 /*
- * gzip declarations
+ * unzip.c
+ *
+ * Recognize compressed images and decompress them.  gzip and PKZIP
+ * data is inflated with zlib (com32/lib/zlib), in a single call with
+ * the whole image as the output buffer: that way zlib works directly
+ * on the final copy of the data, with no sliding window to copy
+ * through.  The other formats live in unxz.c and unlzo.c.
  */
 
-#define OF(args)  args
-#define STATIC static
-
-#define memzero(s, n)     memset ((s), 0, (n))
-
-typedef uint8_t uch;
-typedef uint16_t ush;
-typedef uint32_t ulg;
-
-#define WSIZE 0x8000		/* Window size must be at least 32k, */
-				/* and a power of two */
-
-static uch *inbuf;		/* input pointer */
-static uch window[WSIZE];	/* sliding output window buffer */
-
-static unsigned insize;		/* total input bytes read */
-static unsigned inbytes;	/* valid bytes in inbuf */
-static unsigned outcnt;		/* bytes in output buffer */
-
-/* gzip flag byte */
-#define ASCII_FLAG   0x01	/* bit 0 set: file probably ASCII text */
-#define CONTINUATION 0x02	/* bit 1 set: continuation of multi-part gzip file */
-#define EXTRA_FIELD  0x04	/* bit 2 set: extra field present */
-#define ORIG_NAME    0x08	/* bit 3 set: original file name present */
-#define COMMENT      0x10	/* bit 4 set: file comment present */
-#define ENCRYPTED    0x20	/* bit 5 set: file is encrypted */
-#define RESERVED     0xC0	/* bit 6,7:   reserved */
-
-/* Diagnostic functions */
-#ifdef DEBUG
-#  define Assert(cond,msg) {if(!(cond)) error(msg);}
-#  define Trace(x) fprintf x
-#  define Tracev(x) {if (verbose) fprintf x ;}
-#  define Tracevv(x) {if (verbose>1) fprintf x ;}
-#  define Tracec(c,x) {if (verbose && (c)) fprintf x ;}
-#  define Tracecv(c,x) {if (verbose>1 && (c)) fprintf x ;}
+#include <stdint.h>
+#ifdef TEST
+# include <string.h>
+# include <stdio.h>
+extern void __attribute__ ((noreturn)) die(const char *, ...);
 #else
-#  define Assert(cond,msg)
-#  define Trace(x)
-#  define Tracev(x)
-#  define Tracevv(x)
-#  define Tracec(c,x)
-#  define Tracecv(c,x)
+# include "memdisk.h"
+# include "conio.h"
 #endif
+#include "unzip.h"
+#include "zlib.h"
 
-static int fill_inbuf(void);
-static void flush_window(void);
-static void error(char *m);
-static void gzip_mark(void **);
-static void gzip_release(void **);
-
-static ulg crc_32_tab[256];
-
-/* Get byte from input buffer */
-static inline uch get_byte(void)
-{
-    if (inbytes) {
-	uch b = *inbuf++;
-	inbytes--;
-	return b;
-    } else {
-	return fill_inbuf();	/* Input buffer underrun */
-    }
-}
-
-/* Unget byte from input buffer */
-static inline void unget_byte(void)
-{
-    inbytes++;
-    inbuf--;
-}
-
-static ulg bytes_out = 0;	/* Number of bytes output */
-static uch *output_data;	/* Output data pointer */
-static ulg output_size;		/* Number of output bytes expected */
-
-static void *malloc(int size);
-static void free(void *where);
-
-static ulg free_mem_ptr, free_mem_end_ptr;
-
-#include "inflate.c"
+/*
+ * zlib allocates its state once per image, so memory comes from a
+ * simple bump allocator on a static heap.  The inflate state is
+ * about 10K; with the whole image as the output buffer, inflate()
+ * never needs to allocate a window.  zlib is built with MY_ZCALLOC,
+ * so it uses these by default.
+ */
+static char heap[16384];
+static size_t heap_ptr;
 
-static void *malloc(int size)
+void *zcalloc(void *opaque, unsigned items, unsigned size)
 {
+    size_t len = ((size_t)items * size + 7) & ~(size_t)7;
     void *p;
 
-    if (size < 0)
-	error("malloc error");
+    (void)opaque;
 
-    free_mem_ptr = (free_mem_ptr + 3) & ~3;	/* Align */
-
-    p = (void *)free_mem_ptr;
-    free_mem_ptr += size;
-
-    if (free_mem_ptr >= free_mem_end_ptr)
-	error("out of memory");
+    if (len > sizeof heap - heap_ptr)
+	return NULL;
 
+    p = heap + heap_ptr;
+    heap_ptr += len;
+    memset(p, 0, len);
     return p;
 }
 
-static void free(void *where)
-{
-    /* Don't care */
-    (void)where;
-}
-
-static void gzip_mark(void **ptr)
-{
-    *ptr = (void *)free_mem_ptr;
-}
-
-static void gzip_release(void **ptr)
-{
-    free_mem_ptr = (long)*ptr;
-}
-
-/* ===========================================================================
- * Fill the input buffer. This is called only when the buffer is empty
- * and at least one byte is really needed.
- */
-static int fill_inbuf(void)
+void zcfree(void *opaque, void *ptr)
 {
-    /* This should never happen.  We have already pointed the algorithm
-       to all the data we have. */
-    die("failed\nDecompression error: ran out of input data\n");
-}
-
-/* ===========================================================================
- * Write the output window window[0..outcnt-1] and update crc and bytes_out.
- * (Used for the decompressed data only.)
- */
-static void flush_window(void)
-{
-    ulg c = crc;		/* temporary variable */
-    unsigned n;
-    uch *in, *out, ch;
-
-    if (bytes_out + outcnt > output_size)
-	error("output buffer overrun");
-
-    in = window;
-    out = output_data;
-    for (n = 0; n < outcnt; n++) {
-	ch = *out++ = *in++;
-	c = crc_32_tab[(c ^ ch) & 0xff] ^ (c >> 8);
-    }
-    crc = c;
-    output_data = out;
-    bytes_out += (ulg) outcnt;
-    outcnt = 0;
-}
-
-static void error(char *x)
-{
-    die("failed\nDecompression error: %s\n", x);
+    (void)opaque;
+    (void)ptr;			/* Released all at once, in unzip() */
 }
 
 /* GZIP header */
@@ -230,162 +116,204 @@ struct pkzip_header {
 				   descriptor" */
 #define PK_UNSUPPORTED    0xFFF0	/* All other bits must be zero */
 
-/* Return 0 if (indata, size) points to a ZIP file, and fill in
-   compressed data size, uncompressed data size, CRC, and offset of
-   data.
+static void error(const char *x)
+{
+    die("failed\nDecompression error: %s\n", x);
+}
 
-   If indata is not a ZIP file, return -1. */
-int check_zip(void *indata, uint32_t size, uint32_t * zbytes_p,
-	      uint32_t * dbytes_p, uint32_t * orig_crc, uint32_t * offset_p)
+static int check_gzip(const uint8_t *indata, uint32_t size, struct zimage *zi)
 {
-    struct gzip_header *gzh = (struct gzip_header *)indata;
-    struct pkzip_header *pkzh = (struct pkzip_header *)indata;
+    const struct gzip_header *gzh = (const struct gzip_header *)indata;
+    const struct gzip_trailer *gzt;
     uint32_t offset;
 
-    if (gzh->magic == 0x8b1f) {
-	struct gzip_trailer *gzt = indata + size - sizeof(struct gzip_trailer);
-	/* We only support method #8, DEFLATED */
-	if (gzh->method != 8) {
-	    error("gzip file uses invalid method");
-	    return -1;
-	}
-	if (gzh->flags & ENCRYPTED) {
-	    error("gzip file is encrypted; not supported");
-	    return -1;
-	}
-	if (gzh->flags & CONTINUATION) {
-	    error("gzip file is a continuation file; not supported");
-	    return -1;
-	}
-	if (gzh->flags & RESERVED) {
-	    error("gzip file has unsupported flags");
-	    return -1;
-	}
-	offset = sizeof(*gzh);
-	if (gzh->flags & EXTRA_FIELD) {
-	    /* Skip extra field */
-	    unsigned len = *(unsigned *)(indata + offset);
-	    offset += 2 + len;
-	}
-	if (gzh->flags & ORIG_NAME) {
-	    /* Discard the old name */
-	    uint8_t *p = indata;
-	    while (p[offset] != 0 && offset < size) {
-		offset++;
-	    }
+    if (size < sizeof *gzh + sizeof *gzt)
+	return -1;
+    gzt = (const struct gzip_trailer *)(indata + size - sizeof *gzt);
+
+    /* We only support method #8, DEFLATED */
+    if (gzh->method != 8) {
+	error("gzip file uses invalid method");
+	return -1;
+    }
+    if (gzh->flags & ENCRYPTED) {
+	error("gzip file is encrypted; not supported");
+	return -1;
+    }
+    if (gzh->flags & CONTINUATION) {
+	error("gzip file is a continuation file; not supported");
+	return -1;
+    }
+    if (gzh->flags & RESERVED) {
+	error("gzip file has unsupported flags");
+	return -1;
+    }
+    offset = sizeof(*gzh);
+    if (gzh->flags & EXTRA_FIELD) {
+	/* Skip extra field */
+	unsigned len = indata[offset] + (indata[offset + 1] << 8);
+	offset += 2 + len;
+    }
+    if (gzh->flags & ORIG_NAME) {
+	/* Discard the old name */
+	while (offset < size && indata[offset] != 0)
 	    offset++;
-	}
-
-	if (gzh->flags & COMMENT) {
-	    /* Discard the comment */
-	    uint8_t *p = indata;
-	    while (p[offset] != 0 && offset < size) {
-		offset++;
-	    }
+	offset++;
+    }
+
+    if (gzh->flags & COMMENT) {
+	/* Discard the comment */
+	while (offset < size && indata[offset] != 0)
 	    offset++;
-	}
-
-	if (offset > size) {
-	    error("gzip file corrupt");
-	    return -1;
-	}
-	*zbytes_p = size - offset - sizeof(struct gzip_trailer);
-	*dbytes_p = gzt->dbytes;
-	*orig_crc = gzt->crc;
-	*offset_p = offset;
-	return 0;
-    } else if (pkzh->magic == 0x04034b50UL) {
-	/* Magic number matches pkzip file. */
-
-	offset = sizeof(*pkzh);
-	if (pkzh->flags & PK_ENCRYPTED) {
-	    error("pkzip file is encrypted; not supported");
-	    return -1;
-	}
-	if (pkzh->flags & PK_DATADESC) {
-	    error("pkzip file uses data_descriptor field; not supported");
-	    return -1;
-	}
-	if (pkzh->flags & PK_UNSUPPORTED) {
-	    error("pkzip file has unsupported flags");
-	    return -1;
-	}
-
-	/* We only support method #8, DEFLATED */
-	if (pkzh->method != 8) {
-	    error("pkzip file uses invalid method");
-	    return -1;
-	}
-	/* skip header */
-	offset = sizeof(*pkzh);
-	/* skip filename */
-	offset += pkzh->filename_len;
-	/* skip extra field */
-	offset += pkzh->extra_len;
-
-	if (offset + pkzh->zbytes > size) {
-	    error("pkzip file corrupt");
-	    return -1;
-	}
-
-	*zbytes_p = pkzh->zbytes;
-	*dbytes_p = pkzh->dbytes;
-	*orig_crc = pkzh->crc;
-	*offset_p = offset;
-	return 0;
-    } else {
-	/* Magic number does not match. */
+	offset++;
+    }
+
+    if (offset > size - sizeof *gzt) {
+	error("gzip file corrupt");
+	return -1;
+    }
+    zi->format = ZFMT_GZIP;
+    zi->zbytes = size - offset - sizeof *gzt;
+    zi->dbytes = gzt->dbytes;
+    zi->crc = gzt->crc;
+    zi->offset = offset;
+    return 0;
+}
+
+static int check_pkzip(const uint8_t *indata, uint32_t size,
+		       struct zimage *zi)
+{
+    const struct pkzip_header *pkzh = (const struct pkzip_header *)indata;
+    uint32_t offset;
+
+    if (size < sizeof *pkzh)
+	return -1;
+
+    if (pkzh->flags & PK_ENCRYPTED) {
+	error("pkzip file is encrypted; not supported");
+	return -1;
+    }
+    if (pkzh->flags & PK_DATADESC) {
+	error("pkzip file uses data_descriptor field; not supported");
+	return -1;
+    }
+    if (pkzh->flags & PK_UNSUPPORTED) {
+	error("pkzip file has unsupported flags");
 	return -1;
     }
 
-    error("Internal error in check_zip");
-    return -1;
+    /* We only support method #8, DEFLATED */
+    if (pkzh->method != 8) {
+	error("pkzip file uses invalid method");
+	return -1;
+    }
+    /* skip header */
+    offset = sizeof(*pkzh);
+    /* skip filename */
+    offset += pkzh->filename_len;
+    /* skip extra field */
+    offset += pkzh->extra_len;
+
+    if (offset > size || pkzh->zbytes > size - offset) {
+	error("pkzip file corrupt");
+	return -1;
+    }
+
+    zi->format = ZFMT_GZIP;
+    zi->zbytes = pkzh->zbytes;
+    zi->dbytes = pkzh->dbytes;
+    zi->crc = pkzh->crc;
+    zi->offset = offset;
+    return 0;
 }
 
 /*
- * Decompress the image, trying to flush the end of it as close
- * to end_mem as possible.  Return a pointer to the data block,
- * and change datalen.
+ * Return 0 if (indata, size) points to a compressed image, and fill
+ * in its format, compressed data size and offset, uncompressed data
+ * size and, for gzip and PKZIP, the CRC.
+ *
+ * If indata is not a compressed image, return -1.
  */
-extern void _end;
-
-static char heap[65536];
+int check_zip(const void *indata, uint32_t size, struct zimage *zi)
+{
+    const uint8_t *p = indata;
+
+    if (size >= 4 && p[0] == 0x1f && p[1] == 0x8b)
+	return check_gzip(p, size, zi);
+    else if (size >= 4 && p[0] == 'P' && p[1] == 'K' &&
+	     p[2] == 3 && p[3] == 4)
+	return check_pkzip(p, size, zi);
+    else if (!check_xz(p, size, zi) || !check_lzo(p, size, zi))
+	return 0;
+    else
+	return -1;		/* Magic number does not match */
+}
 
-void *unzip(void *indata, uint32_t zbytes, uint32_t dbytes,
-	    uint32_t orig_crc, void *target)
+static void inflate_image(const uint8_t *in, const struct zimage *zi,
+			  uint8_t *out)
 {
-    /* Set up the heap; it is simply a chunk of bss memory */
-    free_mem_ptr     = (size_t)heap;
-    free_mem_end_ptr = (size_t)heap + sizeof heap;
-
-    /* Set up input buffer */
-    inbuf = indata;
-    /* Sometimes inflate() looks beyond the end of the compressed data,
-       but it always backs up before it is done.  So we give it 4 bytes
-       of slack. */
-    insize = inbytes = zbytes + 4;
-
-    /* Set up output buffer */
-    outcnt = 0;
-    output_data = target;
-    output_size = dbytes;
-    bytes_out = 0;
-
-    makecrc();
-    gunzip();
-
-    /* Verify that gunzip() consumed the entire input. */
-    if (inbytes != 4)
+    z_stream zs;
+    int rv;
+
+    memset(&zs, 0, sizeof zs);
+    heap_ptr = 0;
+
+    /*
+     * Raw deflate data; the gzip or PKZIP wrapper has already been
+     * parsed by check_zip().  The input and output are given in one
+     * go, and inflate() is asked to finish in a single call.
+     */
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+	error("out of memory");
+
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = zi->zbytes;
+    zs.next_out = out;
+    zs.avail_out = zi->dbytes;
+
+    rv = inflate(&zs, Z_FINISH);
+    if (rv != Z_STREAM_END) {
+	if (rv == Z_DATA_ERROR)
+	    error(zs.msg ? zs.msg : "corrupt data");
+	else if (rv == Z_BUF_ERROR && !zs.avail_out)
+	    error("output buffer overrun");
+	else
+	    error("ran out of input data");
+    }
+
+    /* Verify that inflate() consumed the entire input. */
+    if (zs.avail_in)
 	error("compressed data length error");
 
     /* Check the uncompressed data length and CRC. */
-    if (bytes_out != dbytes)
+    if (zs.total_out != zi->dbytes)
 	error("uncompressed data length error");
 
-    if (orig_crc != CRC_VALUE)
+    if (crc32(0, out, zi->dbytes) != zi->crc)
 	error("crc error");
 
-    puts("ok\n");
+    inflateEnd(&zs);
+}
+
+/*
+ * Decompress the image into target, which has room for zi->dbytes
+ * bytes.  Returns target.
+ */
+void *unzip(const void *indata, const struct zimage *zi, void *target)
+{
+    const uint8_t *in = (const uint8_t *)indata + zi->offset;
+
+    switch (zi->format) {
+    case ZFMT_GZIP:
+	inflate_image(in, zi, target);
+	break;
+    case ZFMT_XZ:
+	unxz(in, zi, target);
+	break;
+    case ZFMT_LZO:
+	unlzo(in, zi, target);
+	break;
+    }
 
     return target;
 }
@@ -0,0 +1,56 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * unzip.h
+ *
+ * Decompression of compressed disk images.  This does not depend on
+ * the rest of MEMDISK, so the decoders can also be built on the host
+ * (see unzipbench.c.)
+ */
+
+#ifndef MEMDISK_UNZIP_H
+#define MEMDISK_UNZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum zformat {
+    ZFMT_GZIP,			/* gzip or PKZIP: deflate */
+    ZFMT_XZ,			/* xz: LZMA2 */
+    ZFMT_LZO,			/* lzop: LZO1X */
+};
+
+struct zimage {
+    enum zformat format;
+    uint32_t offset;		/* Offset of the compressed data */
+    uint32_t zbytes;		/* Size of the compressed data */
+    uint32_t dbytes;		/* Size of the decompressed data */
+    uint32_t crc;		/* CRC32 of the decompressed data (gzip) */
+};
+
+/*
+ * check_zip() returns 0 and fills in *zi if the data is in one of the
+ * formats we know, -1 otherwise.  unzip() decompresses it straight
+ * into target, which must have room for zi->dbytes bytes, and dies if
+ * the data is corrupt.
+ */
+extern int check_zip(const void *indata, uint32_t size, struct zimage *zi);
+extern void *unzip(const void *indata, const struct zimage *zi, void *target);
+
+/* Format-specific parts, used by the above */
+extern int check_xz(const uint8_t *indata, uint32_t size, struct zimage *zi);
+extern void unxz(const uint8_t *in, const struct zimage *zi, uint8_t *out);
+extern int check_lzo(const uint8_t *indata, uint32_t size, struct zimage *zi);
+extern void unlzo(const uint8_t *in, const struct zimage *zi, uint8_t *out);
+
+#endif /* MEMDISK_UNZIP_H */
@@ -0,0 +1,307 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * unzipbench.c
+ *
+ * Host-side benchmark of the MEMDISK image decompressors.  Each file
+ * given is decompressed repeatedly with the decoders from unzip.c,
+ * and gzip and PKZIP files also with the legacy inflate.c MEMDISK
+ * used before; the outputs are compared and the speeds printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "unzip.h"
+
+static const char *program;
+
+void __attribute__ ((noreturn)) die(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+/* ---------------------------------------------------------------------
+ * The legacy decoder: inflate.c with the glue MEMDISK used to have
+ * --------------------------------------------------------------------- */
+
+#define OF(args)  args
+#define STATIC static
+#define memzero(s, n)     memset ((s), 0, (n))
+
+typedef uint8_t uch;
+typedef uint16_t ush;
+typedef uint32_t ulg;
+
+#define WSIZE 0x8000
+
+static uch *inbuf;
+static uch window[WSIZE];
+static unsigned insize;
+static unsigned inbytes;
+static unsigned outcnt;
+
+#define Assert(cond,msg)
+#define Trace(x)
+#define Tracev(x)
+#define Tracevv(x)
+#define Tracec(c,x)
+#define Tracecv(c,x)
+
+static int fill_inbuf(void);
+static void flush_window(void);
+static void error(char *m);
+static void gzip_mark(void **);
+static void gzip_release(void **);
+
+static ulg crc_32_tab[256];
+
+static inline uch get_byte(void)
+{
+    if (inbytes) {
+	uch b = *inbuf++;
+	inbytes--;
+	return b;
+    } else {
+	return fill_inbuf();
+    }
+}
+
+static inline void unget_byte(void)
+{
+    inbytes++;
+    inbuf--;
+}
+
+static ulg bytes_out;
+static uch *output_data;
+static ulg output_size;
+
+#define malloc legacy_malloc
+#define free legacy_free
+#define inflate legacy_inflate
+static void *malloc(int size);
+static void free(void *where);
+
+static char heap[65536];
+static size_t free_mem_ptr, free_mem_end_ptr;
+
+#include "inflate.c"
+
+static void *malloc(int size)
+{
+    void *p;
+
+    free_mem_ptr = (free_mem_ptr + 3) & ~3;
+    p = (void *)free_mem_ptr;
+    free_mem_ptr += size;
+    if (size < 0 || free_mem_ptr >= free_mem_end_ptr)
+	error("out of memory");
+    return p;
+}
+
+static void free(void *where)
+{
+    (void)where;
+}
+
+#undef malloc
+#undef free
+#undef inflate
+
+static void gzip_mark(void **ptr)
+{
+    *ptr = (void *)free_mem_ptr;
+}
+
+static void gzip_release(void **ptr)
+{
+    free_mem_ptr = (size_t)*ptr;
+}
+
+static int fill_inbuf(void)
+{
+    die("Legacy decompression error: ran out of input data\n");
+}
+
+static void flush_window(void)
+{
+    ulg c = crc;
+    unsigned n;
+    uch *in, *out, ch;
+
+    if (bytes_out + outcnt > output_size)
+	error("output buffer overrun");
+
+    in = window;
+    out = output_data;
+    for (n = 0; n < outcnt; n++) {
+	ch = *out++ = *in++;
+	c = crc_32_tab[(c ^ ch) & 0xff] ^ (c >> 8);
+    }
+    crc = c;
+    output_data = out;
+    bytes_out += (ulg) outcnt;
+    outcnt = 0;
+}
+
+static void error(char *x)
+{
+    die("Legacy decompression error: %s\n", x);
+}
+
+static void legacy_unzip(const uint8_t *indata, const struct zimage *zi,
+			 uint8_t *target)
+{
+    free_mem_ptr = (size_t)heap;
+    free_mem_end_ptr = (size_t)heap + sizeof heap;
+
+    inbuf = (uch *)indata + zi->offset;
+    insize = inbytes = zi->zbytes + 4;
+
+    outcnt = 0;
+    output_data = target;
+    output_size = zi->dbytes;
+    bytes_out = 0;
+
+    makecrc();
+    gunzip();
+
+    if (inbytes != 4 || bytes_out != zi->dbytes ||
+	(uint32_t)CRC_VALUE != zi->crc)
+	error("bad output");
+}
+
+/* --------------------------------------------------------------------- */
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * Run one decoder over and over for at least mintime seconds;
+ * returns the speed in MB/s of output.
+ */
+static double bench(int legacy, const uint8_t *in, const struct zimage *zi,
+		    uint8_t *out, double mintime)
+{
+    double start = now(), elapsed;
+    unsigned long iter = 0;
+
+    do {
+	if (legacy)
+	    legacy_unzip(in, zi, out);
+	else
+	    unzip(in, zi, out);
+	iter++;
+	elapsed = now() - start;
+    } while (elapsed < mintime);
+
+    return (double)zi->dbytes * iter / elapsed / (1 << 20);
+}
+
+static uint8_t *read_file(const char *name, uint32_t *sizep)
+{
+    FILE *f = fopen(name, "rb");
+    uint8_t *buf;
+    long size;
+
+    if (!f || fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+	fseek(f, 0, SEEK_SET)) {
+	perror(name);
+	exit(1);
+    }
+    /* The legacy decoder may look 4 bytes past the end */
+    buf = calloc(1, size + 4);
+    if (!buf || fread(buf, 1, size, f) != (size_t)size) {
+	perror(name);
+	exit(1);
+    }
+    fclose(f);
+    *sizep = size;
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const zformats[] = {
+	[ZFMT_GZIP] = "gzip",
+	[ZFMT_XZ] = "xz",
+	[ZFMT_LZO] = "lzop",
+    };
+    double mintime = 1.0, newspeed, oldspeed;
+    struct zimage zi;
+    uint8_t *in, *out, *ref;
+    uint32_t size;
+    int i;
+
+    program = argv[0];
+
+    if (argc > 2 && !strcmp(argv[1], "-t")) {
+	mintime = atof(argv[2]);
+	argc -= 2;
+	argv += 2;
+    }
+    if (argc < 2) {
+	fprintf(stderr, "Usage: %s [-t seconds] file...\n", program);
+	return 1;
+    }
+
+    for (i = 1; i < argc; i++) {
+	in = read_file(argv[i], &size);
+	if (check_zip(in, size, &zi)) {
+	    fprintf(stderr, "%s: %s: not a compressed image\n",
+		    program, argv[i]);
+	    return 1;
+	}
+
+	out = malloc(zi.dbytes);
+	ref = malloc(zi.dbytes);
+	if (!out || !ref) {
+	    perror(program);
+	    return 1;
+	}
+
+	newspeed = bench(0, in, &zi, out, mintime);
+	printf("%s: %s, %" PRIu32 " -> %" PRIu32 " bytes: %.1f MB/s",
+	       argv[i], zformats[zi.format], size, zi.dbytes, newspeed);
+
+	if (zi.format == ZFMT_GZIP) {
+	    oldspeed = bench(1, in, &zi, ref, mintime);
+	    if (memcmp(out, ref, zi.dbytes))
+		die("\n%s: %s: output differs from the legacy decoder\n",
+		    program, argv[i]);
+	    printf(", legacy %.1f MB/s (%.2fx)", oldspeed,
+		   newspeed / oldspeed);
+	}
+	putchar('\n');
+
+	free(in);
+	free(out);
+	free(ref);
+    }
+
+    return 0;
+}
@@ -33,6 +33,8 @@ GCCOPT += $(call gcc_ok,-falign-labels=0,-malign-labels=0)
 GCCOPT += $(call gcc_ok,-falign-loops=0,-malign-loops=0)
 GCCOPT += $(call gcc_ok,-mpreferred-stack-boundary=2,)
 GCCOPT += $(call gcc_ok,-incoming-stack-boundary=2,)
+GCCOPT += $(call gcc_ok,-ffunction-sections,)
+GCCOPT += $(call gcc_ok,-fdata-sections,)
 
 com32  := $(topdir)/com32
 RELOCS := $(com32)/tools/relocs
@@ -55,7 +57,9 @@ SFLAGS     = $(GCCOPT) $(GCCWARN) -march=i386 \
 	     -I$(com32)/libutil/include -I$(com32)/include $(GPLINCLUDE)
 
 COM32LD	   = $(com32)/lib/com32.ld
-LDFLAGS    = -m elf_i386 --emit-relocs -T $(COM32LD)
+# Every module links its own copy of the library; drop the parts of
+# it the module doesn't use.
+LDFLAGS    = -m elf_i386 --emit-relocs --gc-sections -T $(COM32LD)
 LIBGCC    := $(shell $(CC) $(GCCOPT) --print-libgcc)
 
 LNXCFLAGS  = -I$(com32)/libutil/include $(GCCWARN) -O -g \
@@ -16,6 +16,8 @@ GCCOPT += $(call gcc_ok,-falign-jumps=0,-malign-jumps=0)
 GCCOPT += $(call gcc_ok,-falign-labels=0,-malign-labels=0)
 GCCOPT += $(call gcc_ok,-falign-loops=0,-malign-loops=0)
 GCCOPT += $(call gcc_ok,-mpreferred-stack-boundary=2,)
+GCCOPT += $(call gcc_ok,-ffunction-sections,)
+GCCOPT += $(call gcc_ok,-fdata-sections,)
 
 INCLUDE	= -I.
 STRIP	= strip --strip-all -R .comment -R .note
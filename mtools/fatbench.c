@@ -0,0 +1,269 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 53 Temple Place Ste 330,
+ *   Boston MA 02111-1307, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * fatbench.c
+ *
+ * Benchmark for libfat: make a large, sparse FAT32 image file holding
+ * a fragmented LDLINUX.SYS, then build its block map the way the
+ * installers do, and report the time taken and the reads issued.
+ *
+ * Usage: fatbench [-s size_mb] [-c sectors_per_cluster] [-k file_kb]
+ *                 [-r] [-1] [imagefile]
+ *
+ * -r scatters the clusters of the file randomly over the filesystem,
+ * instead of every 129th cluster (so that each step of the chain is
+ * in the next FAT sector); -1 reads one sector at a time, with no
+ * readahead.  Build with "make fatbench" in mtools.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include "libfat.h"
+#include "fat.h"
+
+#define SECTOR_SIZE	512
+#define RES_SECTORS	32
+
+static unsigned long nreads, nsectors_read;
+
+static void die(const char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+static int bench_read_multi(intptr_t pp, void *buf, size_t secsize,
+			    libfat_sector_t sector, unsigned int nsec)
+{
+    nreads++;
+    nsectors_read += nsec;
+    return pread(pp, buf, secsize * nsec, (off_t) sector * secsize);
+}
+
+static int bench_read(intptr_t pp, void *buf, size_t secsize,
+		      libfat_sector_t sector)
+{
+    return bench_read_multi(pp, buf, secsize, sector, 1);
+}
+
+static void put_sector(int fd, const void *buf, uint64_t sector)
+{
+    if (pwrite(fd, buf, SECTOR_SIZE, (off_t) sector * SECTOR_SIZE)
+	!= SECTOR_SIZE)
+	die("pwrite");
+}
+
+/* FAT writes go through a one-sector cache */
+static uint8_t fatbuf[SECTOR_SIZE];
+static uint32_t fatsect = -1;
+
+static void flush_fat(int fd, uint32_t fatsz)
+{
+    if (fatsect != (uint32_t) -1) {
+	put_sector(fd, fatbuf, RES_SECTORS + fatsect);
+	put_sector(fd, fatbuf, RES_SECTORS + fatsz + fatsect);
+    }
+}
+
+/* Set one FAT entry, in both FATs */
+static void set_fat(int fd, uint32_t fatsz, uint32_t cluster, uint32_t val)
+{
+    uint32_t sect = cluster >> 7;
+
+    if (sect != fatsect) {
+	flush_fat(fd, fatsz);
+	if (pread(fd, fatbuf, SECTOR_SIZE,
+		  (off_t) (RES_SECTORS + sect) * SECTOR_SIZE) != SECTOR_SIZE)
+	    die("pread");
+	fatsect = sect;
+    }
+
+    write32((le32_t *) & fatbuf[(cluster & 127) << 2], val);
+}
+
+/*
+ * Make a FAT32 filesystem of the given size, with nothing in it but
+ * LDLINUX.SYS, of fileclust clusters.
+ */
+static void make_image(int fd, uint64_t sectors, unsigned int spc,
+		       uint32_t fileclust, int scatter)
+{
+    static uint8_t buf[SECTOR_SIZE];
+    struct fat_bootsect *bs = (struct fat_bootsect *)buf;
+    struct fat_dirent *de = (struct fat_dirent *)buf;
+    uint32_t fatsz, nclusters, i, c, next;
+    uint8_t *used;
+
+    /* Solve for the FAT size */
+    fatsz = 1;
+    for (;;) {
+	nclusters = (sectors - RES_SECTORS - 2 * fatsz) / spc;
+	if (((nclusters + 2) * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE <= fatsz)
+	    break;
+	fatsz = ((nclusters + 2) * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    }
+    if (nclusters <= 0xfff4 || fileclust + 1 >= nclusters) {
+	fprintf(stderr, "fatbench: filesystem too small for FAT32\n");
+	exit(1);
+    }
+
+    if (ftruncate(fd, 0) || ftruncate(fd, (off_t) sectors * SECTOR_SIZE))
+	die("ftruncate");
+
+    memset(buf, 0, sizeof buf);
+    memcpy(bs->bsOemName, "FATBENCH", 8);
+    write16(&bs->bsBytesPerSec, SECTOR_SIZE);
+    write8(&bs->bsSecPerClust, spc);
+    write16(&bs->bsResSectors, RES_SECTORS);
+    write8(&bs->bsFATs, 2);
+    write8(&bs->bsMedia, 0xf8);
+    write32(&bs->bsHugeSectors, sectors);
+    write32(&bs->u.fat32.bpb_fatsz32, fatsz);
+    write32(&bs->u.fat32.bpb_rootclus, 2);
+    write16(&bs->bsSignature, BS_SIGNATURE);
+    put_sector(fd, buf, 0);
+
+    /* The root directory, in cluster 2, holds LDLINUX.SYS */
+    set_fat(fd, fatsz, 0, 0x0ffffff8);
+    set_fat(fd, fatsz, 1, 0x0fffffff);
+    set_fat(fd, fatsz, 2, 0x0fffffff);
+
+    used = calloc(nclusters + 2, 1);
+    if (!used)
+	die("calloc");
+
+    srand(1);
+    c = 3;
+    memset(buf, 0, sizeof buf);
+    memcpy(de->name, "LDLINUX SYS", 11);
+    write8(&de->attribute, 0x07);
+    write16(&de->clustlo, c);
+    write16(&de->clusthi, c >> 16);
+    write32(&de->size, fileclust * spc * SECTOR_SIZE);
+    put_sector(fd, buf, RES_SECTORS + 2 * fatsz);
+
+    used[c] = 1;
+    for (i = 1; i <= fileclust; i++) {
+	if (i == fileclust) {
+	    next = 0x0fffffff;
+	} else {
+	    next = scatter ? 3 + (uint32_t) rand() % (nclusters - 1)
+		: 3 + (i * 129) % (nclusters - 1);
+	    while (used[next])
+		next = next + 1 < nclusters + 2 ? next + 1 : 3;
+	    used[next] = 1;
+	}
+	set_fat(fd, fatsz, c, next);
+	c = next;
+    }
+    flush_fat(fd, fatsz);
+
+    free(used);
+}
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *image = "fatbench.img";
+    uint64_t size_mb = 32768;
+    unsigned int spc = 8, file_kb = 4096;
+    int scatter = 0, single = 0;
+    int opt, fd;
+    struct libfat_filesystem *fs;
+    libfat_sector_t s;
+    int32_t cluster;
+    unsigned long nsectors = 0;
+    double start, elapsed;
+
+    while ((opt = getopt(argc, argv, "s:c:k:r1")) != -1) {
+	switch (opt) {
+	case 's':
+	    size_mb = strtoull(optarg, NULL, 0);
+	    break;
+	case 'c':
+	    spc = strtoul(optarg, NULL, 0);
+	    break;
+	case 'k':
+	    file_kb = strtoul(optarg, NULL, 0);
+	    break;
+	case 'r':
+	    scatter = 1;
+	    break;
+	case '1':
+	    single = 1;
+	    break;
+	default:
+	    fprintf(stderr, "Usage: %s [-s size_mb] [-c sectors_per_cluster] "
+		    "[-k file_kb] [-r] [-1] [imagefile]\n", argv[0]);
+	    return 1;
+	}
+    }
+    if (optind < argc)
+	image = argv[optind];
+
+    if (!spc || (spc & (spc - 1)) || spc > 128) {
+	fprintf(stderr, "%s: bad cluster size\n", argv[0]);
+	return 1;
+    }
+
+    fd = open(image, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+	die(image);
+
+    make_image(fd, size_mb << 11, spc,
+	       (file_kb * 2 + spc - 1) / spc, scatter);
+    fsync(fd);
+
+    start = now();
+
+    fs = libfat_open(bench_read, fd);
+    if (!fs) {
+	fprintf(stderr, "%s: libfat_open failed\n", argv[0]);
+	return 1;
+    }
+    if (!single)
+	libfat_set_readmulti(fs, bench_read_multi);
+
+    cluster = libfat_searchdir(fs, 0, "LDLINUX SYS", NULL);
+    s = libfat_clustertosector(fs, cluster);
+    while (s && s != (libfat_sector_t) - 1) {
+	nsectors++;
+	s = libfat_nextsector(fs, s);
+    }
+    libfat_close(fs);
+
+    elapsed = now() - start;
+
+    printf("%llu MB, %u sectors/cluster, %s file of %lu sectors: "
+	   "%.2f ms, %lu reads, %lu sectors read\n",
+	   (unsigned long long)size_mb, spc,
+	   scatter ? "scattered" : "strided", nsectors,
+	   elapsed * 1000, nreads, nsectors_read);
+
+    close(fd);
+    unlink(image);
+
+    return s ? 1 : 0;
+}
@@ -125,6 +125,13 @@ int libfat_xpread(intptr_t pp, void *buf, size_t secsize,
     return xpread(pp, buf, secsize, offset);
 }
 
+int libfat_xpread_multi(intptr_t pp, void *buf, size_t secsize,
+			libfat_sector_t sector, unsigned int nsec)
+{
+    off_t offset = (off_t) sector * secsize + opt.offset;
+    return xpread(pp, buf, secsize * nsec, offset);
+}
+
 int main(int argc, char *argv[])
 {
     static unsigned char sectbuf[SECTOR_SIZE];
@@ -260,6 +267,7 @@ int main(int argc, char *argv[])
 		       + SECTOR_SIZE - 1) >> SECTOR_SHIFT;
     sectors = calloc(ldlinux_sectors, sizeof *sectors);
     fs = libfat_open(libfat_xpread, dev_fd);
+    libfat_set_readmulti(fs, libfat_xpread_multi);
     ldlinux_cluster = libfat_searchdir(fs, 0, "LDLINUX SYS", NULL);
     secp = sectors;
     nsectors = 0;
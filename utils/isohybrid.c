@@ -671,16 +671,50 @@ display_mbr(const uint8_t *mbr, size_t len)
 }
 
 
+/*
+ * Slice-by-8 CRC32: crc_slice[k][i] is the CRC of byte i followed by k
+ * zero bytes, so eight bytes can be folded in with eight table lookups
+ * and no dependency between them.  The tables are derived from crc_tab
+ * the first time they are needed.
+ */
+static uint32_t crc_slice[8][256];
+
+static void init_crc_slice(void)
+{
+	int i, k;
+
+	for (i = 0; i < 256; i++)
+		crc_slice[0][i] = crc_tab[i];
+
+	for (k = 1; k < 8; k++)
+		for (i = 0; i < 256; i++)
+			crc_slice[k][i] = (crc_slice[k - 1][i] >> 8)
+				^ crc_tab[crc_slice[k - 1][i] & 0xFF];
+}
+
 uint32_t chksum_crc32 (unsigned char *block, unsigned int length)
 {
-	register unsigned long crc;
-	unsigned long i;
+	uint32_t crc, lo, hi;
+
+	if (!crc_slice[1][1])
+		init_crc_slice();
 
 	crc = 0xFFFFFFFF;
-	for (i = 0; i < length; i++)
+	for (; length >= 8; length -= 8, block += 8)
 	{
-		crc = ((crc >> 8) & 0x00FFFFFF) ^ crc_tab[(crc ^ *block++) & 0xFF];
+		lo = crc ^ (block[0] | block[1] << 8 | block[2] << 16
+			    | (uint32_t)block[3] << 24);
+		hi = block[4] | block[5] << 8 | block[6] << 16
+			| (uint32_t)block[7] << 24;
+
+		crc = crc_slice[7][lo & 0xFF] ^ crc_slice[6][(lo >> 8) & 0xFF]
+			^ crc_slice[5][(lo >> 16) & 0xFF] ^ crc_slice[4][lo >> 24]
+			^ crc_slice[3][hi & 0xFF] ^ crc_slice[2][(hi >> 8) & 0xFF]
+			^ crc_slice[1][(hi >> 16) & 0xFF] ^ crc_slice[0][hi >> 24];
 	}
+	while (length--)
+		crc = (crc >> 8) ^ crc_tab[(crc ^ *block++) & 0xFF];
+
 	return (crc ^ 0xFFFFFFFF);
 }
 
@@ -839,7 +873,7 @@ int
 main(int argc, char *argv[])
 {
     int i = 0;
-    FILE *fp = NULL;
+    int fd = -1;
     uint8_t *buf = NULL, *bufz = NULL;
     int cylsize = 0, frac = 0;
     size_t orig_gpt_size, free_space, gpt_size;
@@ -861,20 +895,20 @@ main(int argc, char *argv[])
 
     srand(time(NULL) << (getppid() << getpid()));
 
-    if (!(fp = fopen(argv[0], "r+")))
+    /*
+     * All I/O is positioned reads and writes straight on the descriptor:
+     * only a few sectors at either end of the image are ever touched, so
+     * there is nothing for stdio buffering to gain, and nothing to flush
+     * before the image is extended.
+     */
+    if ((fd = open(argv[0], O_RDWR)) < 0)
         err(1, "could not open file `%s'", argv[0]);
 
-    if (fseek(fp, (16 << 11), SEEK_SET))
-        err(1, "%s: seek error - 0", argv[0]);
-
-    if (fread(&descriptor, sizeof(char), sizeof(descriptor), fp) != sizeof(descriptor))
+    if (pread(fd, &descriptor, sizeof(descriptor), 16 << 11) != sizeof(descriptor))
         err(1, "%s: read error - 0", argv[0]);
 
-    if (fseek(fp, 17 * 2048, SEEK_SET))
-        err(1, "%s: seek error - 1", argv[0]);
-
     bufz = buf = calloc(BUFSIZE, sizeof(char));
-    if (fread(buf, sizeof(char), BUFSIZE, fp) != BUFSIZE)
+    if (pread(fd, buf, BUFSIZE, 17 * 2048) != BUFSIZE)
         err(1, "%s", argv[0]);
 
     if (check_banner(buf))
@@ -883,12 +917,9 @@ main(int argc, char *argv[])
     if (mode & VERBOSE)
         printf("catalogue offset: %d\n", catoffset);
 
-    if (fseek(fp, catoffset * 2048, SEEK_SET))
-        err(1, "%s: seek error - 2", argv[0]);
-
     buf = bufz;
     memset(buf, 0, BUFSIZE);
-    if (fread(buf, sizeof(char), BUFSIZE, fp) != BUFSIZE)
+    if (pread(fd, buf, BUFSIZE, (off_t)catoffset * 2048) != BUFSIZE)
         err(1, "%s", argv[0]);
 
     if (check_catalogue(buf))
@@ -935,12 +966,9 @@ main(int argc, char *argv[])
 	}
     }
 
-    if (fseek(fp, (de_lba * 2048 + 0x40), SEEK_SET))
-        err(1, "%s: seek error - 3", argv[0]);
-
     buf = bufz;
     memset(buf, 0, BUFSIZE);
-    if (fread(buf, sizeof(char), 4, fp) != 4)
+    if (pread(fd, buf, 4, (off_t)de_lba * 2048 + 0x40) != 4)
         err(1, "%s", argv[0]);
 
     if (memcmp(buf, "\xFB\xC0\x78\x70", 4))
@@ -971,10 +999,7 @@ main(int argc, char *argv[])
 
     if (!id)
     {
-        if (fseek(fp, 440, SEEK_SET))
-            err(1, "%s: seek error - 4", argv[0]);
-
-	if (fread(&id, 1, 4, fp) != 4)
+	if (pread(fd, &id, 4, 440) != 4)
 	    err(1, "%s: read error", argv[0]);
 
         id = lendian_int(id);
@@ -995,10 +1020,7 @@ main(int argc, char *argv[])
     if (mode & VERBOSE)
         display_mbr(buf, i);
 
-    if (fseek(fp, 0, SEEK_SET))
-        err(1, "%s: seek error - 5", argv[0]);
-
-    if (fwrite(buf, sizeof(char), i, fp) != (size_t)i)
+    if (pwrite(fd, buf, i, 0) != i)
         err(1, "%s: write error - 1", argv[0]);
 
     if (efi_lba) {
@@ -1036,10 +1058,7 @@ main(int argc, char *argv[])
 	 */
 	initialise_gpt(buf, 1, (isostat.st_size + padding - 1024) / 512, 1);
 
-	if (fseek(fp, 512, SEEK_SET))
-	    err(1, "%s: seek error - 6", argv[0]);
-
-	if (fwrite(buf, sizeof(char), gpt_size, fp) != (size_t)gpt_size)
+	if (pwrite(fd, buf, gpt_size, 512) != (ssize_t)gpt_size)
 	    err(1, "%s: write error - 2", argv[0]);
     }
 
@@ -1053,16 +1072,14 @@ main(int argc, char *argv[])
 
 	initialise_apm(buf, APM_OFFSET);
 
-	fseek(fp, APM_OFFSET, SEEK_SET);
-	fwrite(buf, sizeof(char), apm_size, fp);
+	if (pwrite(fd, buf, apm_size, APM_OFFSET) != apm_size)
+	    err(1, "%s: write error - 3", argv[0]);
     }
 
+    /* The padding is left as a hole; there is no need to write zeroes */
     if (padding)
     {
-        if (fsync(fileno(fp)))
-            err(1, "%s: could not synchronise", argv[0]);
-
-        if (ftruncate(fileno(fp), isostat.st_size + padding))
+        if (ftruncate(fd, isostat.st_size + padding))
             err(1, "%s: could not add padding bytes", argv[0]);
     }
 
@@ -1082,16 +1099,15 @@ main(int argc, char *argv[])
 	 * end of the image
 	 */
 
-	if (fseek(fp, (isostat.st_size + padding) - orig_gpt_size - 512,
-		  SEEK_SET))
-	    err(1, "%s: seek error - 8", argv[0]);
-
-	if (fwrite(buf, sizeof(char), orig_gpt_size, fp) != orig_gpt_size)
+	if (pwrite(fd, buf, orig_gpt_size,
+		   (isostat.st_size + padding) - orig_gpt_size - 512)
+	    != (ssize_t)orig_gpt_size)
 	    err(1, "%s: write error - 4", argv[0]);
     }
 
     free(buf);
-    fclose(fp);
+    if (close(fd))
+        err(1, "%s: close error", argv[0]);
 
     return 0;
 }
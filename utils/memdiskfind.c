@@ -155,8 +155,11 @@ int main(int argc, char *argv[])
     end = map + (0xa0000 - mapbase);
     while (ptr < end) {
 	if (valid_mbft((const struct mBFT *)ptr, end-ptr)) {
-	    output_params((const struct mBFT *)ptr);
-	    err = 0;
+	    /* A block-mapped image has no flat copy in high memory */
+	    if (((const struct mBFT *)ptr)->mdi.diskbuf >= 0x100000) {
+		output_params((const struct mBFT *)ptr);
+		err = 0;
+	    }
 	    break;
 	}
 	ptr += 16;
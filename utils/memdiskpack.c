@@ -0,0 +1,405 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * memdiskpack.c
+ *
+ * Convert a raw disk image into a MEMDISK block-mapped image, in which
+ * each block is compressed on its own, so MEMDISK can keep the image
+ * compressed in memory and decode blocks as they are read.  All-zero
+ * blocks are left out of the image entirely.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../memdisk/blkimg.h"
+
+#define HASH_BITS	14
+
+static const char *program;
+
+static void usage(void)
+{
+    fprintf(stderr,
+	    "Usage: %s [options] input output\n"
+	    "  -b size   block size in bytes, %u-%u (default %u)\n"
+	    "  -n        store blocks uncompressed (zero blocks are still\n"
+	    "            left out)\n"
+	    "  -v        print statistics\n",
+	    program, 1 << BLKIMG_MIN_SHIFT, 1 << BLKIMG_MAX_SHIFT,
+	    1 << BLKIMG_DEF_SHIFT);
+    exit(1);
+}
+
+static void __attribute__ ((noreturn)) die_err(const char *what)
+{
+    fprintf(stderr, "%s: %s: %s\n", program, what, strerror(errno));
+    exit(1);
+}
+
+static inline uint32_t get_32(const uint8_t *p)
+{
+    return p[0] + (p[1] << 8) + (p[2] << 16) + ((uint32_t)p[3] << 24);
+}
+
+static inline void set_16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void set_32(uint8_t *p, uint32_t v)
+{
+    set_16(p, v);
+    set_16(p + 2, v >> 16);
+}
+
+static inline void set_64(uint8_t *p, uint64_t v)
+{
+    set_32(p, v);
+    set_32(p + 4, v >> 32);
+}
+
+static int all_zero(const uint8_t *p, uint32_t len)
+{
+    while (len--)
+	if (*p++)
+	    return 0;
+    return 1;
+}
+
+static inline uint32_t hash4(const uint8_t *p)
+{
+    return (get_32(p) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/* Emit an LZ4 length extension */
+static uint8_t *put_length(uint8_t *op, uint32_t len)
+{
+    while (len >= 255) {
+	*op++ = 255;
+	len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+/*
+ * Compress one block in the LZ4 block format, greedy matching on a
+ * hash of the next four bytes.  Returns the compressed size, or 0 if
+ * the result would not be smaller than max bytes.
+ */
+static uint32_t lz4_compress(const uint8_t *src, uint32_t len,
+			     uint8_t *dst, uint32_t max)
+{
+    static int32_t table[1 << HASH_BITS];
+    const uint8_t *ip = src, *anchor = src;
+    const uint8_t *iend = src + len;
+    const uint8_t *mflimit = iend - 12;	/* Last match start + 1 */
+    const uint8_t *matchlimit = iend - 5;	/* Last match end */
+    const uint8_t *ref;
+    uint8_t *op = dst, *token;
+    uint32_t h, litlen, mlen;
+
+    /* Worst case for a sequence: 1 + 1 + len/255 + literals + 2 + ... */
+#define ROOM(n) ((uint32_t)(dst + max - op) > (n))
+
+    memset(table, -1, sizeof table);
+
+    if (len > 12) {
+	while (ip < mflimit) {
+	    h = hash4(ip);
+	    ref = src + table[h];
+	    table[h] = ip - src;
+
+	    if (ref < src || get_32(ref) != get_32(ip)) {
+		ip++;
+		continue;
+	    }
+
+	    mlen = 4;
+	    while (ip + mlen < matchlimit && ref[mlen] == ip[mlen])
+		mlen++;
+
+	    litlen = ip - anchor;
+	    if (!ROOM(litlen + litlen / 255 + mlen / 255 + 8))
+		return 0;
+
+	    token = op++;
+	    *token = (litlen < 15 ? litlen : 15) << 4;
+	    if (litlen >= 15)
+		op = put_length(op, litlen - 15);
+	    memcpy(op, anchor, litlen);
+	    op += litlen;
+
+	    set_16(op, ip - ref);
+	    op += 2;
+
+	    *token |= (mlen - 4 < 15) ? mlen - 4 : 15;
+	    if (mlen - 4 >= 15)
+		op = put_length(op, mlen - 4 - 15);
+
+	    ip += mlen;
+	    anchor = ip;
+	}
+    }
+
+    /* Final literals */
+    litlen = iend - anchor;
+    if (!ROOM(litlen + litlen / 255 + 2))
+	return 0;
+    token = op++;
+    *token = (litlen < 15 ? litlen : 15) << 4;
+    if (litlen >= 15)
+	op = put_length(op, litlen - 15);
+    memcpy(op, anchor, litlen);
+    op += litlen;
+
+#undef ROOM
+
+    return op - dst;
+}
+
+/*
+ * Decode an LZ4 block, used to verify the output of the compressor.
+ * Returns the number of bytes produced, or -1 on error.
+ */
+static int lz4_decode(const uint8_t *src, uint32_t srclen,
+		      uint8_t *dst, uint32_t dstlen)
+{
+    const uint8_t *ip = src, *iend = src + srclen;
+    uint8_t *op = dst, *oend = dst + dstlen;
+    const uint8_t *ref;
+    uint32_t len;
+    uint8_t token, c;
+
+    while (ip < iend) {
+	token = *ip++;
+
+	len = token >> 4;
+	if (len == 15) {
+	    do {
+		if (ip >= iend)
+		    return -1;
+		c = *ip++;
+		len += c;
+	    } while (c == 255);
+	}
+	if (len > (uint32_t)(iend - ip) || len > (uint32_t)(oend - op))
+	    return -1;
+	memcpy(op, ip, len);
+	op += len;
+	ip += len;
+
+	if (ip >= iend)
+	    break;
+
+	if (iend - ip < 2)
+	    return -1;
+	ref = op - (ip[0] + (ip[1] << 8));
+	ip += 2;
+	if (ref < dst || ref == op)
+	    return -1;
+
+	len = token & 15;
+	if (len == 15) {
+	    do {
+		if (ip >= iend)
+		    return -1;
+		c = *ip++;
+		len += c;
+	    } while (c == 255);
+	}
+	len += 4;
+	if (len > (uint32_t)(oend - op))
+	    return -1;
+	while (len--)
+	    *op++ = *ref++;
+    }
+
+    return op - dst;
+}
+
+static void xpwrite(int fd, const void *buf, size_t len, off_t offset,
+		    const char *name)
+{
+    ssize_t rv;
+
+    while (len) {
+	rv = pwrite(fd, buf, len, offset);
+	if (rv < 0) {
+	    if (errno == EINTR)
+		continue;
+	    die_err(name);
+	}
+	buf = (const char *)buf + rv;
+	len -= rv;
+	offset += rv;
+    }
+}
+
+static size_t xread(int fd, void *buf, size_t len, const char *name)
+{
+    size_t done = 0;
+    ssize_t rv;
+
+    while (done < len) {
+	rv = read(fd, (char *)buf + done, len - done);
+	if (rv < 0) {
+	    if (errno == EINTR)
+		continue;
+	    die_err(name);
+	}
+	if (!rv)
+	    break;
+	done += rv;
+    }
+    return done;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt, ifd, ofd;
+    unsigned int shift = BLKIMG_DEF_SHIFT;
+    int compress = 1, verbose = 0;
+    uint32_t bsize, block, nblocks, zlen;
+    uint64_t disk_size, offset, nzipped = 0, nzero = 0;
+    uint8_t hdr[sizeof(struct blkimg_header)];
+    uint8_t *map, *buf, *zbuf, *vbuf;
+    struct stat st;
+    const char *iname, *oname;
+    size_t got;
+
+    program = argv[0];
+
+    while ((opt = getopt(argc, argv, "b:nv")) != -1) {
+	switch (opt) {
+	case 'b':
+	    bsize = strtoul(optarg, NULL, 0);
+	    for (shift = BLKIMG_MIN_SHIFT; shift <= BLKIMG_MAX_SHIFT; shift++)
+		if (bsize == 1U << shift)
+		    break;
+	    if (shift > BLKIMG_MAX_SHIFT)
+		usage();
+	    break;
+	case 'n':
+	    compress = 0;
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	default:
+	    usage();
+	}
+    }
+
+    if (argc - optind != 2)
+	usage();
+    iname = argv[optind];
+    oname = argv[optind + 1];
+
+    ifd = open(iname, O_RDONLY);
+    if (ifd < 0 || fstat(ifd, &st))
+	die_err(iname);
+    disk_size = st.st_size;
+    if (!disk_size || disk_size > 0xFFFFFFFF) {
+	fprintf(stderr, "%s: %s: image size not supported\n",
+		program, iname);
+	exit(1);
+    }
+
+    ofd = open(oname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (ofd < 0)
+	die_err(oname);
+
+    bsize = 1 << shift;
+    nblocks = (disk_size + bsize - 1) >> shift;
+
+    map = calloc(nblocks, sizeof(struct blkimg_entry));
+    buf = malloc(bsize);
+    zbuf = malloc(bsize);
+    vbuf = malloc(bsize);
+    if (!map || !buf || !zbuf || !vbuf)
+	die_err("malloc");
+
+    memset(hdr, 0, sizeof hdr);
+    set_32(hdr, BLKIMG_MAGIC);
+    set_16(hdr + 4, BLKIMG_VERSION);
+    hdr[6] = shift;
+    set_32(hdr + 8, sizeof hdr);
+    set_32(hdr + 12, nblocks);
+    set_64(hdr + 16, disk_size);
+
+    offset = sizeof hdr + nblocks * sizeof(struct blkimg_entry);
+
+    for (block = 0; block < nblocks; block++) {
+	got = xread(ifd, buf, bsize, iname);
+	memset(buf + got, 0, bsize - got);	/* Pad the last block */
+
+	if (all_zero(buf, bsize)) {
+	    nzero++;		/* Map entry stays 0, 0 */
+	    continue;
+	}
+
+	zlen = compress ? lz4_compress(buf, bsize, zbuf, bsize) : 0;
+	if (zlen && (lz4_decode(zbuf, zlen, vbuf, bsize) != (int)bsize ||
+		     memcmp(buf, vbuf, bsize))) {
+	    fprintf(stderr, "%s: internal error: block %u does not "
+		    "decompress correctly\n", program, block);
+	    exit(1);
+	}
+
+	if (offset + bsize > 0xFFFFFFFF) {
+	    fprintf(stderr, "%s: %s: output image too large\n",
+		    program, oname);
+	    exit(1);
+	}
+
+	set_32(map + block * 8, offset);
+	set_32(map + block * 8 + 4, zlen);
+
+	if (zlen) {
+	    xpwrite(ofd, zbuf, zlen, offset, oname);
+	    offset += (zlen + 3) & ~3;
+	    nzipped++;
+	} else {
+	    xpwrite(ofd, buf, bsize, offset, oname);
+	    offset += bsize;
+	}
+    }
+
+    /* Pad the image to a multiple of 4 bytes */
+    if (ftruncate(ofd, offset))
+	die_err(oname);
+
+    xpwrite(ofd, hdr, sizeof hdr, 0, oname);
+    xpwrite(ofd, map, nblocks * sizeof(struct blkimg_entry), sizeof hdr,
+	    oname);
+
+    if (close(ofd))
+	die_err(oname);
+    close(ifd);
+
+    if (verbose)
+	printf("%s: %u blocks of %u bytes, %" PRIu64 " compressed, "
+	       "%" PRIu64 " zero, %" PRIu64 " -> %" PRIu64 " bytes (%u%%)\n",
+	       oname, nblocks, bsize, nzipped, nzero, disk_size, offset,
+	       (unsigned int)((offset * 100) / disk_size));
+
+    return 0;
+}
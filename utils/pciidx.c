@@ -0,0 +1,395 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Copyright 2011 Intel Corporation; author: H. Peter Anvin
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *   Boston MA 02110-1301, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * pciidx.c
+ *
+ * Compile pci.ids, modules.alias or modules.pcimap into the binary
+ * index format read by the COM32 PCI library (see sys/pciidx.h), so
+ * that HDT and pcitest.c32 can look up the devices present without
+ * parsing the whole text file.  The index is looked for as the name of
+ * the text file with ".idx" appended, e.g.:
+ *
+ *	pciidx pci.ids pci.ids.idx
+ *	pciidx -a modules.alias modules.alias.idx
+ *
+ * An input of "-" is read from stdin.
+ */
+
+#include <ctype.h>
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../com32/include/sys/pciidx.h"
+
+enum input_type {
+    INPUT_PCI_IDS,
+    INPUT_MODULES_ALIAS,
+    INPUT_MODULES_PCIMAP,
+};
+
+struct entry {
+    struct pciidx_key key;	/* In host byte order */
+    unsigned int seq;		/* Input order, to keep the sort stable */
+    char *name;
+};
+
+static const char *program;
+static struct entry *entries;
+static unsigned int nentries, maxentries;
+
+static void __attribute__ ((noreturn)) usage(void)
+{
+    fprintf(stderr, "Usage: %s [-a | -m] input output\n"
+	    "  (default) input is pci.ids\n"
+	    "  -a        input is modules.alias\n"
+	    "  -m        input is modules.pcimap\n", program);
+    exit(1);
+}
+
+static void __attribute__ ((noreturn)) die(const char *msg)
+{
+    fprintf(stderr, "%s: %s: %s\n", program, msg, strerror(errno));
+    exit(1);
+}
+
+static char *skipspace(char *p)
+{
+    while (*p && isspace((unsigned char)*p))
+	p++;
+    return p;
+}
+
+static void add_entry(int group, int type, unsigned int a, unsigned int b,
+		      unsigned int c, unsigned int d, const char *name)
+{
+    struct entry *e;
+    size_t len;
+
+    if (nentries >= maxentries) {
+	maxentries = maxentries ? maxentries * 2 : 4096;
+	entries = realloc(entries, maxentries * sizeof *entries);
+	if (!entries)
+	    die("realloc");
+    }
+
+    e = &entries[nentries];
+    e->key.group = group;
+    e->key.type = type;
+    e->key.id[0] = a;
+    e->key.id[1] = b;
+    e->key.id[2] = c;
+    e->key.id[3] = d;
+    e->seq = nentries++;
+
+    len = strlen(name);
+    if (len > PCIIDX_MAX_NAME)
+	len = PCIIDX_MAX_NAME;
+    e->name = strndup(name, len);
+    if (!e->name)
+	die("strndup");
+}
+
+/* The name field of a pci.ids line: whatever follows the first space */
+static char *ids_name(char *line)
+{
+    char *p = strchr(line, ' ');
+
+    return p ? skipspace(p) : line + strlen(line);
+}
+
+static void parse_pci_ids(FILE *f)
+{
+    char line[512];
+    unsigned int vendor = 0, device = 0, class = 0;
+    int class_mode = 0, have_vendor = 0;
+    char *p;
+
+    while (fgets(line, sizeof line, f)) {
+	line[strcspn(line, "\r\n")] = '\0';
+	if (line[0] == '#' || line[0] == ' ' || !line[0])
+	    continue;
+
+	if (line[0] == 'C' && line[1] == ' ') {
+	    class_mode = 1;
+	    class = strtoul(line + 2, NULL, 16);
+	    add_entry(PCIIDX_GROUP_CLASS, PCIIDX_CLASS, class, 0, 0, 0,
+		      ids_name(line));
+	} else if (class_mode) {
+	    /* Subclasses; programming interfaces are not used */
+	    if (line[0] == '\t' && line[1] != '\t')
+		add_entry(PCIIDX_GROUP_CLASS, PCIIDX_SUBCLASS, class,
+			  strtoul(line + 1, NULL, 16), 0, 0, ids_name(line));
+	} else if (line[0] != '\t') {
+	    vendor = strtoul(line, NULL, 16);
+	    have_vendor = 1;
+	    add_entry(PCIIDX_GROUP_IDS, PCIIDX_VENDOR, vendor, 0, 0, 0,
+		      ids_name(line));
+	} else if (!have_vendor) {
+	    continue;
+	} else if (line[1] != '\t') {
+	    device = strtoul(line + 1, NULL, 16);
+	    add_entry(PCIIDX_GROUP_IDS, PCIIDX_DEVICE, vendor, device, 0, 0,
+		      ids_name(line));
+	} else {
+	    /* "\t\tsubvendor subdevice  name" */
+	    unsigned int sv = strtoul(line + 2, &p, 16);
+	    unsigned int sd = strtoul(p, NULL, 16);
+
+	    add_entry(PCIIDX_GROUP_IDS, PCIIDX_SUBSYS, vendor, device, sv, sd,
+		      ids_name(ids_name(line)));
+	}
+    }
+}
+
+/*
+ * One field of a modules.alias pattern (eight hex digits or '*'),
+ * followed by the given tag; a wildcard gives 0xffff for a subsystem
+ * ID, and makes the alias useless to us (returns -1) for a vendor or
+ * device ID.
+ */
+static int alias_field(char **pp, const char *tag, int wild)
+{
+    char *p = *pp;
+    unsigned long v = 0;
+    int i;
+
+    if (*p == '*') {
+	p++;
+	v = wild;
+    } else {
+	for (i = 0; i < 8; i++, p++) {
+	    if (!isxdigit((unsigned char)*p))
+		return -1;
+	    v = (v << 4) + (isdigit((unsigned char)*p) ? *p - '0'
+			    : (tolower((unsigned char)*p) - 'a' + 10));
+	}
+	if (v > 0xffff)
+	    return -1;
+    }
+
+    if (strncmp(p, tag, strlen(tag)))
+	return -1;
+    *pp = p + strlen(tag);
+    return v;
+}
+
+static void parse_modules_alias(FILE *f)
+{
+    char line[512];
+    char *p, *module;
+    int vendor, device, sv, sd;
+
+    while (fgets(line, sizeof line, f)) {
+	line[strcspn(line, "\r\n")] = '\0';
+	if (strncmp(line, "alias pci:v", 11))
+	    continue;
+
+	p = line + 11;
+	if ((vendor = alias_field(&p, "d", -1)) < 0 ||
+	    (device = alias_field(&p, "sv", -1)) < 0 ||
+	    (sv = alias_field(&p, "sd", 0xffff)) < 0 ||
+	    (sd = alias_field(&p, "bc", 0xffff)) < 0)
+	    continue;
+
+	module = strrchr(p, ' ');
+	if (!module || !module[1])
+	    continue;
+
+	add_entry(PCIIDX_GROUP_MODULE, PCIIDX_MODULE, vendor, device, sv, sd,
+		  module + 1);
+    }
+}
+
+static void parse_modules_pcimap(FILE *f)
+{
+    char line[512];
+    char module[256], *p;
+    unsigned long vendor, device, sv, sd;
+
+    while (fgets(line, sizeof line, f)) {
+	if (line[0] == '#' || line[0] == ' ' || line[0] == '\n')
+	    continue;
+	if (sscanf(line, "%255s %lx %lx %lx %lx",
+		   module, &vendor, &device, &sv, &sd) != 5)
+	    continue;
+
+	/* PCI_ANY_ID vendors or devices never match anything */
+	if (vendor > 0xffff || device > 0xffff)
+	    continue;
+
+	/* Module names use '_' in modules.alias; match that */
+	for (p = module; *p; p++)
+	    if (*p == '-')
+		*p = '_';
+
+	add_entry(PCIIDX_GROUP_MODULE, PCIIDX_MODULE, vendor, device,
+		  sv > 0xffff ? 0xffff : sv, sd > 0xffff ? 0xffff : sd,
+		  module);
+    }
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+    const struct entry *ea = a, *eb = b;
+    int rv = pciidx_keycmp(&ea->key, &eb->key);
+
+    if (rv)
+	return rv;
+    return ea->seq < eb->seq ? -1 : ea->seq > eb->seq;
+}
+
+static void key_to_le(struct pciidx_key *dst, const struct pciidx_key *src)
+{
+    int i;
+
+    dst->group = src->group;
+    dst->type = src->type;
+    for (i = 0; i < 4; i++)
+	dst->id[i] = htole16(src->id[i]);
+}
+
+static void write_index(FILE *out)
+{
+    static uint8_t page[PCIIDX_PAGE_SIZE];
+    struct pciidx_header *hdr;
+    struct pciidx_rec *rec;
+    size_t hdrsize, off, len;
+    unsigned int i, n, npages;
+
+    qsort(entries, nentries, sizeof *entries, entry_cmp);
+
+    /* Drop exact duplicates; modules.alias is full of them */
+    for (i = n = 0; i < nentries; i++) {
+	if (n && !memcmp(&entries[n - 1].key, &entries[i].key,
+			 sizeof(struct pciidx_key)) &&
+	    !strcmp(entries[n - 1].name, entries[i].name))
+	    continue;
+	entries[n++] = entries[i];
+    }
+    nentries = n;
+
+    /* Lay out the pages, recording the first key of each */
+    hdr = calloc(1, sizeof *hdr +
+		 PCIIDX_MAX_PAGES * sizeof(struct pciidx_key));
+    if (!hdr)
+	die("calloc");
+
+    npages = 0;
+    off = PCIIDX_PAGE_SIZE;
+    for (i = 0; i < nentries; i++) {
+	len = sizeof *rec + strlen(entries[i].name) + 1;
+	if (off + len > PCIIDX_PAGE_SIZE) {
+	    if (npages >= PCIIDX_MAX_PAGES) {
+		fprintf(stderr, "%s: too many entries\n", program);
+		exit(1);
+	    }
+	    key_to_le(&hdr->first[npages++], &entries[i].key);
+	    off = 0;
+	}
+	off += len;
+    }
+
+    hdr->magic = htole32(PCIIDX_MAGIC);
+    hdr->version = htole16(PCIIDX_VERSION);
+    hdr->page_size = htole16(PCIIDX_PAGE_SIZE);
+    hdr->npages = htole32(npages);
+
+    hdrsize = PCIIDX_DATA_OFFSET(npages);
+    hdr = realloc(hdr, hdrsize);
+    if (!hdr)
+	die("realloc");
+    off = sizeof *hdr + npages * sizeof(struct pciidx_key);
+    memset((char *)hdr + off, 0, hdrsize - off);
+    if (fwrite(hdr, 1, hdrsize, out) != hdrsize)
+	die("write");
+    free(hdr);
+
+    /* Then the pages themselves */
+    off = 0;
+    memset(page, 0, sizeof page);
+    for (i = 0; i < nentries; i++) {
+	len = sizeof *rec + strlen(entries[i].name) + 1;
+	if (off + len > PCIIDX_PAGE_SIZE) {
+	    if (fwrite(page, 1, sizeof page, out) != sizeof page)
+		die("write");
+	    memset(page, 0, sizeof page);
+	    off = 0;
+	}
+	rec = (struct pciidx_rec *)(page + off);
+	rec->len = len;
+	key_to_le(&rec->key, &entries[i].key);
+	strcpy(rec->name, entries[i].name);
+	off += len;
+    }
+    if (off && fwrite(page, 1, sizeof page, out) != sizeof page)
+	die("write");
+
+    printf("%u entries in %u pages\n", nentries, npages);
+}
+
+int main(int argc, char *argv[])
+{
+    enum input_type type = INPUT_PCI_IDS;
+    FILE *in, *out;
+    int opt;
+
+    program = argv[0];
+
+    while ((opt = getopt(argc, argv, "am")) != -1) {
+	switch (opt) {
+	case 'a':
+	    type = INPUT_MODULES_ALIAS;
+	    break;
+	case 'm':
+	    type = INPUT_MODULES_PCIMAP;
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (argc - optind != 2)
+	usage();
+
+    if (!strcmp(argv[optind], "-"))
+	in = stdin;
+    else
+	in = fopen(argv[optind], "r");
+    if (!in)
+	die(argv[optind]);
+
+    switch (type) {
+    case INPUT_PCI_IDS:
+	parse_pci_ids(in);
+	break;
+    case INPUT_MODULES_ALIAS:
+	parse_modules_alias(in);
+	break;
+    case INPUT_MODULES_PCIMAP:
+	parse_modules_pcimap(in);
+	break;
+    }
+    fclose(in);
+
+    out = fopen(argv[optind + 1], "w");
+    if (!out)
+	die(argv[optind + 1]);
+    write_index(out);
+    if (fclose(out))
+	die(argv[optind + 1]);
+
+    return 0;
+}
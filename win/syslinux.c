@@ -216,24 +216,31 @@ void error(char *msg)
 /*
  * Wrapper for ReadFile suitable for libfat
  */
-int libfat_readfile(intptr_t pp, void *buf, size_t secsize,
-		    libfat_sector_t sector)
+int libfat_readfile_multi(intptr_t pp, void *buf, size_t secsize,
+			  libfat_sector_t sector, unsigned int nsec)
 {
     uint64_t offset = (uint64_t) sector * secsize;
     LONG loword = (LONG) offset;
     LONG hiword = (LONG) (offset >> 32);
     LONG hiwordx = hiword;
     DWORD bytes_read;
+    DWORD bytes = secsize * nsec;
 
     if (SetFilePointer((HANDLE) pp, loword, &hiwordx, FILE_BEGIN) != loword ||
 	hiword != hiwordx ||
-	!ReadFile((HANDLE) pp, buf, secsize, &bytes_read, NULL) ||
-	bytes_read != secsize) {
+	!ReadFile((HANDLE) pp, buf, bytes, &bytes_read, NULL) ||
+	bytes_read != bytes) {
 	fprintf(stderr, "Cannot read sector %u\n", sector);
 	exit(1);
     }
 
-    return secsize;
+    return bytes;
+}
+
+int libfat_readfile(intptr_t pp, void *buf, size_t secsize,
+		    libfat_sector_t sector)
+{
+    return libfat_readfile_multi(pp, buf, secsize, sector, 1);
 }
 
 int main(int argc, char *argv[])
@@ -417,6 +424,7 @@ int main(int argc, char *argv[])
 	goto map_done;
     }
     fs = libfat_open(libfat_readfile, (intptr_t) d_handle);
+    libfat_set_readmulti(fs, libfat_readfile_multi);
     ldlinux_cluster = libfat_searchdir(fs, 0, "LDLINUX SYS", NULL);
     secp = sectors;
     nsectors = 0;